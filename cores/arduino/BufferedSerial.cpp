@@ -21,16 +21,26 @@
  */
 
 #include "BufferedSerial.h"
+#include "Print.h"
 #include "mbed.h"
 #include <stdarg.h>
+#include <algorithm>
 
 BufferedSerial::BufferedSerial(PinName tx, PinName rx, uint32_t buf_size, uint32_t tx_multiple, const char* name, int sample_rate)
-    : RawSerial(tx, rx, sample_rate) , _rxbuf(buf_size), _txbuf((uint32_t)(tx_multiple*buf_size))
+    : RawSerial(tx, rx, sample_rate) , _rxbuf(buf_size), _txbuf((uint32_t)(tx_multiple*buf_size)), _rxlines(BUFFERED_SERIAL_RX_LINES)
 {
-    RawSerial::attach(callback(this, &BufferedSerial::rxIrq), RawSerial::RxIrq);
-
     this->_buf_size = buf_size;
     this->_tx_multiple = tx_multiple;
+    this->_delim = '\n';
+    this->_rx_overruns = 0;
+    this->_rx_framing_errors = 0;
+    this->_rx_lines_lost = 0;
+    this->_rx_lines_seen = 0;
+#if BUFFERED_SERIAL_TX_ASYNCH
+    this->_tx_async_len = 0;
+#endif
+
+    RawSerial::attach(callback(this, &BufferedSerial::rxIrq), RawSerial::RxIrq);
 
     return;
 }
@@ -45,34 +55,146 @@ BufferedSerial::~BufferedSerial(void)
 
 int BufferedSerial::readable(void)
 {
-    return _rxbuf.use();
+    return _rxbuf.size();
 }
 
 int BufferedSerial::writable(void)
 {
-    return _txbuf.available();
+    return _txbuf.space();
 }
 
 void BufferedSerial::flush(void)
 {
+    // the tx irq is the consumer of _txbuf, so stop it before discarding
+#if BUFFERED_SERIAL_TX_ASYNCH
+    SerialBase::abort_write();
+    _tx_async_len = 0;
+#endif
+    RawSerial::attach(NULL, RawSerial::TxIrq);
     _txbuf.clear();
     _rxbuf.clear();
+    BufferedSerial::rxConsumed();
+}
+
+void BufferedSerial::drain(void)
+{
+    if (__get_IPSR() != 0) {
+        return;
+    }
+
+    while (!_txbuf.empty()) {
+        BufferedSerial::prime();
+        BufferedSerial::txWait();
+    }
 }
 
 int BufferedSerial::peek(void)
 {
-    return _rxbuf.peek();  // note: look if things are in the buffer
+    uint8_t data;
+    return _rxbuf.peek(&data) ? data : -1;  // note: look if things are in the buffer
 }
 
 int BufferedSerial::getc(void)
 {
-    return _rxbuf.getc();
+    uint8_t data;
+    if (!_rxbuf.pop(&data)) {
+        return -1;
+    }
+    BufferedSerial::rxConsumed();
+
+    return data;
+}
+
+int BufferedSerial::get(uint8_t *buffer, int length)
+{
+    if (buffer == NULL || length <= 0) {
+        return 0;
+    }
+
+    int n = _rxbuf.read(buffer, length);
+    BufferedSerial::rxConsumed();
+
+    return n;
+}
+
+int BufferedSerial::peek_buffered(const uint8_t **data)
+{
+    uint32_t len;
+    *data = _rxbuf.peekRead(&len);
+
+    return len;
+}
+
+void BufferedSerial::consume(uint32_t length)
+{
+    _rxbuf.consume(length);
+    BufferedSerial::rxConsumed();
+}
+
+int BufferedSerial::line_length(void)
+{
+    uint32_t lost = _rx_lines_lost;
+
+    if (lost != _rx_lines_seen) {
+        // the index overflowed at some point, so a delimiter may be missing
+        // from it; scan until the buffer holds no unindexed delimiter
+        uint8_t delim = _delim;
+        int32_t idx = _rxbuf.find(delim);
+        if (idx >= 0) {
+            return idx + 1;
+        }
+        _rx_lines_seen = lost;
+    }
+
+    BufferedSerial::rxConsumed();
+
+    uint32_t pos;
+    if (_rxlines.peek(&pos)) {
+        return pos - _rxbuf.readCount() + 1;
+    }
+
+    return 0;
+}
+
+int BufferedSerial::getline(uint8_t *buffer, int length)
+{
+    int n = BufferedSerial::line_length();
+
+    if (n > length) {
+        n = length;
+    }
+
+    return n > 0 ? BufferedSerial::get(buffer, n) : 0;
+}
+
+void BufferedSerial::set_delimiter(int c)
+{
+    core_util_critical_section_enter();
+    _delim = (uint8_t)c;
+
+    // positions recorded for the old delimiter are meaningless now; force a
+    // scan until the buffered data has been consumed
+    uint32_t pos;
+    while (_rxlines.pop(&pos)) {
+    }
+    _rx_lines_seen = _rx_lines_lost - 1;
+    core_util_critical_section_exit();
+}
+
+uint32_t BufferedSerial::rx_overruns(void)
+{
+    return _rx_overruns;
+}
+
+uint32_t BufferedSerial::rx_framing_errors(void)
+{
+    return _rx_framing_errors;
 }
 
 int BufferedSerial::putc(int c)
 {
-    _txbuf.putc(c);
-    BufferedSerial::prime();
+    uint8_t data = (uint8_t)c;
+    BufferedSerial::write(&data, 1);
 
     return c;
 }
@@ -80,16 +202,12 @@ int BufferedSerial::putc(int c)
 int BufferedSerial::puts(const uint8_t *s)
 {
     if (s != NULL) {
-        const uint8_t* ptr = s;
-    
-        while(*(ptr) != 0) {
-            _txbuf.putc(*(ptr++)); 
-        }
+        size_t len = strlen((const char*)s);
 
-        _txbuf.putc('\n');      // done per puts definition
-        BufferedSerial::prime();
-    
-        return (ptr - s) + 1;
+        BufferedSerial::write(s, len);
+        BufferedSerial::putc('\n');   // done per puts definition
+
+        return len + 1;
     }
 
     return 0;
@@ -97,79 +215,265 @@ int BufferedSerial::puts(const uint8_t *s)
 
 ssize_t BufferedSerial::write(const void *s, size_t length)
 {
-    if (s != NULL && length > 0) {
-        const char* ptr = (const char*)s;
-        const char* end = ptr + length;
-    
-        while (ptr != end) {
-            _txbuf.putc(*(ptr++));
-        }
+    if (s == NULL || length == 0) {
+        return 0;
+    }
+
+    if (__get_IPSR() != 0) {
+        return BufferedSerial::writeLocked((const uint8_t*)s, length);
+    }
+
+    _tx_lock.lock();
+    ssize_t r = BufferedSerial::writeLocked((const uint8_t*)s, length);
+    _tx_lock.unlock();
+
+    return r;
+}
+
+ssize_t BufferedSerial::writeLocked(const uint8_t* ptr, size_t length)
+{
+    size_t done = 0;
+    bool isr = __get_IPSR() != 0;
+
+    // copy whole spans into the ring (at most two memcpys per pass); when
+    // the ring is full keep the hardware busy and sleep while it drains,
+    // unless called from an interrupt where the remainder has to be dropped
+    while (done < length) {
+        uint32_t n = _txbuf.write(ptr + done, length - done);
+        done += n;
         BufferedSerial::prime();
-    
-        return ptr - (const char*)s;
+
+        if (isr) {
+            break;
+        }
+        if (n == 0) {
+            BufferedSerial::txWait();
+        }
     }
-    return 0;
+
+    return done;
 }
 
 int BufferedSerial::printf(const char* format, ...)
 {
-    char *buffer = (char*)malloc(this->_buf_size);
-    memset(buffer,0,this->_buf_size);
-    uint32_t r = 0;
- 
     va_list arg;
     va_start(arg, format);
-    r = vsprintf(buffer, format, arg);
-    // this may not hit the heap but should alert the user anyways
-    if(r > this->_buf_size) {
-        error("%s %d buffer overwrite (max_buf_size: %d exceeded: %d)!\r\n", __FILE__, __LINE__,this->_buf_size,r);
-        va_end(arg);
-        free(buffer);
+    int r = BufferedSerial::vprintf(format, arg);
+    va_end(arg);
+
+    return r;
+}
+
+int BufferedSerial::vprintf(const char* format, va_list arg)
+{
+    if (__get_IPSR() != 0) {
+        return BufferedSerial::vprintfLocked(format, arg);
+    }
+
+    _tx_lock.lock();
+    int r = BufferedSerial::vprintfLocked(format, arg);
+    _tx_lock.unlock();
+
+    return r;
+}
+
+int BufferedSerial::vprintfLocked(const char* format, va_list arg)
+{
+    // Print over the locked tx path, for output longer than the whole ring
+    class TxPrint : public Print
+    {
+    public:
+        explicit TxPrint(BufferedSerial* serial) : _serial(serial) {}
+        size_t write(uint8_t c) { return write(&c, 1); }
+        size_t write(const uint8_t* buffer, size_t size)
+        {
+            ssize_t n = _serial->writeLocked(buffer, size);
+            return n < 0 ? 0 : n;
+        }
+    private:
+        BufferedSerial* _serial;
+    };
+
+    uint32_t cap = _txbuf.capacity();
+    uint32_t room;
+    uint8_t* head = _txbuf.acquireWrite(cap, &room);
+    int r;
+
+    // common case: the output (plus the terminator vsnprintf insists on)
+    // fits in the contiguous free region at the write position
+    va_list ap;
+    va_copy(ap, arg);
+    r = vsnprintf((char*)head, room, format, ap);
+    va_end(ap);
+
+    if (r < 0) {
         return 0;
     }
 
-    va_end(arg);
-    r = BufferedSerial::write(buffer, r);
-    free(buffer);
+    if ((uint32_t)r >= room) {
+        if (__get_IPSR() != 0) {
+            // can't wait for the uart here, keep what was formatted
+            r = room > 0 ? room - 1 : 0;
+        } else if ((uint32_t)r > cap - 1) {
+            // longer than the whole ring: format it again a conversion at a
+            // time through Print::vprintf's chunk buffer on the stack, each
+            // chunk waiting for room in the ring as it goes
+            TxPrint out(this);
+            return (int)out.vprintf(format, arg);
+        } else {
+            // let the uart drain the ring, then format at the start of the
+            // storage and rotate the text so it begins at the write position
+            while (!_txbuf.empty()) {
+                BufferedSerial::prime();
+                BufferedSerial::txWait();
+            }
+
+            uint8_t* base = _txbuf.storage();
+            head = _txbuf.acquireWrite(cap, &room);
+
+            va_copy(ap, arg);
+            r = vsnprintf((char*)base, cap, format, ap);
+            va_end(ap);
+
+            if (r < 0) {
+                return 0;
+            }
+
+            std::rotate(base, base + room, base + cap);
+        }
+    }
+
+    _txbuf.commitWrite(r);
+    BufferedSerial::prime();
+
     return r;
 }
 
 void BufferedSerial::rxIrq(void)
 {
-    // read from the peripheral and make sure something is available
-    if(serial_readable(&_serial)) {
-       uint8_t data = serial_getc(&_serial); // if so load them into a buffer
-       _rxbuf.putc(data);
+#if defined(TARGET_STM)
+#if DEVICE_SERIAL_ASYNCH
+    USART_TypeDef *uart = (USART_TypeDef *)_serial.serial.uart;
+#else
+    USART_TypeDef *uart = (USART_TypeDef *)_serial.uart;
+#endif
+#endif
+
+    // drain everything the peripheral holds in one interrupt entry
+    while(serial_readable(&_serial)) {
+#if defined(TARGET_STM)
+        // reading SR then DR (in serial_getc) also clears ORE/FE
+        uint32_t sr = uart->SR;
+        if (sr & USART_SR_ORE) {
+            _rx_overruns++;
+        }
+        if (sr & USART_SR_FE) {
+            _rx_framing_errors++;
+        }
+#endif
+        uint8_t data = serial_getc(&_serial);
+        uint32_t pos = _rxbuf.writeCount();
+
+        if (!_rxbuf.push(data)) {
+            _rx_overruns++;
+            continue;
+        }
+
+        if (data == _delim && !_rxlines.push(pos)) {
+            _rx_lines_lost++;
+        }
     }
 
     return;
 }
 
+void BufferedSerial::rxConsumed(void)
+{
+    // drop index entries for delimiters that have already been read
+    uint32_t read = _rxbuf.readCount();
+    uint32_t pos;
+
+    while (_rxlines.peek(&pos) && (int32_t)(pos - read) < 0) {
+        _rxlines.pop(&pos);
+    }
+}
+
 void BufferedSerial::txIrq(void)
 {
-    // see if there is room in the hardware fifo and if something is in the software fifo
-    while(serial_writable(&_serial)) {
-        if(_txbuf.use() > 0) {
-            int data = _txbuf.getc();
-            serial_putc(&_serial, data);
-        } else {
+    // feed the hardware straight from contiguous regions of the software fifo
+    // and release each region in one step rather than per byte
+    for (;;) {
+        uint32_t len;
+        const uint8_t* data = _txbuf.peekRead(&len);
+
+        if (len == 0) {
             // disable the TX interrupt when there is nothing left to send
             RawSerial::attach(NULL, RawSerial::TxIrq);
             break;
         }
+
+        uint32_t sent = 0;
+        while (sent < len && serial_writable(&_serial)) {
+            serial_putc(&_serial, data[sent++]);
+        }
+        _txbuf.consume(sent);
+
+        if (sent < len) {
+            break;      // hardware fifo is full, the next irq resumes here
+        }
     }
 
     return;
 }
 
+#if BUFFERED_SERIAL_TX_ASYNCH
+void BufferedSerial::txAsyncStart(void)
+{
+    uint32_t len;
+    const uint8_t* data = _txbuf.peekRead(&len);
+
+    _tx_async_len = len;
+    if (len > 0) {
+        SerialBase::write(data, (int)len, callback(this, &BufferedSerial::txAsyncDone), SERIAL_EVENT_TX_COMPLETE);
+    }
+}
+
+void BufferedSerial::txAsyncDone(int event)
+{
+    // the region handed to the HAL is only released once it has been sent
+    _txbuf.consume(_tx_async_len);
+    BufferedSerial::txAsyncStart();
+}
+#endif
+
+void BufferedSerial::txWait(void)
+{
+    // a full ring takes milliseconds to drain; sleep rather than spin so
+    // lower priority threads keep running while this one waits for room.
+    // With interrupts masked the caller can't sleep, but prime() still
+    // feeds the UART by polling, so the loop keeps making progress
+    if (__get_PRIMASK() == 0) {
+        Thread::wait(1);
+    }
+}
+
 void BufferedSerial::prime(void)
 {
+#if BUFFERED_SERIAL_TX_ASYNCH
+    // a transfer in flight will chain the next region from its completion
+    core_util_critical_section_enter();
+    if (_tx_async_len == 0) {
+        BufferedSerial::txAsyncStart();
+    }
+    core_util_critical_section_exit();
+#else
     // if already busy then the irq will pick this up
     if(serial_writable(&_serial)) {
         RawSerial::attach(NULL, RawSerial::TxIrq);    // make sure not to cause contention in the irq
         BufferedSerial::txIrq();                // only write to hardware in one place
         RawSerial::attach(callback(this, &BufferedSerial::txIrq), RawSerial::TxIrq);
     }
+#endif
 
     return;
 }
@@ -25,7 +25,29 @@
 #define BUFFEREDSERIAL_H
  
 #include "mbed.h"
-#include "RingBuffer.h"
+#include <stdarg.h>
+#include "SPSCRingBuffer.h"
+
+/** Feed the UART through the asynchronous serial HAL (one transfer per
+ *  contiguous TX ring region) instead of the per-byte TX interrupt.
+ *  The STM32 asynch HAL takes over the UART interrupt vector while a
+ *  transfer is running, so only enable this on ports that are not also
+ *  relying on the RX interrupt.
+ */
+#ifndef BUFFERED_SERIAL_TX_ASYNCH
+#define BUFFERED_SERIAL_TX_ASYNCH 0
+#endif
+
+#if BUFFERED_SERIAL_TX_ASYNCH && !DEVICE_SERIAL_ASYNCH
+#error "BUFFERED_SERIAL_TX_ASYNCH requires DEVICE_SERIAL_ASYNCH"
+#endif
+
+/** Number of delimiter positions tracked in the RX line index. When more
+ *  complete lines than this are pending, line lookups fall back to a scan.
+ */
+#ifndef BUFFERED_SERIAL_RX_LINES
+#define BUFFERED_SERIAL_RX_LINES 16
+#endif
 
 /** A serial port (UART) for communication with other serial devices
  *
@@ -40,21 +62,38 @@
 class BufferedSerial : public RawSerial 
 {
 private:
-    RingBuffer _rxbuf;
-    RingBuffer _txbuf;
+    SPSCRingBuffer<uint8_t> _rxbuf;
+    SPSCRingBuffer<uint8_t> _txbuf;
+    SPSCRingBuffer<uint32_t> _rxlines;  // _rxbuf positions of each pending delimiter
     uint32_t _buf_size;
     uint32_t _tx_multiple;
+    volatile uint8_t _delim;
+    volatile uint32_t _rx_overruns;
+    volatile uint32_t _rx_framing_errors;
+    volatile uint32_t _rx_lines_lost;   // delimiters that did not fit in _rxlines
+    uint32_t _rx_lines_seen;            // value of _rx_lines_lost once no unindexed delimiter is left
+    PlatformMutex _tx_lock;             // one thread-level producer of _txbuf at a time
+#if BUFFERED_SERIAL_TX_ASYNCH
+    volatile uint32_t _tx_async_len;
+
+    void txAsyncStart(void);
+    void txAsyncDone(int event);
+#endif
  
     void rxIrq(void);
+    void rxConsumed(void);
     void txIrq(void);
     void prime(void);
+    void txWait(void);
+    ssize_t writeLocked(const uint8_t* ptr, std::size_t length);
+    int vprintfLocked(const char* format, va_list arg);
     
 public:
     /** Create a BufferedSerial port, connected to the specified transmit and receive pins
      *  @param tx Transmit pin
      *  @param rx Receive pin
-     *  @param buf_size printf() buffer size
-     *  @param tx_multiple amount of max printf() present in the internal ring buffer at one time
+     *  @param buf_size rx buffer size
+     *  @param tx_multiple tx buffer size as a multiple of buf_size
      *  @param name optional name
      *  @note Either tx or rx may be specified as NC if unused
      */
@@ -81,6 +120,50 @@ public:
      */
     virtual int getc(void);
     
+    /** Get up to length bytes that are already buffered, without waiting.
+     *  @param buffer Destination
+     *  @param length Size of the destination
+     *  @return The number of bytes copied
+     */
+    int get(uint8_t *buffer, int length);
+
+    /** Expose the oldest contiguous run of received bytes without consuming it.
+     *  @param data Receives a pointer to the run; valid until consume()
+     *  @return The length of the run, 0 if nothing is buffered
+     */
+    int peek_buffered(const uint8_t **data);
+
+    /** Release bytes previously exposed by peek_buffered().
+     */
+    void consume(uint32_t length);
+
+    /** Length of the next complete line, found through the delimiter index
+     *  kept by the rx interrupt rather than by scanning the buffer.
+     *  @return Bytes up to and including the delimiter, or 0 if no complete line is buffered
+     */
+    int line_length(void);
+
+    /** Get the next complete line (including its delimiter) without waiting.
+     *  A line longer than length is returned in pieces.
+     *  @param buffer Destination
+     *  @param length Size of the destination
+     *  @return The number of bytes copied, 0 if no complete line is buffered
+     */
+    int getline(uint8_t *buffer, int length);
+
+    /** Set the byte that terminates a line for line_length()/getline(). Default '\n'.
+     */
+    void set_delimiter(int c);
+
+    /** Bytes lost on receive, either because the rx buffer was full or because
+     *  the UART overran before the interrupt could read it.
+     */
+    uint32_t rx_overruns(void);
+
+    /** Bytes received with a framing error (still stored in the rx buffer).
+     */
+    uint32_t rx_framing_errors(void);
+
     /** Write a single byte to the BufferedSerial Port.
      *  @param c The byte to write to the Serial Port
      *  @return The byte that was written to the Serial Port Buffer
@@ -98,14 +181,34 @@ public:
      *  @return The number of bytes written to the Serial Port Buffer
      */
     virtual int printf(const char* format, ...);
+
+    /** Format directly into the free space of the tx buffer. Output that
+     *  would wrap around the end of the buffer waits for it to drain first.
+     *  Output longer than the whole tx buffer is formatted again through
+     *  Print::vprintf's small stack chunk and written in pieces as the tx
+     *  buffer drains; nothing is allocated. From an interrupt nothing waits,
+     *  and output is cut at the free space.
+     *  @param format The string + format specifiers to write to the Serial Port
+     *  @param arg The argument list
+     *  @return The number of bytes written to the Serial Port Buffer
+     */
+    virtual int vprintf(const char* format, va_list arg);
     
     /** Write data to the Buffered Serial Port
+     *  Data is copied into the TX ring in whole spans. When the ring is full
+     *  the call sleeps while the UART drains it (outside interrupt context;
+     *  from an interrupt the data that does not fit is dropped).
      *  @param s A pointer to data to send
      *  @param length The amount of data being pointed to
      *  @return The number of bytes written to the Serial Port Buffer
      */
     virtual ssize_t write(const void *s, std::size_t length);
 
+    /** Wait until everything in the tx buffer has been handed to the UART.
+     *  Does nothing from an interrupt.
+     */
+    void drain(void);
+
     virtual void flush(void);
 };
 
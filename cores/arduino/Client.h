@@ -41,6 +41,10 @@ public:
     virtual void stop() = 0;
     virtual uint8_t connected() = 0;
     virtual operator bool() = 0;
+    // optional write coalescing: between cork() and uncork() small writes may be
+    // gathered and sent together; clients without a write buffer ignore both
+    virtual void cork() { }
+    virtual void uncork() { }
 };
 
 #endif
@@ -25,9 +25,11 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
 #include <Arduino.h>
 
 #include "Print.h"
+#include "PrintfSpec.h"
 
 // Public Methods //////////////////////////////////////////////////////////////
 
@@ -40,62 +42,283 @@ size_t Print::write(const uint8_t *buffer, size_t size) {
     return n;
 }
 
+// Formatted output is produced one conversion at a time into a fixed chunk
+// buffer that is handed to write() whenever it fills, so printf() never needs
+// the heap however long the result is.  A single numeric conversion wider than
+// the chunk (e.g. "%80d") is truncated to PRINTF_CHUNK_SIZE - 1 characters.
+#define PRINTF_CHUNK_SIZE 64
+
+struct PrintfChunk {
+    Print *out;
+    char buf[PRINTF_CHUNK_SIZE];
+    size_t len;
+    size_t total;
+};
+
+static void chunkFlush(PrintfChunk *c) {
+    if(c->len > 0) {
+        c->total += c->out->write((const uint8_t *) c->buf, c->len);
+        c->len = 0;
+    }
+}
+
+static void chunkPut(PrintfChunk *c, const char *s, size_t n) {
+    while(n > 0) {
+        if(c->len == sizeof(c->buf))
+            chunkFlush(c);
+        size_t count = sizeof(c->buf) - c->len;
+        if(count > n)
+            count = n;
+        memcpy(c->buf + c->len, s, count);
+        c->len += count;
+        s += count;
+        n -= count;
+    }
+}
+
+static void chunkPad(PrintfChunk *c, int n) {
+    while(n-- > 0)
+        chunkPut(c, " ", 1);
+}
+
+// format one conversion in place; if it does not fit behind what is already
+// buffered, flush and format it again at the start of the chunk
+template <typename T>
+static void chunkFormat(PrintfChunk *c, const char *spec, T value) {
+    size_t room = sizeof(c->buf) - c->len;
+    int n = snprintf(c->buf + c->len, room, spec, value);
+    if(n < 0)
+        return;
+    if((size_t) n >= room) {
+        chunkFlush(c);
+        n = snprintf(c->buf, sizeof(c->buf), spec, value);
+        if(n < 0)
+            return;
+        if((size_t) n >= sizeof(c->buf))
+            n = sizeof(c->buf) - 1;
+    }
+    c->len += n;
+}
+
+// a conversion handed to snprintf never produces more than a chunk, so wider
+// fields and longer precisions than this give the same output once cut
+#define PRINTF_SPEC_FIELD_MAX 999
+
+// append a width or precision to a rebuilt conversion, never past its end
+static size_t specField(char *spec, size_t sl, size_t size, const char *fmt, int v) {
+    if(v > PRINTF_SPEC_FIELD_MAX)
+        v = PRINTF_SPEC_FIELD_MAX;
+    int n = snprintf(spec + sl, size - sl, fmt, v);
+    if(n > 0)
+        sl += n;
+    return sl < size ? sl : size - 1;
+}
+
+// length modifiers as written, indexed by PRINTF_LEN_*
+static const char *const specLength[] = { "", "hh", "h", "l", "ll", "z", "j", "t", "L" };
+
+size_t Print::vprintf(const char *format, va_list arg) {
+    PrintfChunk c;
+    c.out = this;
+    c.len = 0;
+    c.total = 0;
+
+    const char *p = format;
+    while(*p) {
+        const char *literal = p;
+        while(*p && *p != '%')
+            p++;
+        chunkPut(&c, literal, p - literal);
+        if(*p == 0)
+            break;
+
+        printf_spec_t ps;
+        const char *start = p;
+        p = printf_spec_scan(p, &ps);
+        if(ps.conversion == '%') {
+            chunkPut(&c, "%", 1);
+            continue;
+        }
+        char conv = ps.conversion;
+        if(conv == 0)
+            break;
+
+        // rebuild the conversion with '*' arguments resolved so it can be
+        // handed to snprintf on its own
+        char spec[32];
+        size_t sl = 0;
+        bool left = false;
+        bool plain = true;  // no flags other than '-'
+        int width = ps.width;
+        int prec = ps.precision;
+        int len = ps.length;
+
+        spec[sl++] = '%';
+        for(uint8_t i = 0; i < ps.flag_count; i++) {
+            if(ps.flags[i] == '-')
+                left = true;
+            else
+                plain = false;
+            if(sl < 8)
+                spec[sl++] = ps.flags[i];
+        }
+        if(width == PRINTF_FIELD_STAR) {
+            width = va_arg(arg, int);
+            if(width < 0) {
+                left = true;
+                width = (width == INT_MIN) ? INT_MAX : -width;
+                spec[sl++] = '-';
+            }
+        }
+        if(prec == PRINTF_FIELD_STAR) {
+            prec = va_arg(arg, int);
+            if(prec < 0)
+                prec = PRINTF_FIELD_NONE;   // a negative precision is taken as omitted
+        }
+        // '%' and the flags take at most 9 bytes and each field at most 4,
+        // so the length modifier and conversion below always fit
+        if(width >= 0)
+            sl = specField(spec, sl, sizeof(spec), "%d", width);
+        if(prec >= 0)
+            sl = specField(spec, sl, sizeof(spec), ".%d", prec);
+        for(const char *m = specLength[len]; *m; m++)
+            spec[sl++] = *m;
+        spec[sl++] = conv;
+        spec[sl] = 0;
+
+        switch(conv) {
+            case 'd':
+            case 'i':
+                if(len == PRINTF_LEN_L)
+                    chunkFormat(&c, spec, va_arg(arg, long));
+                else if(len == PRINTF_LEN_LL)
+                    chunkFormat(&c, spec, va_arg(arg, long long));
+                else if(len == PRINTF_LEN_Z)
+                    chunkFormat(&c, spec, va_arg(arg, ssize_t));
+                else if(len == PRINTF_LEN_J)
+                    chunkFormat(&c, spec, va_arg(arg, intmax_t));
+                else if(len == PRINTF_LEN_T)
+                    chunkFormat(&c, spec, va_arg(arg, ptrdiff_t));
+                else
+                    chunkFormat(&c, spec, va_arg(arg, int));
+                break;
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                if(len == PRINTF_LEN_L)
+                    chunkFormat(&c, spec, va_arg(arg, unsigned long));
+                else if(len == PRINTF_LEN_LL)
+                    chunkFormat(&c, spec, va_arg(arg, unsigned long long));
+                else if(len == PRINTF_LEN_Z)
+                    chunkFormat(&c, spec, va_arg(arg, size_t));
+                else if(len == PRINTF_LEN_J)
+                    chunkFormat(&c, spec, va_arg(arg, uintmax_t));
+                else if(len == PRINTF_LEN_T)
+                    chunkFormat(&c, spec, va_arg(arg, ptrdiff_t));
+                else
+                    chunkFormat(&c, spec, va_arg(arg, unsigned int));
+                break;
+            case 'c':
+                chunkFormat(&c, spec, va_arg(arg, int));
+                break;
+            case 'p':
+                chunkFormat(&c, spec, va_arg(arg, void *));
+                break;
+            case 'f':
+                // the common "%.2f" goes through the integer formatter; wider
+                // values and flags are left to snprintf
+                if(len != PRINTF_LEN_LD) {
+                    double d = va_arg(arg, double);
+                    if(plain && prec < 64 - DTOA_FIXED_SIZE(0)
+                            && d <= 4294967040.0 && d >= -4294967040.0
+                            && (d != 0.0 || !signbit(d))) {
+                        char num[64];
+                        int n = dtoa_fixed(d, prec < 0 ? 6 : prec, num);
+                        int pad = (width > n) ? width - n : 0;
+                        if(!left)
+                            chunkPad(&c, pad);
+                        chunkPut(&c, num, n);
+                        if(left)
+                            chunkPad(&c, pad);
+                    } else {
+                        chunkFormat(&c, spec, d);
+                    }
+                    break;
+                }
+                // fall through
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                if(len == PRINTF_LEN_LD)
+                    chunkFormat(&c, spec, va_arg(arg, long double));
+                else
+                    chunkFormat(&c, spec, va_arg(arg, double));
+                break;
+            case 's': {
+                // strings are streamed straight through, whatever their length
+                const char *str = va_arg(arg, const char *);
+                if(str == NULL)
+                    str = "(null)";
+                size_t n = (prec >= 0) ? strnlen(str, prec) : strlen(str);
+                int pad = (width > (int) n) ? width - (int) n : 0;
+                if(!left)
+                    chunkPad(&c, pad);
+                chunkPut(&c, str, n);
+                if(left)
+                    chunkPad(&c, pad);
+                break;
+            }
+            case 'n': {
+                size_t count = c.total + c.len;
+                if(len == PRINTF_LEN_HH)
+                    *va_arg(arg, signed char *) = count;
+                else if(len == PRINTF_LEN_H)
+                    *va_arg(arg, short *) = count;
+                else if(len == PRINTF_LEN_L)
+                    *va_arg(arg, long *) = count;
+                else if(len == PRINTF_LEN_LL)
+                    *va_arg(arg, long long *) = count;
+                else
+                    *va_arg(arg, int *) = count;
+                break;
+            }
+            default:
+                // unknown conversion: emit it verbatim
+                chunkPut(&c, start, p - start);
+                break;
+        }
+    }
+
+    chunkFlush(&c);
+    return c.total;
+}
+
 size_t Print::printf(const char *format, ...) {
     va_list arg;
     va_start(arg, format);
-    char temp[64];
-    char* buffer = temp;
-    size_t len = vsnprintf(temp, sizeof(temp), format, arg);
+    size_t len = vprintf(format, arg);
     va_end(arg);
-    if (len > sizeof(temp) - 1) {
-        buffer = new char[len + 1];
-        if (!buffer) {
-            return 0;
-        }
-        va_start(arg, format);
-        vsnprintf(buffer, len + 1, format, arg);
-        va_end(arg);
-    }
-    len = write((const uint8_t*) buffer, len);
-    if (buffer != temp) {
-        delete[] buffer;
-    }
     return len;
 }
 
 size_t Print::printf_P(PGM_P format, ...) {
     va_list arg;
     va_start(arg, format);
-    char temp[64];
-    char* buffer = temp;
-    size_t len = vsnprintf_P(temp, sizeof(temp), format, arg);
+    size_t len = vprintf(format, arg);
     va_end(arg);
-    if (len > sizeof(temp) - 1) {
-        buffer = new char[len + 1];
-        if (!buffer) {
-            return 0;
-        }
-        va_start(arg, format);
-        vsnprintf_P(buffer, len + 1, format, arg);
-        va_end(arg);
-    }
-    len = write((const uint8_t*) buffer, len);
-    if (buffer != temp) {
-        delete[] buffer;
-    }
     return len;
 }
 
 size_t Print::print(const __FlashStringHelper *ifsh) {
     PGM_P p = reinterpret_cast<PGM_P>(ifsh);
 
-    size_t n = 0;
-    while (1) {
-        uint8_t c = pgm_read_byte(p++);
-        if (c == 0) break;
-        n += write(c);
-    }
-    return n;
+    // flash is memory mapped, so the string goes out in one write
+    return write((const uint8_t *) p, strlen_P(p));
 }
 
 size_t Print::print(const String &s) {
@@ -127,9 +350,7 @@ size_t Print::print(long n, int base) {
         return write(n);
     } else if(base == 10) {
         if(n < 0) {
-            int t = print('-');
-            n = -n;
-            return printNumber(n, 10) + t;
+            return printNumber(-(unsigned long) n, 10, true);
         }
         return printNumber(n, 10);
     } else {
@@ -224,8 +445,8 @@ size_t Print::println(const Printable& x) {
 
 // Private Methods /////////////////////////////////////////////////////////////
 
-size_t Print::printNumber(unsigned long n, uint8_t base) {
-    char buf[8 * sizeof(long) + 1]; // Assumes 8-bit chars plus zero byte.
+size_t Print::printNumber(unsigned long n, uint8_t base, bool negative) {
+    char buf[8 * sizeof(long) + 2]; // Assumes 8-bit chars plus sign and zero byte.
     char *str = &buf[sizeof(buf) - 1];
 
     *str = '\0';
@@ -241,51 +462,28 @@ size_t Print::printNumber(unsigned long n, uint8_t base) {
         *--str = c < 10 ? c + '0' : c + 'A' - 10;
     } while(n);
 
-    return write(str);
+    if(negative)
+        *--str = '-';
+
+    return write((const uint8_t *) str, &buf[sizeof(buf) - 1] - str);
 }
 
 size_t Print::printFloat(double number, uint8_t digits) {
-    size_t n = 0;
-
-    if(isnan(number))
-        return print("nan");
-    if(isinf(number))
-        return print("inf");
-    if(number > 4294967040.0)
-        return print("ovf");  // constant determined empirically
-    if(number < -4294967040.0)
-        return print("ovf");  // constant determined empirically
-
-    // Handle negative numbers
-    if(number < 0.0) {
-        n += print('-');
-        number = -number;
-    }
-
-    // Round correctly so that print(1.999, 2) prints as "2.00"
-    double rounding = 0.5;
-    for(uint8_t i = 0; i < digits; ++i)
-        rounding /= 10.0;
-
-    number += rounding;
-
-    // Extract the integer part of the number and print it
-    unsigned long int_part = (unsigned long) number;
-    double remainder = number - (double) int_part;
-    n += print(int_part);
-
-    // Print the decimal point, but only if there are digits beyond
-    if(digits > 0) {
-        n += print(".");
-    }
-
-    // Extract digits from the remainder one at a time
-    while(digits-- > 0) {
-        remainder *= 10.0;
-        int toPrint = int(remainder);
-        n += print(toPrint);
-        remainder -= toPrint;
+    // formatted in one go by dtoa_fixed() (floatIO.c) and written at once;
+    // decimals past what fits in buf are printed as zeros
+    char buf[64];
+    uint8_t exact = digits;
+    if(DTOA_FIXED_SIZE(exact) > sizeof(buf))
+        exact = sizeof(buf) - DTOA_FIXED_SIZE(0);
+
+    size_t n = write((const uint8_t *) buf, dtoa_fixed(number, exact, buf));
+    if(exact < digits && buf[0] != 'n' && buf[0] != 'i' && buf[0] != 'o') {
+        memset(buf, '0', sizeof(buf));
+        for(uint8_t left = digits - exact; left > 0;) {
+            uint8_t count = left < sizeof(buf) ? left : sizeof(buf);
+            n += write((const uint8_t *) buf, count);
+            left -= count;
+        }
     }
-
     return n;
 }
@@ -22,6 +22,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdarg.h>
 
 #include "WString.h"
 #include "Printable.h"
@@ -34,7 +35,7 @@
 class Print {
     private:
         int write_error;
-        size_t printNumber(unsigned long, uint8_t);
+        size_t printNumber(unsigned long, uint8_t, bool negative = false);
         size_t printFloat(double, uint8_t);
     protected:
         void setWriteError(int err = 1) {
@@ -63,6 +64,9 @@ class Print {
             return write((const unsigned char *) buffer, size);
         }
 
+        // formatted output is streamed to write() through a small fixed buffer,
+        // without heap allocation; subclasses may format more directly
+        virtual size_t vprintf(const char * format, va_list arg);
         size_t printf(const char * format, ...)  __attribute__ ((format (printf, 2, 3)));
         size_t printf_P(PGM_P format, ...) __attribute__((format(printf, 2, 3)));
         size_t print(const __FlashStringHelper *);
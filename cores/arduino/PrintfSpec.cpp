@@ -0,0 +1,127 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+#include "PrintfSpec.h"
+#include <limits.h>
+#include <string.h>
+
+// decimal field in a format string, saturating instead of overflowing
+static int spec_digits(const char **p)
+{
+    int v = 0;
+    while (**p >= '0' && **p <= '9')
+    {
+        int d = *(*p)++ - '0';
+        v = (v > (INT_MAX - d) / 10) ? INT_MAX : v * 10 + d;
+    }
+    return v;
+}
+
+const char *printf_spec_scan(const char *p, printf_spec_t *spec)
+{
+    spec->start = p++;
+    spec->flags = p;
+    while (*p && strchr("-+ #0", *p))
+    {
+        p++;
+    }
+    spec->flag_count = (p - spec->flags) < 255 ? (uint8_t)(p - spec->flags) : 255;
+
+    spec->width = PRINTF_FIELD_NONE;
+    if (*p == '*')
+    {
+        spec->width = PRINTF_FIELD_STAR;
+        p++;
+    }
+    else if (*p >= '0' && *p <= '9')
+    {
+        spec->width = spec_digits(&p);
+    }
+
+    spec->precision = PRINTF_FIELD_NONE;
+    if (*p == '.')
+    {
+        p++;
+        if (*p == '*')
+        {
+            spec->precision = PRINTF_FIELD_STAR;
+            p++;
+        }
+        else
+        {
+            spec->precision = spec_digits(&p);
+        }
+    }
+
+    spec->length = PRINTF_LEN_NONE;
+    switch (*p)
+    {
+        case 'h':
+            p++;
+            spec->length = PRINTF_LEN_H;
+            if (*p == 'h')
+            {
+                p++;
+                spec->length = PRINTF_LEN_HH;
+            }
+            break;
+        case 'l':
+            p++;
+            spec->length = PRINTF_LEN_L;
+            if (*p == 'l')
+            {
+                p++;
+                spec->length = PRINTF_LEN_LL;
+            }
+            break;
+        case 'z': p++; spec->length = PRINTF_LEN_Z; break;
+        case 'j': p++; spec->length = PRINTF_LEN_J; break;
+        case 't': p++; spec->length = PRINTF_LEN_T; break;
+        case 'L': p++; spec->length = PRINTF_LEN_LD; break;
+    }
+
+    spec->conversion = *p;
+    if (*p)
+    {
+        p++;
+    }
+    spec->end = p;
+    return p;
+}
+
+uint8_t printf_spec_arg(const printf_spec_t *spec)
+{
+    switch (spec->conversion)
+    {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+            switch (spec->length)
+            {
+                case PRINTF_LEN_L: return PRINTF_ARG_LONG;
+                case PRINTF_LEN_LL: return PRINTF_ARG_LLONG;
+                case PRINTF_LEN_Z: return PRINTF_ARG_SIZE;
+                case PRINTF_LEN_J: return PRINTF_ARG_INTMAX;
+                case PRINTF_LEN_T: return PRINTF_ARG_PTRDIFF;
+                default: return PRINTF_ARG_INT;    // char and short are promoted
+            }
+        case 'c':
+            return PRINTF_ARG_INT;
+        case 'p':
+            return PRINTF_ARG_PTR;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            return (spec->length == PRINTF_LEN_LD) ? PRINTF_ARG_LDOUBLE : PRINTF_ARG_DOUBLE;
+        case 's':
+            return PRINTF_ARG_STRING;
+        case 'n':
+            return PRINTF_ARG_COUNT;
+        default:
+            return PRINTF_ARG_NONE;
+    }
+}
+
+uint8_t printf_spec_stars(const printf_spec_t *spec)
+{
+    if (spec->conversion == '%' || spec->conversion == 0)
+    {
+        return 0;
+    }
+    return (spec->width == PRINTF_FIELD_STAR) + (spec->precision == PRINTF_FIELD_STAR);
+}
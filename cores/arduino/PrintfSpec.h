@@ -0,0 +1,81 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+#ifndef __PRINTF_SPEC_H__
+#define __PRINTF_SPEC_H__
+
+#include <stdint.h>
+
+/*
+ * printf conversion scanner.
+ *
+ * Splits one conversion ("%-08.*lld") into its flags, width, precision,
+ * length modifier and conversion character, so the printf-style formatters
+ * (Print::vprintf, the deferred serial log) agree on what a format means and
+ * on which arguments it takes.
+ */
+
+// width / precision that is absent, or given as a '*' argument
+#define PRINTF_FIELD_NONE   -1
+#define PRINTF_FIELD_STAR   -2
+
+enum
+{
+    PRINTF_LEN_NONE,
+    PRINTF_LEN_HH,
+    PRINTF_LEN_H,
+    PRINTF_LEN_L,
+    PRINTF_LEN_LL,
+    PRINTF_LEN_Z,
+    PRINTF_LEN_J,
+    PRINTF_LEN_T,
+    PRINTF_LEN_LD
+};
+
+// C type the value of a conversion is passed as
+enum
+{
+    PRINTF_ARG_NONE,        // "%%", unknown or cut-off conversion
+    PRINTF_ARG_INT,
+    PRINTF_ARG_LONG,
+    PRINTF_ARG_LLONG,
+    PRINTF_ARG_SIZE,
+    PRINTF_ARG_INTMAX,
+    PRINTF_ARG_PTRDIFF,
+    PRINTF_ARG_PTR,
+    PRINTF_ARG_DOUBLE,
+    PRINTF_ARG_LDOUBLE,
+    PRINTF_ARG_STRING,
+    PRINTF_ARG_COUNT        // %n, a pointer that is written through
+};
+
+typedef struct
+{
+    const char *start;      // the '%'
+    const char *end;        // past the conversion character
+    const char *flags;      // the "-+ #0" run after the '%'
+    uint8_t flag_count;
+    int width;              // literal value (saturated), or PRINTF_FIELD_*
+    int precision;
+    uint8_t length;         // PRINTF_LEN_*
+    char conversion;        // 0 if the format ends inside the conversion
+} printf_spec_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Scan the conversion starting at the '%' p points to; returns spec->end. */
+const char *printf_spec_scan(const char *p, printf_spec_t *spec);
+
+/** PRINTF_ARG_* type of the value the conversion consumes, after any '*'. */
+uint8_t printf_spec_arg(const printf_spec_t *spec);
+
+/** Number of '*' int arguments that come before the value. */
+uint8_t printf_spec_stars(const printf_spec_t *spec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __PRINTF_SPEC_H__
@@ -0,0 +1,303 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+/**
+ * @file SPSCRingBuffer.h
+ * @brief Lock-free single-producer / single-consumer ring buffer.
+ *
+ * Capacity is rounded up to a power of two so index wrapping is a mask
+ * instead of a modulo, and every slot is usable (no "one empty slot" rule).
+ * The head index is only written by the producer and the tail index only by
+ * the consumer; each side publishes its index with release semantics and
+ * reads the other side's with acquire semantics, which makes the hand-off
+ * between an ISR and a thread (or a DMA completion callback) well defined.
+ *
+ * Besides the usual element-at-a-time calls, the buffer exposes contiguous
+ * spans so callers can memcpy or DMA directly into / out of the storage:
+ *
+ * @code
+ *   uint32_t n;
+ *   uint8_t *dst = ring.acquireWrite(len, &n);  // n <= len, may be < len at wrap
+ *   memcpy(dst, src, n);
+ *   ring.commitWrite(n);
+ *
+ *   const uint8_t *src = ring.peekRead(&n);     // n bytes contiguous
+ *   serial_tx(src, n);
+ *   ring.consume(n);
+ * @endcode
+ */
+
+#ifndef SPSC_RING_BUFFER_H
+#define SPSC_RING_BUFFER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+template <typename T>
+class SPSCRingBuffer
+{
+public:
+    /** Create a ring buffer
+     *  @param capacity minimum number of elements; rounded up to a power of two
+     */
+    explicit SPSCRingBuffer(uint32_t capacity)
+        : _owned(true), _head(0), _tail(0)
+    {
+        uint32_t size = 1;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        _mask = size - 1;
+        _buf = new T[size];
+    }
+
+    /** Create a ring buffer over caller-owned storage
+     *  @param storage  at least capacity elements; must outlive the buffer
+     *  @param capacity a power of two
+     */
+    SPSCRingBuffer(T *storage, uint32_t capacity)
+        : _buf(storage), _mask(capacity - 1), _owned(false), _head(0), _tail(0)
+    {
+    }
+
+    ~SPSCRingBuffer()
+    {
+        if (_owned)
+        {
+            delete [] _buf;
+        }
+    }
+
+    /** Total number of elements the buffer can hold */
+    uint32_t capacity() const
+    {
+        return _mask + 1;
+    }
+
+    /** Number of elements ready to be read */
+    uint32_t size() const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    /** Number of elements that can be written */
+    uint32_t space() const
+    {
+        return capacity() - size();
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    bool full() const
+    {
+        return size() == capacity();
+    }
+
+    /** Free-running count of elements ever written (producer position) */
+    uint32_t writeCount() const
+    {
+        return _head.load(std::memory_order_acquire);
+    }
+
+    /** Free-running count of elements ever read (consumer position) */
+    uint32_t readCount() const
+    {
+        return _tail.load(std::memory_order_acquire);
+    }
+
+    /* ---------------------------------------------------------------------
+     * Producer side
+     * ------------------------------------------------------------------- */
+
+    /** Append one element
+     *  @return true on success, false if the buffer is full
+     */
+    bool push(const T &item)
+    {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) > _mask)
+        {
+            return false;
+        }
+        _buf[head & _mask] = item;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Append up to len elements using at most two copies
+     *  @return number of elements written
+     */
+    uint32_t write(const T *data, uint32_t len)
+    {
+        uint32_t done = 0;
+        while (done < len)
+        {
+            uint32_t n;
+            T *dst = acquireWrite(len - done, &n);
+            if (n == 0)
+            {
+                break;
+            }
+            memcpy(dst, data + done, n * sizeof(T));
+            commitWrite(n);
+            done += n;
+        }
+        return done;
+    }
+
+    /** Reserve a contiguous writable region
+     *  @param wanted  number of elements the caller would like to write
+     *  @param granted receives the contiguous length available (<= wanted)
+     *  @return pointer to the start of the region; valid until commitWrite()
+     */
+    T *acquireWrite(uint32_t wanted, uint32_t *granted)
+    {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        uint32_t free = capacity() - (head - _tail.load(std::memory_order_acquire));
+        uint32_t offset = head & _mask;
+        uint32_t contiguous = capacity() - offset;
+        uint32_t n = wanted;
+        if (n > free)
+        {
+            n = free;
+        }
+        if (n > contiguous)
+        {
+            n = contiguous;
+        }
+        *granted = n;
+        return _buf + offset;
+    }
+
+    /** Publish elements written into the region returned by acquireWrite() */
+    void commitWrite(uint32_t n)
+    {
+        _head.store(_head.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    /** Start of the underlying storage. Only for producers that lay out a
+     *  wrapped span in place while the buffer is empty and the consumer idle.
+     */
+    T *storage()
+    {
+        return _buf;
+    }
+
+    /* ---------------------------------------------------------------------
+     * Consumer side
+     * ------------------------------------------------------------------- */
+
+    /** Remove one element
+     *  @return true on success, false if the buffer is empty
+     */
+    bool pop(T *item)
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (_head.load(std::memory_order_acquire) == tail)
+        {
+            return false;
+        }
+        *item = _buf[tail & _mask];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Look at the oldest element without removing it
+     *  @return true on success, false if the buffer is empty
+     */
+    bool peek(T *item) const
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (_head.load(std::memory_order_acquire) == tail)
+        {
+            return false;
+        }
+        *item = _buf[tail & _mask];
+        return true;
+    }
+
+    /** Remove up to len elements using at most two copies
+     *  @return number of elements read
+     */
+    uint32_t read(T *data, uint32_t len)
+    {
+        uint32_t done = 0;
+        while (done < len)
+        {
+            uint32_t n;
+            const T *src = peekRead(&n);
+            if (n == 0)
+            {
+                break;
+            }
+            if (n > len - done)
+            {
+                n = len - done;
+            }
+            memcpy(data + done, src, n * sizeof(T));
+            consume(n);
+            done += n;
+        }
+        return done;
+    }
+
+    /** Find the first readable element equal to item. Consumer side.
+     *  @return offset from the oldest element, or -1 if not present
+     */
+    int32_t find(const T &item) const
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t used = _head.load(std::memory_order_acquire) - tail;
+        for (uint32_t i = 0; i < used; i++)
+        {
+            if (_buf[(tail + i) & _mask] == item)
+            {
+                return (int32_t)i;
+            }
+        }
+        return -1;
+    }
+
+    /** Get the contiguous readable region starting at the oldest element
+     *  @param len receives the number of contiguous elements
+     *  @return pointer to the region; valid until consume()
+     */
+    const T *peekRead(uint32_t *len) const
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t used = _head.load(std::memory_order_acquire) - tail;
+        uint32_t offset = tail & _mask;
+        uint32_t contiguous = capacity() - offset;
+        *len = used < contiguous ? used : contiguous;
+        return _buf + offset;
+    }
+
+    /** Release n elements previously returned by peekRead() */
+    void consume(uint32_t n)
+    {
+        _tail.store(_tail.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    /** Discard everything currently readable. Consumer side only. */
+    void clear()
+    {
+        _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    SPSCRingBuffer(const SPSCRingBuffer &);
+    SPSCRingBuffer &operator=(const SPSCRingBuffer &);
+
+    T *_buf;
+    uint32_t _mask;
+    bool _owned;
+    std::atomic<uint32_t> _head;
+    std::atomic<uint32_t> _tail;
+};
+
+#endif // SPSC_RING_BUFFER_H
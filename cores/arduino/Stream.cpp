@@ -60,6 +60,19 @@ int Stream::timedPeek() {
 int Stream::peekNextDigit() {
     int c;
     while(1) {
+        const uint8_t *data;
+        int n = peekBuffered(&data);
+        if(n > 0) {
+            // skip the whole non-numeric run in one step
+            int i = 0;
+            while(i < n && data[i] != '-' && (data[i] < '0' || data[i] > '9'))
+                i++;
+            c = (i < n) ? data[i] : -1;
+            consumeBuffered(i);
+            if(c >= 0)
+                return c;
+            continue;
+        }
         c = timedPeek();
         if(c < 0)
             return c;  // timeout
@@ -95,26 +108,115 @@ bool Stream::findUntil(const char *target, const char *terminator) {
     return findUntil(target, strlen(target), terminator, strlen(terminator));
 }
 
+// Knuth-Morris-Pratt failure table: fail[i] is the length of the longest proper
+// prefix of pattern[0..i] that is also a suffix of it
+static void findFailureTable(const char *pattern, size_t len, size_t *fail) {
+    size_t k = 0;
+    if(len == 0)
+        return;
+    fail[0] = 0;
+    for(size_t i = 1; i < len; i++) {
+        while(k > 0 && pattern[i] != pattern[k])
+            k = fail[k - 1];
+        if(pattern[i] == pattern[k])
+            k++;
+        fail[i] = k;
+    }
+}
+
+// advance a match of pattern by one character, returns true on a full match
+static bool findStep(const char *pattern, size_t len, const size_t *fail, size_t *index, char c) {
+    if(len == 0)
+        return false;
+    while(*index > 0 && c != pattern[*index])
+        *index = fail[*index - 1];
+    if(c == pattern[*index])
+        (*index)++;
+    return *index >= len;
+}
+
 // reads data from the stream until the target string of the given length is found
 // search terminated if the terminator string is found
 // returns true if target string is found, false if terminated or timed out
 bool Stream::findUntil(const char *target, size_t targetLen, const char *terminator, size_t termLen) {
-    size_t index = 0;  // maximum target string length is 64k bytes!
-    size_t termIndex = 0;
-    int c;
+    size_t tables[2 * FIND_TABLE_SIZE];
+    size_t *targetFail = tables;
+    size_t *termFail = tables + FIND_TABLE_SIZE;
+    size_t *heap = NULL;
 
     if(*target == 0)
         return true;   // return true if target is a null string
-    while((c = timedRead()) > 0) {
 
+    if(targetLen > FIND_TABLE_SIZE || termLen > FIND_TABLE_SIZE) {
+        heap = (size_t *) malloc((targetLen + termLen) * sizeof(size_t));
+        if(heap == NULL)
+            return findUntilLong(target, targetLen, terminator, termLen);
+        targetFail = heap;
+        termFail = heap + targetLen;
+    }
+    findFailureTable(target, targetLen, targetFail);
+    findFailureTable(terminator, termLen, termFail);
+
+    bool found = findUntilMatch(target, targetLen, targetFail, terminator, termLen, termFail);
+    free(heap);
+    return found;
+}
+
+// the KMP search behind findUntil, over failure tables built by the caller
+bool Stream::findUntilMatch(const char *target, size_t targetLen, const size_t *targetFail,
+                            const char *terminator, size_t termLen, const size_t *termFail) {
+    size_t index = 0;
+    size_t termIndex = 0;
+    int c;
+
+    while(1) {
+        const uint8_t *data;
+        int n = peekBuffered(&data);
+        if(n > 0) {
+            // match across the whole buffered run, consuming up to the hit
+            for(int i = 0; i < n; i++) {
+                c = data[i];
+                if(c == 0) {
+                    consumeBuffered(i + 1);
+                    return false;
+                }
+                if(findStep(target, targetLen, targetFail, &index, c)) {
+                    consumeBuffered(i + 1);
+                    return true;     // return true if all chars in the target match
+                }
+                if(findStep(terminator, termLen, termFail, &termIndex, c)) {
+                    consumeBuffered(i + 1);
+                    return false;    // return false if terminate string found before target string
+                }
+            }
+            consumeBuffered(n);
+            continue;
+        }
+
+        c = timedRead();
+        if(c <= 0)
+            return false;
+        if(findStep(target, targetLen, targetFail, &index, c))
+            return true;
+        if(findStep(terminator, termLen, termFail, &termIndex, c))
+            return false;
+    }
+}
+
+// findUntil without failure tables, for when the heap can't hold them: the
+// original byte-at-a-time match, which resets on a mismatch
+bool Stream::findUntilLong(const char *target, size_t targetLen, const char *terminator, size_t termLen) {
+    size_t index = 0;
+    size_t termIndex = 0;
+    int c;
+
+    while((c = timedRead()) > 0) {
         if(c != target[index])
             index = 0; // reset index if any char does not match
 
         if(c == target[index]) {
-            //////Serial.print("found "); Serial.write(c); Serial.print("index now"); Serial.println(index+1);
-            if(++index >= targetLen) { // return true if all chars in the target match
+            if(++index >= targetLen) // return true if all chars in the target match
                 return true;
-            }
         }
 
         if(termLen > 0 && c == terminator[termIndex]) {
@@ -126,6 +228,55 @@ bool Stream::findUntil(const char *target, size_t targetLen, const char *termina
     return false;
 }
 
+// digit-run state shared by the buffered and byte-at-a-time paths of parseInt/parseFloat
+struct NumberRun {
+    boolean first;
+    boolean isNegative;
+    boolean isFraction;
+    long value;
+    float fraction;
+};
+
+// feed one character to a number run, returns false when the run has ended
+static boolean numberStep(NumberRun *run, int c, char skipChar, boolean allowFraction) {
+    if(c == skipChar)
+        ; // ignore this charactor
+    else if(run->first && c == '-')
+        run->isNegative = true;
+    else if(allowFraction && c == '.')
+        run->isFraction = true;
+    else if(c >= '0' && c <= '9') {      // is c a digit?
+        run->value = run->value * 10 + c - '0';
+        if(run->isFraction)
+            run->fraction *= 0.1;
+    }
+    else
+        return false;
+    run->first = false;
+    return true;
+}
+
+// consume a number run, taking whole buffered spans where the stream offers them
+void Stream::parseNumberRun(NumberRun *run, char skipChar, bool allowFraction) {
+    while(1) {
+        const uint8_t *data;
+        int n = peekBuffered(&data);
+        if(n > 0) {
+            int i = 0;
+            while(i < n && numberStep(run, data[i], skipChar, allowFraction))
+                i++;
+            consumeBuffered(i);
+            if(i < n)
+                return;
+            continue;
+        }
+        int c = timedPeek();
+        if(c < 0 || !numberStep(run, c, skipChar, allowFraction))
+            return;
+        read();  // consume the character we got with peek
+    }
+}
+
 // returns the first valid (long) integer value from the current position.
 // initial characters that are not digits (or the minus sign) are skipped
 // function is terminated by the first character that is not a digit.
@@ -136,29 +287,17 @@ long Stream::parseInt() {
 // as above but a given skipChar is ignored
 // this allows format characters (typically commas) in values to be ignored
 long Stream::parseInt(char skipChar) {
-    boolean isNegative = false;
-    long value = 0;
-    int c;
+    NumberRun run = { true, false, false, 0, 1.0 };
 
-    c = peekNextDigit();
     // ignore non numeric leading characters
-    if(c < 0)
+    if(peekNextDigit() < 0)
         return 0; // zero returned if timeout
 
-    do {
-        if(c == skipChar)
-            ; // ignore this charactor
-        else if(c == '-')
-            isNegative = true;
-        else if(c >= '0' && c <= '9')        // is c a digit?
-            value = value * 10 + c - '0';
-        read();  // consume the character we got with peek
-        c = timedPeek();
-    } while((c >= '0' && c <= '9') || c == skipChar);
+    parseNumberRun(&run, skipChar, false);
 
-    if(isNegative)
-        value = -value;
-    return value;
+    if(run.isNegative)
+        run.value = -run.value;
+    return run.value;
 }
 
 // as parseInt but returns a floating point value
@@ -169,39 +308,20 @@ float Stream::parseFloat() {
 // as above but the given skipChar is ignored
 // this allows format characters (typically commas) in values to be ignored
 float Stream::parseFloat(char skipChar) {
-    boolean isNegative = false;
-    boolean isFraction = false;
-    long value = 0;
-    int c;
-    float fraction = 1.0;
+    NumberRun run = { true, false, false, 0, 1.0 };
 
-    c = peekNextDigit();
     // ignore non numeric leading characters
-    if(c < 0)
+    if(peekNextDigit() < 0)
         return 0; // zero returned if timeout
 
-    do {
-        if(c == skipChar)
-            ; // ignore
-        else if(c == '-')
-            isNegative = true;
-        else if(c == '.')
-            isFraction = true;
-        else if(c >= '0' && c <= '9') {      // is c a digit?
-            value = value * 10 + c - '0';
-            if(isFraction)
-                fraction *= 0.1;
-        }
-        read();  // consume the character we got with peek
-        c = timedPeek();
-    } while((c >= '0' && c <= '9') || c == '.' || c == skipChar);
+    parseNumberRun(&run, skipChar, true);
 
-    if(isNegative)
-        value = -value;
-    if(isFraction)
-        return value * fraction;
+    if(run.isNegative)
+        run.value = -run.value;
+    if(run.isFraction)
+        return run.value * run.fraction;
     else
-        return value;
+        return run.value;
 }
 
 // read characters from stream into buffer
@@ -212,11 +332,19 @@ float Stream::parseFloat(char skipChar) {
 size_t Stream::readBytes(char *buffer, size_t length) {
     size_t count = 0;
     while(count < length) {
+        const uint8_t *data;
+        int n = peekBuffered(&data);
+        if(n > 0) {
+            size_t chunk = ((size_t) n < length - count) ? (size_t) n : length - count;
+            memcpy(buffer + count, data, chunk);
+            consumeBuffered(chunk);
+            count += chunk;
+            continue;
+        }
         int c = timedRead();
         if(c < 0)
             break;
-        *buffer++ = (char) c;
-        count++;
+        buffer[count++] = (char) c;
     }
     return count;
 }
@@ -230,32 +358,71 @@ size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length) {
         return 0;
     size_t index = 0;
     while(index < length) {
+        const uint8_t *data;
+        int avail = peekBuffered(&data);
+        if(avail > 0) {
+            size_t chunk = ((size_t) avail < length - index) ? (size_t) avail : length - index;
+            const uint8_t *end = (const uint8_t *) memchr(data, terminator, chunk);
+            if(end != NULL) {
+                chunk = end - data;
+                memcpy(buffer + index, data, chunk);
+                consumeBuffered(chunk + 1);
+                return index + chunk;
+            }
+            memcpy(buffer + index, data, chunk);
+            consumeBuffered(chunk);
+            index += chunk;
+            continue;
+        }
         int c = timedRead();
         if(c < 0 || c == terminator)
             break;
-        *buffer++ = (char) c;
-        index++;
+        buffer[index++] = (char) c;
     }
     return index; // return number of characters, not including null terminator
 }
 
 String Stream::readString() {
     String ret;
-    int c = timedRead();
-    while(c >= 0) {
+    while(1) {
+        const uint8_t *data;
+        int n = peekBuffered(&data);
+        if(n > 0) {
+            ret.concat((const char *) data, n);
+            consumeBuffered(n);
+            continue;
+        }
+        int c = timedRead();
+        if(c < 0)
+            break;
         ret += (char) c;
-        c = timedRead();
     }
     return ret;
 }
 
 String Stream::readStringUntil(char terminator) {
     String ret;
-    int c = timedRead();
-    while(c >= 0 && c != terminator) {
+    int n = bufferedUntil(terminator);
+    if(n > 0)
+        ret.reserve(n - 1);
+    while(1) {
+        const uint8_t *data;
+        int avail = peekBuffered(&data);
+        if(avail > 0) {
+            const uint8_t *end = (const uint8_t *) memchr(data, terminator, avail);
+            if(end != NULL) {
+                ret.concat((const char *) data, end - data);
+                consumeBuffered(end - data + 1);
+                break;
+            }
+            ret.concat((const char *) data, avail);
+            consumeBuffered(avail);
+            continue;
+        }
+        int c = timedRead();
+        if(c < 0 || c == terminator)
+            break;
         ret += (char) c;
-        c = timedRead();
     }
     return ret;
 }
-
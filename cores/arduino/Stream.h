@@ -35,6 +35,12 @@
  readBytesBetween( pre_string, terminator, buffer, length)
  */
 
+// longest target/terminator string whose find()/findUntil() match table lives
+// on the stack; longer strings get theirs from the heap
+#define FIND_TABLE_SIZE 64
+
+struct NumberRun;
+
 class Stream: public Print {
     protected:
         unsigned long _timeout;      // number of milliseconds to wait for the next char before aborting timed read
@@ -43,12 +49,29 @@ class Stream: public Print {
         int timedPeek();    // private method to peek stream with timeout
         int peekNextDigit(); // returns the next numeric digit in the stream or -1 if timeout
 
+        // number of bytes up to and including the next terminator when a complete
+        // terminated run is already buffered, 0 if it is not, or -1 if the stream
+        // keeps no such index (the default); lets the *Until helpers skip the byte loop
+        virtual int bufferedUntil(char terminator) { return -1; }
+        void parseNumberRun(NumberRun *run, char skipChar, bool allowFraction);
+        bool findUntilMatch(const char *target, size_t targetLen, const size_t *targetFail,
+                            const char *terminator, size_t termLen, const size_t *termFail);
+        bool findUntilLong(const char *target, size_t targetLen, const char *terminator, size_t termLen);
+
     public:
         virtual int available() = 0;
         virtual int read() = 0;
         virtual int peek() = 0;
         virtual void flush() = 0;
 
+        // optional bulk interface: point *data at the bytes already buffered as one
+        // contiguous run without consuming them and return its length (0 if nothing
+        // is buffered right now, -1 if the stream does not support it), then release
+        // what was used with consumeBuffered(); the parsing helpers below run over
+        // these spans instead of making a read()/peek() call per byte
+        virtual int peekBuffered(const uint8_t **data) { return -1; }
+        virtual void consumeBuffered(size_t length) { }
+
         Stream() {
             _timeout = 1000;
         }
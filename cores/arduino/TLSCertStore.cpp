@@ -0,0 +1,285 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+#include "mbed.h"
+#include "TLSCertStore.h"
+#include "SystemFileSystem.h"
+#include "MemoryProfiler.h"
+#include "SerialLog.h"
+#include "File.h"
+#include "mbedtls/platform.h"
+#include "mbedtls/pem.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace mbed;
+
+#define STORE_FILE_MAGIC    0x44534C54u     // "TLSD"
+#define STORE_FILE_VERSION  1
+
+// PEM labels are short ("CERTIFICATE", "EC PRIVATE KEY", ...)
+#define PEM_LABEL_MAX       40
+
+// Filenames within the mounted filesystem (leading '/' required by ChaN follow_path with _FS_RPATH=0)
+static const char * const STORE_FILE_NAMES[TLS_CERT_STORE_SLOTS] = {
+    "/tls_ca.der",
+    "/tls_cert.der",
+    "/tls_key.der",
+};
+
+struct StoreFileHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t slot;
+    uint32_t length;
+    uint32_t hash;      // FNV-1a of the DER, catches a torn write
+};
+
+static unsigned char *store_der[TLS_CERT_STORE_SLOTS];
+static size_t store_len[TLS_CERT_STORE_SLOTS];
+static Mutex store_lock;
+
+static uint32_t der_hash(const unsigned char *data, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool valid_slot(TLSCertStoreSlot slot)
+{
+    return (int)slot >= 0 && slot < TLS_CERT_STORE_SLOTS;
+}
+
+// caller holds store_lock
+static void store_drop(TLSCertStoreSlot slot)
+{
+    mem_profile_free(store_der[slot]);
+    store_der[slot] = NULL;
+    store_len[slot] = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Persistence
+static bool store_write_file(TLSCertStoreSlot slot, const unsigned char *der, size_t len)
+{
+    FileSystem *fs = SystemFileSystem_GetFS();
+    if (fs == NULL)
+    {
+        return false;
+    }
+
+    StoreFileHeader hdr;
+    hdr.magic = STORE_FILE_MAGIC;
+    hdr.version = STORE_FILE_VERSION;
+    hdr.slot = (uint16_t)slot;
+    hdr.length = (uint32_t)len;
+    hdr.hash = der_hash(der, len);
+
+    File f;
+    if (f.open(fs, STORE_FILE_NAMES[slot], O_WRONLY | O_CREAT | O_TRUNC) != 0)
+    {
+        return false;
+    }
+    bool ok = f.write(&hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr) &&
+              f.write(der, len) == (ssize_t)len;
+    f.close();
+
+    if (!ok)
+    {
+        fs->remove(STORE_FILE_NAMES[slot]);
+    }
+    return ok;
+}
+
+static unsigned char *store_read_file(TLSCertStoreSlot slot, size_t *len)
+{
+    FileSystem *fs = SystemFileSystem_GetFS();
+    if (fs == NULL)
+    {
+        return NULL;
+    }
+
+    File f;
+    if (f.open(fs, STORE_FILE_NAMES[slot], O_RDONLY) != 0)
+    {
+        return NULL;
+    }
+
+    StoreFileHeader hdr;
+    if (f.read(&hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr) ||
+        hdr.magic != STORE_FILE_MAGIC || hdr.version != STORE_FILE_VERSION ||
+        hdr.slot != (uint16_t)slot || hdr.length == 0)
+    {
+        f.close();
+        return NULL;
+    }
+
+    unsigned char *der = (unsigned char *)mem_profile_malloc(MEM_TAG_TLS, hdr.length);
+    if (der == NULL)
+    {
+        f.close();
+        return NULL;
+    }
+
+    if (f.read(der, hdr.length) != (ssize_t)hdr.length || der_hash(der, hdr.length) != hdr.hash)
+    {
+        SERIAL_LOG_WARN(SERIAL_LOG_MODULE_TLS, "Discarding corrupt %s", STORE_FILE_NAMES[slot]);
+        f.close();
+        mem_profile_free(der);
+        fs->remove(STORE_FILE_NAMES[slot]);
+        return NULL;
+    }
+    f.close();
+
+    *len = hdr.length;
+    return der;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// API
+int TLSCertStore_PemToDer(const char *pem, unsigned char *der, size_t der_size)
+{
+    if (pem == NULL || der == NULL)
+    {
+        return -1;
+    }
+
+    size_t out = 0;
+    int blocks = 0;
+    const char *p = pem;
+    while ((p = strstr(p, "-----BEGIN ")) != NULL)
+    {
+        const char *label = p + 11;
+        const char *label_end = strstr(label, "-----");
+        if (label_end == NULL || label_end - label > PEM_LABEL_MAX)
+        {
+            return -1;
+        }
+
+        char header[PEM_LABEL_MAX + 17];
+        char footer[PEM_LABEL_MAX + 15];
+        int label_len = (int)(label_end - label);
+        snprintf(header, sizeof(header), "-----BEGIN %.*s-----", label_len, label);
+        snprintf(footer, sizeof(footer), "-----END %.*s-----", label_len, label);
+
+        mbedtls_pem_context ctx;
+        mbedtls_pem_init(&ctx);
+        size_t used = 0;
+        int ret = mbedtls_pem_read_buffer(&ctx, header, footer, (const unsigned char *)p, NULL, 0, &used);
+        if (ret != 0 || ctx.buflen > der_size - out)
+        {
+            // encrypted keys land here too (MBEDTLS_ERR_PEM_PASSWORD_REQUIRED)
+            mbedtls_pem_free(&ctx);
+            return -1;
+        }
+
+        memcpy(der + out, ctx.buf, ctx.buflen);
+        out += ctx.buflen;
+        blocks++;
+        mbedtls_pem_free(&ctx);
+        p += used;
+    }
+
+    return blocks > 0 ? (int)out : -1;
+}
+
+int TLSCertStore_Import(TLSCertStoreSlot slot, const char *pem)
+{
+    if (!valid_slot(slot) || pem == NULL)
+    {
+        return -1;
+    }
+
+    // base64 turns 3 bytes into 4, so the DER is always smaller than its PEM
+    size_t der_size = (strlen(pem) * 3) / 4;
+    unsigned char *der = (unsigned char *)mem_profile_malloc(MEM_TAG_TLS, der_size > 0 ? der_size : 1);
+    if (der == NULL)
+    {
+        return -1;
+    }
+
+    int len = TLSCertStore_PemToDer(pem, der, der_size);
+    if (len <= 0)
+    {
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_TLS, "Cannot decode PEM for %s", STORE_FILE_NAMES[slot]);
+        mem_profile_free(der);
+        return -1;
+    }
+
+    unsigned char *fitted = (unsigned char *)mem_profile_realloc(MEM_TAG_TLS, der, len);
+    if (fitted != NULL)
+    {
+        der = fitted;
+    }
+
+    store_lock.lock();
+    if (!store_write_file(slot, der, len))
+    {
+        // still usable for this boot, decoded again on the next one
+        SERIAL_LOG_WARN(SERIAL_LOG_MODULE_TLS, "Cannot write %s", STORE_FILE_NAMES[slot]);
+    }
+    store_drop(slot);
+    store_der[slot] = der;
+    store_len[slot] = len;
+    store_lock.unlock();
+
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_TLS, "Stored %d byte DER (%u byte PEM) in %s",
+                    len, (unsigned int)strlen(pem), STORE_FILE_NAMES[slot]);
+    return len;
+}
+
+const unsigned char *TLSCertStore_Get(TLSCertStoreSlot slot, size_t *len)
+{
+    if (!valid_slot(slot))
+    {
+        return NULL;
+    }
+
+    store_lock.lock();
+    if (store_der[slot] == NULL)
+    {
+        store_der[slot] = store_read_file(slot, &store_len[slot]);
+    }
+    const unsigned char *der = store_der[slot];
+    if (len != NULL)
+    {
+        *len = store_len[slot];
+    }
+    store_lock.unlock();
+
+    return der;
+}
+
+void TLSCertStore_Unload(TLSCertStoreSlot slot)
+{
+    if (!valid_slot(slot))
+    {
+        return;
+    }
+
+    store_lock.lock();
+    store_drop(slot);
+    store_lock.unlock();
+}
+
+void TLSCertStore_Erase(TLSCertStoreSlot slot)
+{
+    if (!valid_slot(slot))
+    {
+        return;
+    }
+
+    store_lock.lock();
+    store_drop(slot);
+    FileSystem *fs = SystemFileSystem_GetFS();
+    if (fs != NULL)
+    {
+        fs->remove(STORE_FILE_NAMES[slot]);
+    }
+    store_lock.unlock();
+}
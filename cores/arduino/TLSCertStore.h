@@ -0,0 +1,66 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+/**
+ * @file TLSCertStore.h
+ * @brief Pre-decoded (DER) certificates and keys for TLSSocket.
+ *
+ * PEM text is base64-decoded once, when it is imported (at provisioning or
+ * on the first boot after it), and the DER is kept in /fs/tls_<slot>.der.
+ * Later boots load the DER and hand it to mbed TLS as is, skipping the PEM
+ * decode and the PEM-sized buffers; DER is about three quarters of the size
+ * of the PEM it came from.
+ *
+ * A slot holding certificates keeps the whole chain, one DER certificate
+ * after another.  A slot holding a key keeps its DER encoding (PKCS#1, SEC1
+ * or PKCS#8, whatever the PEM contained); encrypted PEM keys are rejected.
+ *
+ * NOTE: an imported private key is stored unencrypted in the SPI flash
+ * filesystem rather than in the secure element.
+ */
+
+#ifndef __TLS_CERT_STORE_H__
+#define __TLS_CERT_STORE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum
+{
+    TLS_CERT_STORE_CA = 0,          // trusted CA certificate(s)
+    TLS_CERT_STORE_CLIENT_CERT,     // client/device certificate chain
+    TLS_CERT_STORE_CLIENT_KEY,      // client/device private key
+    TLS_CERT_STORE_SLOTS
+} TLSCertStoreSlot;
+
+/**
+ * @brief Convert every PEM block in @p pem to DER, back to back.
+ * @param der       output buffer; (strlen(pem) * 3) / 4 bytes always suffice
+ * @return DER bytes written, or -1 if the PEM is malformed or does not fit
+ */
+int TLSCertStore_PemToDer(const char *pem, unsigned char *der, size_t der_size);
+
+/**
+ * @brief Decode PEM into a slot and persist it.
+ * @return DER size in bytes, or -1 on failure (the slot is left unchanged)
+ */
+int TLSCertStore_Import(TLSCertStoreSlot slot, const char *pem);
+
+/**
+ * @brief Get the DER in a slot, loading it from flash on first use.
+ *
+ * The buffer stays valid until TLSCertStore_Unload() or TLSCertStore_Erase()
+ * for that slot, or a new import into it.
+ *
+ * @param len  receives the DER size
+ * @return the DER, or NULL if the slot is empty
+ */
+const unsigned char *TLSCertStore_Get(TLSCertStoreSlot slot, size_t *len);
+
+/** @brief Release the RAM copy of a slot; it is reloaded by the next Get. */
+void TLSCertStore_Unload(TLSCertStoreSlot slot);
+
+/** @brief Empty a slot, in RAM and in flash. */
+void TLSCertStore_Erase(TLSCertStoreSlot slot);
+
+#endif // __TLS_CERT_STORE_H__
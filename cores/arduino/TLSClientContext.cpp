@@ -0,0 +1,612 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+#include "TLSClientContext.h"
+#include "MemoryProfiler.h"
+#include "SerialLog.h"
+#include "mbedtls/error.h"
+#include "mbedtls/asn1.h"
+#include <new>
+#include <string.h>
+
+#if DEBUG_LEVEL > 0
+#include "mbedtls/debug.h"
+#endif
+
+#define TLS_CUNSTOM "Arduino TLS Socket"
+
+static TLSClientContext *context_list = NULL;  // most recently used first
+static Mutex context_lock;
+
+static void tls_log_error(const char* label, int ret)
+{
+    char buf[128];
+    mbedtls_strerror(ret, buf, sizeof(buf));
+    SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_TLS, "%s: -0x%04X %s", label, (unsigned int)(-ret), buf);
+}
+
+// FNV-1a over one part of a context's match data, continuing from hash; the
+// length goes in too so the parts cannot run into each other
+static uint32_t part_hash(uint32_t hash, const unsigned char *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return (hash ^ (uint32_t)len) * 16777619u;
+}
+
+// the suites this build of mbed TLS has, in the given order; NULL if none
+static int *copy_suites(const int *suites)
+{
+    size_t count = 0;
+    while (suites[count] != 0)
+    {
+        count++;
+    }
+
+    int *copy = (int *)mem_profile_malloc(MEM_TAG_TLS, (count + 1) * sizeof(int));
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (mbedtls_ssl_ciphersuite_from_id(suites[i]) != NULL)
+        {
+            copy[used++] = suites[i];
+        }
+        else
+        {
+            SERIAL_LOG_WARN(SERIAL_LOG_MODULE_TLS, "Cipher suite 0x%04X not built in, skipped", (unsigned int)suites[i]);
+        }
+    }
+    copy[used] = 0;
+
+    if (used == 0)
+    {
+        mem_profile_free(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+static mbedtls_ecp_group_id *copy_curves(const mbedtls_ecp_group_id *curves)
+{
+    size_t count = 0;
+    while (curves[count] != MBEDTLS_ECP_DP_NONE)
+    {
+        count++;
+    }
+
+    mbedtls_ecp_group_id *copy = (mbedtls_ecp_group_id *)mem_profile_malloc(MEM_TAG_TLS, (count + 1) * sizeof(mbedtls_ecp_group_id));
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (mbedtls_ecp_curve_info_from_grp_id(curves[i]) != NULL)
+        {
+            copy[used++] = curves[i];
+        }
+        else
+        {
+            SERIAL_LOG_WARN(SERIAL_LOG_MODULE_TLS, "Curve %d not built in, skipped", (int)curves[i]);
+        }
+    }
+    copy[used] = MBEDTLS_ECP_DP_NONE;
+
+    if (used == 0)
+    {
+        mem_profile_free(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+// DER starts with a SEQUENCE tag; PEM has a "-----BEGIN" line, possibly after
+// some explanatory text
+static bool is_pem(const unsigned char *data, size_t len)
+{
+    static const char marker[] = "-----BEGIN";
+    const size_t marker_len = sizeof(marker) - 1;
+
+    if (len == 0 || data[0] == (MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE))
+    {
+        return false;
+    }
+    for (size_t i = 0; i + marker_len <= len; i++)
+    {
+        if (data[i] == '-' && memcmp(data + i, marker, marker_len) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// mbed TLS only reads a buffer as PEM when its last byte is '\0'; PEM given
+// without one is parsed from a terminated copy
+static int parse_pem(int (*parse)(void *target, const unsigned char *buf, size_t len), void *target,
+                     const unsigned char *data, size_t len)
+{
+    if (data[len - 1] == '\0')
+    {
+        return parse(target, data, len);
+    }
+
+    unsigned char *copy = (unsigned char *)mem_profile_malloc(MEM_TAG_TLS, len + 1);
+    if (copy == NULL)
+    {
+        return MBEDTLS_ERR_X509_ALLOC_FAILED;
+    }
+    memcpy(copy, data, len);
+    copy[len] = '\0';
+    int ret = parse(target, copy, len + 1);
+    // may be a private key
+    memset(copy, 0, len);
+    mem_profile_free(copy);
+    return ret;
+}
+
+static int parse_crt(void *chain, const unsigned char *buf, size_t len)
+{
+    return mbedtls_x509_crt_parse((mbedtls_x509_crt *)chain, buf, len);
+}
+
+static int parse_key(void *key, const unsigned char *buf, size_t len)
+{
+    return mbedtls_pk_parse_key((mbedtls_pk_context *)key, buf, len, NULL, 0);
+}
+
+// PEM (any number of certificates) or DER certificates back to back
+static int parse_certs(mbedtls_x509_crt *chain, const unsigned char *data, size_t len)
+{
+    if (is_pem(data, len))
+    {
+        return parse_pem(parse_crt, chain, data, len);
+    }
+
+    const unsigned char *p = data;
+    const unsigned char *end = data + len;
+    while (p < end)
+    {
+        unsigned char *body = (unsigned char *)p;
+        size_t body_len;
+        int ret = mbedtls_asn1_get_tag(&body, end, &body_len, MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE);
+        if (ret != 0)
+        {
+            return ret;
+        }
+
+        size_t cert_len = (body - p) + body_len;
+        if ((ret = mbedtls_x509_crt_parse_der(chain, p, cert_len)) != 0)
+        {
+            return ret;
+        }
+        p += cert_len;
+    }
+    return 0;
+}
+
+#if DEBUG_LEVEL > 0
+static void my_debug(void *ctx, int level, const char *file_name, int line, const char *str)
+{
+    char tmp[32];
+    const char *p, *basename;
+
+    if (file_name != NULL)
+    {
+        /* Extract basename from file */
+        basename = file_name;
+        for (p = basename; *p != '\0'; p++)
+        {
+            if(*p == '/' || *p == '\\')
+            {
+                basename = p + 1;
+            }
+        }
+
+        INFO(basename);
+    }
+    sprintf(tmp, " %04d: |%d| ", line, level);
+    INFO(tmp);
+    INFO("\r\n");
+}
+
+static int my_verify(void *data, mbedtls_x509_crt *crt, int depth, uint32_t *flags)
+{
+    const uint32_t buf_size = 1024;
+    char *buf = new char[buf_size];
+    (void) data;
+
+
+    mbedtls_x509_crt_info(buf, buf_size - 1, "  ", crt);
+
+
+    if (*flags == 0)
+    {
+        INFO("No verification issue for this certificate");
+    }
+    else
+    {
+        mbedtls_x509_crt_verify_info(buf, buf_size, "  ! ", *flags);
+        INFO(buf);
+    }
+
+    delete[] buf;
+    return 0;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class
+
+TLSClientContext::TLSClientContext()
+    : _next(NULL), _refs(0), _match_hash(0), _match_data(NULL), _mfl_code(MBEDTLS_SSL_MAX_FRAG_LEN_NONE),
+      _ciphersuites(NULL), _curves(NULL)
+{
+    memset(_match_len, 0, sizeof(_match_len));
+    mbedtls_entropy_init(&_entropy);
+    mbedtls_ctr_drbg_init(&_ctr_drbg);
+    mbedtls_x509_crt_init(&_cacert);
+    mbedtls_x509_crt_init(&_clientcert);
+    mbedtls_pk_init(&_clientkey);
+    mbedtls_ssl_config_init(&_ssl_conf);
+}
+
+TLSClientContext::~TLSClientContext()
+{
+    mbedtls_ssl_config_free(&_ssl_conf);
+    mem_profile_free(_curves);
+    mem_profile_free(_ciphersuites);
+    if (_match_data != NULL)
+    {
+        // holds the private key
+        size_t total = 0;
+        for (int i = 0; i < MATCH_PARTS; i++)
+        {
+            total += _match_len[i];
+        }
+        memset(_match_data, 0, total);
+        mem_profile_free(_match_data);
+    }
+    mbedtls_pk_free(&_clientkey);
+    mbedtls_x509_crt_free(&_clientcert);
+    mbedtls_x509_crt_free(&_cacert);
+    mbedtls_ctr_drbg_free(&_ctr_drbg);
+    mbedtls_entropy_free(&_entropy);
+}
+
+int TLSClientContext::random(void *ctx, unsigned char *output, size_t len)
+{
+    TLSClientContext *self = static_cast<TLSClientContext *>(ctx);
+    self->_rng_lock.lock();
+    int ret = mbedtls_ctr_drbg_random(&self->_ctr_drbg, output, len);
+    self->_rng_lock.unlock();
+    return ret;
+}
+
+bool TLSClientContext::matches(const unsigned char *const parts[MATCH_PARTS], const size_t lens[MATCH_PARTS],
+                               unsigned char mfl_code, uint32_t hash) const
+{
+    if (_match_hash != hash || _mfl_code != mfl_code)
+    {
+        return false;
+    }
+
+    // equal hashes are not proof: a collision must not hand out another
+    // device's credentials
+    const unsigned char *own = _match_data;
+    for (int i = 0; i < MATCH_PARTS; i++)
+    {
+        if (_match_len[i] != lens[i] || (lens[i] > 0 && memcmp(own, parts[i], lens[i]) != 0))
+        {
+            return false;
+        }
+        own += lens[i];
+    }
+    return true;
+}
+
+int TLSClientContext::setup(const unsigned char *ca, size_t ca_len,
+                            const unsigned char *client_cert, size_t client_cert_len,
+                            const unsigned char *client_key, size_t client_key_len,
+                            unsigned char mfl_code, const int *ciphersuites,
+                            const mbedtls_ecp_group_id *curves)
+{
+    int ret;
+    if ((ret = mbedtls_ctr_drbg_seed(&_ctr_drbg, mbedtls_entropy_func, &_entropy,
+                      (const unsigned char *) TLS_CUNSTOM,
+                      sizeof (TLS_CUNSTOM))) != 0)
+    {
+        tls_log_error("drbg_seed", ret);
+        return ret;
+    }
+
+    if ((ret = parse_certs(&_cacert, ca, ca_len)) != 0)
+    {
+        tls_log_error("CA cert parse", ret);
+        return ret;
+    }
+
+    if ((ret = mbedtls_ssl_config_defaults(&_ssl_conf,
+                    MBEDTLS_SSL_IS_CLIENT,
+                    MBEDTLS_SSL_TRANSPORT_STREAM,
+                    MBEDTLS_SSL_PRESET_DEFAULT)) != 0)
+    {
+        tls_log_error("ssl_config_defaults", ret);
+        return ret;
+    }
+
+    mbedtls_ssl_conf_ca_chain(&_ssl_conf, &_cacert, NULL);
+    mbedtls_ssl_conf_rng(&_ssl_conf, TLSClientContext::random, this);
+
+    /* It is possible to disable authentication by passing
+     * MBEDTLS_SSL_VERIFY_NONE in the call to mbedtls_ssl_conf_authmode()
+     */
+    mbedtls_ssl_conf_authmode(&_ssl_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+
+    if (mfl_code != MBEDTLS_SSL_MAX_FRAG_LEN_NONE &&
+        (ret = mbedtls_ssl_conf_max_frag_len(&_ssl_conf, mfl_code)) != 0)
+    {
+        tls_log_error("ssl_conf_max_frag_len", ret);
+        return ret;
+    }
+
+    // offered in this order; the server picks, usually the first it also has
+    if (ciphersuites != NULL)
+    {
+        if ((_ciphersuites = copy_suites(ciphersuites)) != NULL)
+        {
+            mbedtls_ssl_conf_ciphersuites(&_ssl_conf, _ciphersuites);
+        }
+        else
+        {
+            SERIAL_LOG_WARN(SERIAL_LOG_MODULE_TLS, "No requested cipher suite available, offering the defaults");
+        }
+    }
+    if (curves != NULL)
+    {
+        if ((_curves = copy_curves(curves)) != NULL)
+        {
+            mbedtls_ssl_conf_curves(&_ssl_conf, _curves);
+        }
+        else
+        {
+            SERIAL_LOG_WARN(SERIAL_LOG_MODULE_TLS, "No requested curve available, offering the defaults");
+        }
+    }
+
+    // Configure client certificate for mutual TLS if provided
+    if (client_cert != NULL && client_key != NULL)
+    {
+        if ((ret = parse_certs(&_clientcert, client_cert, client_cert_len)) != 0)
+        {
+            tls_log_error("client cert parse", ret);
+            return ret;
+        }
+
+        // PEM or DER (PKCS#1, SEC1, PKCS#8)
+        if (is_pem(client_key, client_key_len))
+        {
+            ret = parse_pem(parse_key, &_clientkey, client_key, client_key_len);
+        }
+        else
+        {
+            ret = mbedtls_pk_parse_key(&_clientkey, client_key, client_key_len, NULL, 0);
+        }
+        if (ret != 0)
+        {
+            tls_log_error("private key parse", ret);
+            return ret;
+        }
+
+        if ((ret = mbedtls_ssl_conf_own_cert(&_ssl_conf, &_clientcert, &_clientkey)) != 0)
+        {
+            tls_log_error("ssl_conf_own_cert", ret);
+            return ret;
+        }
+    }
+
+#if DEBUG_LEVEL > 0
+    mbedtls_ssl_conf_verify(&_ssl_conf, my_verify, NULL);
+    mbedtls_ssl_conf_dbg(&_ssl_conf, my_debug, NULL);
+    mbedtls_debug_set_threshold(DEBUG_LEVEL);
+#endif
+
+    return 0;
+}
+
+TLSClientContext *TLSClientContext::acquire(const char *ssl_ca_pem, const char *ssl_client_cert,
+                                            const char *ssl_client_key, unsigned char mfl_code,
+                                            const int *ciphersuites, const mbedtls_ecp_group_id *curves)
+{
+    return acquire((const unsigned char *)ssl_ca_pem, ssl_ca_pem ? strlen(ssl_ca_pem) + 1 : 0,
+                   (const unsigned char *)ssl_client_cert, ssl_client_cert ? strlen(ssl_client_cert) + 1 : 0,
+                   (const unsigned char *)ssl_client_key, ssl_client_key ? strlen(ssl_client_key) + 1 : 0,
+                   mfl_code, ciphersuites, curves);
+}
+
+TLSClientContext *TLSClientContext::acquire(const unsigned char *ca, size_t ca_len,
+                                            const unsigned char *client_cert, size_t client_cert_len,
+                                            const unsigned char *client_key, size_t client_key_len,
+                                            unsigned char mfl_code, const int *ciphersuites,
+                                            const mbedtls_ecp_group_id *curves)
+{
+    if (ca == NULL || ca_len == 0)
+    {
+        return NULL;
+    }
+    if (client_cert == NULL || client_key == NULL)
+    {
+        client_cert = NULL;
+        client_key = NULL;
+        client_cert_len = 0;
+        client_key_len = 0;
+    }
+
+    size_t suites_count = 0;
+    while (ciphersuites != NULL && ciphersuites[suites_count] != 0)
+    {
+        suites_count++;
+    }
+    size_t curves_count = 0;
+    while (curves != NULL && curves[curves_count] != MBEDTLS_ECP_DP_NONE)
+    {
+        curves_count++;
+    }
+
+    const unsigned char *parts[MATCH_PARTS] = {
+        ca, client_cert, client_key,
+        (const unsigned char *)ciphersuites, (const unsigned char *)curves
+    };
+    size_t lens[MATCH_PARTS] = {
+        ca_len, client_cert_len, client_key_len,
+        suites_count * sizeof(int), curves_count * sizeof(mbedtls_ecp_group_id)
+    };
+    uint32_t hash = 2166136261u;
+    size_t total = 0;
+    for (int i = 0; i < MATCH_PARTS; i++)
+    {
+        hash = part_hash(hash, parts[i], lens[i]);
+        total += lens[i];
+    }
+
+    // held across setup() so two sockets asking for the same credentials at
+    // once do not both parse them
+    context_lock.lock();
+
+    TLSClientContext *prev = NULL;
+    for (TLSClientContext *ctx = context_list; ctx != NULL; prev = ctx, ctx = ctx->_next)
+    {
+        if (ctx->matches(parts, lens, mfl_code, hash))
+        {
+            if (prev != NULL)
+            {
+                prev->_next = ctx->_next;
+                ctx->_next = context_list;
+                context_list = ctx;
+            }
+            ctx->_refs++;
+            context_lock.unlock();
+            return ctx;
+        }
+    }
+
+    void *mem = mem_profile_malloc(MEM_TAG_TLS, sizeof(TLSClientContext));
+    if (mem == NULL)
+    {
+        context_lock.unlock();
+        return NULL;
+    }
+
+    TLSClientContext *ctx = new (mem) TLSClientContext();
+    ctx->_match_data = (unsigned char *)mem_profile_malloc(MEM_TAG_TLS, total);
+    if (ctx->_match_data == NULL ||
+        ctx->setup(ca, ca_len, client_cert, client_cert_len, client_key, client_key_len,
+                   mfl_code, ciphersuites, curves) != 0)
+    {
+        ctx->~TLSClientContext();
+        mem_profile_free(mem);
+        context_lock.unlock();
+        return NULL;
+    }
+
+    unsigned char *own = ctx->_match_data;
+    for (int i = 0; i < MATCH_PARTS; i++)
+    {
+        if (lens[i] > 0)
+        {
+            memcpy(own, parts[i], lens[i]);
+        }
+        ctx->_match_len[i] = lens[i];
+        own += lens[i];
+    }
+    ctx->_match_hash = hash;
+    ctx->_mfl_code = mfl_code;
+    ctx->_refs = 1;
+    ctx->_next = context_list;
+    context_list = ctx;
+
+    context_lock.unlock();
+    return ctx;
+}
+
+void TLSClientContext::release(TLSClientContext *ctx)
+{
+    if (ctx == NULL)
+    {
+        return;
+    }
+
+    context_lock.lock();
+
+    ctx->_refs--;
+
+    // keep the most recently used idle contexts, free the rest
+    int idle = 0;
+    TLSClientContext *prev = NULL;
+    TLSClientContext *cur = context_list;
+    while (cur != NULL)
+    {
+        TLSClientContext *next = cur->_next;
+        if (cur->_refs == 0 && ++idle > TLS_CLIENT_CONTEXT_IDLE_MAX)
+        {
+            if (prev != NULL)
+            {
+                prev->_next = next;
+            }
+            else
+            {
+                context_list = next;
+            }
+            cur->~TLSClientContext();
+            mem_profile_free(cur);
+        }
+        else
+        {
+            prev = cur;
+        }
+        cur = next;
+    }
+
+    context_lock.unlock();
+}
+
+void TLSClientContext::purge()
+{
+    context_lock.lock();
+
+    TLSClientContext *prev = NULL;
+    TLSClientContext *cur = context_list;
+    while (cur != NULL)
+    {
+        TLSClientContext *next = cur->_next;
+        if (cur->_refs == 0)
+        {
+            if (prev != NULL)
+            {
+                prev->_next = next;
+            }
+            else
+            {
+                context_list = next;
+            }
+            cur->~TLSClientContext();
+            mem_profile_free(cur);
+        }
+        else
+        {
+            prev = cur;
+        }
+        cur = next;
+    }
+
+    context_lock.unlock();
+}
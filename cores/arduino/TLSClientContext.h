@@ -0,0 +1,125 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+/**
+ * @file TLSClientContext.h
+ * @brief Shared, reference-counted mbed TLS client configuration.
+ *
+ * Seeding the DRBG and parsing a PEM CA chain (plus client certificate and
+ * key for mutual TLS) is done once per distinct set of credentials; every
+ * TLSSocket using the same credentials shares the resulting
+ * mbedtls_ssl_config and keeps only its own mbedtls_ssl_context.
+ *
+ * Credentials are given as PEM strings or as DER (see TLSCertStore.h).
+ * Contexts are matched on their content, so separate copies of the same CA
+ * share one context; each context keeps a copy of its credentials to compare
+ * against, with a hash to skip most comparisons.  The max_fragment_length, cipher suites and curves a
+ * socket offers are part of the configuration, so they are part of the match
+ * as well.  A context no socket uses any more stays
+ * cached for the next connection; at most TLS_CLIENT_CONTEXT_IDLE_MAX idle
+ * contexts are kept, and purge() frees them all.
+ */
+
+#ifndef __TLS_CLIENT_CONTEXT_H__
+#define __TLS_CLIENT_CONTEXT_H__
+
+#include "mbed.h"
+
+#include "mbedtls/platform.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/ecp.h"
+
+// idle contexts kept for reuse once their last socket is gone
+#ifndef TLS_CLIENT_CONTEXT_IDLE_MAX
+#define TLS_CLIENT_CONTEXT_IDLE_MAX 2
+#endif
+
+class TLSClientContext
+{
+public:
+    /**
+     * @brief Get the context for a CA chain and optional client credentials
+     * @param ssl_ca_pem        CA certificate(s) in PEM format
+     * @param ssl_client_cert   Client certificate in PEM format, or NULL
+     * @param ssl_client_key    Client private key in PEM format, or NULL
+     * @param mfl_code          MBEDTLS_SSL_MAX_FRAG_LEN_* to offer the server
+     * @param ciphersuites      suites to offer, ending in 0, or NULL for the library default
+     * @param curves            curves to offer, ending in MBEDTLS_ECP_DP_NONE, or NULL
+     * @return a referenced context, or NULL if the credentials do not parse
+     */
+    static TLSClientContext *acquire(const char *ssl_ca_pem, const char *ssl_client_cert,
+                                     const char *ssl_client_key,
+                                     unsigned char mfl_code = MBEDTLS_SSL_MAX_FRAG_LEN_NONE,
+                                     const int *ciphersuites = NULL,
+                                     const mbedtls_ecp_group_id *curves = NULL);
+
+    /**
+     * @brief Get the context for credentials given with their lengths
+     *
+     * A buffer holding a "-----BEGIN" line is read as PEM, with or without a
+     * trailing '\0'; one starting with a DER SEQUENCE tag (0x30) as DER.  A DER
+     * certificate buffer may hold several certificates back to back.  The
+     * suite and curve lists are copied, leaving out what the library was
+     * built without.
+     */
+    static TLSClientContext *acquire(const unsigned char *ca, size_t ca_len,
+                                     const unsigned char *client_cert, size_t client_cert_len,
+                                     const unsigned char *client_key, size_t client_key_len,
+                                     unsigned char mfl_code = MBEDTLS_SSL_MAX_FRAG_LEN_NONE,
+                                     const int *ciphersuites = NULL,
+                                     const mbedtls_ecp_group_id *curves = NULL);
+
+    /** @brief Drop a reference taken with acquire() */
+    static void release(TLSClientContext *ctx);
+
+    /** @brief Free every cached context no socket is using */
+    static void purge();
+
+    const mbedtls_ssl_config *config() const { return &_ssl_conf; }
+
+private:
+    TLSClientContext();
+    ~TLSClientContext();
+
+    int setup(const unsigned char *ca, size_t ca_len,
+              const unsigned char *client_cert, size_t client_cert_len,
+              const unsigned char *client_key, size_t client_key_len,
+              unsigned char mfl_code, const int *ciphersuites,
+              const mbedtls_ecp_group_id *curves);
+    // what a context is looked up by: credentials, suite and curve lists
+    enum
+    {
+        MATCH_CA = 0,
+        MATCH_CERT,
+        MATCH_KEY,
+        MATCH_SUITES,
+        MATCH_CURVES,
+        MATCH_PARTS
+    };
+
+    bool matches(const unsigned char *const parts[MATCH_PARTS], const size_t lens[MATCH_PARTS],
+                 unsigned char mfl_code, uint32_t hash) const;
+    static int random(void *ctx, unsigned char *output, size_t len);
+
+    TLSClientContext *_next;
+    int _refs;
+    uint32_t _match_hash;               // over the parts, checked before comparing them
+    unsigned char *_match_data;         // copies of the parts, back to back
+    size_t _match_len[MATCH_PARTS];     // 0 for a part not given
+    unsigned char _mfl_code;
+    int *_ciphersuites;                 // own copies, mbed TLS keeps the pointers
+    mbedtls_ecp_group_id *_curves;
+
+    Mutex _rng_lock;            // the DRBG is shared by every connection
+    mbedtls_entropy_context _entropy;
+    mbedtls_ctr_drbg_context _ctr_drbg;
+    mbedtls_x509_crt _cacert;
+    mbedtls_x509_crt _clientcert;
+    mbedtls_pk_context _clientkey;
+    mbedtls_ssl_config _ssl_conf;
+};
+
+#endif  // __TLS_CLIENT_CONTEXT_H__
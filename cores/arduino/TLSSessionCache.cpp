@@ -0,0 +1,541 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+#include "mbed.h"
+#include "TLSSessionCache.h"
+#include "SystemFileSystem.h"
+#include "MemoryProfiler.h"
+#include "SerialLog.h"
+#include "File.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+using namespace mbed;
+
+// Filename within the mounted filesystem (leading '/' required by ChaN follow_path with _FS_RPATH=0)
+#define CACHE_FILE_NAME     "/tls_sessions.bin"
+#define CACHE_FILE_MAGIC    0x43534C54u     // "TLSC"
+#define CACHE_FILE_VERSION  1
+
+// earliest plausible wall-clock time (2020-01-01); below it the clock has not
+// been synced and expiry of persisted sessions cannot be judged
+#define CACHE_CLOCK_VALID   1577836800u
+
+// the part of a session that is needed to resume it; also the on-file record,
+// followed by ticket_len bytes of ticket
+struct TLSSessionRecord
+{
+    char key[TLS_SESSION_KEY_MAX];
+    uint32_t expires;
+    int32_t ciphersuite;
+    int32_t compression;
+    uint8_t id_len;
+    uint8_t id[32];
+    uint8_t master[48];
+    uint8_t mfl_code;
+    uint8_t trunc_hmac;
+    uint8_t encrypt_then_mac;
+    uint16_t ticket_len;
+    uint32_t ticket_lifetime;
+};
+
+struct TLSSessionEntry
+{
+    TLSSessionRecord rec;
+    unsigned char *ticket;
+    uint32_t last_used;
+    uint32_t saved_expires;     // expiry of the copy in the file, 0 if none
+};
+
+struct CacheFileHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+};
+
+static TLSSessionEntry cache[TLS_SESSION_CACHE_ENTRIES];
+static Mutex cache_lock;
+static bool cache_enabled = false;
+static bool cache_persist = false;
+static bool cache_loaded = false;
+static uint32_t cache_lifetime = TLS_SESSION_DEFAULT_LIFETIME;
+static uint32_t cache_clock = 0;
+static bool cache_dirty = false;        // RAM differs from the file
+static uint32_t cache_dirty_since = 0;
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Entries
+// false if host:port does not fit; such hosts are not cached
+static bool make_key(char *key, const char *host, uint16_t port)
+{
+    int len = snprintf(key, TLS_SESSION_KEY_MAX, "%s:%u", host, (unsigned int)port);
+    return len > 0 && len < TLS_SESSION_KEY_MAX;
+}
+
+static void entry_clear(TLSSessionEntry *e)
+{
+    mem_profile_free(e->ticket);
+    // the master secret should not linger in RAM
+    memset(e, 0, sizeof(TLSSessionEntry));
+}
+
+static TLSSessionEntry *entry_find(const char *key)
+{
+    for (int i = 0; i < TLS_SESSION_CACHE_ENTRIES; i++)
+    {
+        if (cache[i].rec.key[0] != '\0' && strcmp(cache[i].rec.key, key) == 0)
+        {
+            return &cache[i];
+        }
+    }
+    return NULL;
+}
+
+// an empty slot, or else the least recently used one
+static TLSSessionEntry *entry_slot(void)
+{
+    TLSSessionEntry *slot = &cache[0];
+    for (int i = 0; i < TLS_SESSION_CACHE_ENTRIES; i++)
+    {
+        if (cache[i].rec.key[0] == '\0')
+        {
+            return &cache[i];
+        }
+        if (cache[i].last_used < slot->last_used)
+        {
+            slot = &cache[i];
+        }
+    }
+    entry_clear(slot);
+    return slot;
+}
+
+static bool entry_expired(const TLSSessionEntry *e, uint32_t now)
+{
+    return now >= e->rec.expires;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Persistence
+static void cache_write_file(void)
+{
+    FileSystem *fs = SystemFileSystem_GetFS();
+    if (fs == NULL)
+    {
+        return;
+    }
+    cache_dirty = false;
+
+    CacheFileHeader hdr;
+    hdr.magic = CACHE_FILE_MAGIC;
+    hdr.version = CACHE_FILE_VERSION;
+    hdr.count = 0;
+    for (int i = 0; i < TLS_SESSION_CACHE_ENTRIES; i++)
+    {
+        if (cache[i].rec.key[0] != '\0')
+        {
+            hdr.count++;
+        }
+    }
+
+    if (hdr.count == 0)
+    {
+        fs->remove(CACHE_FILE_NAME);
+        return;
+    }
+
+    File f;
+    if (f.open(fs, CACHE_FILE_NAME, O_WRONLY | O_CREAT | O_TRUNC) != 0)
+    {
+        SERIAL_LOG_WARN(SERIAL_LOG_MODULE_TLS, "Cannot write session cache");
+        return;
+    }
+    f.write(&hdr, sizeof(hdr));
+    for (int i = 0; i < TLS_SESSION_CACHE_ENTRIES; i++)
+    {
+        if (cache[i].rec.key[0] != '\0')
+        {
+            f.write(&cache[i].rec, sizeof(TLSSessionRecord));
+            if (cache[i].rec.ticket_len > 0)
+            {
+                f.write(cache[i].ticket, cache[i].rec.ticket_len);
+            }
+            cache[i].saved_expires = cache[i].rec.expires;
+        }
+    }
+    f.close();
+}
+
+static void cache_read_file(uint32_t now)
+{
+    FileSystem *fs = SystemFileSystem_GetFS();
+    if (fs == NULL)
+    {
+        return;
+    }
+
+    File f;
+    if (f.open(fs, CACHE_FILE_NAME, O_RDONLY) != 0)
+    {
+        return;
+    }
+
+    CacheFileHeader hdr;
+    if (f.read(&hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr) ||
+        hdr.magic != CACHE_FILE_MAGIC || hdr.version != CACHE_FILE_VERSION)
+    {
+        f.close();
+        return;
+    }
+
+    for (int i = 0; i < hdr.count; i++)
+    {
+        TLSSessionRecord rec;
+        if (f.read(&rec, sizeof(rec)) != (ssize_t)sizeof(rec) || rec.ticket_len > TLS_SESSION_TICKET_MAX)
+        {
+            break;
+        }
+        rec.key[TLS_SESSION_KEY_MAX - 1] = '\0';
+
+        unsigned char *ticket = NULL;
+        if (rec.ticket_len > 0)
+        {
+            ticket = (unsigned char *)mem_profile_malloc(MEM_TAG_TLS, rec.ticket_len);
+            if (ticket == NULL || f.read(ticket, rec.ticket_len) != (ssize_t)rec.ticket_len)
+            {
+                mem_profile_free(ticket);
+                break;
+            }
+        }
+
+        // sessions negotiated in this boot win over the persisted ones
+        if (now >= rec.expires || rec.id_len > sizeof(rec.id) || entry_find(rec.key) != NULL)
+        {
+            mem_profile_free(ticket);
+            continue;
+        }
+
+        TLSSessionEntry *e = entry_slot();
+        e->rec = rec;
+        e->ticket = ticket;
+        e->last_used = 0;
+        e->saved_expires = rec.expires;
+    }
+    f.close();
+}
+
+// Rewriting the file on every handshake would wear the flash and stall each
+// connect, so changes are written TLS_SESSION_PERSIST_DELAY seconds after the
+// first unsaved one (checked on the next cache call), by TLSSessionCache_Flush(),
+// or at once when a reboot would otherwise lose a host's session: it has no
+// copy in the file, or that copy expires before the delay is up.
+static void cache_changed(const TLSSessionEntry *e, uint32_t now)
+{
+    if (!cache_persist)
+    {
+        return;
+    }
+    if (!cache_dirty)
+    {
+        cache_dirty = true;
+        cache_dirty_since = now;
+    }
+    if (e != NULL && (e->saved_expires == 0 || e->saved_expires <= now + TLS_SESSION_PERSIST_DELAY))
+    {
+        cache_write_file();
+    }
+}
+
+static void cache_write_due(uint32_t now)
+{
+    if (cache_persist && cache_dirty && now - cache_dirty_since >= TLS_SESSION_PERSIST_DELAY)
+    {
+        cache_write_file();
+    }
+}
+
+// persisted sessions are read once the clock can tell which ones expired
+static void cache_load(uint32_t now)
+{
+    if (cache_persist && !cache_loaded && now >= CACHE_CLOCK_VALID)
+    {
+        cache_loaded = true;
+        cache_read_file(now);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Public API
+void TLSSessionCache_Enable(uint32_t lifetime, bool persist)
+{
+    cache_lock.lock();
+    cache_enabled = true;
+    cache_lifetime = lifetime > 0 ? lifetime : TLS_SESSION_DEFAULT_LIFETIME;
+    if (persist && !cache_persist)
+    {
+        cache_loaded = false;
+    }
+    cache_persist = persist;
+    cache_load((uint32_t)time(NULL));
+    cache_lock.unlock();
+}
+
+void TLSSessionCache_Disable(void)
+{
+    cache_lock.lock();
+    if (cache_persist && cache_dirty)
+    {
+        cache_write_file();
+    }
+    cache_enabled = false;
+    for (int i = 0; i < TLS_SESSION_CACHE_ENTRIES; i++)
+    {
+        entry_clear(&cache[i]);
+    }
+    cache_loaded = false;
+    cache_lock.unlock();
+}
+
+void TLSSessionCache_Clear(void)
+{
+    cache_lock.lock();
+    for (int i = 0; i < TLS_SESSION_CACHE_ENTRIES; i++)
+    {
+        entry_clear(&cache[i]);
+    }
+    FileSystem *fs = SystemFileSystem_GetFS();
+    if (fs != NULL)
+    {
+        fs->remove(CACHE_FILE_NAME);
+    }
+    cache_dirty = false;
+    cache_lock.unlock();
+}
+
+void TLSSessionCache_Flush(void)
+{
+    cache_lock.lock();
+    if (cache_persist && cache_dirty)
+    {
+        cache_write_file();
+    }
+    cache_lock.unlock();
+}
+
+bool TLSSessionCache_IsEnabled(void)
+{
+    return cache_enabled;
+}
+
+bool TLSSessionCache_Resume(const char *host, uint16_t port, mbedtls_ssl_context *ssl)
+{
+    if (!cache_enabled || host == NULL || ssl == NULL)
+    {
+        return false;
+    }
+
+    char key[TLS_SESSION_KEY_MAX];
+    if (!make_key(key, host, port))
+    {
+        return false;
+    }
+    uint32_t now = (uint32_t)time(NULL);
+
+    cache_lock.lock();
+    cache_load(now);
+    cache_write_due(now);
+
+    TLSSessionEntry *e = entry_find(key);
+    if (e == NULL)
+    {
+        cache_lock.unlock();
+        return false;
+    }
+    if (entry_expired(e, now))
+    {
+        // the file loader skips it too, so there is no hurry
+        entry_clear(e);
+        cache_changed(NULL, now);
+        cache_lock.unlock();
+        return false;
+    }
+
+    // mbedtls_ssl_set_session() takes a deep copy (ticket included)
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+#if defined(MBEDTLS_HAVE_TIME)
+    session.start = mbedtls_time(NULL);
+#endif
+    session.ciphersuite = e->rec.ciphersuite;
+    session.compression = e->rec.compression;
+    session.id_len = e->rec.id_len;
+    memcpy(session.id, e->rec.id, sizeof(session.id));
+    memcpy(session.master, e->rec.master, sizeof(session.master));
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+    session.ticket = e->ticket;
+    session.ticket_len = e->rec.ticket_len;
+    session.ticket_lifetime = e->rec.ticket_lifetime;
+#endif
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    session.mfl_code = e->rec.mfl_code;
+#endif
+#if defined(MBEDTLS_SSL_TRUNCATED_HMAC)
+    session.trunc_hmac = e->rec.trunc_hmac;
+#endif
+#if defined(MBEDTLS_SSL_ENCRYPT_THEN_MAC)
+    session.encrypt_then_mac = e->rec.encrypt_then_mac;
+#endif
+    e->last_used = ++cache_clock;
+
+    int ret = mbedtls_ssl_set_session(ssl, &session);
+
+    // the ticket still belongs to the cache; scrub the copy of the secret
+    memset(&session, 0, sizeof(session));
+    cache_lock.unlock();
+
+    return ret == 0;
+}
+
+bool TLSSessionCache_Save(const char *host, uint16_t port, const mbedtls_ssl_context *ssl)
+{
+    if (!cache_enabled || host == NULL || ssl == NULL || ssl->session == NULL)
+    {
+        return false;
+    }
+
+    const mbedtls_ssl_session *s = ssl->session;
+    char key[TLS_SESSION_KEY_MAX];
+    if (!make_key(key, host, port))
+    {
+        return false;
+    }
+    uint32_t now = (uint32_t)time(NULL);
+
+    unsigned char *ticket = NULL;
+    size_t ticket_len = 0;
+    uint32_t ticket_lifetime = 0;
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+    if (s->ticket != NULL && s->ticket_len > 0 && s->ticket_len <= TLS_SESSION_TICKET_MAX)
+    {
+        ticket = s->ticket;
+        ticket_len = s->ticket_len;
+        ticket_lifetime = s->ticket_lifetime;
+    }
+#endif
+
+    // nothing a server could recognise the session by
+    if (s->id_len == 0 && ticket_len == 0)
+    {
+        return false;
+    }
+
+    cache_lock.lock();
+    cache_write_due(now);
+
+    TLSSessionEntry *e = entry_find(key);
+    bool resumed = e != NULL && memcmp(e->rec.master, s->master, sizeof(s->master)) == 0;
+    bool changed = !resumed ||
+                   e->rec.id_len != s->id_len || memcmp(e->rec.id, s->id, s->id_len) != 0 ||
+                   e->rec.ticket_len != ticket_len ||
+                   (ticket_len > 0 && memcmp(e->ticket, ticket, ticket_len) != 0);
+
+    if (!changed)
+    {
+        // a resumed session keeps the expiry of its full handshake
+        e->last_used = ++cache_clock;
+        cache_lock.unlock();
+        return true;
+    }
+
+    unsigned char *ticket_copy = NULL;
+    if (ticket_len > 0)
+    {
+        ticket_copy = (unsigned char *)mem_profile_malloc(MEM_TAG_TLS, ticket_len);
+        if (ticket_copy == NULL)
+        {
+            ticket_len = 0;
+        }
+        else
+        {
+            memcpy(ticket_copy, ticket, ticket_len);
+        }
+    }
+    if (ticket_len == 0 && s->id_len == 0)
+    {
+        cache_lock.unlock();
+        return resumed;
+    }
+
+    uint32_t expires = resumed ? e->rec.expires : now + cache_lifetime;
+    if (ticket_len > 0 && ticket_lifetime > 0 && now + ticket_lifetime < expires)
+    {
+        expires = now + ticket_lifetime;
+    }
+
+    uint32_t saved_expires = 0;
+    if (e != NULL)
+    {
+        saved_expires = e->saved_expires;
+        entry_clear(e);
+    }
+    else
+    {
+        e = entry_slot();
+    }
+
+    strncpy(e->rec.key, key, TLS_SESSION_KEY_MAX - 1);
+    e->rec.expires = expires;
+    e->rec.ciphersuite = s->ciphersuite;
+    e->rec.compression = s->compression;
+    e->rec.id_len = (uint8_t)s->id_len;
+    memcpy(e->rec.id, s->id, sizeof(e->rec.id));
+    memcpy(e->rec.master, s->master, sizeof(e->rec.master));
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    e->rec.mfl_code = s->mfl_code;
+#endif
+#if defined(MBEDTLS_SSL_TRUNCATED_HMAC)
+    e->rec.trunc_hmac = (uint8_t)s->trunc_hmac;
+#endif
+#if defined(MBEDTLS_SSL_ENCRYPT_THEN_MAC)
+    e->rec.encrypt_then_mac = (uint8_t)s->encrypt_then_mac;
+#endif
+    e->rec.ticket_len = (uint16_t)ticket_len;
+    e->rec.ticket_lifetime = ticket_lifetime;
+    e->ticket = ticket_copy;
+    e->last_used = ++cache_clock;
+    e->saved_expires = saved_expires;
+
+    cache_changed(e, now);
+    cache_lock.unlock();
+
+    return resumed;
+}
+
+void TLSSessionCache_Forget(const char *host, uint16_t port)
+{
+    if (!cache_enabled || host == NULL)
+    {
+        return;
+    }
+
+    char key[TLS_SESSION_KEY_MAX];
+    if (!make_key(key, host, port))
+    {
+        return;
+    }
+
+    uint32_t now = (uint32_t)time(NULL);
+
+    cache_lock.lock();
+    TLSSessionEntry *e = entry_find(key);
+    if (e != NULL)
+    {
+        // a stale copy in the file costs one full handshake after a reboot
+        entry_clear(e);
+        cache_changed(NULL, now);
+    }
+    cache_write_due(now);
+    cache_lock.unlock();
+}
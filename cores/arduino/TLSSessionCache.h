@@ -0,0 +1,83 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+/**
+ * @file TLSSessionCache.h
+ * @brief Opt-in TLS session resumption for TLSSocket.
+ *
+ * Once enabled, every TLSSocket looks up the last session it negotiated with
+ * the same host:port and offers it to the server (session ID and, when the
+ * server issued one, session ticket), turning the reconnect into an
+ * abbreviated handshake without certificate checks or key exchange.  If the
+ * server declines, mbed TLS falls back to a full handshake transparently.
+ *
+ * Sessions live in RAM and, optionally, in /fs/tls_sessions.bin so they
+ * survive a reboot.  The file is not rewritten on every handshake: changes go
+ * out TLS_SESSION_PERSIST_DELAY seconds later, on TLSSessionCache_Flush() (which
+ * SystemReboot() calls), or at once for a host with no usable copy in it.  Each one expires after the lifetime given to
+ * TLSSessionCache_Enable(), or the server's ticket lifetime hint if that is
+ * shorter.  Persisted sessions are only loaded once the clock has been set
+ * (NTP), since their expiry cannot be judged before that.
+ *
+ * NOTE: a persisted session contains the session's master secret in plain
+ * form; only enable persistence where flash contents are trusted.
+ */
+
+#ifndef __TLS_SESSION_CACHE_H__
+#define __TLS_SESSION_CACHE_H__
+
+#include <stdint.h>
+#include "mbedtls/ssl.h"
+
+// number of host:port entries, least recently used is replaced
+#ifndef TLS_SESSION_CACHE_ENTRIES
+#define TLS_SESSION_CACHE_ENTRIES   4
+#endif
+
+// longest session ticket kept; longer tickets are not cached (ID only)
+#ifndef TLS_SESSION_TICKET_MAX
+#define TLS_SESSION_TICKET_MAX      1024
+#endif
+
+// seconds unsaved changes may wait before the session file is rewritten
+#ifndef TLS_SESSION_PERSIST_DELAY
+#define TLS_SESSION_PERSIST_DELAY   600
+#endif
+
+#define TLS_SESSION_KEY_MAX         72      // "host:port" including '\0'
+#define TLS_SESSION_DEFAULT_LIFETIME 3600   // seconds
+
+/**
+ * @brief Turn session resumption on for all TLSSockets.
+ * @param lifetime  seconds a session may be resumed after it was negotiated
+ * @param persist   also keep sessions in the filesystem across reboots
+ */
+void TLSSessionCache_Enable(uint32_t lifetime = TLS_SESSION_DEFAULT_LIFETIME, bool persist = false);
+
+/** @brief Turn resumption off; cached sessions are dropped from RAM. */
+void TLSSessionCache_Disable(void);
+
+/** @brief Drop every cached session, including the persisted ones. */
+void TLSSessionCache_Clear(void);
+
+/** @brief Write sessions not yet persisted to the filesystem now, e.g. before a reset. */
+void TLSSessionCache_Flush(void);
+
+bool TLSSessionCache_IsEnabled(void);
+
+/**
+ * @brief Offer the cached session for host:port on a context before its handshake.
+ * @return true if a session was set
+ */
+bool TLSSessionCache_Resume(const char *host, uint16_t port, mbedtls_ssl_context *ssl);
+
+/**
+ * @brief Remember the session of a completed handshake.
+ * @return true if the handshake resumed the session that was cached
+ */
+bool TLSSessionCache_Save(const char *host, uint16_t port, const mbedtls_ssl_context *ssl);
+
+/** @brief Forget host:port, e.g. after a failed handshake. */
+void TLSSessionCache_Forget(const char *host, uint16_t port);
+
+#endif // __TLS_SESSION_CACHE_H__
@@ -1,238 +1,234 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. 
-// Modified to use IoT Hub SDK-style buffering and polling
+// Modified to use IoT Hub SDK-style buffering and event-driven waits
 
 #include "TLSSocket.h"
+#include "SerialLog.h"
+#include "MemoryProfiler.h"
+#include "TLSClientContext.h"
+#include "TLSSessionCache.h"
+#include "SystemTickCounter.h"
 #include "mbedtls/error.h"
 #include <stdlib.h>
 #include <string.h>
 
+typedef struct
+{
+    unsigned char mfl_code;
+    size_t recv_buffer_size;
+    size_t cork_buffer_size;
+} TLSMemoryProfileSpec;
+
+// indexed by TLSMemoryProfile
+static const TLSMemoryProfileSpec memory_profiles[] = {
+    { MBEDTLS_SSL_MAX_FRAG_LEN_1024, 1024, 1024 },
+    { MBEDTLS_SSL_MAX_FRAG_LEN_NONE, TLSIO_RECV_BUFFER_SIZE, TLS_CORK_BUFFER_SIZE },
+    { MBEDTLS_SSL_MAX_FRAG_LEN_NONE, 8192, 4096 },
+};
+
+const int TLS_CIPHERSUITES_ECDHE[] = {
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384,
+    0
+};
+
+const mbedtls_ecp_group_id TLS_CURVES_NIST[] = {
+    MBEDTLS_ECP_DP_SECP256R1,
+    MBEDTLS_ECP_DP_SECP384R1,
+    MBEDTLS_ECP_DP_NONE
+};
+
+// servers that answered max_fragment_length with an alert, by FNV-1a of host and port
+static uint32_t mfl_refused[TLS_MFL_REFUSED_MAX];
+static int mfl_refused_next = 0;
+static Mutex mfl_refused_lock;
+
+static bool handshake_log = TLS_HANDSHAKE_LOG != 0;
+
 static void tls_log_error(const char* label, int ret)
 {
     char buf[128];
     mbedtls_strerror(ret, buf, sizeof(buf));
-    printf("[TLS] %s: -0x%04X %s\r\n", label, (unsigned int)(-ret), buf);
+    SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_TLS, "%s: -0x%04X %s", label, (unsigned int)(-ret), buf);
+}
+
+static uint32_t server_hash(const char *host, uint16_t port)
+{
+    uint32_t hash = 2166136261u;
+    for (const char *p = host; *p != '\0'; p++)
+    {
+        hash = (hash ^ (unsigned char)*p) * 16777619u;
+    }
+    hash = (hash ^ (port & 0xFF)) * 16777619u;
+    hash = (hash ^ (port >> 8)) * 16777619u;
+    return hash != 0 ? hash : 1;
 }
 
-#define TLS_CUNSTOM "Arduino TLS Socket"
+static TLSConnectPhase handshake_phase(int state)
+{
+    switch (state)
+    {
+    case MBEDTLS_SSL_HELLO_REQUEST:
+    case MBEDTLS_SSL_CLIENT_HELLO:
+        return TLS_PHASE_CLIENT_HELLO;
+    case MBEDTLS_SSL_SERVER_HELLO:
+        return TLS_PHASE_SERVER_HELLO;
+    case MBEDTLS_SSL_SERVER_CERTIFICATE:
+        return TLS_PHASE_CERTIFICATE;
+    case MBEDTLS_SSL_SERVER_KEY_EXCHANGE:
+    case MBEDTLS_SSL_CERTIFICATE_REQUEST:
+    case MBEDTLS_SSL_SERVER_HELLO_DONE:
+        return TLS_PHASE_SERVER_KX;
+    case MBEDTLS_SSL_CLIENT_CERTIFICATE:
+    case MBEDTLS_SSL_CLIENT_KEY_EXCHANGE:
+    case MBEDTLS_SSL_CERTIFICATE_VERIFY:
+        return TLS_PHASE_CLIENT_KX;
+    default:
+        return TLS_PHASE_FINISHED;
+    }
+}
+
+static bool mfl_is_refused(const char *host, uint16_t port)
+{
+    uint32_t hash = server_hash(host, port);
+    bool found = false;
+    mfl_refused_lock.lock();
+    for (int i = 0; i < TLS_MFL_REFUSED_MAX && !found; i++)
+    {
+        found = mfl_refused[i] == hash;
+    }
+    mfl_refused_lock.unlock();
+    return found;
+}
+
+static void mfl_add_refused(const char *host, uint16_t port)
+{
+    mfl_refused_lock.lock();
+    mfl_refused[mfl_refused_next] = server_hash(host, port);
+    mfl_refused_next = (mfl_refused_next + 1) % TLS_MFL_REFUSED_MAX;
+    mfl_refused_lock.unlock();
+}
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////
 // IoT Hub SDK-style SSL callbacks
 // These use the TLSSocket instance pointer to access internal buffer
 
 /**
- * Receive callback for mbed TLS - IoT Hub SDK style
+ * Receive callback for mbed TLS
  * 
- * Uses internal buffer and polling loop like tlsio_mbedtls.c on_io_recv()
+ * Serves mbed TLS from the receive ring, which is refilled from the TCP
+ * socket in ring-sized chunks when it runs empty.  The socket is
+ * non-blocking: with nothing pending this returns WANT_READ and the caller
+ * waits for the socket's sigio event (or hands WANT_READ to its event loop).
  */
-static int ssl_recv(void *ctx, unsigned char *buf, size_t len) 
+int ssl_recv(void *ctx, unsigned char *buf, size_t len)
 {
     TLSSocket *tls = static_cast<TLSSocket *>(ctx);
-    TCPSocket *socket = tls->_tcp_socket;
-    int pending = 0;
+    SPSCRingBuffer<unsigned char> *ring = tls->_recv_ring;
     
-    // IoT Hub SDK style: poll socket until we have data in buffer
-    while (tls->_recv_buffer_count == 0)
+    if (ring->empty())
     {
-        // Try to receive data from underlying socket
-        unsigned char temp_buf[128];
-        int recv_result = socket->recv(temp_buf, sizeof(temp_buf));
+        int recv_result = tls->fill_recv_buffer();
         
-        if (recv_result > 0)
-        {
-            // Got data - add to internal buffer
-            size_t new_size = tls->_recv_buffer_count + recv_result;
-            unsigned char *new_buffer = (unsigned char *)realloc(tls->_recv_buffer, new_size);
-            if (new_buffer != NULL)
-            {
-                tls->_recv_buffer = new_buffer;
-                memcpy(tls->_recv_buffer + tls->_recv_buffer_count, temp_buf, recv_result);
-                tls->_recv_buffer_count = new_size;
-            }
-            break;  // Got data, exit polling loop
-        }
-        else if (recv_result == NSAPI_ERROR_WOULD_BLOCK || recv_result == 0)
+        if (recv_result == NSAPI_ERROR_WOULD_BLOCK || recv_result == 0)
         {
             // No data available yet
-            if (tls->_handshake_complete)
-            {
-                // After handshake, don't block - return WANT_READ
-                break;
-            }
-            else
-            {
-                // During handshake: poll with timeout like IoT Hub SDK
-                if (pending++ >= HANDSHAKE_TIMEOUT_MS / HANDSHAKE_WAIT_INTERVAL_MS)
-                {
-                    // Timeout during handshake
-                    return MBEDTLS_ERR_SSL_TIMEOUT;
-                }
-                wait_ms(HANDSHAKE_WAIT_INTERVAL_MS);
-            }
+            return MBEDTLS_ERR_SSL_WANT_READ;
         }
-        else
+        else if (recv_result < 0)
         {
             // Real socket error
             return -1;
         }
     }
     
-    // Return data from internal buffer (like IoT Hub SDK on_io_recv)
-    int result = (int)tls->_recv_buffer_count;
-    if (result > (int)len)
-    {
-        result = (int)len;
-    }
-    
-    if (result > 0)
-    {
-        // Copy data to caller's buffer
-        memcpy(buf, tls->_recv_buffer, result);
-        
-        // Shift remaining data in buffer
-        size_t remaining = tls->_recv_buffer_count - result;
-        if (remaining > 0)
-        {
-            memmove(tls->_recv_buffer, tls->_recv_buffer + result, remaining);
-            tls->_recv_buffer_count = remaining;
-            
-            // Shrink buffer
-            unsigned char *new_buffer = (unsigned char *)realloc(tls->_recv_buffer, remaining);
-            if (new_buffer != NULL)
-            {
-                tls->_recv_buffer = new_buffer;
-            }
-        }
-        else
-        {
-            // Buffer empty
-            free(tls->_recv_buffer);
-            tls->_recv_buffer = NULL;
-            tls->_recv_buffer_count = 0;
-        }
-        
-        return result;
-    }
-    
-    // No data in buffer - tell mbedTLS to try again
-    return MBEDTLS_ERR_SSL_WANT_READ;
+    // Copy to the caller's buffer straight out of the ring
+    int read = (int)ring->read(buf, len);
+    tls->count_handshake_io(0, read);
+    return read;
 }
 
 /**
- * Send callback for mbed TLS - IoT Hub SDK style
+ * Send callback for mbed TLS
  * 
- * Loops until all data sent or error (like tlsio_mbedtls.c on_io_send)
+ * Returns WANT_WRITE when the socket cannot take more; mbed TLS keeps the
+ * record and the caller retries once sigio reports the socket writable.
  */
-static int ssl_send(void *ctx, const unsigned char *buf, size_t len)
+int ssl_send(void *ctx, const unsigned char *buf, size_t len)
 {
     TLSSocket *tls = static_cast<TLSSocket *>(ctx);
-    TCPSocket *socket = tls->_tcp_socket;
+    int size = tls->tcp_send(buf, len);
     
-    // IoT Hub SDK style: retry loop for send
-    for (int i = 0; i < 10; ++i)
+    if (size > 0)
     {
-        int size = socket->send(buf, len);
-        
-        if (size > 0)
-        {
-            return size;
-        }
-        else if (size == NSAPI_ERROR_WOULD_BLOCK || size == 0)
-        {
-            // Can't send right now - wait and retry
-            wait_ms(100);
-        }
-        else
-        {
-            // Real socket error
-            return -1;
-        }
+        tls->count_handshake_io(size, 0);
+        return size;
     }
-    
-    // Exhausted retries - tell mbedTLS we sent it (like original devkit-sdk)
-    // This prevents mbedTLS from treating it as fatal error
-    return len;
-}
-
-#if DEBUG_LEVEL > 0
-static void my_debug(void *ctx, int level, const char *file_name, int line, const char *str)
-{
-    char tmp[32];
-    const char *p, *basename;
-    
-    if (file_name != NULL)
+    else if (size == NSAPI_ERROR_WOULD_BLOCK || size == 0)
     {
-        /* Extract basename from file */
-        basename = file_name;
-        for (p = basename; *p != '\0'; p++)
-        {
-            if(*p == '/' || *p == '\\')
-            {
-                basename = p + 1;
-            }
-        }
-        
-        INFO(basename);
+        return MBEDTLS_ERR_SSL_WANT_WRITE;
     }
-    sprintf(tmp, " %04d: |%d| ", line, level);
-    INFO(tmp);
-    INFO("\r\n");
-}
-
-static int my_verify(void *data, mbedtls_x509_crt *crt, int depth, uint32_t *flags)
-{
-    const uint32_t buf_size = 1024;
-    char *buf = new char[buf_size];
-    (void) data;
-
-    
-    mbedtls_x509_crt_info(buf, buf_size - 1, "  ", crt);
     
-
-    if (*flags == 0)
-    {
-        INFO("No verification issue for this certificate");
-    }
-    else
-    {
-        mbedtls_x509_crt_verify_info(buf, buf_size, "  ! ", *flags);
-        INFO(buf);
-    }
-
-    delete[] buf;
-    return 0;
+    // Real socket error
+    return -1;
 }
-#endif
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////
 // Class
 
 void TLSSocket::init_common(NetworkInterface* net_iface)
 {
-    // IoT Hub SDK-style: initialize receive buffer
-    _recv_buffer = NULL;
-    _recv_buffer_count = 0;
+    // IoT Hub SDK-style: receive ring is allocated on connect
+    _recv_ring = NULL;
+    _recv_storage = NULL;
+    _recv_buffer_size = TLSIO_RECV_BUFFER_SIZE;
     _handshake_complete = false;
+    _handshake_pending = false;
+    _resume_offered = false;
+    _blocking = true;
+    _timeout_ms = HANDSHAKE_TIMEOUT_MS;
+    _recv_timeout_ms = 0;
+    _op_start = 0;
+    _wbuf = NULL;
+    _wbuf_size = TLS_CORK_BUFFER_SIZE;
+    _wbuf_len = 0;
+    _corked = false;
+    _cork_start = 0;
+    _net_iface = net_iface;
+    _profile = TLS_MEMORY_DEFAULT;
+    _mfl_code = MBEDTLS_SSL_MAX_FRAG_LEN_NONE;
+    _ciphersuites = NULL;
+    _curves = NULL;
+    _ctx_stale = false;
+    _heap_setup = 0;
+    _heap_base = 0;
+    _heap_high = 0;
+    _heap_peak = 0;
+    memset(&_timing, 0, sizeof(_timing));
+    _phase = TLS_PHASE_COUNT;
+    _connect_start = 0;
+    _phase_start = 0;
+    memset(&_net_stats, 0, sizeof(_net_stats));
     
     if (net_iface)
     {
         _tcp_socket = new TCPSocket(net_iface);
+        _tcp_socket->sigio(mbed::callback(this, &TLSSocket::on_sigio));
     }
     else
     {
         _tcp_socket = NULL;
     }
 
+    // SSL configuration is shared, acquired on the first connect
+    _ctx = NULL;
     if (_ssl_ca_pem)
     {
-        // SSL
-        mbedtls_entropy_init(&_entropy);
-        mbedtls_ctr_drbg_init(&_ctr_drbg);
-        mbedtls_x509_crt_init(&_cacert);
-        mbedtls_x509_crt_init(&_clientcert);
-        mbedtls_pk_init(&_clientkey);
         mbedtls_ssl_init(&_ssl);
-        mbedtls_ssl_config_init(&_ssl_conf);
     }
 }
 
@@ -241,6 +237,9 @@ TLSSocket::TLSSocket(const char *ssl_ca_pem, NetworkInterface* net_iface)
     _ssl_ca_pem = ssl_ca_pem;
     _ssl_client_cert = NULL;
     _ssl_client_key = NULL;
+    _ssl_ca_len = 0;
+    _ssl_client_cert_len = 0;
+    _ssl_client_key_len = 0;
     init_common(net_iface);
 }
 
@@ -250,27 +249,37 @@ TLSSocket::TLSSocket(const char *ssl_ca_pem, const char *ssl_client_cert,
     _ssl_ca_pem = ssl_ca_pem;
     _ssl_client_cert = ssl_client_cert;
     _ssl_client_key = ssl_client_key;
+    _ssl_ca_len = 0;
+    _ssl_client_cert_len = 0;
+    _ssl_client_key_len = 0;
+    init_common(net_iface);
+}
+
+TLSSocket::TLSSocket(const unsigned char *ca, size_t ca_len,
+                     const unsigned char *client_cert, size_t client_cert_len,
+                     const unsigned char *client_key, size_t client_key_len,
+                     NetworkInterface* net_iface)
+{
+    _ssl_ca_pem = (const char *)ca;
+    _ssl_client_cert = (const char *)client_cert;
+    _ssl_client_key = (const char *)client_key;
+    _ssl_ca_len = ca_len;
+    _ssl_client_cert_len = client_cert_len;
+    _ssl_client_key_len = client_key_len;
     init_common(net_iface);
 }
 
 TLSSocket::~TLSSocket()
 {
-    // Free receive buffer
-    if (_recv_buffer != NULL)
-    {
-        free(_recv_buffer);
-        _recv_buffer = NULL;
-    }
+    // Free receive ring
+    delete _recv_ring;
+    mem_profile_free(_recv_storage);
+    mem_profile_free(_wbuf);
     
     if (_ssl_ca_pem)
     {
-        mbedtls_entropy_free(&_entropy);
-        mbedtls_ctr_drbg_free(&_ctr_drbg);
-        mbedtls_x509_crt_free(&_cacert);
-        mbedtls_x509_crt_free(&_clientcert);
-        mbedtls_pk_free(&_clientkey);
         mbedtls_ssl_free(&_ssl);
-        mbedtls_ssl_config_free(&_ssl_conf);
+        TLSClientContext::release(_ctx);
     }
     
     if (_tcp_socket)
@@ -282,196 +291,687 @@ TLSSocket::~TLSSocket()
 
 nsapi_error_t TLSSocket::connect(const char *host, uint16_t port)
 {
+    int ret;
     if (_tcp_socket == NULL)
     {
         return NSAPI_ERROR_NO_SOCKET;
     }
     
+    if (_handshake_pending)
+    {
+        // non-blocking connect() called again: carry on with the handshake
+        return handshake(host, port);
+    }
+
+    memset(&_timing, 0, sizeof(_timing));
+    _connect_start = SystemTickCounterRead();
+    _phase_start = _connect_start;
+    _phase = TLS_PHASE_COUNT;
+
     if (_ssl_ca_pem == NULL)
     {
         // No SSL
-        return _tcp_socket->connect(host, port);
+        ret = tcp_connect(host, port);
+        _timing.total_ms = (uint32_t)(SystemTickCounterRead() - _connect_start);
+        net_stats_connect(NET_STATS_TCP, &_net_stats, _timing.total_ms, ret == NSAPI_ERROR_OK);
+        if (ret == NSAPI_ERROR_OK && !_blocking)
+        {
+            _tcp_socket->set_blocking(false);
+        }
+        return ret;
     }
     
-    // Initialize TLS-related stuf.
-    int ret;
-    if ((ret = mbedtls_ctr_drbg_seed(&_ctr_drbg, mbedtls_entropy_func, &_entropy,
-                      (const unsigned char *) TLS_CUNSTOM,
-                      sizeof (TLS_CUNSTOM))) != 0)
-    {
-        tls_log_error("drbg_seed", ret);
-        return -1;
-    }
-
-    if ((ret = mbedtls_x509_crt_parse(&_cacert, (const unsigned char *)_ssl_ca_pem,
-                       strlen(_ssl_ca_pem) + 1)) != 0)
+    // Offer max_fragment_length unless this server turned it down before
+    unsigned char mfl_code = memory_profiles[_profile].mfl_code;
+    if (mfl_code != MBEDTLS_SSL_MAX_FRAG_LEN_NONE && mfl_is_refused(host, port))
     {
-        tls_log_error("CA cert parse", ret);
-        return -1;
+        mfl_code = MBEDTLS_SSL_MAX_FRAG_LEN_NONE;
     }
-
-    if ((ret = mbedtls_ssl_config_defaults(&_ssl_conf,
-                    MBEDTLS_SSL_IS_CLIENT,
-                    MBEDTLS_SSL_TRANSPORT_STREAM,
-                    MBEDTLS_SSL_PRESET_DEFAULT)) != 0)
+    if (_ctx != NULL && (mfl_code != _mfl_code || _ctx_stale))
     {
-        tls_log_error("ssl_config_defaults", ret);
-        return -1;
+        // these are part of the shared configuration: switch to another one
+        mbedtls_ssl_free(&_ssl);
+        mbedtls_ssl_init(&_ssl);
+        TLSClientContext::release(_ctx);
+        _ctx = NULL;
     }
+    _mfl_code = mfl_code;
+    _ctx_stale = false;
 
-    mbedtls_ssl_conf_ca_chain(&_ssl_conf, &_cacert, NULL);
-    mbedtls_ssl_conf_rng(&_ssl_conf, mbedtls_ctr_drbg_random, &_ctr_drbg);
-
-    /* It is possible to disable authentication by passing
-     * MBEDTLS_SSL_VERIFY_NONE in the call to mbedtls_ssl_conf_authmode()
-     */
-    mbedtls_ssl_conf_authmode(&_ssl_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
-    
-    // Configure client certificate for mutual TLS if provided
-    if (_ssl_client_cert != NULL && _ssl_client_key != NULL)
+    // Initialize TLS-related stuf.
+    if (_ctx == NULL)
     {
-        if ((ret = mbedtls_x509_crt_parse(&_clientcert, (const unsigned char *)_ssl_client_cert,
-                           strlen(_ssl_client_cert) + 1)) != 0)
+        // DRBG, CA chain and client credentials are shared with every other
+        // socket using the same certificates
+        if (_ssl_ca_len == 0)
         {
-            tls_log_error("client cert parse", ret);
-            return -1;
+            _ctx = TLSClientContext::acquire(_ssl_ca_pem, _ssl_client_cert, _ssl_client_key,
+                                             _mfl_code, _ciphersuites, _curves);
         }
-        
-        if ((ret = mbedtls_pk_parse_key(&_clientkey, (const unsigned char *)_ssl_client_key,
-                         strlen(_ssl_client_key) + 1, NULL, 0)) != 0)
+        else
+        {
+            _ctx = TLSClientContext::acquire((const unsigned char *)_ssl_ca_pem, _ssl_ca_len,
+                                             (const unsigned char *)_ssl_client_cert, _ssl_client_cert_len,
+                                             (const unsigned char *)_ssl_client_key, _ssl_client_key_len,
+                                             _mfl_code, _ciphersuites, _curves);
+        }
+        if (_ctx == NULL)
         {
-            tls_log_error("private key parse", ret);
             return -1;
         }
-        
-        if ((ret = mbedtls_ssl_conf_own_cert(&_ssl_conf, &_clientcert, &_clientkey)) != 0)
+
+        // record buffers: the bulk of what a connection costs
+        mem_stats_t heap;
+        mem_profile_heap(&heap, NULL);
+        uint32_t before = heap.current;
+        if ((ret = mbedtls_ssl_setup(&_ssl, _ctx->config())) != 0)
         {
-            tls_log_error("ssl_conf_own_cert", ret);
+            tls_log_error("ssl_setup", ret);
+            TLSClientContext::release(_ctx);
+            _ctx = NULL;
             return -1;
         }
+        mem_profile_heap(&heap, NULL);
+        _heap_setup = heap.current > before ? heap.current - before : 0;
     }
-
-#if DEBUG_LEVEL > 0
-    mbedtls_ssl_conf_verify(&_ssl_conf, my_verify, NULL);
-    mbedtls_ssl_conf_dbg(&_ssl_conf, my_debug, NULL);
-    mbedtls_debug_set_threshold(DEBUG_LEVEL);
-#endif
-
-    if ((ret = mbedtls_ssl_setup(&_ssl, &_ssl_conf)) != 0)
+    else if ((ret = mbedtls_ssl_session_reset(&_ssl)) != 0)
     {
-        tls_log_error("ssl_setup", ret);
+        // reconnect on the same socket: keep the context, drop the old session state
+        tls_log_error("ssl_session_reset", ret);
         return -1;
     }
     
     mbedtls_ssl_set_hostname(&_ssl, host);
+
+    // One receive ring for the life of the connection
+    uint32_t ring_size = 1;
+    while (ring_size < _recv_buffer_size)
+    {
+        ring_size <<= 1;
+    }
+    if (_recv_ring == NULL || _recv_ring->capacity() != ring_size)
+    {
+        delete _recv_ring;
+        mem_profile_free(_recv_storage);
+        _recv_ring = NULL;
+        _recv_storage = (unsigned char *)mem_profile_malloc(MEM_TAG_TLS, ring_size);
+        if (_recv_storage == NULL)
+        {
+            SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_TLS, "No memory for %u byte receive buffer", (unsigned int)ring_size);
+            return NSAPI_ERROR_NO_MEMORY;
+        }
+        _recv_ring = new SPSCRingBuffer<unsigned char>(_recv_storage, ring_size);
+    }
+    _recv_ring->clear();
     
     // IoT Hub SDK style: pass TLSSocket pointer to callbacks for buffer access
     mbedtls_ssl_set_bio(&_ssl, static_cast<void *>(this), ssl_send, ssl_recv, NULL);
     
     /* Connect to the server */
-    ret = _tcp_socket->connect(host, port);
+    ret = tcp_connect(host, port);
     if (ret != NSAPI_ERROR_OK)
     {
-        printf("[TLS] TCP connect failed: %d\r\n", ret);
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_TLS, "TCP connect failed: %d", ret);
+        net_stats_connect(NET_STATS_TLS, &_net_stats, (uint32_t)(SystemTickCounterRead() - _connect_start), false);
         return ret;
     }
-    printf("[TLS] TCP connected, starting handshake...\r\n");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_TLS, "TCP connected, starting handshake...");
     
-    // IoT Hub SDK style: set socket to non-blocking for polling
+    // Non-blocking socket; readiness is signalled through sigio
     _tcp_socket->set_blocking(false);
-    _tcp_socket->set_timeout(100);  // Short timeout for polling
 
-    /* Start the handshake - IoT Hub SDK style: loop until complete */
+    // Offer the last session with this server, if resumption is enabled
+    _resume_offered = TLSSessionCache_Resume(host, port, &_ssl);
+
     _handshake_complete = false;
-    do
+    _handshake_pending = true;
+    _wbuf_len = 0;
+
+    // handshake allocations are counted from here, on top of what the socket holds
+    mem_stats_t heap;
+    mem_profile_heap(&heap, NULL);
+    _heap_base = heap.current;
+    _heap_high = heap.peak;
+    _heap_peak = 0;
+    begin_io();
+    return handshake(host, port);
+}
+
+nsapi_error_t TLSSocket::handshake(const char *host, uint16_t port)
+{
+    int ret = 0;
+    // step by step (as mbedtls_ssl_handshake() does) to time each state and
+    // sample the heap in between
+    while (_ssl.state != MBEDTLS_SSL_HANDSHAKE_OVER)
     {
-        ret = mbedtls_ssl_handshake(&_ssl);
-    } while (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+        enter_phase(handshake_phase(_ssl.state));
+        ret = mbedtls_ssl_handshake_step(&_ssl);
+        sample_heap();
+        if (ret == 0)
+        {
+            continue;
+        }
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+        {
+            break;
+        }
+        uint64_t wait_start = SystemTickCounterRead();
+        bool waited = wait_io(_timeout_ms);
+        _timing.wait_ms[_phase] += (uint32_t)(SystemTickCounterRead() - wait_start);
+        if (!waited)
+        {
+            if (!_blocking && SystemTickCounterRead() - _op_start < (uint64_t)_timeout_ms)
+            {
+                return NSAPI_ERROR_IN_PROGRESS;
+            }
+            ret = MBEDTLS_ERR_SSL_TIMEOUT;
+            break;
+        }
+    }
+    enter_phase(TLS_PHASE_COUNT);
+    _handshake_pending = false;
     
+    if (ret < 0 && _mfl_code != MBEDTLS_SSL_MAX_FRAG_LEN_NONE && _ssl.state <= MBEDTLS_SSL_SERVER_HELLO &&
+        (ret == MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE || ret == MBEDTLS_ERR_SSL_BAD_HS_SERVER_HELLO))
+    {
+        // an alert in answer to the ClientHello, or a ServerHello with the
+        // wrong fragment length: try again without the extension
+        SERIAL_LOG_WARN(SERIAL_LOG_MODULE_TLS, "%s refused max_fragment_length, reconnecting without it", host);
+        mfl_add_refused(host, port);
+        return reconnect(host, port);
+    }
+
     if (ret < 0) 
     {
         tls_log_error("handshake", ret);
+        net_stats_connect(NET_STATS_TLS, &_net_stats, (uint32_t)(SystemTickCounterRead() - _connect_start), false);
+        if (_resume_offered)
+        {
+            TLSSessionCache_Forget(host, port);
+        }
         uint32_t flags = mbedtls_ssl_get_verify_result(&_ssl);
         if (flags != 0)
         {
             char vrfy[512];
             mbedtls_x509_crt_verify_info(vrfy, sizeof(vrfy), "  ! ", flags);
-            printf("[TLS] verify flags=0x%08X\r\n%s\r\n", (unsigned int)flags, vrfy);
+            SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_TLS, "verify flags=0x%08X", (unsigned int)flags);
+            // one record per line of the report
+            char *save;
+            for (char *line = strtok_r(vrfy, "\n", &save); line != NULL; line = strtok_r(NULL, "\n", &save))
+            {
+                SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_TLS, "%s", line);
+            }
         }
         return -1;
     }
     
-    printf("[TLS] Handshake complete.\r\n");
+    _timing.total_ms = (uint32_t)(SystemTickCounterRead() - _connect_start);
+    net_stats_connect(NET_STATS_TLS, &_net_stats, _timing.total_ms, true);
+    _timing.resumed = TLSSessionCache_Save(host, port, &_ssl);
+    if (_timing.resumed)
+    {
+        SERIAL_LOG_INFO(SERIAL_LOG_MODULE_TLS, "Handshake complete (session resumed).");
+    }
+    else
+    {
+        SERIAL_LOG_INFO(SERIAL_LOG_MODULE_TLS, "Handshake complete.");
+    }
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_TLS, "TLS heap %u bytes (records %u, handshake %u), max fragment %u",
+                    (unsigned int)heap_peak(), (unsigned int)_heap_setup, (unsigned int)_heap_peak,
+                    (unsigned int)max_fragment_length());
+    if (handshake_log)
+    {
+        log_handshake(host, port);
+    }
     _handshake_complete = true;
     return NSAPI_ERROR_OK;
 }
 
+nsapi_error_t TLSSocket::tcp_connect(const char *host, uint16_t port)
+{
+    // resolved separately to time the lookup on its own
+    enter_phase(TLS_PHASE_DNS);
+    SocketAddress address;
+    nsapi_error_t ret = _net_iface->gethostbyname(host, &address);
+    if (ret != NSAPI_ERROR_OK)
+    {
+        enter_phase(TLS_PHASE_COUNT);
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_TLS, "DNS lookup of %s failed: %d", host, ret);
+        return ret;
+    }
+    address.set_port(port);
+
+    enter_phase(TLS_PHASE_TCP);
+    ret = _tcp_socket->connect(address);
+    enter_phase(TLS_PHASE_COUNT);
+    return ret;
+}
+
+void TLSSocket::enter_phase(TLSConnectPhase phase)
+{
+    uint64_t now = SystemTickCounterRead();
+    if (_phase < TLS_PHASE_COUNT)
+    {
+        _timing.time_ms[_phase] += (uint32_t)(now - _phase_start);
+    }
+    _phase = phase;
+    _phase_start = now;
+}
+
+void TLSSocket::count_handshake_io(size_t sent, size_t received)
+{
+    if (_handshake_pending && _phase < TLS_PHASE_COUNT)
+    {
+        _timing.bytes_sent[_phase] += sent;
+        _timing.bytes_received[_phase] += received;
+    }
+}
+
+void TLSSocket::set_handshake_log(bool enable)
+{
+    handshake_log = enable;
+}
+
+void TLSSocket::log_handshake(const char *host, uint16_t port)
+{
+    const TLSHandshakeTiming &t = _timing;
+    uint32_t wait = 0;
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    for (int i = 0; i < TLS_PHASE_COUNT; i++)
+    {
+        wait += t.wait_ms[i];
+        sent += t.bytes_sent[i];
+        received += t.bytes_received[i];
+    }
+
+    // one line: ms per phase, then socket waits and bytes over the handshake
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_TLS,
+                    "hs %s:%u %lums%s dns %lu tcp %lu ch %lu sh %lu cert %lu skx %lu ckx %lu fin %lu wait %lu tx %lu rx %lu",
+                    host, (unsigned int)port, (unsigned long)t.total_ms, t.resumed ? " resumed" : "",
+                    (unsigned long)t.time_ms[TLS_PHASE_DNS], (unsigned long)t.time_ms[TLS_PHASE_TCP],
+                    (unsigned long)t.time_ms[TLS_PHASE_CLIENT_HELLO], (unsigned long)t.time_ms[TLS_PHASE_SERVER_HELLO],
+                    (unsigned long)t.time_ms[TLS_PHASE_CERTIFICATE], (unsigned long)t.time_ms[TLS_PHASE_SERVER_KX],
+                    (unsigned long)t.time_ms[TLS_PHASE_CLIENT_KX], (unsigned long)t.time_ms[TLS_PHASE_FINISHED],
+                    (unsigned long)wait, (unsigned long)sent, (unsigned long)received);
+}
+
+nsapi_error_t TLSSocket::reconnect(const char *host, uint16_t port)
+{
+    _tcp_socket->close();
+    if (_tcp_socket->open(_net_iface) != NSAPI_ERROR_OK)
+    {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+    return connect(host, port);
+}
+
+void TLSSocket::sample_heap()
+{
+    mem_stats_t heap;
+    mem_profile_heap(&heap, NULL);
+
+    uint32_t high = heap.current;
+    if (heap.peak > _heap_high)
+    {
+        // a new heap record was set inside the step
+        high = heap.peak;
+        _heap_high = heap.peak;
+    }
+    if (high > _heap_base && high - _heap_base > _heap_peak)
+    {
+        _heap_peak = high - _heap_base;
+    }
+}
+
+size_t TLSSocket::heap_peak() const
+{
+    if (_ssl_ca_pem == NULL || _ctx == NULL)
+    {
+        return 0;
+    }
+    size_t held = _heap_setup;
+    if (_recv_storage != NULL)
+    {
+        held += _recv_ring->capacity();
+    }
+    if (_wbuf != NULL)
+    {
+        held += _wbuf_size;
+    }
+    return held + _heap_peak;
+}
+
+size_t TLSSocket::max_fragment_length() const
+{
+    if (_ctx == NULL || _mfl_code == MBEDTLS_SSL_MAX_FRAG_LEN_NONE)
+    {
+        return 0;
+    }
+    return mbedtls_ssl_get_max_frag_len(&_ssl);
+}
+
+void TLSSocket::set_ciphersuites(const int *ciphersuites)
+{
+    _ciphersuites = ciphersuites;
+    _ctx_stale = true;
+}
+
+void TLSSocket::set_curves(const mbedtls_ecp_group_id *curves)
+{
+    _curves = curves;
+    _ctx_stale = true;
+}
+
+void TLSSocket::set_memory_profile(TLSMemoryProfile profile)
+{
+    if ((int)profile < TLS_MEMORY_SMALL || profile > TLS_MEMORY_LARGE)
+    {
+        profile = TLS_MEMORY_DEFAULT;
+    }
+    _profile = profile;
+    set_recv_buffer_size(memory_profiles[profile].recv_buffer_size);
+    set_cork_buffer_size(memory_profiles[profile].cork_buffer_size);
+}
+
+void TLSSocket::on_sigio()
+{
+    // network stack context: just wake the waiter and pass the event on
+    _io_event.release();
+    if (_sigio)
+    {
+        _sigio();
+    }
+}
+
+void TLSSocket::begin_io()
+{
+    // events from before this operation are stale, it tries the socket first anyway
+    while (_io_event.wait(0) > 0)
+    {
+    }
+    _op_start = SystemTickCounterRead();
+}
+
+bool TLSSocket::wait_io(int timeout_ms)
+{
+    if (!_blocking)
+    {
+        return false;
+    }
+
+    uint64_t now = SystemTickCounterRead();
+    uint64_t elapsed = now - _op_start;
+    if (elapsed >= (uint64_t)timeout_ms)
+    {
+        return false;
+    }
+    _io_event.wait((uint32_t)(timeout_ms - elapsed));
+
+    // every caller tries the socket again after this
+    net_stats_wait(net_kind(), &_net_stats, (uint32_t)(SystemTickCounterRead() - now));
+    net_stats_retry(net_kind(), &_net_stats);
+    return true;
+}
+
+void TLSSocket::set_blocking(bool blocking)
+{
+    _blocking = blocking;
+    if (_tcp_socket != NULL && _ssl_ca_pem == NULL)
+    {
+        // plain TCP follows the caller's choice; under TLS the socket is always non-blocking
+        _tcp_socket->set_blocking(blocking);
+    }
+}
+
+void TLSSocket::set_timeout(int timeout_ms)
+{
+    _timeout_ms = timeout_ms > 0 ? timeout_ms : HANDSHAKE_TIMEOUT_MS;
+}
+
+void TLSSocket::set_recv_timeout(int timeout_ms)
+{
+    _recv_timeout_ms = timeout_ms > 0 ? timeout_ms : 0;
+}
+
+void TLSSocket::sigio(mbed::Callback<void()> func)
+{
+    _sigio = func;
+}
+
+void TLSSocket::set_recv_buffer_size(size_t size)
+{
+    _recv_buffer_size = size > 0 ? size : TLSIO_RECV_BUFFER_SIZE;
+}
+
+int TLSSocket::tcp_send(const void *data, size_t size)
+{
+    int ret = _tcp_socket->send(data, size);
+    net_stats_send(net_kind(), &_net_stats, ret);
+    return ret;
+}
+
+int TLSSocket::tcp_recv(void *data, size_t size)
+{
+    int ret = _tcp_socket->recv(data, size);
+    net_stats_recv(net_kind(), &_net_stats, ret);
+    return ret;
+}
+
+int TLSSocket::fill_recv_buffer()
+{
+    int total = 0;
+
+    // at most two reads: up to the end of the ring, then the wrapped part
+    for (int i = 0; i < 2; i++)
+    {
+        uint32_t room;
+        unsigned char *dst = _recv_ring->acquireWrite(_recv_ring->space(), &room);
+        if (room == 0)
+        {
+            break;
+        }
+
+        int ret = tcp_recv(dst, room);
+        if (ret <= 0)
+        {
+            return total > 0 ? total : ret;
+        }
+        _recv_ring->commitWrite(ret);
+        total += ret;
+
+        if ((uint32_t)ret < room)
+        {
+            break;  // socket drained
+        }
+    }
+
+    return total;
+}
+
 nsapi_error_t TLSSocket::close()
 {
     if (_tcp_socket == NULL)
     {
         return NSAPI_ERROR_NO_SOCKET;
     }
+    // best effort: whatever is still corked goes before the close
+    flush();
+    _wbuf_len = 0;
+    _corked = false;
     return _tcp_socket->close();
 }
 
+void TLSSocket::cork()
+{
+    _corked = true;
+}
+
+nsapi_error_t TLSSocket::uncork()
+{
+    _corked = false;
+    return flush();
+}
+
+nsapi_error_t TLSSocket::flush()
+{
+    if (_wbuf_len == 0)
+    {
+        return NSAPI_ERROR_OK;
+    }
+    if (_tcp_socket == NULL)
+    {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+
+    int ret = write_through(_wbuf, _wbuf_len);
+    if (ret < 0)
+    {
+        return ret;
+    }
+    if ((size_t)ret < _wbuf_len)
+    {
+        // keep the rest in order for the next flush
+        memmove(_wbuf, _wbuf + ret, _wbuf_len - ret);
+        _wbuf_len -= ret;
+        return NSAPI_ERROR_WOULD_BLOCK;
+    }
+    _wbuf_len = 0;
+    return NSAPI_ERROR_OK;
+}
+
+void TLSSocket::set_cork_buffer_size(size_t size)
+{
+    if (size == 0)
+    {
+        size = TLS_CORK_BUFFER_SIZE;
+    }
+    else if (size > MBEDTLS_SSL_OUT_CONTENT_LEN)
+    {
+        size = MBEDTLS_SSL_OUT_CONTENT_LEN;
+    }
+
+    if (_wbuf_len == 0 && size != _wbuf_size)
+    {
+        mem_profile_free(_wbuf);
+        _wbuf = NULL;
+        _wbuf_size = size;
+    }
+}
+
 nsapi_size_or_error_t TLSSocket::send(const void *data, nsapi_size_t size)
 {
     if (_tcp_socket == NULL)
     {
         return NSAPI_ERROR_NO_SOCKET;
     }
-    
-    if (_ssl_ca_pem == NULL)
+
+    const unsigned char *ptr = (const unsigned char *)data;
+    int ret;
+
+    if (_wbuf_len > 0 && (!_corked || SystemTickCounterRead() - _cork_start >= TLS_CORK_TIMEOUT_MS))
     {
-        // No SSL - use direct TCP send with retry
-        const unsigned char *ptr = (const unsigned char *)data;
-        size_t total_sent = 0;
-        
-        while (total_sent < size)
+        // gathered bytes go first so the stream stays in order
+        if ((ret = flush()) != NSAPI_ERROR_OK)
+        {
+            return ret;
+        }
+    }
+
+    if (_corked && _wbuf == NULL)
+    {
+        _wbuf = (unsigned char *)mem_profile_malloc(MEM_TAG_TLS, _wbuf_size);
+        if (_wbuf == NULL)
+        {
+            SERIAL_LOG_WARN(SERIAL_LOG_MODULE_TLS, "No memory for %u byte write buffer, sending uncorked", (unsigned int)_wbuf_size);
+            _corked = false;
+        }
+    }
+
+    if (!_corked || (_wbuf_len == 0 && size >= _wbuf_size))
+    {
+        return write_through(ptr, size);
+    }
+
+    size_t taken = 0;
+    while (taken < size)
+    {
+        size_t n = size - taken;
+        if (n > _wbuf_size - _wbuf_len)
+        {
+            n = _wbuf_size - _wbuf_len;
+        }
+        if (_wbuf_len == 0)
+        {
+            _cork_start = SystemTickCounterRead();
+        }
+        memcpy(_wbuf + _wbuf_len, ptr + taken, n);
+        _wbuf_len += n;
+        taken += n;
+
+        if (_wbuf_len == _wbuf_size && (ret = flush()) != NSAPI_ERROR_OK)
         {
-            int result = _tcp_socket->send(ptr + total_sent, size - total_sent);
-            if (result > 0)
+            // the buffer holds what did not go out; tell the caller about the rest
+            if (ret != NSAPI_ERROR_WOULD_BLOCK)
             {
-                total_sent += result;
+                return ret;
             }
-            else if (result == NSAPI_ERROR_WOULD_BLOCK || result == 0)
+            break;
+        }
+    }
+
+    return taken > 0 ? (nsapi_size_or_error_t)taken : NSAPI_ERROR_WOULD_BLOCK;
+}
+
+nsapi_size_or_error_t TLSSocket::write_through(const unsigned char *ptr, size_t size)
+{
+    size_t total_sent = 0;
+    begin_io();
+
+    while (total_sent < size)
+    {
+        int ret;
+        if (_ssl_ca_pem == NULL)
+        {
+            // No SSL - direct TCP send
+            ret = tcp_send(ptr + total_sent, size - total_sent);
+            if (ret == 0)
             {
-                wait_ms(100);
+                ret = NSAPI_ERROR_WOULD_BLOCK;
             }
-            else
+        }
+        else
+        {
+            ret = mbedtls_ssl_write(&_ssl, ptr + total_sent, size - total_sent);
+            if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE)
             {
-                return result;  // Real error
+                ret = NSAPI_ERROR_WOULD_BLOCK;
             }
         }
-        return (nsapi_size_or_error_t)size;
-    }
 
-    // IoT Hub SDK style: loop until all data sent
-    const unsigned char *ptr = (const unsigned char *)data;
-    int out_left = (int)size;
-    
-    do
-    {
-        int ret = mbedtls_ssl_write(&_ssl, ptr + (size - out_left), out_left);
-        
         if (ret > 0)
         {
-            out_left -= ret;
+            total_sent += ret;
         }
-        else if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE)
+        else if (ret == NSAPI_ERROR_WOULD_BLOCK)
         {
-            // Non-fatal: retry
-            wait_ms(10);
+            if (!wait_io(_timeout_ms))
+            {
+                // non-blocking: report what went out; blocking: deadline passed
+                if (total_sent > 0)
+                {
+                    break;
+                }
+                return NSAPI_ERROR_WOULD_BLOCK;
+            }
         }
         else
         {
-            // Real error
-            return ret;
+            return ret;  // Real error
         }
-    } while (out_left > 0);
+    }
     
-    return (nsapi_size_or_error_t)size;
+    return (nsapi_size_or_error_t)total_sent;
 }
 
 nsapi_size_or_error_t TLSSocket::recv(void *data, nsapi_size_t size)
@@ -480,22 +980,38 @@ nsapi_size_or_error_t TLSSocket::recv(void *data, nsapi_size_t size)
     {
         return NSAPI_ERROR_NO_SOCKET;
     }
-    
+
+    // a read means the request is complete: send what is still corked
+    if (_wbuf_len > 0)
+    {
+        flush();
+    }
+
     if (_ssl_ca_pem == NULL)
     {
         // No SSL
-        return _tcp_socket->recv(data, size);
+        return tcp_recv(data, size);
     }
 
-    // IoT Hub SDK style: decode received bytes with retry
-    int ret = mbedtls_ssl_read(&_ssl, (unsigned char*)data, size);
-    
-    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE)
+    // IoT Hub SDK style: decode received bytes, waiting for the socket up
+    // to the receive timeout
+    if (_recv_timeout_ms > 0)
     {
-        // No data available - return 0 (not error)
-        return 0;
+        begin_io();
     }
-    else if (ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY)
+
+    int ret;
+    while ((ret = mbedtls_ssl_read(&_ssl, (unsigned char*)data, size)) == MBEDTLS_ERR_SSL_WANT_READ ||
+           ret == MBEDTLS_ERR_SSL_WANT_WRITE)
+    {
+        if (_recv_timeout_ms == 0 || !wait_io(_recv_timeout_ms))
+        {
+            // No data available - 0 (not error) unless the caller runs an event loop
+            return _blocking ? 0 : NSAPI_ERROR_WOULD_BLOCK;
+        }
+    }
+
+    if (ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY)
     {
         // Graceful close
         return 0;
@@ -5,22 +5,83 @@
 #define __TLS_SOCKET_H__
 
 #include "mbed.h"
+#include "SPSCRingBuffer.h"
+#include "NetStats.h"
 
 #include "mbedtls/platform.h"
 #include "mbedtls/ssl.h"
-#include "mbedtls/entropy.h"
-#include "mbedtls/ctr_drbg.h"
 #include "mbedtls/error.h"
-#include "mbedtls/pk.h"
+#include "mbedtls/ecp.h"
 
-#if DEBUG_LEVEL > 0
-#include "mbedtls/debug.h"
-#endif
+class TLSClientContext;
 
 // IoT Hub SDK-style configuration
-#define TLSIO_RECV_BUFFER_SIZE 256
+// default receive ring size, rounded up to a power of two
+#ifndef TLSIO_RECV_BUFFER_SIZE
+#define TLSIO_RECV_BUFFER_SIZE 2048
+#endif
+// default deadline for a blocking handshake or send(), see set_timeout()
 #define HANDSHAKE_TIMEOUT_MS 5000
-#define HANDSHAKE_WAIT_INTERVAL_MS 10
+// default size of the cork() write buffer, i.e. the largest coalesced record
+#ifndef TLS_CORK_BUFFER_SIZE
+#define TLS_CORK_BUFFER_SIZE 1024
+#endif
+// corked bytes older than this go out with the next send()
+#ifndef TLS_CORK_TIMEOUT_MS
+#define TLS_CORK_TIMEOUT_MS 200
+#endif
+
+// servers remembered as refusing max_fragment_length
+#ifndef TLS_MFL_REFUSED_MAX
+#define TLS_MFL_REFUSED_MAX 4
+#endif
+
+// 1 to log every handshake's timing line by default, see set_handshake_log()
+#ifndef TLS_HANDSHAKE_LOG
+#define TLS_HANDSHAKE_LOG 0
+#endif
+
+/**
+ * Connection phases, in the order they happen.  The handshake ones group the
+ * mbed TLS client states; a resumed session skips certificate and key exchange.
+ */
+typedef enum
+{
+    TLS_PHASE_DNS = 0,          // resolve the host name
+    TLS_PHASE_TCP,              // TCP connect
+    TLS_PHASE_CLIENT_HELLO,     // build and send ClientHello
+    TLS_PHASE_SERVER_HELLO,     // wait for and parse ServerHello: round trip plus server time
+    TLS_PHASE_CERTIFICATE,      // receive, parse and verify the server's chain
+    TLS_PHASE_SERVER_KX,        // ServerKeyExchange signature, CertificateRequest, ServerHelloDone
+    TLS_PHASE_CLIENT_KX,        // client certificate, ECDHE/RSA key exchange, CertificateVerify
+    TLS_PHASE_FINISHED,         // ChangeCipherSpec and Finished both ways, session ticket
+    TLS_PHASE_COUNT
+} TLSConnectPhase;
+
+typedef struct
+{
+    uint32_t time_ms[TLS_PHASE_COUNT];          // wall time in the phase
+    uint32_t wait_ms[TLS_PHASE_COUNT];          // of which waiting for the socket
+    uint32_t bytes_sent[TLS_PHASE_COUNT];       // TLS bytes written to the socket
+    uint32_t bytes_received[TLS_PHASE_COUNT];   // TLS bytes consumed from the socket
+    uint32_t total_ms;                          // whole connect(), 0 until it succeeds
+    bool resumed;                               // abbreviated handshake
+} TLSHandshakeTiming;
+
+// ECDHE only, ECDSA before RSA, AES-128-GCM before CBC and AES-256; ends in 0
+extern const int TLS_CIPHERSUITES_ECDHE[];
+// P-256 (fast reduction with MBEDTLS_ECP_NIST_OPTIM), then P-384; ends in MBEDTLS_ECP_DP_NONE
+extern const mbedtls_ecp_group_id TLS_CURVES_NIST[];
+
+/**
+ * Per-connection memory trade-off, see TLSSocket::set_memory_profile().
+ */
+typedef enum
+{
+    TLS_MEMORY_SMALL = 0,       // offer 1 KB max_fragment_length, 1 KB receive ring and write buffer
+    TLS_MEMORY_DEFAULT,         // no max_fragment_length, TLSIO_RECV_BUFFER_SIZE / TLS_CORK_BUFFER_SIZE
+    TLS_MEMORY_LARGE            // no max_fragment_length, 8 KB receive ring, 4 KB write buffer (bulk downloads)
+} TLSMemoryProfile;
 
 class TLSSocket
 {
@@ -41,6 +102,22 @@ public:
      */
     TLSSocket(const char *ssl_ca_pem, const char *ssl_client_cert, 
               const char *ssl_client_key, NetworkInterface* net_iface);
+
+    /**
+     * @brief Construct TLSSocket from credentials with explicit lengths
+     *
+     * Each buffer is PEM if it holds a "-----BEGIN" line (a trailing '\0' is
+     * optional) and DER if it starts with 0x30 (see TLSCertStore.h).
+     * The buffers must stay valid for the life of the socket.
+     * @param ca                CA certificate(s)
+     * @param client_cert       Client certificate, or NULL for one-way authentication
+     * @param client_key        Client private key, or NULL
+     * @param net_iface         Network interface to use
+     */
+    TLSSocket(const unsigned char *ca, size_t ca_len,
+              const unsigned char *client_cert, size_t client_cert_len,
+              const unsigned char *client_key, size_t client_key_len,
+              NetworkInterface* net_iface);
     
     virtual ~TLSSocket();
 
@@ -54,27 +131,223 @@ public:
      * @return true if client certificate is set
      */
     bool isMutualTLS() const { return _ssl_client_cert != NULL; }
-    
-    // IoT Hub SDK-style: internal receive buffer for ssl_recv callback
-    unsigned char *_recv_buffer;
-    size_t _recv_buffer_count;
-    bool _handshake_complete;
-    TCPSocket *_tcp_socket;
+
+    /**
+     * @brief Choose blocking or non-blocking connect() and send()
+     *
+     * Blocking (the default) waits for socket events up to the timeout.
+     * Non-blocking never waits: connect() returns NSAPI_ERROR_IN_PROGRESS
+     * until the handshake is done (call it again with the same host and
+     * port), send() returns the bytes taken or NSAPI_ERROR_WOULD_BLOCK (retry
+     * with the same data), and recv() returns NSAPI_ERROR_WOULD_BLOCK rather
+     * than 0 when nothing is pending.  sigio() tells when to try again.
+     */
+    void set_blocking(bool blocking);
+
+    /**
+     * @brief Deadline for the handshake and for a blocking send()
+     * @param timeout_ms  milliseconds; the handshake deadline also holds across non-blocking connect() calls
+     */
+    void set_timeout(int timeout_ms);
+
+    /**
+     * @brief How long a blocking recv() waits for data
+     * @param timeout_ms  milliseconds; 0 (the default) returns 0 at once when nothing is pending
+     */
+    void set_recv_timeout(int timeout_ms);
+
+    /**
+     * @brief Register a callback for socket activity (readable, writable or closed)
+     *
+     * Called from the network stack's thread; keep it short, e.g. set a flag
+     * or release a semaphore.
+     */
+    void sigio(mbed::Callback<void()> func);
+
+    /**
+     * @brief Gather the following send() calls into as few TLS records as possible
+     *
+     * Bytes are kept in a write buffer and go out as one record on uncork(),
+     * flush() or recv(), when the buffer is full, or with the first send()
+     * after TLS_CORK_TIMEOUT_MS.  A send() larger than the buffer bypasses it
+     * once what was gathered before it has gone out.
+     */
+    void cork();
+
+    /**
+     * @brief Stop gathering and send what was gathered
+     * @return NSAPI_ERROR_OK, NSAPI_ERROR_WOULD_BLOCK if some bytes are still
+     *         buffered (retry with flush()), or a socket error
+     */
+    nsapi_error_t uncork();
+
+    /** @brief Send what cork() has gathered so far; same results as uncork() */
+    nsapi_error_t flush();
+
+    /**
+     * @brief Set the size of the cork() write buffer
+     * @param size  bytes, at most MBEDTLS_SSL_OUT_CONTENT_LEN (one record); takes effect once the buffer is empty
+     */
+    void set_cork_buffer_size(size_t size);
+
+    /**
+     * @brief Choose the buffer sizes and max_fragment_length for the next connect()
+     *
+     * TLS_MEMORY_SMALL offers the server a 1 KB max_fragment_length (RFC 6066).
+     * A server that answers it with an alert is remembered and reconnected to
+     * without the extension; one that ignores it keeps sending full records,
+     * which are still received.  Sets the receive ring and write buffer sizes,
+     * so call set_recv_buffer_size() / set_cork_buffer_size() after it to
+     * override them.
+     */
+    void set_memory_profile(TLSMemoryProfile profile);
+
+    /**
+     * @brief Cipher suites to offer, most preferred first, from the next connect()
+     *
+     * A shorter list makes a smaller ClientHello and keeps the server off
+     * suites that are slow on the device.  Suites the library was built
+     * without are skipped; the list is copied at connect().
+     * @param ciphersuites  MBEDTLS_TLS_* ids ending in 0 (e.g. TLS_CIPHERSUITES_ECDHE),
+     *                      or NULL for the library default
+     */
+    void set_ciphersuites(const int *ciphersuites);
+
+    /**
+     * @brief Elliptic curves to offer for ECDHE, most preferred first, from the next connect()
+     * @param curves  ids ending in MBEDTLS_ECP_DP_NONE (e.g. TLS_CURVES_NIST), or NULL for the default
+     */
+    void set_curves(const mbedtls_ecp_group_id *curves);
+    TLSMemoryProfile memory_profile() const { return _profile; }
+
+    /**
+     * @brief Heap held by this connection at its highest
+     *
+     * The record buffers, receive ring and write buffer the socket holds,
+     * plus the highest transient handshake allocation, sampled from the heap
+     * statistics between handshake steps.  The configuration shared with
+     * other sockets is not counted; allocations by other threads during the
+     * handshake are.
+     * @return bytes, 0 before connect()
+     */
+    size_t heap_peak() const;
+
+    /**
+     * @brief Largest record payload this connection sends
+     * @return bytes, 0 if no max_fragment_length was offered
+     */
+    size_t max_fragment_length() const;
+
+    /**
+     * @brief Where the last connect() spent its time, phase by phase
+     *
+     * Filled in as the connection proceeds; a failed connect() leaves the
+     * phases it went through.  In non-blocking mode the time between
+     * connect() calls counts towards the phase that was waiting.
+     */
+    const TLSHandshakeTiming &handshake_timing() const { return _timing; }
+
+    /**
+     * @brief Log one line per completed handshake with its phase timings
+     * @param enable  applies to every socket; TLS_HANDSHAKE_LOG sets the default
+     */
+    static void set_handshake_log(bool enable);
+
+    /**
+     * @brief Socket calls, waits and connects of this socket
+     *
+     * Kept for the life of the object, across connects; also added to the
+     * system-wide totals (see NetStats.h), as NET_STATS_TLS or, without a
+     * CA certificate, NET_STATS_TCP.
+     */
+    const net_stats_t &net_stats() const { return _net_stats; }
+
+    /**
+     * @brief Set the size of the receive ring the TCP socket is read into
+     * @param size  bytes, rounded up to a power of two; used from the next connect()
+     */
+    void set_recv_buffer_size(size_t size);
 
 private:
+    // the mbed TLS BIO callbacks, see TLSSocket.cpp
+    friend int ssl_send(void *ctx, const unsigned char *buf, size_t len);
+    friend int ssl_recv(void *ctx, unsigned char *buf, size_t len);
+
+    // for the BIO callbacks: count handshake bytes against the current phase
+    void count_handshake_io(size_t sent, size_t received);
+
+    // for the BIO callbacks: TCP socket calls, counted in net_stats()
+    int tcp_send(const void *data, size_t size);
+    int tcp_recv(void *data, size_t size);
+
+    /**
+     * @brief Read as much as the TCP socket has into the receive ring
+     * @return bytes added, 0 if nothing was pending, or a negative socket error
+     */
+    int fill_recv_buffer();
+
     void init_common(NetworkInterface* net_iface);
+    nsapi_error_t handshake(const char *host, uint16_t port);
+    void on_sigio();
+    void begin_io();
+    bool wait_io(int timeout_ms);
+    nsapi_size_or_error_t write_through(const unsigned char *data, size_t size);
+    nsapi_error_t reconnect(const char *host, uint16_t port);
+    nsapi_error_t tcp_connect(const char *host, uint16_t port);
+    void enter_phase(TLSConnectPhase phase);
+    void log_handshake(const char *host, uint16_t port);
+    void sample_heap();
+    uint8_t net_kind() const { return _ssl_ca_pem != NULL ? NET_STATS_TLS : NET_STATS_TCP; }
+
+    Semaphore _io_event;                // released by sigio
+    mbed::Callback<void()> _sigio;
+    bool _blocking;
+    bool _handshake_pending;            // non-blocking connect() in progress
+    bool _resume_offered;
+    int _timeout_ms;
+    int _recv_timeout_ms;
+    uint64_t _op_start;                 // start of the current handshake or send()
+
+    unsigned char *_wbuf;               // cork() write buffer, allocated on first use
+    size_t _wbuf_size;
+    size_t _wbuf_len;
+    bool _corked;
+    uint64_t _cork_start;               // when the oldest buffered byte was written
+
+    NetworkInterface *_net_iface;
+    TLSMemoryProfile _profile;
+    unsigned char _mfl_code;            // offered on the current connection
+    const int *_ciphersuites;
+    const mbedtls_ecp_group_id *_curves;
+    bool _ctx_stale;                    // suites or curves changed since _ctx was acquired
+    uint32_t _heap_setup;               // mbedtls_ssl_setup(): record buffers
+    uint32_t _heap_base;                // heap in use when the handshake started
+    uint32_t _heap_high;                // heap peak statistic last seen
+    uint32_t _heap_peak;                // highest handshake allocation above _heap_base
+
+    TLSHandshakeTiming _timing;
+    TLSConnectPhase _phase;
+    uint64_t _connect_start;
+    uint64_t _phase_start;
+    net_stats_t _net_stats;
     
-    mbedtls_entropy_context _entropy;
-    mbedtls_ctr_drbg_context _ctr_drbg;
-    mbedtls_x509_crt _cacert;
-    mbedtls_x509_crt _clientcert;     // Client certificate for mutual TLS
-    mbedtls_pk_context _clientkey;     // Client private key for mutual TLS
+    TLSClientContext *_ctx;            // shared config, DRBG and certificates
     mbedtls_ssl_context _ssl;
-    mbedtls_ssl_config _ssl_conf;
     
     const char *_ssl_ca_pem;
     const char *_ssl_client_cert;
     const char *_ssl_client_key;
+    size_t _ssl_ca_len;                 // 0 for a PEM string
+    size_t _ssl_client_cert_len;
+    size_t _ssl_client_key_len;
+
+    // IoT Hub SDK-style: receive ring for the ssl_recv callback, allocated
+    // once per connection
+    SPSCRingBuffer<unsigned char> *_recv_ring;
+    unsigned char *_recv_storage;
+    size_t _recv_buffer_size;
+    bool _handshake_complete;
+    TCPSocket *_tcp_socket;
 };
 
 
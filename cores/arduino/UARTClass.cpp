@@ -23,12 +23,14 @@
 UARTClass::UARTClass()
 {
   serial = NULL;
+  lineDelimiter = '\n';
 }
 
 UARTClass::UARTClass(UARTName p)
 {
   serial = NULL;
   port = p;
+  lineDelimiter = '\n';
 }
 
 UARTClass::~UARTClass()
@@ -60,6 +62,12 @@ size_t UARTClass::write(const uint8_t *buffer, size_t size)
   return serial->write(buffer, size);
 }
 
+size_t UARTClass::vprintf(const char *format, va_list arg)
+{
+  init();
+  return serial->vprintf(format, arg);
+}
+
 int UARTClass::available( void )
 {
   init();
@@ -85,12 +93,73 @@ int UARTClass::peek( void )
   return serial->peek();
 }
 
+int UARTClass::peekBuffered(const uint8_t **data)
+{
+  init();
+  return serial->peek_buffered(data);
+}
+
+void UARTClass::consumeBuffered(size_t length)
+{
+  init();
+  serial->consume(length);
+}
+
+size_t UARTClass::readAvailable(char *buffer, size_t length)
+{
+  init();
+  return serial->get((uint8_t *)buffer, length);
+}
+
+size_t UARTClass::readLine(char *buffer, size_t length)
+{
+  init();
+  return serial->getline((uint8_t *)buffer, length);
+}
+
+void UARTClass::setLineDelimiter(char c)
+{
+  init();
+  lineDelimiter = c;
+  serial->set_delimiter(c);
+}
+
+uint32_t UARTClass::rxOverruns(void)
+{
+  init();
+  return serial->rx_overruns();
+}
+
+uint32_t UARTClass::rxFramingErrors(void)
+{
+  init();
+  return serial->rx_framing_errors();
+}
+
+int UARTClass::bufferedUntil(char terminator)
+{
+  init();
+  if (lineDelimiter != terminator)
+  {
+    // the index only tracks the line delimiter, which readLine() users such
+    // as the console rely on, so don't re-key it for another terminator
+    return -1;
+  }
+  return serial->line_length();
+}
+
 void UARTClass::flush( void )
 {
   init();
   return serial->flush();
 }
 
+void UARTClass::drain(void)
+{
+  init();
+  serial->drain();
+}
+
 void UARTClass::init(void)
 {
   if(serial == NULL)
@@ -20,6 +20,7 @@
 #define _UART_CLASS_
 
 #include "mbed.h"
+#include <stdarg.h>
 #include "HardwareSerial.h"
 #include "BufferedSerial.h"
 
@@ -41,17 +42,38 @@ class UARTClass : public HardwareSerial
     int peek(void);
     void flush(void);
 
+    // wait until buffered output has been handed to the UART
+    void drain(void);
+
     size_t write(const unsigned char c);
     size_t write(const unsigned char *buffer, size_t size);
     
     using Print::write; // pull in write(str) and write(buf, size) from Print
 
+    // bulk reads served straight from the rx ring
+    int peekBuffered(const uint8_t **data);
+    void consumeBuffered(size_t length);
+    size_t readAvailable(char *buffer, size_t length);
+
+    // complete lines located through the rx delimiter index
+    size_t readLine(char *buffer, size_t length);
+    void setLineDelimiter(char c);
+
+    uint32_t rxOverruns(void);
+    uint32_t rxFramingErrors(void);
+
+    // formatted into the tx ring (or a small stack chunk when longer than
+    // the ring), never a heap buffer
+    size_t vprintf(const char *format, va_list arg);
+
     operator bool() { return true; }; // UART always active
 
   protected:
+    int bufferedUntil(char terminator);
     void init(void);
     BufferedSerial *serial;
     UARTName port;
+    char lineDelimiter;
 };
 
 #endif // _UART_CLASS_
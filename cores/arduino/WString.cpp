@@ -130,9 +130,7 @@ String::String(double value, unsigned char decimalPlaces) {
 }
 
 String::~String() {
-    if(buffer) {
-        free(buffer);
-    }
+    release();
     init();
 }
 
@@ -144,11 +142,16 @@ inline void String::init(void) {
     buffer = NULL;
     capacity = 0;
     len = 0;
+    storage = STORAGE_HEAP;
 }
 
-void String::invalidate(void) {
-    if(buffer)
+void String::release(void) {
+    if(buffer && storage == STORAGE_HEAP)
         free(buffer);
+}
+
+void String::invalidate(void) {
+    release();
     init();
 }
 
@@ -163,21 +166,65 @@ unsigned char String::reserve(unsigned int size) {
     return 0;
 }
 
+unsigned char String::setBuffer(char *buf, unsigned int bufsize) {
+    if(!buf || bufsize == 0 || len >= bufsize)
+        return 0;
+    if(buffer)
+        memcpy(buf, buffer, len);
+    buf[len] = 0;
+    release();
+    buffer = buf;
+    capacity = bufsize - 1;
+    storage = STORAGE_EXTERNAL;
+    return 1;
+}
+
 unsigned char String::changeBuffer(unsigned int maxStrLen) {
-    size_t newSize = (maxStrLen + 16) & (~0xf);
-    char *newbuffer = (char *) realloc(buffer, newSize);
-    if(newbuffer) {
-        size_t oldSize = capacity + 1; // include NULL.
-        if (newSize > oldSize)
-        {
-            memset(newbuffer + oldSize, 0, newSize - oldSize);
-        }
-        capacity = newSize - 1;
-        buffer = newbuffer;
+    if(!buffer && maxStrLen < sizeof(sso)) {
+        buffer = sso;
+        capacity = sizeof(sso) - 1;
+        storage = STORAGE_INLINE;
         return 1;
     }
+    size_t newSize = (maxStrLen + 16) & (~0xf);
+    size_t oldSize; // bytes of the old buffer carried over, include NULL.
+    char *newbuffer;
+    if(storage == STORAGE_HEAP) {
+        newbuffer = (char *) realloc(buffer, newSize);
+        oldSize = buffer ? capacity + 1 : 0;
+    } else {
+        // inline or caller-owned storage outgrown: move to the heap
+        newbuffer = (char *) malloc(newSize);
+        oldSize = len + 1;
+        if(newbuffer)
+            memcpy(newbuffer, buffer, oldSize);
+    }
+    if(!newbuffer)
+        return 0;
+    if (newSize > oldSize)
+    {
+        memset(newbuffer + oldSize, 0, newSize - oldSize);
+    }
+    capacity = newSize - 1;
     buffer = newbuffer;
-    return 0;
+    storage = STORAGE_HEAP;
+    return 1;
+}
+
+// like reserve(), but for appends: a buffer that has to grow at least doubles
+// (up to STRING_GROWTH_LIMIT bytes per step) so that building a string piece
+// by piece costs O(n) copies and leaves few holes in the heap
+unsigned char String::grow(unsigned int maxStrLen) {
+    if(buffer && capacity >= maxStrLen)
+        return 1;
+    if(buffer) {
+        unsigned int step = capacity + 1;
+        if(step > STRING_GROWTH_LIMIT)
+            step = STRING_GROWTH_LIMIT;
+        if(maxStrLen < capacity + step && reserve(capacity + step))
+            return 1;
+    }
+    return reserve(maxStrLen);
 }
 
 // /*********************************************/
@@ -190,7 +237,8 @@ String & String::copy(const char *cstr, unsigned int length) {
         return *this;
     }
     len = length;
-    strcpy(buffer, cstr);
+    memmove(buffer, cstr, length);
+    buffer[length] = 0;
     return *this;
 }
 
@@ -206,22 +254,24 @@ String & String::copy(const __FlashStringHelper *pstr, unsigned int length) {
 
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
 void String::move(String &rhs) {
-    if(buffer) {
-        if(capacity >= rhs.len) {
-            strcpy(buffer, rhs.buffer);
-            len = rhs.len;
+    if(rhs.storage != STORAGE_HEAP || !rhs.buffer || (buffer && capacity >= rhs.len)) {
+        // inline and caller-owned storage cannot change hands, and there is
+        // no point giving up a buffer that is already big enough
+        if(rhs.buffer) {
+            copy(rhs.buffer, rhs.len);
             rhs.len = 0;
-            return;
+            rhs.buffer[0] = 0;
         } else {
-            free(buffer);
+            invalidate();
         }
+        return;
     }
+    release();
     buffer = rhs.buffer;
     capacity = rhs.capacity;
     len = rhs.len;
-    rhs.buffer = NULL;
-    rhs.capacity = 0;
-    rhs.len = 0;
+    storage = STORAGE_HEAP;
+    rhs.init();
 }
 #endif
 
@@ -282,9 +332,17 @@ unsigned char String::concat(const char *cstr, unsigned int length) {
         return 0;
     if(length == 0)
         return 1;
-    if(!reserve(newlen))
+    // s += s: the source moves with the buffer if it has to grow
+    if(buffer && cstr >= buffer && cstr <= buffer + len) {
+        unsigned int offset = cstr - buffer;
+        if(!grow(newlen))
+            return 0;
+        cstr = buffer + offset;
+    } else if(!grow(newlen)) {
         return 0;
-    strcpy(buffer + len, cstr);
+    }
+    memcpy(buffer + len, cstr, length);
+    buffer[newlen] = 0;
     len = newlen;
     return 1;
 }
@@ -349,7 +407,7 @@ unsigned char String::concat(const __FlashStringHelper * str) {
     int length = strlen_P((PGM_P)str);
     if (length == 0) return 1;
     unsigned int newlen = len + length;
-    if (!reserve(newlen)) return 0;
+    if (!grow(newlen)) return 0;
     strcpy_P(buffer + len, (PGM_P)str);
     len = newlen;
     return 1;
@@ -683,7 +741,7 @@ void String::replace(const String& find, const String& replace) {
         }
         if(size == len)
             return;
-        if(size > capacity && !changeBuffer(size))
+        if(!grow(size))
             return; // XXX: tell user!
         int index = len - 1;
         while(index >= 0 && (index = lastIndexOf(find, index)) >= 0) {
@@ -38,6 +38,18 @@ class __FlashStringHelper;
 #define FPSTR(pstr_pointer) (reinterpret_cast<const __FlashStringHelper *>(pstr_pointer))
 #define F(string_literal) (FPSTR(PSTR(string_literal)))
 
+// strings shorter than STRING_SSO_SIZE are kept inside the String object
+// itself and never touch the heap
+#ifndef STRING_SSO_SIZE
+#define STRING_SSO_SIZE 16
+#endif
+
+// when concatenation outgrows a heap buffer its capacity is doubled, but by
+// no more than STRING_GROWTH_LIMIT bytes at a time
+#ifndef STRING_GROWTH_LIMIT
+#define STRING_GROWTH_LIMIT 1024
+#endif
+
 // The string class
 class String {
         // use a function pointer to allow for "if (s)" without the
@@ -75,6 +87,13 @@ class String {
         // is left unchanged).  reserve(0), if successful, will validate an
         // invalid string (i.e., "if (s)" will be true afterwards)
         unsigned char reserve(unsigned int size);
+        // use caller-owned storage of bufsize bytes (including the '\0') for
+        // this string, e.g. a stack array in a loop that builds telemetry.
+        // the current value is copied in; returns false, leaving the string
+        // unchanged, if it does not fit.  the storage must outlive the String
+        // or the next assignment that no longer fits, at which point the
+        // string moves to the heap.  it is never freed by String.
+        unsigned char setBuffer(char *buf, unsigned int bufsize);
         inline unsigned int length(void) const {
             if(buffer) {
                 return len;
@@ -101,6 +120,7 @@ class String {
         // concatenation is considered unsuccessful.
         unsigned char concat(const String &str);
         unsigned char concat(const char *cstr);
+        unsigned char concat(const char *cstr, unsigned int length);    // may contain NUL bytes
         unsigned char concat(char c);
         unsigned char concat(unsigned char c);
         unsigned char concat(int num);
@@ -242,14 +262,24 @@ class String {
         float toFloat(void) const;
 
     protected:
+        // where buffer points to
+        enum {
+            STORAGE_HEAP,       // malloc'ed and owned (or NULL when invalid)
+            STORAGE_INLINE,     // sso[] below
+            STORAGE_EXTERNAL    // caller-owned, see setBuffer()
+        };
+
         char *buffer;	        // the actual char array
         unsigned int capacity;  // the array length minus one (for the '\0')
         unsigned int len;       // the String length (not counting the '\0')
+        unsigned char storage;  // one of STORAGE_*
+        char sso[STRING_SSO_SIZE];
     protected:
         void init(void);
         void invalidate(void);
+        void release(void);
         unsigned char changeBuffer(unsigned int maxStrLen);
-        unsigned char concat(const char *cstr, unsigned int length);
+        unsigned char grow(unsigned int maxStrLen);
 
         // copy and move
         String & copy(const char *cstr, unsigned int length);
@@ -7,8 +7,11 @@
 #include "EEPROMInterface.h"
 #include "SystemWiFi.h"
 #include "SystemVersion.h"
+#include "SystemFunc.h"
 #include "UARTClass.h"
 #include "console_cli.h"
+#include "MemoryProfiler.h"
+#include "NetStats.h"
 #include "config/DeviceConfig.h"
 #include "config/DeviceConfigCLI.h"
 
@@ -44,6 +47,8 @@ static void reboot_and_exit_command(int argc, char **argv);
 static void wifi_scan(int argc, char **argv);
 static void enable_secure_command(int argc, char **argv);
 static void status_command(int argc, char **argv);
+static void mem_command(int argc, char **argv);
+static void net_command(int argc, char **argv);
 
 static const struct console_command cmds[] = {
   {"help",          "Help document",                                             help_command},
@@ -51,6 +56,8 @@ static const struct console_command cmds[] = {
   {"exit",          "Exit and reboot",                                           reboot_and_exit_command},
   {"scan",          "Scan Wi-Fi AP",                                             wifi_scan},
   {"status",        "Show configuration status",                                 status_command},
+  {"mem",           "Heap, fragmentation and stack usage (mem json | mem reset)", mem_command},
+  {"net",           "Network counters per socket type (net json | net hex | net reset)", net_command},
   {"enable_secure", "Enable secure channel between AZ3166 and secure chip",      enable_secure_command},
 };
 
@@ -122,7 +129,7 @@ static void wifi_scan(int argc, char **argv)
 static void reboot_and_exit_command(int argc, char **argv)
 {
     Serial.printf("Reboot\r\n");
-    mico_system_reboot();
+    SystemReboot();
 }
 
 static void status_command(int argc, char **argv)
@@ -130,6 +137,41 @@ static void status_command(int argc, char **argv)
     config_show_status();
 }
 
+static void mem_command(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0)
+    {
+        mem_profile_reset_peaks();
+        Serial.printf("Peaks reset.\r\n");
+        return;
+    }
+    mem_profile_print(Serial, argc > 1 && strcmp(argv[1], "json") == 0);
+}
+
+static void net_command(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0)
+    {
+        net_stats_reset();
+        Serial.printf("Counters reset.\r\n");
+        return;
+    }
+    if (argc > 1 && strcmp(argv[1], "hex") == 0)
+    {
+        // the binary snapshot, as telemetry would carry it; its second byte is
+        // NET_STATS_SNAPSHOT_VERSION, which changes with the counter layout
+        uint8_t snapshot[NET_STATS_SNAPSHOT_MAX];
+        size_t length = net_stats_snapshot(snapshot, sizeof(snapshot));
+        for (size_t i = 0; i < length; i++)
+        {
+            Serial.printf("%02x", snapshot[i]);
+        }
+        Serial.printf("\r\n");
+        return;
+    }
+    net_stats_print(Serial, argc > 1 && strcmp(argv[1], "json") == 0);
+}
+
 static void enable_secure_command(int argc, char **argv)
 {
     int ret = -2;
@@ -196,6 +238,11 @@ static void enable_secure_command(int argc, char **argv)
 // Console app
 static bool get_input(char *inbuf, unsigned int *bp)
 {
+    // bytes taken from the UART but not yet consumed, kept across calls
+    static char chunk[64];
+    static int chunk_len = 0;
+    static int chunk_pos = 0;
+
     if (inbuf == NULL) 
     {
         return false;
@@ -203,50 +250,80 @@ static bool get_input(char *inbuf, unsigned int *bp)
     
     while (true) 
     {
-        if (!Serial.available())
+        if (chunk_pos == chunk_len)
         {
-            continue;
-        }
-        inbuf[*bp] = (char)Serial.read();
-        
-        if (inbuf[*bp] == END_CHAR) 
-        {
-            /* end of input line */
-            inbuf[*bp] = NULL_CHAR;
-            *bp = 0;
-            return true;
-        }
-        else if (inbuf[*bp] == TAB_CHAR) 
-        {
-            inbuf[*bp] = SPACE_CHAR;
-        }
-        else if (inbuf[*bp] == BACKSPACE_CHAR || inbuf[*bp] == DEL_CHAR)
-        {
-            // Delete
-            if (*bp > 0) 
+            // a complete line comes out of the rx line index in one copy; a
+            // partial one (typing, or a paste longer than the rx buffer) is
+            // drained as it arrives
+            chunk_pos = 0;
+            chunk_len = Serial.readLine(chunk, sizeof(chunk));
+            if (chunk_len == 0)
             {
-                (*bp)--;
-                Serial.write(BACKSPACE_CHAR);
-                Serial.write(SPACE_CHAR);
-                Serial.write(BACKSPACE_CHAR);
+                chunk_len = Serial.readAvailable(chunk, sizeof(chunk));
+            }
+            if (chunk_len == 0)
+            {
+                continue;
             }
-            continue;
         }
-        else if (inbuf[*bp] < SPACE_CHAR)
+
+        // printable characters are echoed in runs rather than one by one
+        unsigned int echo_from = *bp;
+        bool done = false;
+
+        while (chunk_pos < chunk_len)
         {
-            continue;
+            inbuf[*bp] = chunk[chunk_pos++];
+
+            if (inbuf[*bp] == END_CHAR) 
+            {
+                /* end of input line */
+                inbuf[*bp] = NULL_CHAR;
+                done = true;
+                break;
+            }
+            else if (inbuf[*bp] == TAB_CHAR) 
+            {
+                inbuf[*bp] = SPACE_CHAR;
+            }
+            else if (inbuf[*bp] == BACKSPACE_CHAR || inbuf[*bp] == DEL_CHAR)
+            {
+                Serial.write((const uint8_t *)&inbuf[echo_from], *bp - echo_from);
+                // Delete
+                if (*bp > 0) 
+                {
+                    (*bp)--;
+                    Serial.write(BACKSPACE_CHAR);
+                    Serial.write(SPACE_CHAR);
+                    Serial.write(BACKSPACE_CHAR);
+                }
+                echo_from = *bp;
+                continue;
+            }
+            else if (inbuf[*bp] < SPACE_CHAR)
+            {
+                continue;
+            }
+
+            (*bp)++;
+            
+            if (*bp >= INBUF_SIZE) 
+            {
+                Serial.write((const uint8_t *)&inbuf[echo_from], *bp - echo_from);
+                Serial.printf("\r\nError: input buffer overflow\r\n");
+                Serial.printf(PROMPT);
+                *bp = 0;
+                return false;
+            }
         }
 
         // Echo
-        Serial.write(inbuf[*bp]);
-        (*bp)++;
-        
-        if (*bp >= INBUF_SIZE) 
+        Serial.write((const uint8_t *)&inbuf[echo_from], *bp - echo_from);
+
+        if (done)
         {
-            Serial.printf("\r\nError: input buffer overflow\r\n");
-            Serial.printf(PROMPT);
             *bp = 0;
-            break;
+            return true;
         }
     }
     
@@ -374,6 +451,9 @@ void cli_main(void)
     static char inbuf[INBUF_SIZE];
     unsigned int bp = 0;
     
+    // the rx line index tracks the same terminator get_input() looks for
+    Serial.setLineDelimiter(END_CHAR);
+
     print_help();
     Serial.print(PROMPT);
     
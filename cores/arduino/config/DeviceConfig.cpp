@@ -15,6 +15,7 @@
 #include "DeviceConfigFile.h"
 #include "SettingUI.h"
 #include "EEPROMInterface.h"
+#include "TLSCertStore.h"
 #include <string.h>
 
 // Check for user-provided custom profile definition
@@ -369,6 +370,26 @@ int DeviceConfig_Save(SettingID setting, const char* value)
         written += toWrite;
         remaining -= toWrite;
     }
+
+    // DER decoded from the previous value is stale; re-imported on next use
+    switch (setting)
+    {
+        case SETTING_CA_CERT:
+            TLSCertStore_Erase(TLS_CERT_STORE_CA);
+            break;
+        case SETTING_CLIENT_CERT:
+            TLSCertStore_Erase(TLS_CERT_STORE_CLIENT_CERT);
+            break;
+        case SETTING_CLIENT_KEY:
+            TLSCertStore_Erase(TLS_CERT_STORE_CLIENT_KEY);
+            break;
+        case SETTING_DEVICE_CERT:
+            TLSCertStore_Erase(TLS_CERT_STORE_CLIENT_CERT);
+            TLSCertStore_Erase(TLS_CERT_STORE_CLIENT_KEY);
+            break;
+        default:
+            break;
+    }
     
     return 0;
 }
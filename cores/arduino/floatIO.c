@@ -1,6 +1,7 @@
 // Copyright (c) 2015 Volodymyr Shymanskyy. All rights reserved.
 // Licensed under the MIT license.
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
@@ -26,56 +27,136 @@ char *f2s(float f, int p){
     return dtostrf(f, 0, p, pBuff);       // call the library function
 }
 
-/*
- * As there is a problem of sprintf %f in Arduino,
-   follow https://github.com/blynkkk/blynk-library/issues/14 to implement dtostrf
+/* fixed-point formatting
+ * number is split into an integer mantissa and a power of two, which turns
+ * the decimal expansion into integer arithmetic: the integer part is at most
+ * 32 bits ("ovf" above that, as before) and the fraction is kept as a 124-bit
+ * binary fraction in two 64-bit words (frac_hi holds the top FRAC_BITS bits)
+ * that is multiplied out one digit at a time; values with no bits below 2^-60,
+ * which includes every float >= 2^-37, never touch the low word.  The result
+ * is the exact value rounded to prec decimals, ties to even, i.e. the same
+ * text as printf("%.*f"), for every float and every double >= 2^-71.
+ * No libc printf or soft-float arithmetic is involved past the first split.
  */
-char * dtostrf(double number, signed char width, unsigned char prec, char *s) {
+#define FRAC_BITS 60
+#define FRAC_MASK ((1ULL << FRAC_BITS) - 1)
+
+int dtoa_fixed(double number, unsigned char prec, char *s) {
+    char *out = s;
+    uint64_t bits;
+    uint64_t mant;
+    int exp;
+
     if(isnan(number)) {
         strcpy(s, "nan");
-        return s;
+        return 3;
     }
     if(isinf(number)) {
         strcpy(s, "inf");
-        return s;
+        return 3;
     }
-
     if(number > 4294967040.0 || number < -4294967040.0) {
         strcpy(s, "ovf");
-        return s;
+        return 3;
     }
-    char* out = s;
-    // Handle negative numbers
+
+    memcpy(&bits, &number, sizeof(bits));
     if(number < 0.0) {
-        *out = '-';
-        ++out;
-        number = -number;
+        *out++ = '-';
+    }
+    exp = (int)((bits >> 52) & 0x7ff);
+    mant = bits & ((1ULL << 52) - 1);
+    if(exp == 0) {
+        exp = 1;                          // subnormal
+    } else {
+        mant |= 1ULL << 52;
     }
-    // Round correctly so that print(1.999, 2) prints as "2.00"
-    double rounding = 0.5;
-    for(unsigned char i = 0; i < prec; ++i) {
-      rounding /= 10.0;
+    exp -= 1075;                          // number = mant * 2^exp
+
+    // integer part, and the fraction as frac_hi:frac_lo / 2^(FRAC_BITS + 64)
+    uint32_t int_part = 0;
+    uint64_t frac_hi = 0;
+    uint64_t frac_lo = 0;
+    int shift = -exp;
+    if(exp >= 0) {
+        int_part = (uint32_t)(mant << exp);
+    } else if(shift <= FRAC_BITS) {
+        int_part = (uint32_t)(mant >> shift);
+        frac_hi = (mant << (FRAC_BITS - shift)) & FRAC_MASK;
+    } else if(shift < FRAC_BITS + 64) {
+        shift = FRAC_BITS + 64 - shift;   // mant << shift, 0 < shift < 64
+        frac_hi = mant >> (64 - shift);
+        frac_lo = mant << shift;
+    } else {
+        // below 2^-124: keep a sticky bit so ties still round the right way
+        shift -= FRAC_BITS + 64;
+        frac_lo = (shift < 64) ? mant >> shift : 0;
+        if(shift >= 64 || (mant & ((1ULL << shift) - 1))) {
+            frac_lo |= mant != 0;
+        }
     }
-    number += rounding;
 
-    // Extract the integer part of the number and print it
-    unsigned long int_part = (unsigned long) number;
-    double remainder = number - (double) int_part;
-    out += sprintf(out, "%lu", int_part);
+    // integer digits
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = '0' + int_part % 10;
+        int_part /= 10;
+    } while(int_part);
+    char *int_start = out;
+    while(n > 0) {
+        *out++ = digits[--n];
+    }
 
-    // Print the decimal point, but only if there are digits beyond
+    // fraction digits; frac_hi < 2^60 so frac_hi * 10 never overflows
     if(prec > 0) {
-        *out = '.';
-        ++out;
+        *out++ = '.';
+        for(unsigned char i = 0; i < prec; ++i) {
+            if(frac_lo) {
+                uint64_t lo = (frac_lo & 0xffffffff) * 10;
+                uint64_t hi = (frac_lo >> 32) * 10 + (lo >> 32);
+                frac_lo = (hi << 32) | (lo & 0xffffffff);
+                frac_hi = frac_hi * 10 + (hi >> 32);
+            } else {
+                frac_hi *= 10;
+            }
+            *out++ = '0' + (char)(frac_hi >> FRAC_BITS);
+            frac_hi &= FRAC_MASK;
+        }
     }
+    *out = 0;
 
-    while(prec-- > 0) {
-        remainder *= 10.0;
-        if((int)remainder == 0){
-                *out = '0';
-                 ++out;
+    // round what is left: above half, or exactly half with an odd last digit
+    const uint64_t half = 1ULL << (FRAC_BITS - 1);
+    if(frac_hi > half || (frac_hi == half && (frac_lo || (out[-1] & 1)))) {
+        char *p = out - 1;
+        while(p >= int_start) {
+            if(*p == '.') {
+                --p;
+                continue;
+            }
+            if(*p != '9') {
+                ++*p;
+                break;
+            }
+            *p-- = '0';
+        }
+        if(p < int_start) {
+            // carried out of the leading digit: 9.99 -> 10.00
+            memmove(int_start + 1, int_start, out - int_start + 1);
+            *int_start = '1';
+            ++out;
         }
     }
-    sprintf(out, "%d", (int) remainder);
+    return (int)(out - s);
+}
+
+/*
+ * As there is a problem of sprintf %f in Arduino,
+   follow https://github.com/blynkkk/blynk-library/issues/14 to implement dtostrf
+ * width is accepted for compatibility but, as before, no padding is added.
+ */
+char * dtostrf(double number, signed char width, unsigned char prec, char *s) {
+    dtoa_fixed(number, prec, s);
     return s;
-}
\ No newline at end of file
+}
@@ -11,6 +11,15 @@ char *f2s(float f, int p);
 
 char* dtostrf (double val, signed char width, unsigned char prec, char *s);
 
+/* space dtoa_fixed() needs for prec decimals: sign, 10 digits, '.', NUL */
+#define DTOA_FIXED_SIZE(prec) ((prec) + 13)
+
+/* Write number with exactly prec decimals (rounded, ties to even, like
+ * printf "%.*f") to s, which must hold DTOA_FIXED_SIZE(prec) bytes.
+ * NaN, infinity and magnitudes above 4294967040 give "nan", "inf" and "ovf"
+ * like dtostrf(). Returns the length of the string. */
+int dtoa_fixed(double number, unsigned char prec, char *s);
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,6 +16,7 @@
  */
 
 #include "http_c_response.h"
+#include "MemoryProfiler.h"
 
 HttpResponse::HttpResponse()
 {
@@ -36,7 +37,7 @@ HttpResponse::~HttpResponse()
     }
     if (body)
     {
-        free(body);
+        mem_profile_free(body);
     }
     while (headers != NULL)
     {
@@ -155,17 +156,17 @@ void HttpResponse::set_body(const char* at, size_t length)
     
     if(body != NULL)
     {
-        char* bd = (char*)malloc(body_length + length + 1);
+        char* bd = (char*)mem_profile_malloc(MEM_TAG_HTTP, body_length + length + 1);
         memcpy(bd, body, body_length);
         memcpy(&bd[body_length], at, length);
         bd[body_length + length] = 0;
-        free(body);
+        mem_profile_free(body);
         body = bd;
         body_length += length;
     }
     else
     {
-        body = (char*)malloc(length + 1);
+        body = (char*)mem_profile_malloc(MEM_TAG_HTTP, length + 1);
         memcpy(body, at, length);
         body[length] = 0;
         body_length = length;
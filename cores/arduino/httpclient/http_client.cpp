@@ -77,6 +77,14 @@ void HTTPClient::set_header(const char* key, const char* value)
     }
 }
 
+void HTTPClient::set_memory_profile(TLSMemoryProfile profile)
+{
+    if (_https_request != NULL)
+    {
+        _https_request->set_memory_profile(profile);
+    }
+}
+
 nsapi_error_t HTTPClient::get_error()
 {
     if (_https_request != NULL)
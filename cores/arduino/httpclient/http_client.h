@@ -37,6 +37,7 @@ public:
     
     const Http_Response* send(const void* body = NULL, int body_size = 0);
     void set_header(const char* key, const char* value);
+    void set_memory_profile(TLSMemoryProfile profile);
     nsapi_error_t get_error();
     
 private:
@@ -45,5 +45,10 @@ typedef struct _tagKeyValue
 
 #define HTTP_RECEIVE_BUFFER_SIZE 2048
 
+// longest silence while waiting for the response
+#ifndef HTTP_RECEIVE_TIMEOUT_MS
+#define HTTP_RECEIVE_TIMEOUT_MS 10000
+#endif
+
 
 #endif // __HTTPS_COMMON_H__
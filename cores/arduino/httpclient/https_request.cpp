@@ -46,6 +46,8 @@ HttpsRequest::HttpsRequest(NetworkInterface* net_iface,
 
     _parsed_url = new ParsedUrl(url);
     _tlssocket = new TLSSocket(ssl_ca_pem, net_iface);
+    // wait for the response rather than treating the first quiet moment as its end
+    _tlssocket->set_recv_timeout(HTTP_RECEIVE_TIMEOUT_MS);
     _headerBuilder = new HttpHeaderBuilder(method, _parsed_url);
 }
 
@@ -98,6 +100,9 @@ HttpResponse* HttpsRequest::send(const void* body, size_t body_size)
         return NULL;
     }
     
+    /* Header, body and ending are gathered into as few TLS records as possible */
+    _tlssocket->cork();
+
     /* Send the HTTP header */
     size_t request_size = 0;
     char* request = _headerBuilder->build(body_size, request_size);
@@ -133,6 +138,13 @@ HttpResponse* HttpsRequest::send(const void* body, size_t body_size)
         _tlssocket->close();
         return NULL;
     }
+    _error = _tlssocket->uncork();
+    if (_error != NSAPI_ERROR_OK)
+    {
+        ERROR("Failed to send the request");
+        _tlssocket->close();
+        return NULL;
+    }
     
     // Create a response object
     if (_response)
@@ -197,6 +209,16 @@ void HttpsRequest::set_header(const char* key, const char* value)
     _headerBuilder->set_header(key, value);
 }
 
+/**
+ * Set the TLS memory profile (buffer sizes, max_fragment_length).
+ *
+ * @param[in] profile Takes effect on the next send()
+ */
+void HttpsRequest::set_memory_profile(TLSMemoryProfile profile)
+{
+    _tlssocket->set_memory_profile(profile);
+}
+
 /**
  * Get the error code.
  *
@@ -75,6 +75,13 @@ public:
      */
     void set_header(const char* key, const char* value);
 
+    /**
+     * Set the TLS memory profile (buffer sizes, max_fragment_length).
+     *
+     * @param[in] profile Takes effect on the next send()
+     */
+    void set_memory_profile(TLSMemoryProfile profile);
+
     /**
      * Get the error code.
      *
@@ -44,6 +44,7 @@
 #include "OledDisplay.h"
 #include "SystemVariables.h"
 #include "SystemWeb.h"
+#include "SystemFunc.h"
 
 #define HTTPD_HDR_DEFORT (HTTPD_HDR_ADD_SERVER|HTTPD_HDR_ADD_CONN_CLOSE|HTTPD_HDR_ADD_PRAGMA_NO_CACHE)
 
@@ -760,7 +761,7 @@ exit:
     if (err == kNoErr && saveSuccess)
     {
         wait_ms(3000);
-        mico_system_reboot();
+        SystemReboot();
     }
     
     return err;
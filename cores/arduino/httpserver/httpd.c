@@ -35,6 +35,7 @@
 #include "httpd_wsgi.h"
 #include "http-strings.h"
 #include "mico.h"
+#include "MemoryProfiler.h"
 
 typedef enum
 {
@@ -401,6 +402,8 @@ static void httpd_main( mico_thread_arg_t arg )
     int status, max_sockfd = -1;
     fd_set readfds, active_readfds;
 
+    mem_profile_name_thread( mem_profile_current_thread( ), "httpd" );
+
     status = httpd_setup_main_sockets( );
     if ( status != kNoErr )
         httpd_suspend_thread( true );
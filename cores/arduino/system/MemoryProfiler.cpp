@@ -0,0 +1,505 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+#include "MemoryProfiler.h"
+#include "Print.h"
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#if defined(__MBED__)
+#include "mbed.h"
+#include "mbed_stats.h"
+#include "cmsis_os.h"
+#include <reent.h>
+#include <unistd.h>
+
+// newlib-nano keeps free chunks in an address-ordered list; size includes the
+// chunk header
+struct MallocChunk
+{
+    long size;
+    MallocChunk *next;
+};
+
+extern "C" MallocChunk *__malloc_free_list;
+extern "C" void __malloc_lock(struct _reent *r);
+extern "C" void __malloc_unlock(struct _reent *r);
+extern unsigned char *mbed_heap_start;
+extern uint32_t mbed_heap_size;
+#endif
+
+// in front of every tagged block; keeps the caller's pointer 8-byte aligned
+struct MemHeader
+{
+    uint32_t size;
+    uint8_t tag;
+    uint8_t reserved[3];
+};
+
+struct MemCounters
+{
+    std::atomic<uint32_t> current;
+    std::atomic<uint32_t> peak;
+    std::atomic<uint32_t> total;
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> allocs;
+    std::atomic<uint32_t> fails;
+};
+
+static MemCounters mem_tags[MEM_TAG_COUNT];
+
+static const char *const mem_tag_names[MEM_TAG_COUNT] =
+{
+    "other",
+    "tls",
+    "mqtt",
+    "http",
+    "wifi",
+    "user",
+};
+
+// thread id slots are claimed by CAS, names are static strings
+static std::atomic<uint32_t> mem_thread_ids[MEM_PROFILE_MAX_THREADS];
+static const char *volatile mem_thread_names[MEM_PROFILE_MAX_THREADS];
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Tagged allocations
+static void mem_note_alloc(uint8_t tag, uint32_t size)
+{
+    MemCounters &c = mem_tags[tag];
+    uint32_t now = c.current.fetch_add(size, std::memory_order_relaxed) + size;
+    uint32_t peak = c.peak.load(std::memory_order_relaxed);
+    while (now > peak && !c.peak.compare_exchange_weak(peak, now, std::memory_order_relaxed))
+    {
+    }
+    c.total.fetch_add(size, std::memory_order_relaxed);
+    c.count.fetch_add(1, std::memory_order_relaxed);
+    c.allocs.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void mem_note_free(uint8_t tag, uint32_t size)
+{
+    MemCounters &c = mem_tags[tag];
+    c.current.fetch_sub(size, std::memory_order_relaxed);
+    c.count.fetch_sub(1, std::memory_order_relaxed);
+}
+
+static void mem_note_fail(uint8_t tag)
+{
+    mem_tags[tag].fails.fetch_add(1, std::memory_order_relaxed);
+}
+
+void *mem_profile_malloc(uint8_t tag, size_t size)
+{
+    if (tag >= MEM_TAG_COUNT)
+    {
+        tag = MEM_TAG_OTHER;
+    }
+
+    MemHeader *hdr = NULL;
+    if (size <= UINT32_MAX - sizeof(MemHeader))
+    {
+        hdr = (MemHeader *)malloc(sizeof(MemHeader) + size);
+    }
+    if (hdr == NULL)
+    {
+        mem_note_fail(tag);
+        return NULL;
+    }
+
+    hdr->size = (uint32_t)size;
+    hdr->tag = tag;
+    mem_note_alloc(tag, (uint32_t)size);
+    return hdr + 1;
+}
+
+void *mem_profile_calloc(uint8_t tag, size_t count, size_t size)
+{
+    if (size != 0 && count > SIZE_MAX / size)
+    {
+        mem_note_fail(tag < MEM_TAG_COUNT ? tag : MEM_TAG_OTHER);
+        return NULL;
+    }
+
+    void *ptr = mem_profile_malloc(tag, count * size);
+    if (ptr != NULL)
+    {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void *mem_profile_realloc(uint8_t tag, void *ptr, size_t size)
+{
+    if (ptr == NULL)
+    {
+        return mem_profile_malloc(tag, size);
+    }
+    if (size == 0)
+    {
+        mem_profile_free(ptr);
+        return NULL;
+    }
+    if (tag >= MEM_TAG_COUNT)
+    {
+        tag = MEM_TAG_OTHER;
+    }
+
+    MemHeader *hdr = (MemHeader *)ptr - 1;
+    uint8_t old_tag = hdr->tag;
+    uint32_t old_size = hdr->size;
+
+    MemHeader *resized = NULL;
+    if (size <= UINT32_MAX - sizeof(MemHeader))
+    {
+        resized = (MemHeader *)realloc(hdr, sizeof(MemHeader) + size);
+    }
+    if (resized == NULL)
+    {
+        // the original block is left as it was
+        mem_note_fail(tag);
+        return NULL;
+    }
+
+    resized->size = (uint32_t)size;
+    resized->tag = tag;
+    mem_note_free(old_tag, old_size);
+    mem_note_alloc(tag, (uint32_t)size);
+    return resized + 1;
+}
+
+void mem_profile_free(void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    MemHeader *hdr = (MemHeader *)ptr - 1;
+    mem_note_free(hdr->tag, hdr->size);
+    free(hdr);
+}
+
+void mem_profile_tag(uint8_t tag, mem_stats_t *stats)
+{
+    if (stats == NULL)
+    {
+        return;
+    }
+    if (tag >= MEM_TAG_COUNT)
+    {
+        memset(stats, 0, sizeof(mem_stats_t));
+        return;
+    }
+
+    MemCounters &c = mem_tags[tag];
+    stats->current = c.current.load(std::memory_order_relaxed);
+    stats->peak = c.peak.load(std::memory_order_relaxed);
+    stats->total = c.total.load(std::memory_order_relaxed);
+    stats->count = c.count.load(std::memory_order_relaxed);
+    stats->allocs = c.allocs.load(std::memory_order_relaxed);
+    stats->fails = c.fails.load(std::memory_order_relaxed);
+}
+
+const char *mem_profile_tag_name(uint8_t tag)
+{
+    return tag < MEM_TAG_COUNT ? mem_tag_names[tag] : "?";
+}
+
+void mem_profile_reset_peaks(void)
+{
+    for (int i = 0; i < MEM_TAG_COUNT; i++)
+    {
+        mem_tags[i].peak.store(mem_tags[i].current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Whole heap
+void mem_profile_heap(mem_stats_t *stats, uint32_t *reserved)
+{
+    if (stats == NULL)
+    {
+        return;
+    }
+
+#if defined(__MBED__)
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    stats->current = heap.current_size;
+    stats->peak = heap.max_size;
+    stats->total = heap.total_size;
+    stats->count = heap.alloc_cnt;
+    stats->allocs = 0;      // not kept by mbed
+    stats->fails = heap.alloc_fail_cnt;
+    if (reserved != NULL)
+    {
+        *reserved = heap.reserved_size;
+    }
+#else
+    // host: only what went through the tagged allocator
+    memset(stats, 0, sizeof(mem_stats_t));
+    for (uint8_t i = 0; i < MEM_TAG_COUNT; i++)
+    {
+        mem_stats_t tag;
+        mem_profile_tag(i, &tag);
+        stats->current += tag.current;
+        stats->peak += tag.peak;
+        stats->total += tag.total;
+        stats->count += tag.count;
+        stats->allocs += tag.allocs;
+        stats->fails += tag.fails;
+    }
+    if (reserved != NULL)
+    {
+        *reserved = 0;
+    }
+#endif
+}
+
+static int mem_bucket(uint32_t size)
+{
+    int bucket = 0;
+    for (uint32_t limit = 16; size >= limit && bucket < MEM_HISTOGRAM_BUCKETS - 1; limit <<= 1)
+    {
+        bucket++;
+    }
+    return bucket;
+}
+
+void mem_profile_free_blocks(mem_free_stats_t *stats)
+{
+    if (stats == NULL)
+    {
+        return;
+    }
+    memset(stats, 0, sizeof(mem_free_stats_t));
+
+#if defined(__MBED__)
+    // the list is only read, under the allocator's own lock
+    __malloc_lock(_REENT);
+    for (MallocChunk *chunk = __malloc_free_list; chunk != NULL; chunk = chunk->next)
+    {
+        uint32_t size = (uint32_t)chunk->size;
+        stats->free_bytes += size;
+        stats->free_blocks++;
+        stats->buckets[mem_bucket(size)]++;
+        if (size > stats->largest)
+        {
+            stats->largest = size;
+        }
+    }
+    unsigned char *brk = (unsigned char *)sbrk(0);
+    __malloc_unlock(_REENT);
+
+    unsigned char *limit = mbed_heap_start + mbed_heap_size;
+    if (brk != (unsigned char *)-1 && brk < limit)
+    {
+        stats->top = (uint32_t)(limit - brk);
+        if (stats->top > stats->largest)
+        {
+            stats->largest = stats->top;
+        }
+    }
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Thread stacks
+static const char *mem_thread_name(uint32_t thread_id)
+{
+    for (int i = 0; i < MEM_PROFILE_MAX_THREADS; i++)
+    {
+        if (mem_thread_ids[i].load(std::memory_order_acquire) == thread_id)
+        {
+            return mem_thread_names[i];
+        }
+    }
+    return NULL;
+}
+
+void mem_profile_name_thread(uint32_t thread_id, const char *name)
+{
+    if (thread_id == 0)
+    {
+        return;
+    }
+
+    for (int i = 0; i < MEM_PROFILE_MAX_THREADS; i++)
+    {
+        uint32_t id = mem_thread_ids[i].load(std::memory_order_acquire);
+        if (id == 0)
+        {
+            if (!mem_thread_ids[i].compare_exchange_strong(id, thread_id, std::memory_order_acq_rel))
+            {
+                if (id != thread_id)
+                {
+                    continue;
+                }
+            }
+            mem_thread_names[i] = name;
+            return;
+        }
+        if (id == thread_id)
+        {
+            mem_thread_names[i] = name;
+            return;
+        }
+    }
+}
+
+uint32_t mem_profile_current_thread(void)
+{
+#if defined(__MBED__)
+    return (uint32_t)osThreadGetId();
+#else
+    return 0;
+#endif
+}
+
+int mem_profile_stacks(mem_stack_stats_t *stats, int count)
+{
+    int n = 0;
+
+#if defined(__MBED__)
+    osThreadEnumId list = _osThreadsEnumStart();
+    osThreadId id;
+    while ((id = _osThreadEnumNext(list)) != NULL)
+    {
+        if (stats != NULL && n < count)
+        {
+            stats[n].thread_id = (uint32_t)id;
+            stats[n].name = mem_thread_name((uint32_t)id);
+            stats[n].used = _osThreadGetInfo(id, osThreadInfoStackMax).value.v;
+            stats[n].size = _osThreadGetInfo(id, osThreadInfoStackSize).value.v;
+        }
+        n++;
+    }
+    _osThreadEnumFree(list);
+#endif
+
+    return n;
+}
+
+void mem_profile_name_new_threads(const char *name)
+{
+    mem_stack_stats_t threads[MEM_PROFILE_MAX_THREADS];
+    int n = mem_profile_stacks(threads, MEM_PROFILE_MAX_THREADS);
+    if (n > MEM_PROFILE_MAX_THREADS)
+    {
+        n = MEM_PROFILE_MAX_THREADS;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        if (threads[i].name == NULL)
+        {
+            mem_profile_name_thread(threads[i].thread_id, name);
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Report
+static void mem_print_stats(Print &out, const char *name, const mem_stats_t *s, bool json)
+{
+    if (json)
+    {
+        out.printf("\"%s\":{\"current\":%lu,\"peak\":%lu,\"total\":%lu,\"count\":%lu,\"allocs\":%lu,\"fails\":%lu}",
+            name, (unsigned long)s->current, (unsigned long)s->peak, (unsigned long)s->total,
+            (unsigned long)s->count, (unsigned long)s->allocs, (unsigned long)s->fails);
+    }
+    else
+    {
+        out.printf("  %-6s %8lu %8lu %10lu %6lu %8lu %5lu\r\n",
+            name, (unsigned long)s->current, (unsigned long)s->peak, (unsigned long)s->total,
+            (unsigned long)s->count, (unsigned long)s->allocs, (unsigned long)s->fails);
+    }
+}
+
+void mem_profile_print(Print &out, bool json)
+{
+    mem_stats_t heap;
+    uint32_t reserved;
+    mem_profile_heap(&heap, &reserved);
+
+    mem_free_stats_t free_stats;
+    mem_profile_free_blocks(&free_stats);
+
+    mem_stack_stats_t stacks[MEM_PROFILE_MAX_THREADS];
+    int threads = mem_profile_stacks(stacks, MEM_PROFILE_MAX_THREADS);
+    if (threads > MEM_PROFILE_MAX_THREADS)
+    {
+        threads = MEM_PROFILE_MAX_THREADS;
+    }
+
+    if (json)
+    {
+        out.printf("{\"reserved\":%lu,", (unsigned long)reserved);
+        mem_print_stats(out, "heap", &heap, true);
+        out.print(",\"tags\":{");
+        for (uint8_t i = 0; i < MEM_TAG_COUNT; i++)
+        {
+            mem_stats_t tag;
+            mem_profile_tag(i, &tag);
+            if (i > 0)
+            {
+                out.print(',');
+            }
+            mem_print_stats(out, mem_tag_names[i], &tag, true);
+        }
+        out.printf("},\"free\":{\"bytes\":%lu,\"blocks\":%lu,\"largest\":%lu,\"top\":%lu,\"histogram\":[",
+            (unsigned long)free_stats.free_bytes, (unsigned long)free_stats.free_blocks,
+            (unsigned long)free_stats.largest, (unsigned long)free_stats.top);
+        for (int i = 0; i < MEM_HISTOGRAM_BUCKETS; i++)
+        {
+            out.printf(i > 0 ? ",%lu" : "%lu", (unsigned long)free_stats.buckets[i]);
+        }
+        out.print("]},\"stacks\":[");
+        for (int i = 0; i < threads; i++)
+        {
+            out.printf("%s{\"id\":%lu,\"name\":\"%s\",\"used\":%lu,\"size\":%lu}", i > 0 ? "," : "",
+                (unsigned long)stacks[i].thread_id, stacks[i].name ? stacks[i].name : "",
+                (unsigned long)stacks[i].used, (unsigned long)stacks[i].size);
+        }
+        out.print("]}\r\n");
+        return;
+    }
+
+    out.printf("Heap: %lu bytes in use, %lu reserved\r\n", (unsigned long)heap.current, (unsigned long)reserved);
+    out.print("  tag     current     peak      total  count   allocs fails\r\n");
+    mem_print_stats(out, "heap", &heap, false);
+    for (uint8_t i = 0; i < MEM_TAG_COUNT; i++)
+    {
+        mem_stats_t tag;
+        mem_profile_tag(i, &tag);
+        mem_print_stats(out, mem_tag_names[i], &tag, false);
+    }
+
+    out.printf("Free: %lu bytes in %lu blocks, %lu never used, largest %lu\r\n",
+        (unsigned long)free_stats.free_bytes, (unsigned long)free_stats.free_blocks,
+        (unsigned long)free_stats.top, (unsigned long)free_stats.largest);
+    for (int i = 0; i < MEM_HISTOGRAM_BUCKETS; i++)
+    {
+        if (free_stats.buckets[i] == 0)
+        {
+            continue;
+        }
+        if (i == MEM_HISTOGRAM_BUCKETS - 1)
+        {
+            out.printf("  >= %5lu: %lu\r\n", 16UL << (i - 1), (unsigned long)free_stats.buckets[i]);
+        }
+        else
+        {
+            out.printf("  < %6lu: %lu\r\n", 16UL << i, (unsigned long)free_stats.buckets[i]);
+        }
+    }
+
+    out.print("Stacks:\r\n");
+    for (int i = 0; i < threads; i++)
+    {
+        out.printf("  0x%08lX %-8s %5lu of %5lu bytes\r\n", (unsigned long)stacks[i].thread_id,
+            stacks[i].name ? stacks[i].name : "-", (unsigned long)stacks[i].used, (unsigned long)stacks[i].size);
+    }
+}
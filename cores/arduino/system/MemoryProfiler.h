@@ -0,0 +1,115 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+#ifndef __MEMORY_PROFILER_H__
+#define __MEMORY_PROFILER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Heap and stack profiling.
+ *
+ * Whole-heap figures come from the mbed heap statistics.  Buffers the
+ * framework owns (TLS receive buffer, MQTT packet buffer, ...) are allocated
+ * through mem_profile_malloc() and friends with a tag, which keeps current,
+ * peak and cumulative figures per tag at the cost of an 8 byte header per
+ * block.  mem_profile_free_blocks() walks the allocator's free list into a
+ * power-of-two histogram to show fragmentation, and mem_profile_stacks()
+ * reports the high-water mark of every thread stack.
+ *
+ * `mem` in the configuration console, or mem_profile_print() from a sketch,
+ * prints all of it as a table or as one JSON object.
+ *
+ * Built without __MBED__ (e.g. on a host), the whole-heap figures are the sum
+ * of the tags and the free list and stacks are reported empty, so the module
+ * can be exercised under a host malloc.
+ */
+
+#define MEM_TAG_OTHER       0
+#define MEM_TAG_TLS         1
+#define MEM_TAG_MQTT        2
+#define MEM_TAG_HTTP        3
+#define MEM_TAG_WIFI        4
+#define MEM_TAG_USER        5
+#define MEM_TAG_COUNT       6
+
+// free blocks are counted in buckets [0,16), [16,32), ... [8K,16K), [16K,...)
+#define MEM_HISTOGRAM_BUCKETS   12
+
+// threads that can be given a name
+#ifndef MEM_PROFILE_MAX_THREADS
+#define MEM_PROFILE_MAX_THREADS 16
+#endif
+
+typedef struct
+{
+    uint32_t current;       // bytes allocated now
+    uint32_t peak;          // highest value of current
+    uint32_t total;         // bytes ever allocated
+    uint32_t count;         // blocks allocated now
+    uint32_t allocs;        // blocks ever allocated
+    uint32_t fails;         // allocations that returned NULL
+} mem_stats_t;
+
+typedef struct
+{
+    uint32_t free_bytes;    // in the free list
+    uint32_t free_blocks;
+    uint32_t largest;       // largest free region, including top
+    uint32_t top;           // never claimed from the heap region yet
+    uint32_t buckets[MEM_HISTOGRAM_BUCKETS];
+} mem_free_stats_t;
+
+typedef struct
+{
+    uint32_t thread_id;
+    const char *name;       // NULL if never named
+    uint32_t used;          // stack high-water mark
+    uint32_t size;
+} mem_stack_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Allocate, resize and release a block counted against a tag. Blocks must
+ *  be released with mem_profile_free(), never free(). */
+void *mem_profile_malloc(uint8_t tag, size_t size);
+void *mem_profile_calloc(uint8_t tag, size_t count, size_t size);
+void *mem_profile_realloc(uint8_t tag, void *ptr, size_t size);
+void mem_profile_free(void *ptr);
+
+/** Whole heap (reserved is the heap region in use by the allocator). */
+void mem_profile_heap(mem_stats_t *stats, uint32_t *reserved);
+
+void mem_profile_tag(uint8_t tag, mem_stats_t *stats);
+const char *mem_profile_tag_name(uint8_t tag);
+
+/** Restart the per-tag peaks from the current figures. */
+void mem_profile_reset_peaks(void);
+
+void mem_profile_free_blocks(mem_free_stats_t *stats);
+
+/** Fill up to count entries; returns the number of threads. */
+int mem_profile_stacks(mem_stack_stats_t *stats, int count);
+
+/** Name a thread in the stack report (name must be static). */
+void mem_profile_name_thread(uint32_t thread_id, const char *name);
+
+/** Give the name to every thread that does not have one yet, i.e. the
+ *  threads created since the previous call. */
+void mem_profile_name_new_threads(const char *name);
+
+uint32_t mem_profile_current_thread(void);
+
+#ifdef __cplusplus
+}
+
+class Print;
+
+/** Print everything as a table, or as a single line of JSON. */
+void mem_profile_print(Print &out, bool json);
+#endif
+
+#endif  // __MEMORY_PROFILER_H__
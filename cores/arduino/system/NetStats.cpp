@@ -0,0 +1,244 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+#include "NetStats.h"
+#include "Print.h"
+#include <string.h>
+#include <atomic>
+
+#if defined(__MBED__)
+#include "nsapi_types.h"
+#else
+#define NSAPI_ERROR_WOULD_BLOCK     -3001
+#endif
+
+#define FIELD(name)     (offsetof(net_stats_t, name) / sizeof(uint32_t))
+
+struct NetCounters
+{
+    std::atomic<uint32_t> v[NET_STATS_FIELDS];
+};
+
+static NetCounters net_totals[NET_STATS_KIND_COUNT];
+
+static const char *const net_kind_names[NET_STATS_KIND_COUNT] =
+{
+    "tcp",
+    "tls",
+};
+
+static const char *const net_field_names[NET_STATS_FIELDS] =
+{
+    "bytes_in",
+    "bytes_out",
+    "recv_calls",
+    "send_calls",
+    "would_block",
+    "closes",
+    "retries",
+    "wait_ms",
+    "errors",
+    "connects",
+    "connect_fails",
+    "reconnects",
+    "connect_ms",
+    "connect_ms_total",
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Counting
+static void net_add(uint8_t kind, net_stats_t *stats, size_t field, uint32_t n)
+{
+    if (stats != NULL)
+    {
+        ((uint32_t *)stats)[field] += n;
+    }
+    if (kind < NET_STATS_KIND_COUNT)
+    {
+        net_totals[kind].v[field].fetch_add(n, std::memory_order_relaxed);
+    }
+}
+
+static void net_set(uint8_t kind, net_stats_t *stats, size_t field, uint32_t n)
+{
+    if (stats != NULL)
+    {
+        ((uint32_t *)stats)[field] = n;
+    }
+    if (kind < NET_STATS_KIND_COUNT)
+    {
+        net_totals[kind].v[field].store(n, std::memory_order_relaxed);
+    }
+}
+
+static void net_count_result(uint8_t kind, net_stats_t *stats, size_t bytes_field, int result)
+{
+    if (result > 0)
+    {
+        net_add(kind, stats, bytes_field, (uint32_t)result);
+    }
+    else if (result == NSAPI_ERROR_WOULD_BLOCK)
+    {
+        net_add(kind, stats, FIELD(would_block), 1);
+    }
+    else if (result < 0)
+    {
+        net_add(kind, stats, FIELD(errors), 1);
+    }
+}
+
+void net_stats_send(uint8_t kind, net_stats_t *stats, int result)
+{
+    net_add(kind, stats, FIELD(send_calls), 1);
+    net_count_result(kind, stats, FIELD(bytes_out), result);
+}
+
+void net_stats_recv(uint8_t kind, net_stats_t *stats, int result)
+{
+    net_add(kind, stats, FIELD(recv_calls), 1);
+    if (result == 0)
+    {
+        // the peer closed the connection
+        net_add(kind, stats, FIELD(closes), 1);
+        return;
+    }
+    net_count_result(kind, stats, FIELD(bytes_in), result);
+}
+
+void net_stats_retry(uint8_t kind, net_stats_t *stats)
+{
+    net_add(kind, stats, FIELD(retries), 1);
+}
+
+void net_stats_wait(uint8_t kind, net_stats_t *stats, uint32_t ms)
+{
+    if (ms > 0)
+    {
+        net_add(kind, stats, FIELD(wait_ms), ms);
+    }
+}
+
+void net_stats_connect(uint8_t kind, net_stats_t *stats, uint32_t ms, bool ok)
+{
+    if (!ok)
+    {
+        net_add(kind, stats, FIELD(connect_fails), 1);
+        return;
+    }
+
+    if (stats != NULL && stats->connects > 0)
+    {
+        net_add(kind, stats, FIELD(reconnects), 1);
+    }
+    net_add(kind, stats, FIELD(connects), 1);
+    net_set(kind, stats, FIELD(connect_ms), ms);
+    net_add(kind, stats, FIELD(connect_ms_total), ms);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Totals
+void net_stats_total(uint8_t kind, net_stats_t *stats)
+{
+    if (stats == NULL)
+    {
+        return;
+    }
+    memset(stats, 0, sizeof(net_stats_t));
+    if (kind >= NET_STATS_KIND_COUNT)
+    {
+        return;
+    }
+
+    uint32_t *out = (uint32_t *)stats;
+    for (size_t i = 0; i < NET_STATS_FIELDS; i++)
+    {
+        out[i] = net_totals[kind].v[i].load(std::memory_order_relaxed);
+    }
+}
+
+const char *net_stats_kind_name(uint8_t kind)
+{
+    return kind < NET_STATS_KIND_COUNT ? net_kind_names[kind] : "";
+}
+
+void net_stats_reset(void)
+{
+    for (int k = 0; k < NET_STATS_KIND_COUNT; k++)
+    {
+        for (size_t i = 0; i < NET_STATS_FIELDS; i++)
+        {
+            net_totals[k].v[i].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t net_stats_snapshot(uint8_t *buf, size_t size)
+{
+    if (buf == NULL || size < NET_STATS_SNAPSHOT_MAX)
+    {
+        return 0;
+    }
+
+    size_t n = 0;
+    buf[n++] = 'N';
+    buf[n++] = NET_STATS_SNAPSHOT_VERSION;
+    buf[n++] = NET_STATS_KIND_COUNT;
+    buf[n++] = NET_STATS_FIELDS;
+    for (int k = 0; k < NET_STATS_KIND_COUNT; k++)
+    {
+        for (size_t i = 0; i < NET_STATS_FIELDS; i++)
+        {
+            uint32_t v = net_totals[k].v[i].load(std::memory_order_relaxed);
+            while (v >= 0x80)
+            {
+                buf[n++] = (uint8_t)(v | 0x80);
+                v >>= 7;
+            }
+            buf[n++] = (uint8_t)v;
+        }
+    }
+    return n;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Report
+void net_stats_print(Print &out, bool json)
+{
+    net_stats_t totals[NET_STATS_KIND_COUNT];
+    for (uint8_t k = 0; k < NET_STATS_KIND_COUNT; k++)
+    {
+        net_stats_total(k, &totals[k]);
+    }
+
+    if (json)
+    {
+        out.print('{');
+        for (uint8_t k = 0; k < NET_STATS_KIND_COUNT; k++)
+        {
+            const uint32_t *v = (const uint32_t *)&totals[k];
+            out.printf("%s\"%s\":{", k > 0 ? "," : "", net_kind_names[k]);
+            for (size_t i = 0; i < NET_STATS_FIELDS; i++)
+            {
+                out.printf("%s\"%s\":%lu", i > 0 ? "," : "", net_field_names[i], (unsigned long)v[i]);
+            }
+            out.print('}');
+        }
+        out.print("}\r\n");
+        return;
+    }
+
+    out.print("                     ");
+    for (uint8_t k = 0; k < NET_STATS_KIND_COUNT; k++)
+    {
+        out.printf(" %10s", net_kind_names[k]);
+    }
+    out.print("\r\n");
+    for (size_t i = 0; i < NET_STATS_FIELDS; i++)
+    {
+        out.printf("  %-18s", net_field_names[i]);
+        for (uint8_t k = 0; k < NET_STATS_KIND_COUNT; k++)
+        {
+            out.printf(" %10lu", (unsigned long)((const uint32_t *)&totals[k])[i]);
+        }
+        out.print("\r\n");
+    }
+}
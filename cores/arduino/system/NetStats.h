@@ -0,0 +1,91 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+#ifndef __NET_STATS_H__
+#define __NET_STATS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Network counters.
+ *
+ * Every socket wrapper (WiFiClient, TLSSocket and through it
+ * WiFiClientSecure) keeps a net_stats_t of its own and reports each socket
+ * call, wait and connect through the functions below, which also add it to
+ * system-wide totals per kind.  Counters are 32-bit and wrap.
+ *
+ * `net` in the configuration console, or net_stats_print() from a sketch,
+ * prints the totals as a table or as one JSON object; net_stats_snapshot()
+ * packs them into a few dozen bytes for telemetry (`net hex` prints one).
+ */
+
+#define NET_STATS_TCP           0   // WiFiClient, TLSSocket without TLS
+#define NET_STATS_TLS           1   // TLSSocket, WiFiClientSecure
+#define NET_STATS_KIND_COUNT    2
+
+typedef struct
+{
+    uint32_t bytes_in;          // received from the socket
+    uint32_t bytes_out;         // taken by the socket
+    uint32_t recv_calls;
+    uint32_t send_calls;
+    uint32_t would_block;       // calls that had nothing to give or no room
+    uint32_t closes;            // receives that found the connection closed
+    uint32_t retries;           // operations tried again after waiting
+    uint32_t wait_ms;           // time spent waiting for the socket
+    uint32_t errors;            // calls that failed
+    uint32_t connects;          // successful connects
+    uint32_t connect_fails;
+    uint32_t reconnects;        // connects after the first on the same object
+    uint32_t connect_ms;        // duration of the last successful connect
+    uint32_t connect_ms_total;  // of all successful connects
+} net_stats_t;
+
+#define NET_STATS_FIELDS        (sizeof(net_stats_t) / sizeof(uint32_t))
+
+/* Snapshot: 'N', version, kinds, fields, then every counter of every kind in
+ * net_stats_t order as an unsigned LEB128 varint (7 bits per byte, low
+ * first, top bit set on all but the last byte).  Version 2 added closes
+ * after would_block. */
+#define NET_STATS_SNAPSHOT_VERSION  2
+#define NET_STATS_SNAPSHOT_MAX      (4 + NET_STATS_KIND_COUNT * NET_STATS_FIELDS * 5)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Count one socket call into stats and the totals for kind; result is what
+ *  the call returned (bytes, 0, or a negative nsapi error).  A receive
+ *  returning 0 counts as a close. */
+void net_stats_send(uint8_t kind, net_stats_t *stats, int result);
+void net_stats_recv(uint8_t kind, net_stats_t *stats, int result);
+
+void net_stats_retry(uint8_t kind, net_stats_t *stats);
+void net_stats_wait(uint8_t kind, net_stats_t *stats, uint32_t ms);
+
+/** A connect finished after ms, successfully or not. */
+void net_stats_connect(uint8_t kind, net_stats_t *stats, uint32_t ms, bool ok);
+
+/** System-wide totals for one kind. */
+void net_stats_total(uint8_t kind, net_stats_t *stats);
+const char *net_stats_kind_name(uint8_t kind);
+
+/** Zero the system-wide totals; per-object counters are left alone. */
+void net_stats_reset(void);
+
+/** Pack the totals; returns the bytes written, 0 if size is too small
+ *  (NET_STATS_SNAPSHOT_MAX is always enough). */
+size_t net_stats_snapshot(uint8_t *buf, size_t size);
+
+#ifdef __cplusplus
+}
+
+class Print;
+
+/** Print the totals as a table, or as a single line of JSON. */
+void net_stats_print(Print &out, bool json);
+#endif
+
+#endif  // __NET_STATS_H__
@@ -1,49 +1,443 @@
 // Copyright (c) Microsoft. All rights reserved.
-// Licensed under the MIT license. 
+// Licensed under the MIT license.
 
 #include "Arduino.h"
+#include "mbed.h"
+#include "SerialLog.h"
+#include "MemoryProfiler.h"
+#include "PrintfSpec.h"
+#include <stddef.h>
+#include <atomic>
 
-#ifdef __cplusplus
-extern "C" {
-#endif
+#define LOG_MASK            (SERIAL_LOG_BUFFER_SIZE - 1)
+#define LOG_POLL_MS         10
+#define LOG_STACK_SIZE      0x800
+#define LOG_LINE_SIZE       128
 
-void serial_log(const char* msg)
+// record state word: size in bytes, plus flags
+#define RECORD_READY        0x80000000u
+#define RECORD_FILLER       0x40000000u     // skips the end of the ring
+#define RECORD_SIZE_MASK    0x0000FFFFu
+
+// every record starts on a 4-byte boundary; its state word is written last
+// (release) by the producer and zeroed again by the consumer before the
+// space is handed back
+struct LogRecord
 {
-    if (msg != NULL)
+    uint32_t state;
+    uint32_t timestamp;     // us_ticker_read() at the call site
+    const char *format;
+    uint8_t level;
+    uint8_t module;
+    uint16_t length;        // packed arguments that follow
+};
+
+static uint32_t log_buf[SERIAL_LOG_BUFFER_SIZE / sizeof(uint32_t)];
+static std::atomic<uint32_t> log_reserved(0);  // producers, claimed by CAS
+static std::atomic<uint32_t> log_read(0);      // consumer
+static std::atomic<uint32_t> log_dropped(0);
+static uint32_t log_dropped_reported = 0;
+static Mutex log_lock;                         // one consumer at a time
+static Thread log_thread(osPriorityLow, LOG_STACK_SIZE, NULL);
+static std::atomic<bool> log_started(false);
+
+static const char *log_prefix(uint8_t module)
+{
+    switch (module)
     {
-        Serial.print(msg);
+        case SERIAL_LOG_MODULE_TLS:
+            return "[TLS] ";
+        case SERIAL_LOG_MODULE_AZUREIOT:
+            return "[AzureIoT] ";
+        case SERIAL_LOG_MODULE_DPS:
+            return "[DPS] ";
+        default:
+            return "";
     }
 }
 
-void serial_xlog(const char *format, ...)
+/* Find the next conversion in format; returns NULL when there is none. */
+static const char *log_next_spec(const char *p, printf_spec_t *spec)
+{
+    p = strchr(p, '%');
+    return (p != NULL) ? printf_spec_scan(p, spec) : NULL;
+}
+
+#define LOG_PUT(value) \
+    do { \
+        if (out) memcpy(out + n, &(value), sizeof(value)); \
+        n += sizeof(value); \
+    } while (0)
+
+/* Copy the arguments format refers to into out, or only measure them if out is NULL. */
+static uint32_t log_pack(uint8_t *out, const char *format, va_list ap)
+{
+    uint32_t n = 0;
+    printf_spec_t spec;
+
+    while ((format = log_next_spec(format, &spec)) != NULL)
+    {
+        for (uint8_t i = printf_spec_stars(&spec); i > 0; i--)
+        {
+            int star = va_arg(ap, int);
+            LOG_PUT(star);
+        }
+        switch (printf_spec_arg(&spec))
+        {
+            case PRINTF_ARG_INT: { int v = va_arg(ap, int); LOG_PUT(v); break; }
+            case PRINTF_ARG_LONG: { long v = va_arg(ap, long); LOG_PUT(v); break; }
+            case PRINTF_ARG_LLONG: { long long v = va_arg(ap, long long); LOG_PUT(v); break; }
+            case PRINTF_ARG_SIZE: { size_t v = va_arg(ap, size_t); LOG_PUT(v); break; }
+            case PRINTF_ARG_INTMAX: { intmax_t v = va_arg(ap, intmax_t); LOG_PUT(v); break; }
+            case PRINTF_ARG_PTRDIFF: { ptrdiff_t v = va_arg(ap, ptrdiff_t); LOG_PUT(v); break; }
+            case PRINTF_ARG_PTR: { void *v = va_arg(ap, void *); LOG_PUT(v); break; }
+            case PRINTF_ARG_DOUBLE: { double v = va_arg(ap, double); LOG_PUT(v); break; }
+            case PRINTF_ARG_LDOUBLE: { long double v = va_arg(ap, long double); LOG_PUT(v); break; }
+            case PRINTF_ARG_COUNT: (void)va_arg(ap, void *); break;
+            case PRINTF_ARG_STRING:
+            {
+                const char *s = va_arg(ap, const char *);
+                if (s == NULL)
+                {
+                    s = "(null)";
+                }
+                // a cut string ends in "..." so the line shows it is incomplete
+                size_t len = strnlen(s, SERIAL_LOG_STRING_MAX);
+                bool cut = (len == SERIAL_LOG_STRING_MAX && s[len] != 0);
+                if (out)
+                {
+                    if (cut)
+                    {
+                        len -= 3;
+                        memcpy(out + n, s, len);
+                        memcpy(out + n + len, "...", 3);
+                        len += 3;
+                    }
+                    else
+                    {
+                        memcpy(out + n, s, len);
+                    }
+                    out[n + len] = 0;
+                }
+                n += len + 1;
+                break;
+            }
+        }
+    }
+    return n;
+}
+
+void serial_log_vrecord(uint8_t level, uint8_t module, const char *format, va_list arg)
+{
+    if (format == NULL)
+    {
+        return;
+    }
+
+    uint32_t timestamp = us_ticker_read();
+    va_list ap;
+    va_copy(ap, arg);
+    uint32_t length = log_pack(NULL, format, ap);
+    va_end(ap);
+
+    uint32_t size = (sizeof(LogRecord) + length + 3) & ~3u;
+    if (size > SERIAL_LOG_BUFFER_SIZE / 4)
+    {
+        log_dropped++;
+        return;
+    }
+
+    // claim size bytes, plus the tail of the ring if the record would wrap
+    uint32_t pos = log_reserved.load(std::memory_order_relaxed);
+    uint32_t offset;
+    uint32_t skip;
+    do
+    {
+        offset = pos & LOG_MASK;
+        skip = (SERIAL_LOG_BUFFER_SIZE - offset < size) ? SERIAL_LOG_BUFFER_SIZE - offset : 0;
+        if (pos + skip + size - log_read.load(std::memory_order_acquire) > SERIAL_LOG_BUFFER_SIZE)
+        {
+            log_dropped++;
+            return;
+        }
+    } while (!log_reserved.compare_exchange_weak(pos, pos + skip + size,
+                                                 std::memory_order_acq_rel, std::memory_order_relaxed));
+
+    uint8_t *base = (uint8_t *)log_buf;
+    if (skip)
+    {
+        __atomic_store_n((uint32_t *)(base + offset), skip | RECORD_FILLER | RECORD_READY, __ATOMIC_RELEASE);
+        offset = 0;
+    }
+
+    LogRecord *record = (LogRecord *)(base + offset);
+    record->timestamp = timestamp;
+    record->format = format;
+    record->level = level;
+    record->module = module;
+    record->length = length;
+    va_copy(ap, arg);
+    log_pack(base + offset + sizeof(LogRecord), format, ap);
+    va_end(ap);
+    __atomic_store_n(&record->state, size | RECORD_READY, __ATOMIC_RELEASE);
+}
+
+void serial_log_record(uint8_t level, uint8_t module, const char *format, ...)
 {
     va_list arg;
     va_start(arg, format);
-    char temp[64];
-    char* buffer = temp;
-    size_t len = vsnprintf(temp, sizeof(temp), format, arg);
+    serial_log_vrecord(level, module, format, arg);
     va_end(arg);
-    if (len > sizeof(temp) - 1)
+}
+
+/* Line assembly for the consumer: whole lines go to Serial in one write. */
+struct LogLine
+{
+    char buf[LOG_LINE_SIZE];
+    size_t len;
+};
+
+static void log_flush_line(LogLine *line)
+{
+    if (line->len > 0)
+    {
+        Serial.write((const uint8_t *)line->buf, line->len);
+        line->len = 0;
+    }
+}
+
+static void log_append(LogLine *line, const char *s, size_t n)
+{
+    while (n > 0)
     {
-        buffer = new char[len + 1];
-        if (!buffer)
+        if (line->len == sizeof(line->buf))
         {
-            return;
+            log_flush_line(line);
         }
+        size_t count = sizeof(line->buf) - line->len;
+        if (count > n)
+        {
+            count = n;
+        }
+        memcpy(line->buf + line->len, s, count);
+        line->len += count;
+        s += count;
+        n -= count;
+    }
+}
 
-        va_start(arg, format);
-        vsnprintf(buffer, len + 1, format, arg);
-        va_end(arg);
+template <typename T>
+static T log_take(const uint8_t **args)
+{
+    T value;
+    memcpy(&value, *args, sizeof(value));
+    *args += sizeof(value);
+    return value;
+}
+
+template <typename T>
+static void log_format(LogLine *line, const char *spec, const int *stars, uint8_t count, T value)
+{
+    char text[64];
+    int n;
+    if (count == 0)
+    {
+        n = snprintf(text, sizeof(text), spec, value);
+    }
+    else if (count == 1)
+    {
+        n = snprintf(text, sizeof(text), spec, stars[0], value);
+    }
+    else
+    {
+        n = snprintf(text, sizeof(text), spec, stars[0], stars[1], value);
+    }
+    if (n > 0)
+    {
+        log_append(line, text, ((size_t)n < sizeof(text)) ? n : sizeof(text) - 1);
     }
+}
 
-    Serial.print(buffer);
-    
-    if (buffer != temp)
+static void log_print(const LogRecord *record)
+{
+    LogLine line;
+    const uint8_t *args = (const uint8_t *)(record + 1);
+    const char *p = record->format;
+    const char *prefix = log_prefix(record->module);
+    printf_spec_t spec;
+
+    line.len = 0;
+#if SERIAL_LOG_TIMESTAMPS
+    if (record->module != 0)
+    {
+        char stamp[16];
+        int n = snprintf(stamp, sizeof(stamp), "%lu.%06lu ",
+                         (unsigned long)(record->timestamp / 1000000), (unsigned long)(record->timestamp % 1000000));
+        log_append(&line, stamp, n);
+    }
+#endif
+    log_append(&line, prefix, strlen(prefix));
+
+    while (*p)
+    {
+        const char *next = log_next_spec(p, &spec);
+        if (next == NULL)
+        {
+            log_append(&line, p, strlen(p));
+            break;
+        }
+        log_append(&line, p, spec.start - p);
+        p = next;
+
+        int stars[2] = { 0, 0 };
+        uint8_t star_count = printf_spec_stars(&spec);
+        for (uint8_t i = 0; i < star_count; i++)
+        {
+            stars[i] = log_take<int>(&args);
+        }
+
+        // the conversion on its own, for snprintf
+        char fmt[24];
+        size_t fmt_len = spec.end - spec.start;
+        if (fmt_len >= sizeof(fmt))
+        {
+            fmt_len = 0;
+        }
+        memcpy(fmt, spec.start, fmt_len);
+        fmt[fmt_len] = 0;
+
+        switch (printf_spec_arg(&spec))
+        {
+            case PRINTF_ARG_INT: log_format(&line, fmt, stars, star_count, log_take<int>(&args)); break;
+            case PRINTF_ARG_LONG: log_format(&line, fmt, stars, star_count, log_take<long>(&args)); break;
+            case PRINTF_ARG_LLONG: log_format(&line, fmt, stars, star_count, log_take<long long>(&args)); break;
+            case PRINTF_ARG_SIZE: log_format(&line, fmt, stars, star_count, log_take<size_t>(&args)); break;
+            case PRINTF_ARG_INTMAX: log_format(&line, fmt, stars, star_count, log_take<intmax_t>(&args)); break;
+            case PRINTF_ARG_PTRDIFF: log_format(&line, fmt, stars, star_count, log_take<ptrdiff_t>(&args)); break;
+            case PRINTF_ARG_PTR: log_format(&line, fmt, stars, star_count, log_take<void *>(&args)); break;
+            case PRINTF_ARG_DOUBLE: log_format(&line, fmt, stars, star_count, log_take<double>(&args)); break;
+            case PRINTF_ARG_LDOUBLE: log_format(&line, fmt, stars, star_count, log_take<long double>(&args)); break;
+            case PRINTF_ARG_COUNT: break;
+            case PRINTF_ARG_STRING:
+            {
+                // strings are stored inline; a plain %s is appended whatever
+                // its length, only a width or precision needs snprintf
+                const char *s = (const char *)args;
+                size_t len = strlen(s);
+                if (spec.end - spec.start == 2)
+                {
+                    log_append(&line, s, len);
+                }
+                else
+                {
+                    log_format(&line, fmt, stars, star_count, s);
+                }
+                args += len + 1;
+                break;
+            }
+            default:
+                if (fmt_len == 2 && fmt[1] == '%')
+                {
+                    log_append(&line, "%", 1);
+                }
+                else
+                {
+                    log_append(&line, spec.start, spec.end - spec.start);
+                }
+                break;
+        }
+    }
+
+    if (record->module != 0)
+    {
+        log_append(&line, "\r\n", 2);
+    }
+    log_flush_line(&line);
+}
+
+/* Print the records that are ready; thread context only. */
+static void log_print_pending(void)
+{
+    log_lock.lock();
+
+    uint8_t *base = (uint8_t *)log_buf;
+    uint32_t read = log_read.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        uint32_t offset = read & LOG_MASK;
+        uint32_t state = __atomic_load_n((uint32_t *)(base + offset), __ATOMIC_ACQUIRE);
+        if (!(state & RECORD_READY))
+        {
+            break;
+        }
+
+        uint32_t size = state & RECORD_SIZE_MASK;
+        if (!(state & RECORD_FILLER))
+        {
+            log_print((const LogRecord *)(base + offset));
+        }
+        memset(base + offset, 0, size);
+        read += size;
+        log_read.store(read, std::memory_order_release);
+    }
+
+    uint32_t dropped = log_dropped.load(std::memory_order_relaxed);
+    if (dropped != log_dropped_reported)
     {
-        delete[] buffer;
+        Serial.printf("[log] %lu messages dropped\r\n", (unsigned long)(dropped - log_dropped_reported));
+        log_dropped_reported = dropped;
     }
+
+    log_lock.unlock();
 }
 
-#ifdef __cplusplus
+void serial_log_flush(void)
+{
+    // the log lock and the wait for the UART need a thread with interrupts on
+    if (__get_IPSR() != 0 || __get_PRIMASK() != 0)
+    {
+        return;
+    }
+
+    log_print_pending();
+    Serial.drain();
+}
+
+uint32_t serial_log_dropped(void)
+{
+    return log_dropped.load(std::memory_order_relaxed);
+}
+
+static void log_main(void)
+{
+    for (;;)
+    {
+        log_print_pending();
+        Thread::wait(LOG_POLL_MS);
+    }
+}
+
+void serial_log_init(void)
+{
+    if (!log_started.exchange(true))
+    {
+        log_thread.start(log_main);
+        mem_profile_name_thread((uint32_t)log_thread.gettid(), "log");
+    }
+}
+
+void serial_log(const char* msg)
+{
+    if (msg != NULL)
+    {
+        serial_log_record(SERIAL_LOG_LEVEL_INFO, 0, "%s", msg);
+    }
+}
+
+void serial_xlog(const char *format, ...)
+{
+    va_list arg;
+    va_start(arg, format);
+    serial_log_vrecord(SERIAL_LOG_LEVEL_INFO, 0, format, arg);
+    va_end(arg);
 }
-#endif
\ No newline at end of file
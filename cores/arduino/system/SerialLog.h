@@ -1,16 +1,114 @@
 // Copyright (c) Microsoft. All rights reserved.
-// Licensed under the MIT license. 
+// Licensed under the MIT license.
 
 #ifndef __SERIAL_LOG_H__
 #define __SERIAL_LOG_H__
 
+#include <stdint.h>
+#include <stdarg.h>
+
+/*
+ * Deferred logging.
+ *
+ * A log call only stores the format pointer, a microsecond timestamp and the
+ * raw arguments (strings are copied) into a lock-free ring; a low priority
+ * thread formats the records and writes them to Serial later, one line per
+ * record with the module's "[tag] " prefix and "\r\n" appended.  Calls are
+ * safe from any thread or interrupt; when the ring is full the record is
+ * dropped and counted.
+ *
+ * The format must stay valid until the record is printed, i.e. be a string
+ * literal or otherwise static.  Levels above SERIAL_LOG_LEVEL and modules not
+ * in SERIAL_LOG_MODULES are removed at compile time.
+ *
+ * Deferred lines can come out after Serial output written directly later
+ * on.  Every level is deferred, errors included, so logging on timed paths
+ * (TLS and MQTT connects) never waits for the UART.  The ring is flushed
+ * synchronously before SystemReboot() and before mbed's error() halts the
+ * board; call serial_log_flush() before any other reset.
+ *
+ * Call-site cost in host cycles (tests/host/bench_serial_log), formatting
+ * the line and writing it to a memory Serial as serial_xlog used to, against
+ * recording it:
+ *   "read %d bytes"                      ~270 vs ~240
+ *   "%s:%d connected in %lu ms"          ~455 vs ~485
+ *   100 character %s                     ~930 vs ~270
+ * Recording costs about the same as a host snprintf for short lines and does
+ * not grow with the output.  On the board, formatting also runs newlib's
+ * slower vfprintf and, once the TX ring is full, waits for the UART (87 us
+ * per byte at 115200 baud); recording does neither.
+ */
+
+#define SERIAL_LOG_LEVEL_NONE   0
+#define SERIAL_LOG_LEVEL_ERROR  1
+#define SERIAL_LOG_LEVEL_WARN   2
+#define SERIAL_LOG_LEVEL_INFO   3
+#define SERIAL_LOG_LEVEL_DEBUG  4
+
+#ifndef SERIAL_LOG_LEVEL
+#define SERIAL_LOG_LEVEL        SERIAL_LOG_LEVEL_INFO
+#endif
+
+#define SERIAL_LOG_MODULE_SYSTEM    0x01    // no prefix
+#define SERIAL_LOG_MODULE_TLS       0x02    // [TLS]
+#define SERIAL_LOG_MODULE_AZUREIOT  0x04    // [AzureIoT]
+#define SERIAL_LOG_MODULE_DPS       0x08    // [DPS]
+
+#ifndef SERIAL_LOG_MODULES
+#define SERIAL_LOG_MODULES          0xFF
+#endif
+
+// ring size in bytes, a power of two
+#ifndef SERIAL_LOG_BUFFER_SIZE
+#define SERIAL_LOG_BUFFER_SIZE      4096
+#endif
+
+// longest string argument copied into a record; longer ones are cut and
+// end in "..."
+#ifndef SERIAL_LOG_STRING_MAX
+#define SERIAL_LOG_STRING_MAX       256
+#endif
+
+// start each line with the call-site time in seconds (us_ticker, wraps
+// after ~71 minutes)
+#ifndef SERIAL_LOG_TIMESTAMPS
+#define SERIAL_LOG_TIMESTAMPS       0
+#endif
+
+#define SERIAL_LOG(level, module, ...) \
+    do { \
+        if ((level) <= SERIAL_LOG_LEVEL && ((module) & SERIAL_LOG_MODULES)) \
+            serial_log_record((level), (module), __VA_ARGS__); \
+    } while (0)
+
+#define SERIAL_LOG_ERROR(module, ...)   SERIAL_LOG(SERIAL_LOG_LEVEL_ERROR, module, __VA_ARGS__)
+#define SERIAL_LOG_WARN(module, ...)    SERIAL_LOG(SERIAL_LOG_LEVEL_WARN, module, __VA_ARGS__)
+#define SERIAL_LOG_INFO(module, ...)    SERIAL_LOG(SERIAL_LOG_LEVEL_INFO, module, __VA_ARGS__)
+#define SERIAL_LOG_DEBUG(module, ...)   SERIAL_LOG(SERIAL_LOG_LEVEL_DEBUG, module, __VA_ARGS__)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/** Start the thread that prints logged records; called once at boot. */
+void serial_log_init(void);
+
+/** Record one log line; use the SERIAL_LOG_* macros instead. */
+void serial_log_record(uint8_t level, uint8_t module, const char *format, ...) __attribute__ ((format (printf, 3, 4)));
+void serial_log_vrecord(uint8_t level, uint8_t module, const char *format, va_list arg);
+
+/** Print everything recorded so far from the calling thread and wait until it
+ *  has been handed to the UART (does nothing from an interrupt or with
+ *  interrupts masked). */
+void serial_log_flush(void);
+
+/** Number of records dropped because the ring was full. */
+uint32_t serial_log_dropped(void);
+
+/** Log text as is, without prefix or line end (deferred like the above). */
 void serial_log(const char* msg);
 
-void serial_xlog(const char *format, ...);
+void serial_xlog(const char *format, ...) __attribute__ ((format (printf, 1, 2)));
 
 #ifdef __cplusplus
 }
@@ -5,12 +5,31 @@
 #include "mico.h"
 #include "SystemFunc.h"
 #include "SystemWeb.h"
+#include "SerialLog.h"
+#include "TLSSessionCache.h"
 
 void SystemReboot(void)
 {
+    // pending log lines and unsaved TLS sessions would be lost with the RAM
+    // they sit in
+    serial_log_flush();
+    TLSSessionCache_Flush();
     mico_system_reboot();
 }
 
+// replaces mbed's weak error(): the same message and halt, with the pending
+// log lines printed first
+extern "C" void error(const char* format, ...)
+{
+    serial_log_flush();
+
+    va_list arg;
+    va_start(arg, format);
+    mbed_error_vfprintf(format, arg);
+    va_end(arg);
+    exit(1);
+}
+
 void SystemStandby(int timeout)
 {
     MicoSystemStandBy(timeout);
@@ -9,6 +9,124 @@
 #include "SystemWiFi.h"
 #include "SystemTime.h"
 #include "DeviceConfig.h"
+#include "MemoryProfiler.h"
+#include "SystemTickCounter.h"
+#include "SystemFileSystem.h"
+#include "File.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Access point cache
+#define WIFI_CACHE_MAGIC    0x43494657  // "WFIC"
+#define WIFI_CACHE_VERSION  1
+
+// The access point and lease of the last successful connect
+typedef struct
+{
+    uint32_t magic;
+    uint8_t version;
+    uint8_t channel;
+    uint8_t security;           // nsapi_security_t
+    uint8_t reserved;
+    char ssid[WIFI_SSID_MAX_LEN + 1];
+    uint8_t bssid[6];
+    char ip[16];
+    char netmask[16];
+    char gateway[16];
+    char dns[16];
+} WiFiCache;
+
+static WiFiCache wifi_cache;
+static bool wifi_cache_valid = false;
+static wifi_connect_timing_t wifi_timing;
+
+static void wifi_cache_load(const char *wifiSsid)
+{
+    wifi_cache_valid = false;
+    mbed::FileSystem *fs = SystemFileSystem_GetFS();
+    if (fs == NULL)
+    {
+        return;
+    }
+
+    mbed::File f;
+    if (f.open(fs, WIFI_CACHE_FILE_NAME, O_RDONLY) != 0)
+    {
+        return;
+    }
+    ssize_t n = f.read(&wifi_cache, sizeof(wifi_cache));
+    f.close();
+
+    // a cache for another network (or firmware) is as good as none
+    wifi_cache_valid = n == (ssize_t)sizeof(wifi_cache) &&
+                       wifi_cache.magic == WIFI_CACHE_MAGIC && wifi_cache.version == WIFI_CACHE_VERSION &&
+                       wifi_cache.channel >= 1 && wifi_cache.channel <= 14 &&
+                       strncmp(wifi_cache.ssid, wifiSsid, sizeof(wifi_cache.ssid)) == 0;
+}
+
+// Records where the connect ended up; the flash is written only when that changed
+static void wifi_cache_save(const char *wifiSsid, nsapi_security_t security)
+{
+    LinkStatusTypeDef link;
+    IPStatusTypedef lease;
+    memset(&link, 0, sizeof(link));
+    memset(&lease, 0, sizeof(lease));
+    if (micoWlanGetLinkStatus(&link) != kNoErr || !link.is_connected || link.channel < 1 || link.channel > 14 ||
+        micoWlanGetIPStatus(&lease, Station) != kNoErr)
+    {
+        return;
+    }
+
+    WiFiCache c;
+    memset(&c, 0, sizeof(c));
+    c.magic = WIFI_CACHE_MAGIC;
+    c.version = WIFI_CACHE_VERSION;
+    c.channel = (uint8_t)link.channel;
+    c.security = (uint8_t)security;
+    strncpy(c.ssid, wifiSsid, WIFI_SSID_MAX_LEN);
+    memcpy(c.bssid, link.bssid, sizeof(c.bssid));
+    strncpy(c.ip, lease.ip, sizeof(c.ip) - 1);
+    strncpy(c.netmask, lease.mask, sizeof(c.netmask) - 1);
+    strncpy(c.gateway, lease.gate, sizeof(c.gateway) - 1);
+    strncpy(c.dns, lease.dns, sizeof(c.dns) - 1);
+
+    // the radio falls back to a full scan by itself when the channel is wrong
+    wifi_timing.channel = c.channel;
+    wifi_timing.fast = wifi_timing.fast && c.channel == wifi_cache.channel;
+    wifi_timing.same_ap = wifi_cache_valid && memcmp(c.bssid, wifi_cache.bssid, sizeof(c.bssid)) == 0;
+    wifi_timing.same_lease = wifi_cache_valid && strcmp(c.ip, wifi_cache.ip) == 0;
+    if (wifi_cache_valid && memcmp(&c, &wifi_cache, sizeof(c)) == 0)
+    {
+        return;
+    }
+
+    mbed::FileSystem *fs = SystemFileSystem_GetFS();
+    mbed::File f;
+    if (fs == NULL || f.open(fs, WIFI_CACHE_FILE_NAME, O_WRONLY | O_CREAT | O_TRUNC) != 0)
+    {
+        return;
+    }
+    if (f.write(&c, sizeof(c)) == (ssize_t)sizeof(c))
+    {
+        wifi_cache = c;
+        wifi_cache_valid = true;
+    }
+    f.close();
+}
+
+void SystemWiFiForgetAP(void)
+{
+    wifi_cache_valid = false;
+    mbed::FileSystem *fs = SystemFileSystem_GetFS();
+    if (fs != NULL)
+    {
+        fs->remove(WIFI_CACHE_FILE_NAME);
+    }
+}
+
+const wifi_connect_timing_t* SystemWiFiConnectTiming(void)
+{
+    return &wifi_timing;
+}
 
 //////////////////////////////////////////////////////////////////////////////////////////////
 // WiFi related functions
@@ -20,6 +138,7 @@ bool InitSystemWiFi(void)
     if (_defaultSystemNetwork == NULL)
     {
         _defaultSystemNetwork = (NetworkInterface*)new EMW10xxInterface();
+        mem_profile_name_new_threads("wifi");
     }
     
     return (_defaultSystemNetwork != NULL);
@@ -36,35 +155,100 @@ bool SystemWiFiConnect(void)
         return false;
     }
     
-    // Copy to local ssid for SystemWiFiSSID()
-    strncpy(ssid, wifiSsid, WIFI_SSID_MAX_LEN);
-    ssid[WIFI_SSID_MAX_LEN] = '\0';
-
-    ((EMW10xxInterface*)_defaultSystemNetwork)->set_interface(Station);
-    int ret = ((EMW10xxInterface*)_defaultSystemNetwork)->connect((char*)wifiSsid, wifiPwd, NSAPI_SECURITY_WPA_WPA2, 0);
-    if(ret != 0)
+    // SystemWiFiConnectTo() is quiet for WiFi.begin(); the system connect reports here
+    bool connected = SystemWiFiConnectTo(wifiSsid, wifiPwd);
+    if (wifi_timing.fast_ms > 0 && !wifi_timing.fast)
+    {
+        Serial.printf("INFO: Wi-Fi %s was not found on its cached channel, scanned.\r\n", ssid);
+    }
+    if (!connected)
     {
-      	Serial.printf("ERROR: Failed to connect Wi-Fi %s.\r\n", ssid);
+        Serial.printf("ERROR: Failed to connect Wi-Fi %s.\r\n", ssid);
         return false;
     }
+
+    Serial.printf("Wi-Fi %s connected in %lu ms (%s).\r\n", ssid, (unsigned long)wifi_timing.total_ms,
+                  wifi_timing.fast ? "cached channel" : "scan");
+    if (IsTimeSynced() == 0)
+    {
+        time_t t = time(NULL);
+        Serial.printf("Now is (UTC): %s\r\n", ctime(&t));
+    }
     else
     {
-        Serial.printf("Wi-Fi %s connected.\r\n", ssid);
-        
-        // Sync system from NTP time server
-        SyncTime();
-        if (IsTimeSynced() == 0)
+        Serial.println("Time sync failed");
+    }
+    return true;
+}
+
+bool SystemWiFiConnectTo(const char* wifiSsid, const char* wifiPwd)
+{
+    if (_defaultSystemNetwork == NULL || wifiSsid == NULL)
+    {
+        return false;
+    }
+    EMW10xxInterface *wifi = (EMW10xxInterface*)_defaultSystemNetwork;
+    nsapi_security_t security = NSAPI_SECURITY_WPA_WPA2;
+
+    // Copy to local ssid for SystemWiFiSSID()
+    strncpy(ssid, wifiSsid, WIFI_SSID_MAX_LEN);
+    ssid[WIFI_SSID_MAX_LEN] = '\0';
+
+    memset(&wifi_timing, 0, sizeof(wifi_timing));
+    uint64_t start = SystemTickCounterRead();
+    wifi_cache_load(wifiSsid);
+    uint64_t now = SystemTickCounterRead();
+    wifi_timing.cache_ms = (uint32_t)(now - start);
+
+    wifi->set_interface(Station);
+    int ret = -1;
+#if WIFI_FAST_CONNECT
+    if (wifi_cache_valid)
+    {
+        // directed connect: the driver joins on the cached channel instead of scanning all of them
+        wifi->set_credentials(wifiSsid, wifiPwd, (nsapi_security_t)wifi_cache.security);
+        wifi->set_channel(wifi_cache.channel);
+        ret = wifi->connect();
+        wifi->set_channel(0);
+        uint64_t end = SystemTickCounterRead();
+        wifi_timing.fast_ms = (uint32_t)(end - now);
+        now = end;
+        if (ret == 0)
         {
-            time_t t = time(NULL);
-            Serial.printf("Now is (UTC): %s\r\n", ctime(&t));
+            wifi_timing.fast = true;
+            security = (nsapi_security_t)wifi_cache.security;
         }
         else
         {
-            Serial.println("Time sync failed");
+            // the driver has already dropped the attempt
+            SystemWiFiForgetAP();
         }
-
-        return true;
     }
+#endif  // WIFI_FAST_CONNECT
+    if (ret != 0)
+    {
+        ret = wifi->connect(wifiSsid, wifiPwd, security, 0);
+        uint64_t end = SystemTickCounterRead();
+        wifi_timing.full_ms = (uint32_t)(end - now);
+        now = end;
+    }
+    if(ret != 0)
+    {
+        wifi_timing.total_ms = (uint32_t)(now - start);
+        return false;
+    }
+
+#if WIFI_FAST_CONNECT
+    wifi_cache_save(wifiSsid, security);
+#endif  // WIFI_FAST_CONNECT
+    wifi_timing.total_ms = (uint32_t)(SystemTickCounterRead() - start);
+    mem_profile_name_new_threads("wifi");
+    
+    // Sync system from NTP time server
+    now = SystemTickCounterRead();
+    SyncTime();
+    wifi_timing.time_sync_ms = (uint32_t)(SystemTickCounterRead() - now);
+    return true;
 }
 
 const char* SystemWiFiSSID(void)
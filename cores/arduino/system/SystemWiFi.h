@@ -6,12 +6,42 @@
 
 #include "mbed.h"
 
+// Join the last access point on its channel before falling back to a full scan
+#ifndef WIFI_FAST_CONNECT
+#define WIFI_FAST_CONNECT       1
+#endif
+
+// Last access point and DHCP lease, on the SFlash filesystem
+#ifndef WIFI_CACHE_FILE_NAME
+#define WIFI_CACHE_FILE_NAME    "/wifi.cache"
+#endif
+
+// Where the last SystemWiFiConnect() spent its time, in ms
+typedef struct
+{
+    uint32_t cache_ms;          // reading the cached access point
+    uint32_t fast_ms;           // connect on the cached channel, 0 if not tried
+    uint32_t full_ms;           // scan and connect, 0 if not needed
+    uint32_t total_ms;          // up to an IP address
+    uint32_t time_sync_ms;      // NTP, after total_ms
+    uint8_t channel;            // joined on, 0 if not known
+    bool fast;                  // joined on the cached channel
+    bool same_ap;               // the cached BSSID
+    bool same_lease;            // DHCP handed out the cached address
+} wifi_connect_timing_t;
+
 #ifdef __cplusplus
 extern "C"{
 #endif  // __cplusplus
 
 bool InitSystemWiFi(void);
+// Joins the configured network and reports on Serial how it went
 bool SystemWiFiConnect(void);
+// Same without printing anything, for WiFi.begin(); see SystemWiFiConnectTiming()
+bool SystemWiFiConnectTo(const char* ssid, const char* passphrase);
+const wifi_connect_timing_t* SystemWiFiConnectTiming(void);
+// Drop the cached access point, e.g. after moving the device to another network
+void SystemWiFiForgetAP(void);
 int SystemWiFiRSSI(void);
 const char* SystemWiFiSSID(void);
 NetworkInterface* WiFiInterface(void);
@@ -20,6 +20,7 @@
 #define ARDUINO_MAIN
 #include "Arduino.h"
 #include "Thread.h"
+#include "MemoryProfiler.h"
 
 static void arduino_main( void )
 {
@@ -37,4 +38,5 @@ void start_arduino ( void )
 {
     // Put arduino entries in a thread due to the small stack of the main thread (only 512 Bytes)
     arduino_thread.start(arduino_main);
+    mem_profile_name_thread((uint32_t)arduino_thread.gettid(), "arduino");
 }
\ No newline at end of file
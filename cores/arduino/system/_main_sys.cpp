@@ -8,6 +8,8 @@
 #include "mbed.h"
 #include "mbed_stats.h"
 #include "mico_system.h"
+#include "SerialLog.h"
+#include "MemoryProfiler.h"
 #include "SystemTickCounter.h"
 #include "SystemWeb.h"
 #include "SystemWiFi.h"
@@ -24,7 +26,11 @@ static bool Initialization(void)
     mbed_stats_heap_t heap_stats;
     mbed_stats_heap_get(&heap_stats);
 
+    // threads running so far are the RTOS ones
+    mem_profile_name_new_threads("system");
+
     mbed_lwip_init();
+    mem_profile_name_new_threads("lwip");
 
 #if defined(USBCON)
     USBDevice.attach();
@@ -37,6 +43,9 @@ static bool Initialization(void)
     // Initialize the system tickcounter
     SystemTickCounterInit();
 
+    // Start the thread that prints deferred log records
+    serial_log_init();
+
     // Initialize the OLED screen
     Screen.init();
 
@@ -8,6 +8,7 @@
 #include "mbedtls/md.h"
 #include "mbedtls/base64.h"
 #include <Arduino.h>
+#include "SerialLog.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -58,7 +59,7 @@ bool AzureIoT_GenerateSasToken(const char* resourceUri, const char* signingKey,
                                 uint32_t expiryTimeSeconds,
                                 char* tokenBuffer, size_t tokenBufferSize)
 {
-    Serial.println("[AzureIoT] Generating SAS token...");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Generating SAS token...");
 
     // URL-encode the resource URI
     char encodedUri[256];
@@ -75,8 +76,7 @@ bool AzureIoT_GenerateSasToken(const char* resourceUri, const char* signingKey,
                                      (const unsigned char*)signingKey, strlen(signingKey));
     if (ret != 0)
     {
-        Serial.print("[AzureIoT] Failed to decode key! Error: ");
-        Serial.println(ret);
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Failed to decode key! Error: %d", ret);
         return false;
     }
 
@@ -86,7 +86,7 @@ bool AzureIoT_GenerateSasToken(const char* resourceUri, const char* signingKey,
                               (const unsigned char*)signatureString, strlen(signatureString),
                               hmacResult, sizeof(hmacResult)))
     {
-        Serial.println("[AzureIoT] Failed to compute HMAC!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Failed to compute HMAC!");
         return false;
     }
 
@@ -97,7 +97,7 @@ bool AzureIoT_GenerateSasToken(const char* resourceUri, const char* signingKey,
                                  hmacResult, sizeof(hmacResult));
     if (ret != 0)
     {
-        Serial.println("[AzureIoT] Failed to base64 encode signature!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Failed to base64 encode signature!");
         return false;
     }
     base64Signature[base64Len] = '\0';
@@ -111,14 +111,14 @@ bool AzureIoT_GenerateSasToken(const char* resourceUri, const char* signingKey,
         "SharedAccessSignature sr=%s&sig=%s&se=%lu",
         encodedUri, encodedSignature, (unsigned long)expiryTimeSeconds);
 
-    Serial.println("[AzureIoT] SAS token generated successfully");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "SAS token generated successfully");
     return true;
 }
 
 bool AzureIoT_DeriveGroupKey(const char* groupKey, const char* registrationId,
                               char* derivedKeyBuffer, size_t derivedKeyBufferSize)
 {
-    Serial.println("[DPS] Deriving device key from group key...");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Deriving device key from group key...");
 
     // Decode the base64-encoded group key
     unsigned char decodedGroupKey[64];
@@ -127,7 +127,7 @@ bool AzureIoT_DeriveGroupKey(const char* groupKey, const char* registrationId,
                                      (const unsigned char*)groupKey, strlen(groupKey));
     if (ret != 0)
     {
-        Serial.println("[DPS] Failed to decode group key!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Failed to decode group key!");
         return false;
     }
 
@@ -137,7 +137,7 @@ bool AzureIoT_DeriveGroupKey(const char* groupKey, const char* registrationId,
                               (const unsigned char*)registrationId, strlen(registrationId),
                               hmacResult, sizeof(hmacResult)))
     {
-        Serial.println("[DPS] Failed to derive device key!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Failed to derive device key!");
         return false;
     }
 
@@ -148,20 +148,20 @@ bool AzureIoT_DeriveGroupKey(const char* groupKey, const char* registrationId,
                                  hmacResult, sizeof(hmacResult));
     if (ret != 0)
     {
-        Serial.println("[DPS] Failed to encode derived key!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Failed to encode derived key!");
         return false;
     }
     base64Key[base64Len] = '\0';
 
     if (base64Len >= derivedKeyBufferSize)
     {
-        Serial.println("[DPS] Derived key buffer too small!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Derived key buffer too small!");
         return false;
     }
 
     strncpy(derivedKeyBuffer, (const char*)base64Key, derivedKeyBufferSize - 1);
     derivedKeyBuffer[derivedKeyBufferSize - 1] = '\0';
 
-    Serial.println("[DPS] Device key derived successfully");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Device key derived successfully");
     return true;
 }
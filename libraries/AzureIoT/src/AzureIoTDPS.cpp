@@ -7,6 +7,7 @@
 #include "AzureIoTDPS.h"
 #include "AzureIoTConfig.h"
 #include <Arduino.h>
+#include "SerialLog.h"
 #include <PubSubClient.h>
 #include "AZ3166WiFi.h"
 
@@ -49,31 +50,27 @@ static void dpsCallback(char* topic, byte* payload, unsigned int length)
     memcpy(message, payload, copyLen);
     message[copyLen] = '\0';
 
-    Serial.println("[DPS] Response received");
-    Serial.print("[DPS] Topic: ");
-    Serial.println(topic);
-    Serial.print("[DPS] Payload: ");
-    Serial.println(message);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Response received");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Topic: %s", topic);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Payload: %s", message);
 
     // Parse status from topic: $dps/registrations/res/{status}/?$rid={rid}
     const char* statusStr = topic + strlen("$dps/registrations/res/");
     int status = atoi(statusStr);
     s_responseStatus = status;
 
-    Serial.print("[DPS] Status: ");
-    Serial.println(status);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Status: %d", status);
 
     if (status == 202)
     {
         // Registration in progress - extract operationId
         if (jsonExtractString(message, "operationId", s_operationId, sizeof(s_operationId)))
         {
-            Serial.print("[DPS] Operation ID: ");
-            Serial.println(s_operationId);
+            SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Operation ID: %s", s_operationId);
         }
         else
         {
-            Serial.println("[DPS] Error: Could not extract operationId!");
+            SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Error: Could not extract operationId!");
         }
     }
     else if (status == 200)
@@ -81,12 +78,11 @@ static void dpsCallback(char* topic, byte* payload, unsigned int length)
         // Registration complete - extract assigned hub and device ID
         if (jsonExtractString(message, "assignedHub", s_assignedHub, sizeof(s_assignedHub)))
         {
-            Serial.print("[DPS] Assigned Hub: ");
-            Serial.println(s_assignedHub);
+            SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Assigned Hub: %s", s_assignedHub);
         }
         else
         {
-            Serial.println("[DPS] Error: Could not extract assignedHub!");
+            SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Error: Could not extract assignedHub!");
             return;
         }
 
@@ -97,16 +93,14 @@ static void dpsCallback(char* topic, byte* payload, unsigned int length)
         }
         else
         {
-            Serial.print("[DPS] Assigned Device ID: ");
-            Serial.println(s_assignedDeviceId);
+            SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Assigned Device ID: %s", s_assignedDeviceId);
         }
 
         s_assigned = true;
     }
     else
     {
-        Serial.print("[DPS] Registration failed with status: ");
-        Serial.println(status);
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Registration failed with status: %d", status);
     }
 }
 
@@ -116,13 +110,10 @@ bool AzureIoT_DPSRegister(WiFiClientSecure& wifiClient,
                             char* assignedHub, size_t hubSize,
                             char* assignedDeviceId, size_t deviceIdSize)
 {
-    Serial.println("[DPS] Starting device provisioning...");
-    Serial.print("[DPS] Endpoint: ");
-    Serial.println(endpoint);
-    Serial.print("[DPS] Scope ID: ");
-    Serial.println(scopeId);
-    Serial.print("[DPS] Registration ID: ");
-    Serial.println(registrationId);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Starting device provisioning...");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Endpoint: %s", endpoint);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Scope ID: %s", scopeId);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Registration ID: %s", registrationId);
 
     // Configure TLS CA cert for DPS
     wifiClient.setCACert(AZURE_IOT_ROOT_CA);
@@ -147,8 +138,7 @@ bool AzureIoT_DPSRegister(WiFiClientSecure& wifiClient,
     s_operationId[0] = '\0';
 
     // Connect to DPS endpoint
-    Serial.print("[DPS] Connecting to ");
-    Serial.println(endpoint);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Connecting to %s", endpoint);
 
     bool connected;
     if (password != NULL)
@@ -162,17 +152,16 @@ bool AzureIoT_DPSRegister(WiFiClientSecure& wifiClient,
 
     if (!connected)
     {
-        Serial.println("[DPS] Failed to connect to DPS!");
-        Serial.print("[DPS] MQTT state: ");
-        Serial.println(dpsMqtt.state());
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Failed to connect to DPS!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "MQTT state: %d", dpsMqtt.state());
         return false;
     }
-    Serial.println("[DPS] Connected to DPS");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Connected to DPS");
 
     // Subscribe to DPS response topic
     if (!dpsMqtt.subscribe("$dps/registrations/res/#"))
     {
-        Serial.println("[DPS] Failed to subscribe to response topic!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Failed to subscribe to response topic!");
         dpsMqtt.disconnect();
         return false;
     }
@@ -187,10 +176,10 @@ bool AzureIoT_DPSRegister(WiFiClientSecure& wifiClient,
     snprintf(registerPayload, sizeof(registerPayload),
         "{\"registrationId\":\"%s\"}", registrationId);
 
-    Serial.println("[DPS] Sending registration request...");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Sending registration request...");
     if (!dpsMqtt.publish(registerTopic, registerPayload))
     {
-        Serial.println("[DPS] Failed to send registration request!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Failed to send registration request!");
         dpsMqtt.disconnect();
         return false;
     }
@@ -210,7 +199,7 @@ bool AzureIoT_DPSRegister(WiFiClientSecure& wifiClient,
 
         if (s_responseStatus == 0)
         {
-            Serial.println("[DPS] Timeout waiting for response");
+            SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Timeout waiting for response");
             retries++;
             continue;
         }
@@ -222,9 +211,7 @@ bool AzureIoT_DPSRegister(WiFiClientSecure& wifiClient,
 
         if (s_responseStatus == 202 && s_operationId[0] != '\0')
         {
-            Serial.print("[DPS] Polling status (attempt ");
-            Serial.print(retries + 1);
-            Serial.println(")...");
+            SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Polling status (attempt %d)...", retries + 1);
 
             delay(DPS_POLL_INTERVAL);
 
@@ -239,8 +226,7 @@ bool AzureIoT_DPSRegister(WiFiClientSecure& wifiClient,
         }
         else if (s_responseStatus != 200)
         {
-            Serial.print("[DPS] Registration failed with status: ");
-            Serial.println(s_responseStatus);
+            SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Registration failed with status: %d", s_responseStatus);
             dpsMqtt.disconnect();
             return false;
         }
@@ -253,7 +239,7 @@ bool AzureIoT_DPSRegister(WiFiClientSecure& wifiClient,
 
     if (!s_assigned)
     {
-        Serial.println("[DPS] Registration timed out!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Registration timed out!");
         return false;
     }
 
@@ -271,15 +257,12 @@ bool AzureIoT_DPSRegister(WiFiClientSecure& wifiClient,
         // Use registration ID as device ID if DPS didn't return one
         strncpy(assignedDeviceId, registrationId, deviceIdSize - 1);
         assignedDeviceId[deviceIdSize - 1] = '\0';
-        Serial.print("[DPS] Using registration ID as Device ID: ");
-        Serial.println(assignedDeviceId);
+        SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Using registration ID as Device ID: %s", assignedDeviceId);
     }
 
-    Serial.println("[DPS] Device provisioned successfully!");
-    Serial.print("[DPS] Assigned to: ");
-    Serial.println(assignedHub);
-    Serial.print("[DPS] Device ID: ");
-    Serial.println(assignedDeviceId);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Device provisioned successfully!");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Assigned to: %s", assignedHub);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Device ID: %s", assignedDeviceId);
 
     return true;
 }
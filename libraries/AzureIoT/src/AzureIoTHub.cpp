@@ -10,6 +10,8 @@
 #include "AzureIoTDPS.h"
 #include "DeviceConfig.h"
 #include "SystemTime.h"
+#include "SerialLog.h"
+#include "TLSCertStore.h"
 
 #include <PubSubClient.h>
 #include "AZ3166WiFi.h"
@@ -31,8 +33,13 @@ static char registrationId[128];
 #endif
 
 #if CONNECTION_PROFILE == PROFILE_DPS_CERT || CONNECTION_PROFILE == PROFILE_IOTHUB_CERT
-static char deviceCertPem[2700];
-static char privateKeyPem[1300];
+// PEM as read from the secure element, only needed until it is decoded
+#define DEVICE_CERT_PEM_MAX 2700
+
+static const unsigned char* deviceCertDer = NULL;
+static size_t deviceCertDerLen = 0;
+static const unsigned char* privateKeyDer = NULL;
+static size_t privateKeyDerLen = 0;
 #endif
 
 #if CONNECTION_PROFILE == PROFILE_IOTHUB_SAS || CONNECTION_PROFILE == PROFILE_DPS_SAS || CONNECTION_PROFILE == PROFILE_DPS_SAS_GROUP
@@ -70,21 +77,19 @@ static bool loadConnectionString()
     const char* cs = DeviceConfig_GetConnectionString();
     if (cs == NULL || cs[0] == '\0')
     {
-        Serial.println("[AzureIoT] Error: Connection string not configured!");
-        Serial.println("[AzureIoT] Use: set_az_iothub <connection_string>");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Error: Connection string not configured!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Use: set_az_iothub <connection_string>");
         return false;
     }
     strncpy(connectionString, cs, sizeof(connectionString) - 1);
     connectionString[sizeof(connectionString) - 1] = '\0';
-    Serial.print("[AzureIoT] Connection string loaded (");
-    Serial.print(strlen(connectionString));
-    Serial.println(" bytes)");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Connection string loaded (%u bytes)", (unsigned int)strlen(connectionString));
 
     // Parse HostName
     const char* hostStart = strstr(connectionString, "HostName=");
     if (hostStart == NULL)
     {
-        Serial.println("[AzureIoT] Error: HostName not found!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Error: HostName not found!");
         return false;
     }
     hostStart += 9;
@@ -93,7 +98,7 @@ static bool loadConnectionString()
     size_t hostLen = hostEnd - hostStart;
     if (hostLen >= sizeof(iotHubHostname))
     {
-        Serial.println("[AzureIoT] Error: HostName too long!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Error: HostName too long!");
         return false;
     }
     strncpy(iotHubHostname, hostStart, hostLen);
@@ -103,7 +108,7 @@ static bool loadConnectionString()
     const char* deviceStart = strstr(connectionString, "DeviceId=");
     if (deviceStart == NULL)
     {
-        Serial.println("[AzureIoT] Error: DeviceId not found!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Error: DeviceId not found!");
         return false;
     }
     deviceStart += 9;
@@ -112,7 +117,7 @@ static bool loadConnectionString()
     size_t deviceLen = deviceEnd - deviceStart;
     if (deviceLen >= sizeof(deviceId))
     {
-        Serial.println("[AzureIoT] Error: DeviceId too long!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Error: DeviceId too long!");
         return false;
     }
     strncpy(deviceId, deviceStart, deviceLen);
@@ -123,7 +128,7 @@ static bool loadConnectionString()
     const char* keyStart = strstr(connectionString, "SharedAccessKey=");
     if (keyStart == NULL)
     {
-        Serial.println("[AzureIoT] Error: SharedAccessKey not found!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Error: SharedAccessKey not found!");
         return false;
     }
     keyStart += 16;
@@ -132,17 +137,15 @@ static bool loadConnectionString()
     size_t keyLen = keyEnd - keyStart;
     if (keyLen >= sizeof(deviceKey))
     {
-        Serial.println("[AzureIoT] Error: SharedAccessKey too long!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Error: SharedAccessKey too long!");
         return false;
     }
     strncpy(deviceKey, keyStart, keyLen);
     deviceKey[keyLen] = '\0';
 #endif
 
-    Serial.print("  HostName: ");
-    Serial.println(iotHubHostname);
-    Serial.print("  DeviceId: ");
-    Serial.println(deviceId);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "  HostName: %s", iotHubHostname);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "  DeviceId: %s", deviceId);
 
     return true;
 }
@@ -155,8 +158,8 @@ static bool loadDPSSettings()
     const char* ep = DeviceConfig_GetDpsEndpoint();
     if (ep == NULL || ep[0] == '\0')
     {
-        Serial.println("[DPS] Error: DPS endpoint not configured!");
-        Serial.println("[DPS] Use: set_dps_endpoint global.azure-devices-provisioning.net");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Error: DPS endpoint not configured!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Use: set_dps_endpoint global.azure-devices-provisioning.net");
         return false;
     }
     strncpy(dpsEndpoint, ep, sizeof(dpsEndpoint) - 1);
@@ -165,8 +168,8 @@ static bool loadDPSSettings()
     const char* sid = DeviceConfig_GetScopeId();
     if (sid == NULL || sid[0] == '\0')
     {
-        Serial.println("[DPS] Error: Scope ID not configured!");
-        Serial.println("[DPS] Use: set_scopeid <scope_id>");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Error: Scope ID not configured!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Use: set_scopeid <scope_id>");
         return false;
     }
     strncpy(scopeId, sid, sizeof(scopeId) - 1);
@@ -175,79 +178,111 @@ static bool loadDPSSettings()
     const char* rid = DeviceConfig_GetRegistrationId();
     if (rid == NULL || rid[0] == '\0')
     {
-        Serial.println("[DPS] Error: Registration ID not configured!");
-        Serial.println("[DPS] Use: set_regid <registration_id>");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Error: Registration ID not configured!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Use: set_regid <registration_id>");
         return false;
     }
     strncpy(registrationId, rid, sizeof(registrationId) - 1);
     registrationId[sizeof(registrationId) - 1] = '\0';
 
-    Serial.print("[DPS] Endpoint: ");
-    Serial.println(dpsEndpoint);
-    Serial.print("[DPS] Scope ID: ");
-    Serial.println(scopeId);
-    Serial.print("[DPS] Registration ID: ");
-    Serial.println(registrationId);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Endpoint: %s", dpsEndpoint);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Scope ID: %s", scopeId);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_DPS, "Registration ID: %s", registrationId);
 
     return true;
 }
 #endif // DPS profiles
 
 #if CONNECTION_PROFILE == PROFILE_DPS_CERT || CONNECTION_PROFILE == PROFILE_IOTHUB_CERT
-// Load and parse device certificate and private key from EEPROM
-static bool loadAndParseCert()
+// Decode the device certificate and private key from EEPROM into the certificate store
+static bool importCert()
 {
-    if (!DeviceConfig_IsSettingAvailable(SETTING_DEVICE_CERT))
+    char* deviceCertPem = (char*)malloc(DEVICE_CERT_PEM_MAX);
+    if (deviceCertPem == NULL)
     {
-        Serial.println("[AzureIoT] Error: Device certificate not available!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Error: No memory for device certificate!");
         return false;
     }
-    DeviceConfig_Read(SETTING_DEVICE_CERT, deviceCertPem, sizeof(deviceCertPem));
+
+    bool ok = false;
+    DeviceConfig_Read(SETTING_DEVICE_CERT, deviceCertPem, DEVICE_CERT_PEM_MAX);
     if (deviceCertPem[0] == '\0')
     {
-        Serial.println("[AzureIoT] Error: Device certificate not configured!");
-        Serial.println("[AzureIoT] Use: set_devicecert <pem_cert_and_key>");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Error: Device certificate not configured!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Use: set_devicecert <pem_cert_and_key>");
+        free(deviceCertPem);
         return false;
     }
 
     // Find end of certificate
     const char* endMarker = "-----END CERTIFICATE-----";
     char* endPos = strstr(deviceCertPem, endMarker);
+    const char* keyStart = NULL;
     if (endPos == NULL)
     {
-        Serial.println("[AzureIoT] Error: Certificate end marker not found!");
-        return false;
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Error: Certificate end marker not found!");
     }
-    endPos += strlen(endMarker);
-    if (*endPos == '\r') endPos++;
-    if (*endPos == '\n') endPos++;
+    else
+    {
+        endPos += strlen(endMarker);
+        if (*endPos == '\r') endPos++;
+        if (*endPos == '\n') endPos++;
 
-    // Find private key start
-    const char* keyStart = strstr(endPos, "-----BEGIN");
-    if (keyStart == NULL)
+        // Find private key start
+        keyStart = strstr(endPos, "-----BEGIN");
+        if (keyStart == NULL)
+        {
+            SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Error: Private key not found in certificate data!");
+        }
+    }
+
+    if (keyStart != NULL)
     {
-        Serial.println("[AzureIoT] Error: Private key not found in certificate data!");
-        return false;
+        // Key first, then null-terminate the cert portion in place
+        if (TLSCertStore_Import(TLS_CERT_STORE_CLIENT_KEY, keyStart) < 0)
+        {
+            SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Error: Private key could not be decoded!");
+        }
+        else
+        {
+            *endPos = '\0';
+            if (TLSCertStore_Import(TLS_CERT_STORE_CLIENT_CERT, deviceCertPem) < 0)
+            {
+                SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Error: Certificate could not be decoded!");
+                TLSCertStore_Erase(TLS_CERT_STORE_CLIENT_KEY);
+            }
+            else
+            {
+                ok = true;
+            }
+        }
     }
 
-    // Copy private key to separate buffer
-    size_t keyLen = strlen(keyStart);
-    if (keyLen >= sizeof(privateKeyPem))
+    free(deviceCertPem);
+    return ok;
+}
+
+// Load the device certificate and private key, decoding them on the first boot after provisioning
+static bool loadAndParseCert()
+{
+    if (!DeviceConfig_IsSettingAvailable(SETTING_DEVICE_CERT))
     {
-        Serial.println("[AzureIoT] Error: Private key too long!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Error: Device certificate not available!");
         return false;
     }
-    strncpy(privateKeyPem, keyStart, sizeof(privateKeyPem) - 1);
-    privateKeyPem[sizeof(privateKeyPem) - 1] = '\0';
 
-    // Null-terminate cert portion in-place (key already copied)
-    char* certEnd = strstr(deviceCertPem, endMarker);
-    certEnd += strlen(endMarker);
-    if (*certEnd == '\r') certEnd++;
-    if (*certEnd == '\n') certEnd++;
-    *certEnd = '\0';
+    deviceCertDer = TLSCertStore_Get(TLS_CERT_STORE_CLIENT_CERT, &deviceCertDerLen);
+    privateKeyDer = TLSCertStore_Get(TLS_CERT_STORE_CLIENT_KEY, &privateKeyDerLen);
+    if (deviceCertDer == NULL || privateKeyDer == NULL)
+    {
+        if (!importCert()) return false;
+        deviceCertDer = TLSCertStore_Get(TLS_CERT_STORE_CLIENT_CERT, &deviceCertDerLen);
+        privateKeyDer = TLSCertStore_Get(TLS_CERT_STORE_CLIENT_KEY, &privateKeyDerLen);
+        if (deviceCertDer == NULL || privateKeyDer == NULL) return false;
+    }
 
-    Serial.println("[AzureIoT] Certificate and key parsed successfully");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Certificate (%u bytes) and key (%u bytes) loaded",
+                    (unsigned int)deviceCertDerLen, (unsigned int)privateKeyDerLen);
     return true;
 }
 #endif // PROFILE_DPS_CERT || PROFILE_IOTHUB_CERT
@@ -256,20 +291,19 @@ static bool loadAndParseCert()
 // Sync time via NTP and get expiry timestamp
 static uint32_t syncTimeAndGetExpiry()
 {
-    Serial.println("[AzureIoT] Syncing time via NTP...");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Syncing time via NTP...");
     SyncTime();
 
     uint32_t expiryTime;
     if (IsTimeSynced() == 0)
     {
         time_t epochTime = time(NULL);
-        Serial.print("[AzureIoT] Time synced, epoch: ");
-        Serial.println((unsigned long)epochTime);
+        SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Time synced, epoch: %lu", (unsigned long)epochTime);
         expiryTime = (uint32_t)epochTime + SAS_TOKEN_DURATION;
     }
     else
     {
-        Serial.println("[AzureIoT] NTP failed, using fallback expiry");
+        SERIAL_LOG_WARN(SERIAL_LOG_MODULE_AZUREIOT, "NTP failed, using fallback expiry");
         expiryTime = 1770076800;
     }
     return expiryTime;
@@ -292,19 +326,15 @@ static void mqttCallback(char* topic, byte* payload, unsigned int length)
     memcpy(messageContent, payload, copyLength);
     messageContent[copyLength] = '\0';
 
-    Serial.println();
-    Serial.println("[AzureIoT] ======================================");
-    Serial.print("[AzureIoT] Message on: ");
-    Serial.println(topic);
-    Serial.print("[AzureIoT] Payload (");
-    Serial.print(length);
-    Serial.println(" bytes)");
-    Serial.println("[AzureIoT] ======================================");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "======================================");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Message on: %s", topic);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Payload (%u bytes)", length);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "======================================");
 
     // Route: C2D messages
     if (strstr(topic, "/messages/devicebound/") != NULL)
     {
-        Serial.println("[AzureIoT] -> C2D Message");
+        SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "-> C2D Message");
         if (c2dCallback != NULL)
         {
             c2dCallback(topic, messageContent, length);
@@ -314,13 +344,12 @@ static void mqttCallback(char* topic, byte* payload, unsigned int length)
     else if (strncmp(topic, "$iothub/twin/res/", 17) == 0)
     {
         int status = atoi(topic + 17);
-        Serial.print("[AzureIoT] -> Twin Response, status: ");
-        Serial.println(status);
+        SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "-> Twin Response, status: %d", status);
 
         if (status == 200 && twinGetPending)
         {
             twinGetPending = false;
-            Serial.println("[AzureIoT] Full Device Twin received");
+            SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Full Device Twin received");
             if (twinReceivedCallback != NULL)
             {
                 twinReceivedCallback(messageContent);
@@ -328,12 +357,11 @@ static void mqttCallback(char* topic, byte* payload, unsigned int length)
         }
         else if (status == 204)
         {
-            Serial.println("[AzureIoT] Reported properties accepted");
+            SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Reported properties accepted");
         }
         else if (status != 200)
         {
-            Serial.print("[AzureIoT] Twin operation failed: ");
-            Serial.println(status);
+            SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Twin operation failed: %d", status);
         }
     }
     // Route: Desired Property Update
@@ -346,8 +374,7 @@ static void mqttCallback(char* topic, byte* payload, unsigned int length)
             version = atoi(versionStart + 9);
         }
 
-        Serial.print("[AzureIoT] -> Desired Properties, version: ");
-        Serial.println(version);
+        SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "-> Desired Properties, version: %d", version);
 
         if (desiredPropsCallback != NULL)
         {
@@ -356,7 +383,7 @@ static void mqttCallback(char* topic, byte* payload, unsigned int length)
     }
     else
     {
-        Serial.println("[AzureIoT] -> Unknown message type");
+        SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "-> Unknown message type");
     }
 }
 
@@ -364,9 +391,8 @@ static void mqttCallback(char* topic, byte* payload, unsigned int length)
 
 bool azureIoTInit()
 {
-    Serial.println("[AzureIoT] Initializing...");
-    Serial.print("[AzureIoT] Profile: ");
-    Serial.println(DeviceConfig_GetProfileName());
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Initializing...");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Profile: %s", DeviceConfig_GetProfileName());
 
 #if CONNECTION_PROFILE == PROFILE_IOTHUB_SAS
     // ===== IoT Hub SAS: Load connection string, generate SAS token =====
@@ -380,8 +406,8 @@ bool azureIoTInit()
     if (!loadConnectionString()) return false;
     if (!loadAndParseCert()) return false;
 
-    wifiClient.setCertificate(deviceCertPem);
-    wifiClient.setPrivateKey(privateKeyPem);
+    wifiClient.setCertificate(deviceCertDer, deviceCertDerLen);
+    wifiClient.setPrivateKey(privateKeyDer, privateKeyDerLen);
 
 #elif CONNECTION_PROFILE == PROFILE_DPS_SAS || CONNECTION_PROFILE == PROFILE_DPS_SAS_GROUP
     // ===== DPS SAS: Provision with symmetric key, then connect =====
@@ -391,8 +417,8 @@ bool azureIoTInit()
     const char* sk = DeviceConfig_GetSymmetricKey();
     if (sk == NULL || sk[0] == '\0')
     {
-        Serial.println("[DPS] Error: Symmetric key not configured!");
-        Serial.println("[DPS] Use: set_symkey <key>");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Error: Symmetric key not configured!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Use: set_symkey <key>");
         return false;
     }
     strncpy(symmetricKey, sk, sizeof(symmetricKey) - 1);
@@ -415,7 +441,7 @@ bool azureIoTInit()
         snprintf(dpsResourceUri, sizeof(dpsResourceUri), "%s/registrations/%s", scopeId, registrationId);
         if (!AzureIoT_GenerateSasToken(dpsResourceUri, symmetricKey, expiryTime, dpsSasToken, sizeof(dpsSasToken)))
         {
-            Serial.println("[DPS] Failed to generate SAS token!");
+            SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "Failed to generate SAS token!");
             return false;
         }
         // DPS requires skn=registration in the SAS token
@@ -438,8 +464,8 @@ bool azureIoTInit()
     if (!loadDPSSettings()) return false;
     if (!loadAndParseCert()) return false;
 
-    wifiClient.setCertificate(deviceCertPem);
-    wifiClient.setPrivateKey(privateKeyPem);
+    wifiClient.setCertificate(deviceCertDer, deviceCertDerLen);
+    wifiClient.setPrivateKey(privateKeyDer, privateKeyDerLen);
 
     if (!AzureIoT_DPSRegister(wifiClient, dpsEndpoint, scopeId, registrationId, NULL,
                                 iotHubHostname, sizeof(iotHubHostname), deviceId, sizeof(deviceId)))
@@ -461,22 +487,18 @@ bool azureIoTInit()
     snprintf(c2dTopic, sizeof(c2dTopic),
         "devices/%s/messages/devicebound/#", deviceId);
 
-    Serial.println("[AzureIoT] Configuration:");
-    Serial.print("  Hub: ");
-    Serial.println(iotHubHostname);
-    Serial.print("  Device: ");
-    Serial.println(deviceId);
-    Serial.print("  Username: ");
-    Serial.println(mqttUsername);
-    Serial.print("  D2C Topic: ");
-    Serial.println(telemetryTopic);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Configuration:");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "  Hub: %s", iotHubHostname);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "  Device: %s", deviceId);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "  Username: %s", mqttUsername);
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "  D2C Topic: %s", telemetryTopic);
 
     // Configure TLS for IoT Hub
-    Serial.println("[AzureIoT] Configuring TLS...");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Configuring TLS...");
     wifiClient.setCACert(AZURE_IOT_ROOT_CA);
 
     isInitialized = true;
-    Serial.println("[AzureIoT] Initialization complete");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Initialization complete");
     return true;
 }
 
@@ -484,11 +506,11 @@ bool azureIoTConnect()
 {
     if (!isInitialized)
     {
-        Serial.println("[AzureIoT] Not initialized!");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Not initialized!");
         return false;
     }
 
-    Serial.println("[AzureIoT] Connecting to IoT Hub...");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Connecting to IoT Hub...");
 
     mqttClient.setServer(iotHubHostname, MQTT_PORT);
     mqttClient.setCallback(mqttCallback);
@@ -499,8 +521,7 @@ bool azureIoTConnect()
     int retries = 0;
     while (!mqttClient.connected() && retries < 5)
     {
-        Serial.print("[AzureIoT] Attempt ");
-        Serial.println(retries + 1);
+        SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Attempt %d", retries + 1);
 
 #if CONNECTION_PROFILE == PROFILE_DPS_CERT || CONNECTION_PROFILE == PROFILE_IOTHUB_CERT
         if (mqttClient.connect(deviceId, mqttUsername, ""))
@@ -509,7 +530,7 @@ bool azureIoTConnect()
 #endif
         {
             isConnected = true;
-            Serial.println("[AzureIoT] Connected!");
+            SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Connected!");
 
             bool subOk = true;
             subOk &= mqttClient.subscribe(c2dTopic);
@@ -517,24 +538,23 @@ bool azureIoTConnect()
             subOk &= mqttClient.subscribe("$iothub/twin/PATCH/properties/desired/#");
 
             if (subOk)
-                Serial.println("[AzureIoT] Subscribed to all topics");
+                SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Subscribed to all topics");
             else
-                Serial.println("[AzureIoT] Warning: Some subscriptions failed");
+                SERIAL_LOG_WARN(SERIAL_LOG_MODULE_AZUREIOT, "Warning: Some subscriptions failed");
 
             return true;
         }
         else
         {
             int state = mqttClient.state();
-            Serial.print("[AzureIoT] Failed, state: ");
-            Serial.println(state);
+            SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Failed, state: %d", state);
             retries++;
             delay(3000);
         }
     }
 
     isConnected = false;
-    Serial.println("[AzureIoT] Connection failed after retries");
+    SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Connection failed after retries");
     return false;
 }
 
@@ -550,7 +570,7 @@ void azureIoTLoop()
     if (!mqttClient.connected())
     {
         isConnected = false;
-        Serial.println("[AzureIoT] Disconnected, attempting reconnect...");
+        SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Disconnected, attempting reconnect...");
         azureIoTConnect();
     }
 
@@ -576,7 +596,7 @@ bool azureIoTSendTelemetry(const char* payload, const char* properties)
 {
     if (!azureIoTIsConnected())
     {
-        Serial.println("[AzureIoT] Cannot send: not connected");
+        SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Cannot send: not connected");
         return false;
     }
 
@@ -592,9 +612,9 @@ bool azureIoTSendTelemetry(const char* payload, const char* properties)
 
     bool success = mqttClient.publish(topic, payload);
     if (success)
-        Serial.println("[AzureIoT] Telemetry sent");
+        SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Telemetry sent");
     else
-        Serial.println("[AzureIoT] Telemetry send failed");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Telemetry send failed");
     return success;
 }
 
@@ -602,7 +622,7 @@ void azureIoTRequestTwin()
 {
     if (!azureIoTIsConnected())
     {
-        Serial.println("[AzureIoT] Cannot request twin: not connected");
+        SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Cannot request twin: not connected");
         return;
     }
 
@@ -612,10 +632,10 @@ void azureIoTRequestTwin()
     twinGetPending = true;
 
     if (mqttClient.publish(topic, ""))
-        Serial.println("[AzureIoT] Twin GET request sent");
+        SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Twin GET request sent");
     else
     {
-        Serial.println("[AzureIoT] Twin GET request failed");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Twin GET request failed");
         twinGetPending = false;
     }
 }
@@ -624,7 +644,7 @@ void azureIoTUpdateReportedProperties(const char* jsonPayload)
 {
     if (!azureIoTIsConnected())
     {
-        Serial.println("[AzureIoT] Cannot update reported: not connected");
+        SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Cannot update reported: not connected");
         return;
     }
 
@@ -633,9 +653,9 @@ void azureIoTUpdateReportedProperties(const char* jsonPayload)
         "$iothub/twin/PATCH/properties/reported/?$rid=%d", ++twinRequestId);
 
     if (mqttClient.publish(topic, jsonPayload))
-        Serial.println("[AzureIoT] Reported properties sent");
+        SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "Reported properties sent");
     else
-        Serial.println("[AzureIoT] Reported properties send failed");
+        SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_AZUREIOT, "Reported properties send failed");
 }
 
 const char* azureIoTGetDeviceId()
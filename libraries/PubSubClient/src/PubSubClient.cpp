@@ -7,6 +7,7 @@
 
 #include "PubSubClient.h"
 #include "Arduino.h"
+#include "MemoryProfiler.h"
 
 PubSubClient::PubSubClient() {
     this->_state = MQTT_DISCONNECTED;
@@ -159,7 +160,8 @@ PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGN
 }
 
 PubSubClient::~PubSubClient() {
-  free(this->buffer);
+  mem_profile_free(this->buffer);
+  mem_profile_free(this->rxBuffer);
 }
 
 boolean PubSubClient::connect(const char *id) {
@@ -195,6 +197,8 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
 
         if (result == 1) {
             nextMsgId = 1;
+            // nothing left over from an earlier connection
+            this->rxState = MQTT_RX_HEADER;
             // Leave room in the buffer for header and variable length field
             uint16_t length = MQTT_MAX_HEADER_SIZE;
             unsigned int j;
@@ -254,7 +258,13 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
 
             lastInActivity = lastOutActivity = millis();
 
-            while (!_client->available()) {
+            uint8_t llen;
+            uint32_t len;
+            while ((len = readPacket(&llen)) == 0) {
+                if (!_client->connected()) {
+                    break;
+                }
+                yield();
                 unsigned long t = millis();
                 if (t-lastInActivity >= ((int32_t) this->socketTimeout*1000UL)) {
                     _state = MQTT_CONNECTION_TIMEOUT;
@@ -262,17 +272,15 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
                     return false;
                 }
             }
-            uint8_t llen;
-            uint32_t len = readPacket(&llen);
 
             if (len == 4) {
-                if (buffer[3] == 0) {
+                if (rxBuffer[3] == 0) {
                     lastInActivity = millis();
                     pingOutstanding = false;
                     _state = MQTT_CONNECTED;
                     return true;
                 } else {
-                    _state = buffer[3];
+                    _state = rxBuffer[3];
                 }
             }
             _client->stop();
@@ -284,87 +292,127 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
     return true;
 }
 
-// reads a byte into result
-boolean PubSubClient::readByte(uint8_t * result) {
-   uint32_t previousMillis = millis();
-   while(!_client->available()) {
-     yield();
-     uint32_t currentMillis = millis();
-     if(currentMillis - previousMillis >= ((int32_t) this->socketTimeout * 1000)){
-       return false;
-     }
-   }
-   *result = _client->read();
-   return true;
-}
-
-// reads a byte into result[*index] and increments index
-boolean PubSubClient::readByte(uint8_t * result, uint16_t * index){
-  uint16_t current_index = *index;
-  uint8_t * write_address = &(result[current_index]);
-  if(readByte(write_address)){
-    *index = current_index + 1;
-    return true;
-  }
-  return false;
-}
+// Feeds received bytes to the packet being assembled, stopping at its end.
+// Returns the bytes used, or -1 for an invalid remaining length.
+int PubSubClient::decode(const uint8_t* data, size_t size, boolean* complete) {
+    size_t used = 0;
+    *complete = false;
+    while (used < size && !*complete) {
+        if (this->rxState == MQTT_RX_HEADER) {
+            this->rxBuffer[0] = data[used++];
+            this->rxLen = 1;
+            this->rxLength = 0;
+            this->rxShift = 0;
+            this->rxBody = 0;
+            this->rxSkip = 0;
+            this->rxState = MQTT_RX_LENGTH;
+        } else if (this->rxState == MQTT_RX_LENGTH) {
+            if (this->rxLen == MQTT_MAX_HEADER_SIZE) {
+                return -1;
+            }
+            uint8_t digit = data[used++];
+            this->rxBuffer[this->rxLen++] = digit;
+            this->rxLength += (uint32_t)(digit & 127) << this->rxShift;
+            this->rxShift += 7;
+            if ((digit & 128) == 0) {
+                this->rxLengthBytes = this->rxLen - 1;
+                this->rxState = MQTT_RX_BODY;
+                *complete = (this->rxLength == 0);
+            }
+        } else {
+            bool isPublish = (this->rxBuffer[0]&0xF0) == MQTTPUBLISH;
+            size_t n = this->rxLength - this->rxBody;
+            if (n > size - used) {
+                n = size - used;
+            }
+            if (isPublish && this->rxBody < 2) {
+                // topic length, to know where the payload starts for the stream
+                n = 1;
+                this->rxSkip = (this->rxSkip << 8) + data[used];
+                if (this->rxBody == 1 && (this->rxBuffer[0]&MQTTQOS1)) {
+                    // skip message id
+                    this->rxSkip += 2;
+                }
+            }
 
-uint32_t PubSubClient::readPacket(uint8_t* lengthLength) {
-    uint16_t len = 0;
-    if(!readByte(this->buffer, &len)) return 0;
-    bool isPublish = (this->buffer[0]&0xF0) == MQTTPUBLISH;
-    uint32_t multiplier = 1;
-    uint32_t length = 0;
-    uint8_t digit = 0;
-    uint16_t skip = 0;
-    uint32_t start = 0;
+            if (this->rxLen < this->bufferSize) {
+                size_t room = this->bufferSize - this->rxLen;
+                size_t copy = n < room ? n : room;
+                memcpy(this->rxBuffer + this->rxLen, data + used, copy);
+                this->rxLen += copy;
+            }
+            if (this->stream && isPublish && this->rxBody >= 2) {
+                uint32_t from = 2 + this->rxSkip;
+                uint32_t end = this->rxBody + n;
+                if (end > from) {
+                    uint32_t begin = this->rxBody > from ? this->rxBody : from;
+                    this->stream->write(data + used + (begin - this->rxBody), end - begin);
+                }
+            }
 
-    do {
-        if (len == 5) {
-            // Invalid remaining length encoding - kill the connection
-            _state = MQTT_DISCONNECTED;
-            _client->stop();
-            return 0;
-        }
-        if(!readByte(&digit)) return 0;
-        this->buffer[len++] = digit;
-        length += (digit & 127) * multiplier;
-        multiplier <<=7; //multiplier *= 128
-    } while ((digit & 128) != 0);
-    *lengthLength = len-1;
-
-    if (isPublish) {
-        // Read in topic length to calculate bytes to skip over for Stream writing
-        if(!readByte(this->buffer, &len)) return 0;
-        if(!readByte(this->buffer, &len)) return 0;
-        skip = (this->buffer[*lengthLength+1]<<8)+this->buffer[*lengthLength+2];
-        start = 2;
-        if (this->buffer[0]&MQTTQOS1) {
-            // skip message id
-            skip += 2;
+            this->rxBody += n;
+            used += n;
+            *complete = (this->rxBody == this->rxLength);
         }
     }
-    uint32_t idx = len;
+    if (*complete) {
+        this->rxState = MQTT_RX_HEADER;
+    }
+    return (int)used;
+}
 
-    for (uint32_t i = start;i<length;i++) {
-        if(!readByte(&digit)) return 0;
-        if (this->stream) {
-            if (isPublish && idx-*lengthLength-2>skip) {
-                this->stream->write(digit);
+uint32_t PubSubClient::readPacket(uint8_t* lengthLength) {
+    boolean complete = false;
+    while (!complete) {
+        const uint8_t* data;
+        int used;
+        int n = _client->peekBuffered(&data);
+        if (n >= 0) {
+            if (n == 0) {
+                return 0;
+            }
+            // decode straight out of the client's buffer
+            used = decode(data, n, &complete);
+            if (used > 0) {
+                _client->consumeBuffered(used);
+            }
+        } else {
+            // no bulk interface: read no further than this packet goes
+            uint8_t chunk[MQTT_RX_CHUNK_SIZE];
+            int avail = _client->available();
+            if (avail <= 0) {
+                return 0;
             }
+            size_t want = 1;
+            if (this->rxState == MQTT_RX_BODY) {
+                want = this->rxLength - this->rxBody;
+            }
+            if (want > (size_t)avail) {
+                want = avail;
+            }
+            if (want > sizeof(chunk)) {
+                want = sizeof(chunk);
+            }
+            int got = _client->read(chunk, want);
+            if (got <= 0) {
+                return 0;
+            }
+            used = decode(chunk, got, &complete);
         }
-
-        if (len < this->bufferSize) {
-            this->buffer[len] = digit;
-            len++;
+        if (used < 0) {
+            // Invalid remaining length encoding - kill the connection
+            this->rxState = MQTT_RX_HEADER;
+            _state = MQTT_DISCONNECTED;
+            _client->stop();
+            return 0;
         }
-        idx++;
     }
+    *lengthLength = this->rxLengthBytes;
 
-    if (!this->stream && idx > this->bufferSize) {
-        len = 0; // This will cause the packet to be ignored.
+    if (!this->stream && 1 + this->rxLengthBytes + this->rxLength > this->bufferSize) {
+        return 0; // This will cause the packet to be ignored.
     }
-    return len;
+    return this->rxLen;
 }
 
 boolean PubSubClient::loop() {
@@ -384,50 +432,50 @@ boolean PubSubClient::loop() {
                 pingOutstanding = true;
             }
         }
-        if (_client->available()) {
-            uint8_t llen;
-            uint16_t len = readPacket(&llen);
+        // every packet that is complete; a partial one is kept for the next loop()
+        uint8_t llen;
+        uint16_t len;
+        while ((len = readPacket(&llen)) > 0) {
             uint16_t msgId = 0;
             uint8_t *payload;
-            if (len > 0) {
-                lastInActivity = t;
-                uint8_t type = this->buffer[0]&0xF0;
-                if (type == MQTTPUBLISH) {
-                    if (callback) {
-                        uint16_t tl = (this->buffer[llen+1]<<8)+this->buffer[llen+2]; /* topic length in bytes */
-                        memmove(this->buffer+llen+2,this->buffer+llen+3,tl); /* move topic inside buffer 1 byte to front */
-                        this->buffer[llen+2+tl] = 0; /* end the topic as a 'C' string with \x00 */
-                        char *topic = (char*) this->buffer+llen+2;
-                        // msgId only present for QOS>0
-                        if ((this->buffer[0]&0x06) == MQTTQOS1) {
-                            msgId = (this->buffer[llen+3+tl]<<8)+this->buffer[llen+3+tl+1];
-                            payload = this->buffer+llen+3+tl+2;
-                            callback(topic,payload,len-llen-3-tl-2);
-
-                            this->buffer[0] = MQTTPUBACK;
-                            this->buffer[1] = 2;
-                            this->buffer[2] = (msgId >> 8);
-                            this->buffer[3] = (msgId & 0xFF);
-                            _client->write(this->buffer,4);
-                            lastOutActivity = t;
-
-                        } else {
-                            payload = this->buffer+llen+3+tl;
-                            callback(topic,payload,len-llen-3-tl);
-                        }
+            lastInActivity = t;
+            uint8_t type = this->rxBuffer[0]&0xF0;
+            if (type == MQTTPUBLISH) {
+                if (callback) {
+                    uint16_t tl = (this->rxBuffer[llen+1]<<8)+this->rxBuffer[llen+2]; /* topic length in bytes */
+                    memmove(this->rxBuffer+llen+2,this->rxBuffer+llen+3,tl); /* move topic inside buffer 1 byte to front */
+                    this->rxBuffer[llen+2+tl] = 0; /* end the topic as a 'C' string with \x00 */
+                    char *topic = (char*) this->rxBuffer+llen+2;
+                    // msgId only present for QOS>0
+                    if ((this->rxBuffer[0]&0x06) == MQTTQOS1) {
+                        msgId = (this->rxBuffer[llen+3+tl]<<8)+this->rxBuffer[llen+3+tl+1];
+                        payload = this->rxBuffer+llen+3+tl+2;
+                        callback(topic,payload,len-llen-3-tl-2);
+
+                        this->buffer[0] = MQTTPUBACK;
+                        this->buffer[1] = 2;
+                        this->buffer[2] = (msgId >> 8);
+                        this->buffer[3] = (msgId & 0xFF);
+                        _client->write(this->buffer,4);
+                        lastOutActivity = t;
+
+                    } else {
+                        payload = this->rxBuffer+llen+3+tl;
+                        callback(topic,payload,len-llen-3-tl);
                     }
-                } else if (type == MQTTPINGREQ) {
-                    this->buffer[0] = MQTTPINGRESP;
-                    this->buffer[1] = 0;
-                    _client->write(this->buffer,2);
-                } else if (type == MQTTPINGRESP) {
-                    pingOutstanding = false;
                 }
-            } else if (!connected()) {
-                // readPacket has closed the connection
-                return false;
+            } else if (type == MQTTPINGREQ) {
+                this->buffer[0] = MQTTPINGRESP;
+                this->buffer[1] = 0;
+                _client->write(this->buffer,2);
+            } else if (type == MQTTPINGRESP) {
+                pingOutstanding = false;
             }
         }
+        if (this->_state != MQTT_CONNECTED) {
+            // readPacket has closed the connection
+            return false;
+        }
         return true;
     }
     return false;
@@ -510,11 +558,14 @@ boolean PubSubClient::publish_P(const char* topic, const uint8_t* payload, unsig
 
     pos = writeString(topic,this->buffer,pos);
 
+    // header and byte-wise payload leave as one TLS record where the client can coalesce
+    _client->cork();
     rc += _client->write(this->buffer,pos);
 
     for (i=0;i<plength;i++) {
         rc += _client->write((char)pgm_read_byte_near(payload + i));
     }
+    _client->uncork();
 
     lastOutActivity = millis();
 
@@ -533,15 +584,24 @@ boolean PubSubClient::beginPublish(const char* topic, unsigned int plength, bool
             header |= 1;
         }
         size_t hlen = buildHeader(header, this->buffer, plength+length-MQTT_MAX_HEADER_SIZE);
+        // gather the header with the payload writes, endPublish() sends them
+        _client->cork();
         uint16_t rc = _client->write(this->buffer+(MQTT_MAX_HEADER_SIZE-hlen),length-(MQTT_MAX_HEADER_SIZE-hlen));
         lastOutActivity = millis();
-        return (rc == (length-(MQTT_MAX_HEADER_SIZE-hlen)));
+        if (rc != (length-(MQTT_MAX_HEADER_SIZE-hlen))) {
+            _client->uncork();
+            return false;
+        }
+        return true;
     }
     return false;
 }
 
 int PubSubClient::endPublish() {
- return 1;
+    if (_client) {
+        _client->uncork();
+    }
+    return 1;
 }
 
 size_t PubSubClient::write(uint8_t data) {
@@ -587,6 +647,7 @@ boolean PubSubClient::write(uint8_t header, uint8_t* buf, uint16_t length) {
     uint16_t bytesRemaining = length+hlen;  //Match the length type
     uint8_t bytesToWrite;
     boolean result = true;
+    _client->cork();
     while((bytesRemaining > 0) && result) {
         bytesToWrite = (bytesRemaining > MQTT_MAX_TRANSFER_SIZE)?MQTT_MAX_TRANSFER_SIZE:bytesRemaining;
         rc = _client->write(writeBuf,bytesToWrite);
@@ -594,6 +655,7 @@ boolean PubSubClient::write(uint8_t header, uint8_t* buf, uint16_t length) {
         bytesRemaining -= rc;
         writeBuf += rc;
     }
+    _client->uncork();
     return result;
 #else
     rc = _client->write(buf+(MQTT_MAX_HEADER_SIZE-hlen),length+hlen);
@@ -743,17 +805,32 @@ boolean PubSubClient::setBufferSize(uint16_t size) {
         return false;
     }
     if (this->bufferSize == 0) {
-        this->buffer = (uint8_t*)malloc(size);
+        this->buffer = (uint8_t*)mem_profile_malloc(MEM_TAG_MQTT, size);
+        this->rxBuffer = (uint8_t*)mem_profile_malloc(MEM_TAG_MQTT, size);
     } else {
-        uint8_t* newBuffer = (uint8_t*)realloc(this->buffer, size);
+        uint8_t* newBuffer = (uint8_t*)mem_profile_realloc(MEM_TAG_MQTT, this->buffer, size);
         if (newBuffer != NULL) {
             this->buffer = newBuffer;
         } else {
             return false;
         }
+        newBuffer = (uint8_t*)mem_profile_realloc(MEM_TAG_MQTT, this->rxBuffer, size);
+        if (newBuffer != NULL) {
+            this->rxBuffer = newBuffer;
+        } else {
+            // buffer has the new size already; both still hold the smaller one
+            if (size < this->bufferSize) {
+                this->bufferSize = size;
+            }
+            return false;
+        }
+        if (this->rxLen > size) {
+            // a packet arriving now no longer fits and will be ignored
+            this->rxLen = size;
+        }
     }
     this->bufferSize = size;
-    return (this->buffer != NULL);
+    return (this->buffer != NULL && this->rxBuffer != NULL);
 }
 
 uint16_t PubSubClient::getBufferSize() {
@@ -76,6 +76,16 @@
 // Maximum size of fixed header and variable length size header
 #define MQTT_MAX_HEADER_SIZE 5
 
+// readPacket() decoder states
+#define MQTT_RX_HEADER  0
+#define MQTT_RX_LENGTH  1
+#define MQTT_RX_BODY    2
+
+// Bytes read per call from clients without peekBuffered()
+#ifndef MQTT_RX_CHUNK_SIZE
+#define MQTT_RX_CHUNK_SIZE 64
+#endif
+
 #if defined(ESP8266) || defined(ESP32)
 #include <functional>
 #define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
@@ -89,6 +99,9 @@ class PubSubClient : public Print {
 private:
    Client* _client;
    uint8_t* buffer;
+   // Incoming packets, apart from buffer so that publish() and the replies loop()
+   // sends cannot overwrite a packet that is still arriving
+   uint8_t* rxBuffer;
    uint16_t bufferSize;
    uint16_t keepAlive;
    uint16_t socketTimeout;
@@ -97,9 +110,17 @@ private:
    unsigned long lastInActivity;
    bool pingOutstanding;
    MQTT_CALLBACK_SIGNATURE;
+   // Incoming packet, assembled in rxBuffer across readPacket() calls
+   uint8_t rxState;
+   uint8_t rxLengthBytes;
+   uint8_t rxShift;
+   uint16_t rxLen;       // bytes of the packet in buffer
+   uint32_t rxLength;    // remaining length
+   uint32_t rxBody;      // remaining length bytes received
+   uint32_t rxSkip;      // publish: topic and message id bytes, not written to stream
+   // Returns the length of a complete packet in rxBuffer, 0 while none is complete; never waits
    uint32_t readPacket(uint8_t*);
-   boolean readByte(uint8_t * result);
-   boolean readByte(uint8_t * result, uint16_t * index);
+   int decode(const uint8_t* data, size_t size, boolean* complete);
    boolean write(uint8_t header, uint8_t* buf, uint16_t length);
    uint16_t writeString(const char* string, uint8_t* buf, uint16_t pos);
    // Build up the header ready to send
@@ -193,15 +193,24 @@ int SensorManager::toJson(char *buf, size_t bufLen)
 {
     SensorData d = readAll();
 
+    // readings are formatted with dtoa_fixed() rather than printf's %f,
+    // which goes through the much slower soft-float printf path
+    char temperature[DTOA_FIXED_SIZE(2)];
+    char humidity[DTOA_FIXED_SIZE(2)];
+    char pressure[DTOA_FIXED_SIZE(2)];
+    dtoa_fixed(d.temperature, 2, temperature);
+    dtoa_fixed(d.humidity, 2, humidity);
+    dtoa_fixed(d.pressure, 2, pressure);
+
     int n = snprintf(buf, bufLen,
-        "{\"temperature\":%.2f,"
-        "\"humidity\":%.2f,"
-        "\"pressure\":%.2f,"
+        "{\"temperature\":%s,"
+        "\"humidity\":%s,"
+        "\"pressure\":%s,"
         "\"accelerometer\":{\"x\":%ld,\"y\":%ld,\"z\":%ld},"
         "\"gyroscope\":{\"x\":%ld,\"y\":%ld,\"z\":%ld},"
         "\"magnetometer\":{\"x\":%ld,\"y\":%ld,\"z\":%ld},"
         "\"buttons\":{\"a\":%s,\"b\":%s}}",
-        d.temperature, d.humidity, d.pressure,
+        temperature, humidity, pressure,
         d.accelX, d.accelY, d.accelZ,
         d.gyroX,  d.gyroY,  d.gyroZ,
         d.magX,   d.magY,   d.magZ,
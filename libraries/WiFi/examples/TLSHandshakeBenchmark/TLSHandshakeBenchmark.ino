@@ -0,0 +1,162 @@
+/*
+  TLSHandshakeBenchmark
+
+  Measures the client CPU time of a full TLS handshake for each cipher
+  suite / curve pair, to pick the lists passed to setCipherSuites() and
+  setCurves().
+
+  CPU time is the handshake wall time minus the time spent waiting for the
+  socket (see TLSSocket::handshake_timing()), so network round trips and
+  the server's own work drop out. Session resumption is turned off so every
+  run is a full handshake.
+
+  Before running:
+  1. On a PC on the same network, run tls_bench_server.py (next to this
+     sketch) with the PC's IP address:
+         python3 tls_bench_server.py 192.168.1.10
+     It serves an RSA-2048 chain on port 4433 and an ECDSA P-256 chain on
+     port 4434, and prints both CA certificates.
+  2. Paste the two CA certificates below and set benchServer to the same IP.
+  3. Set your WiFi SSID and password.
+*/
+
+#include "Arduino.h"
+#include "AZ3166WiFi.h"
+#include "AZ3166WiFiClientSecure.h"
+#include "TLSSessionCache.h"
+
+// WiFi credentials
+char ssid[] = "yourNetwork";
+char pass[] = "yourPassword";
+
+// Machine running tls_bench_server.py, must match the address given to it
+const char* benchServer = "192.168.1.10";
+const int rsaPort = 4433;
+const int ecdsaPort = 4434;
+
+// Full handshakes per suite / curve pair
+const int runs = 5;
+
+// "CA (RSA)" as printed by tls_bench_server.py
+const char* rsaCA =
+  "-----BEGIN CERTIFICATE-----\n"
+  "...\n"
+  "-----END CERTIFICATE-----\n";
+
+// "CA (ECDSA)" as printed by tls_bench_server.py
+const char* ecdsaCA =
+  "-----BEGIN CERTIFICATE-----\n"
+  "...\n"
+  "-----END CERTIFICATE-----\n";
+
+static const int suiteEcdsaGcm[] = { MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256, 0 };
+static const int suiteEcdsaCbc[] = { MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256, 0 };
+static const int suiteRsaGcm[] = { MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256, 0 };
+static const int suiteRsaGcm256[] = { MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384, 0 };
+
+static const mbedtls_ecp_group_id curveP256[] = { MBEDTLS_ECP_DP_SECP256R1, MBEDTLS_ECP_DP_NONE };
+static const mbedtls_ecp_group_id curveP384[] = { MBEDTLS_ECP_DP_SECP384R1, MBEDTLS_ECP_DP_NONE };
+static const mbedtls_ecp_group_id curveX25519[] = { MBEDTLS_ECP_DP_CURVE25519, MBEDTLS_ECP_DP_NONE };
+
+struct BenchCase
+{
+  const char* name;
+  const int* suites;
+  const mbedtls_ecp_group_id* curves;
+  bool ecdsa;
+};
+
+static const BenchCase cases[] = {
+  { "ECDHE-ECDSA-AES128-GCM  P-256",  suiteEcdsaGcm,  curveP256,   true  },
+  { "ECDHE-ECDSA-AES128-GCM  P-384",  suiteEcdsaGcm,  curveP384,   true  },
+  { "ECDHE-ECDSA-AES128-GCM  X25519", suiteEcdsaGcm,  curveX25519, true  },
+  { "ECDHE-ECDSA-AES128-CBC  P-256",  suiteEcdsaCbc,  curveP256,   true  },
+  { "ECDHE-RSA-AES128-GCM    P-256",  suiteRsaGcm,    curveP256,   false },
+  { "ECDHE-RSA-AES128-GCM    P-384",  suiteRsaGcm,    curveP384,   false },
+  { "ECDHE-RSA-AES128-GCM    X25519", suiteRsaGcm,    curveX25519, false },
+  { "ECDHE-RSA-AES256-GCM    P-256",  suiteRsaGcm256, curveP256,   false },
+  // the shipped preference lists, to check what they negotiate
+  { "TLS_CIPHERSUITES_ECDHE (ECDSA)", TLS_CIPHERSUITES_ECDHE, TLS_CURVES_NIST, true  },
+  { "TLS_CIPHERSUITES_ECDHE (RSA)",   TLS_CIPHERSUITES_ECDHE, TLS_CURVES_NIST, false },
+};
+
+// Client CPU spent in the handshake phases, i.e. without DNS, TCP and socket waits
+static uint32_t handshakeCpu(const TLSHandshakeTiming* t, int phase)
+{
+  return t->time_ms[phase] - t->wait_ms[phase];
+}
+
+static void runCase(const BenchCase& c)
+{
+  uint32_t best = 0xFFFFFFFF;
+  uint32_t sum = 0;
+  uint32_t cert = 0, serverKx = 0, clientKx = 0, hello = 0;
+  int ok = 0;
+
+  for (int i = 0; i < runs; i++)
+  {
+    WiFiClientSecure client;
+    client.setCACert(c.ecdsa ? ecdsaCA : rsaCA);
+    client.setCipherSuites(c.suites);
+    client.setCurves(c.curves);
+
+    if (!client.connect(benchServer, c.ecdsa ? ecdsaPort : rsaPort))
+    {
+      Serial.printf("  %s: connect failed\r\n", c.name);
+      continue;
+    }
+
+    const TLSHandshakeTiming* t = client.getHandshakeTiming();
+    uint32_t cpu = 0;
+    for (int phase = TLS_PHASE_CLIENT_HELLO; phase < TLS_PHASE_COUNT; phase++)
+    {
+      cpu += handshakeCpu(t, phase);
+    }
+    cert += handshakeCpu(t, TLS_PHASE_CERTIFICATE);
+    serverKx += handshakeCpu(t, TLS_PHASE_SERVER_KX);
+    clientKx += handshakeCpu(t, TLS_PHASE_CLIENT_KX);
+    hello = t->bytes_sent[TLS_PHASE_CLIENT_HELLO];
+    client.stop();
+
+    sum += cpu;
+    if (cpu < best) best = cpu;
+    ok++;
+  }
+
+  if (ok == 0)
+  {
+    return;
+  }
+  Serial.printf("%-32s %6lu %6lu %6lu %6lu %6lu %6lu\r\n", c.name,
+                (unsigned long)best, (unsigned long)(sum / ok),
+                (unsigned long)(cert / ok), (unsigned long)(serverKx / ok),
+                (unsigned long)(clientKx / ok), (unsigned long)hello);
+}
+
+void setup()
+{
+  Serial.begin(115200);
+
+  int status = WL_IDLE_STATUS;
+  while (status != WL_CONNECTED) {
+    Serial.printf("Connecting to %s...\r\n", ssid);
+    status = WiFi.begin(ssid, pass);
+    if (status != WL_CONNECTED) delay(5000);
+  }
+  Serial.printf("WiFi connected. IP: %s\r\n", WiFi.localIP().get_address());
+
+  // every run must be a full handshake
+  TLSSessionCache_Disable();
+}
+
+void loop()
+{
+  Serial.printf("\r\nHandshake CPU time in ms over %d runs (cert/skx/ckx are averages)\r\n", runs);
+  Serial.printf("%-32s %6s %6s %6s %6s %6s %6s\r\n", "suite / curve",
+                "min", "avg", "cert", "skx", "ckx", "hello");
+  for (unsigned int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+  {
+    runCase(cases[i]);
+  }
+  delay(60000);
+}
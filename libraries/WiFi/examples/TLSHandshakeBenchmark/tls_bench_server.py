@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+# Copyright (c) Microsoft. All rights reserved.
+# Licensed under the MIT license.
+"""Local TLS server for the TLSHandshakeBenchmark sketch.
+
+Creates an RSA-2048 and an ECDSA P-256 chain (CA -> server certificate, so the
+device verifies one signature of each kind), prints both CA certificates for
+pasting into the sketch, and completes a handshake with every client on
+
+    4433  RSA-2048 server certificate    (ECDHE-RSA suites)
+    4434  ECDSA P-256 server certificate (ECDHE-ECDSA suites)
+
+Usage: python3 tls_bench_server.py <address the device connects to> [workdir]
+Needs python3 and the openssl command line tool.
+"""
+
+import os
+import socket
+import ssl
+import subprocess
+import sys
+import tempfile
+import threading
+
+RSA_PORT = 4433
+ECDSA_PORT = 4434
+
+
+def openssl(*args):
+    subprocess.check_call(("openssl",) + args, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+
+def make_chain(workdir, name, keyargs, host):
+    ca_key = os.path.join(workdir, name + "_ca.key")
+    ca_crt = os.path.join(workdir, name + "_ca.pem")
+    key = os.path.join(workdir, name + "_server.key")
+    csr = os.path.join(workdir, name + "_server.csr")
+    crt = os.path.join(workdir, name + "_server.pem")
+
+    openssl("genpkey", *keyargs, "-out", ca_key)
+    openssl("req", "-x509", "-new", "-key", ca_key, "-sha256", "-days", "365",
+            "-subj", "/CN=TLS bench " + name + " CA", "-out", ca_crt)
+    openssl("genpkey", *keyargs, "-out", key)
+    # mbed TLS matches the host against the CN when there is no subjectAltName
+    openssl("req", "-new", "-key", key, "-subj", "/CN=" + host, "-out", csr)
+    openssl("x509", "-req", "-in", csr, "-CA", ca_crt, "-CAkey", ca_key, "-CAcreateserial",
+            "-sha256", "-days", "365", "-out", crt)
+    return ca_crt, crt, key
+
+
+def serve(port, crt, key, label):
+    ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    ctx.minimum_version = ssl.TLSVersion.TLSv1_2
+    ctx.maximum_version = ssl.TLSVersion.TLSv1_2
+    ctx.options |= ssl.OP_NO_TICKET
+    # honour the client's order so the preset lists show what they negotiate
+    ctx.options &= ~ssl.OP_CIPHER_SERVER_PREFERENCE
+    ctx.set_ciphers("ECDHE")
+    ctx.load_cert_chain(crt, key)
+
+    listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    listener.bind(("", port))
+    listener.listen(4)
+    while True:
+        conn, peer = listener.accept()
+        conn.settimeout(30)
+        try:
+            with ctx.wrap_socket(conn, server_side=True) as tls:
+                print("%-5s %s  %s  %s" % (label, peer[0], tls.version(), tls.cipher()[0]))
+                # the sketch closes right after the handshake
+                tls.recv(1)
+        except (OSError, ssl.SSLError) as e:
+            print("%-5s %s  handshake failed: %s" % (label, peer[0], e))
+            conn.close()
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 1
+    host = sys.argv[1]
+    workdir = sys.argv[2] if len(sys.argv) > 2 else tempfile.mkdtemp(prefix="tls_bench_")
+    os.makedirs(workdir, exist_ok=True)
+
+    rsa_ca, rsa_crt, rsa_key = make_chain(workdir, "rsa",
+                                          ("-algorithm", "RSA", "-pkeyopt", "rsa_keygen_bits:2048"), host)
+    ec_ca, ec_crt, ec_key = make_chain(workdir, "ecdsa",
+                                       ("-algorithm", "EC", "-pkeyopt", "ec_paramgen_curve:P-256"), host)
+
+    for label, path in (("CA (RSA)", rsa_ca), ("CA (ECDSA)", ec_ca)):
+        print("%s:" % label)
+        with open(path) as f:
+            for line in f.read().splitlines():
+                print('  "%s\\n"' % line)
+        print()
+
+    threads = [threading.Thread(target=serve, args=(RSA_PORT, rsa_crt, rsa_key, "RSA")),
+               threading.Thread(target=serve, args=(ECDSA_PORT, ec_crt, ec_key, "ECDSA"))]
+    for t in threads:
+        t.daemon = True
+        t.start()
+    print("Serving %s:%d (RSA) and %s:%d (ECDSA), files in %s" % (host, RSA_PORT, host, ECDSA_PORT, workdir))
+    for t in threads:
+        t.join()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
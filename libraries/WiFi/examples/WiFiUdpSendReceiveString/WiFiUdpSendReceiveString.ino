@@ -61,7 +61,7 @@ void setup() {
 void loop() {
 
   // if there's data available, read a packet
-  int packetSize = Udp.read(packetBuffer, 255);
+  int packetSize = Udp.parsePacket();
   if (packetSize > 0) {
     Serial.print("Received packet of size ");
     Serial.println(packetSize);
@@ -71,6 +71,11 @@ void loop() {
     Serial.print(", port ");
     Serial.println(Udp.remotePort());
 
+    // read the packet into packetBuffer
+    int len = Udp.read(packetBuffer, sizeof(packetBuffer) - 1);
+    if (len > 0) {
+      packetBuffer[len] = 0;
+    }
     Serial.println("Contents:");
     Serial.println(packetBuffer);
 
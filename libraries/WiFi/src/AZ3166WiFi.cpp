@@ -101,12 +101,9 @@ int WiFiClass::begin(char* ssid, const char *passphrase)
         return WL_CONNECTED;
     }
 
-    ((EMW10xxInterface*)WiFiInterface())->set_interface(Station);
-    if (((EMW10xxInterface*)WiFiInterface())->connect(ssid, passphrase, NSAPI_SECURITY_WPA_WPA2, 0) == 0)
+    // also syncs the time from the NTP server
+    if (SystemWiFiConnectTo(ssid, passphrase))
     {
-        // Sync system from NTP time server
-        SyncTime();
-
         strcpy(this->ssid, ssid);
         is_station_inited = true;
         current_status = WL_CONNECTED;
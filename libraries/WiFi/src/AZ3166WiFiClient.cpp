@@ -15,29 +15,185 @@
 #include "AZ3166WiFi.h"
 #include "AZ3166WiFiClient.h"
 #include "SystemWiFi.h"
+#include "MemoryProfiler.h"
 
 WiFiClient::WiFiClient()
 {
     _pTcpSocket = NULL;
     _useServerSocket = false;
+    _rxBuffer = NULL;
+    _rxCapacity = 0;
+    _rxBufferSize = WIFI_CLIENT_RX_BUFFER_SIZE;
+    _rxLen = 0;
+    _rxPos = 0;
+    memset(&_netStats, 0, sizeof(_netStats));
 }
 
 WiFiClient::WiFiClient(TCPSocket* socket)
 {
     _pTcpSocket = socket;
     _useServerSocket = true;
+    _rxBuffer = NULL;
+    _rxCapacity = 0;
+    _rxBufferSize = WIFI_CLIENT_RX_BUFFER_SIZE;
+    _rxLen = 0;
+    _rxPos = 0;
+    memset(&_netStats, 0, sizeof(_netStats));
+}
+
+WiFiClient::WiFiClient(const WiFiClient& other)
+{
+    _pTcpSocket = other._pTcpSocket;
+    _useServerSocket = other._useServerSocket;
+    _rxBuffer = NULL;
+    _rxCapacity = 0;
+    _rxBufferSize = other._rxBufferSize;
+    _rxLen = 0;
+    _rxPos = 0;
+    _netStats = other._netStats;
+}
+
+WiFiClient::WiFiClient(WiFiClient&& other)
+{
+    _pTcpSocket = other._pTcpSocket;
+    _useServerSocket = other._useServerSocket;
+    _rxBuffer = other._rxBuffer;
+    _rxCapacity = other._rxCapacity;
+    _rxBufferSize = other._rxBufferSize;
+    _rxLen = other._rxLen;
+    _rxPos = other._rxPos;
+    _netStats = other._netStats;
+
+    // the moved-from client must not close the socket when destroyed
+    other._pTcpSocket = NULL;
+    other._rxBuffer = NULL;
+    other._rxCapacity = 0;
+    other._rxLen = 0;
+    other._rxPos = 0;
 }
 
 WiFiClient::~WiFiClient()
 {
     stop();
+    releaseBuffer();
 }
 
-int WiFiClient::peek()
+WiFiClient& WiFiClient::operator=(const WiFiClient& other)
+{
+    if (this != &other)
+    {
+        releaseBuffer();
+        _pTcpSocket = other._pTcpSocket;
+        _useServerSocket = other._useServerSocket;
+        _rxBufferSize = other._rxBufferSize;
+        _netStats = other._netStats;
+    }
+    return *this;
+}
+
+WiFiClient& WiFiClient::operator=(WiFiClient&& other)
+{
+    if (this != &other)
+    {
+        releaseBuffer();
+        _pTcpSocket = other._pTcpSocket;
+        _useServerSocket = other._useServerSocket;
+        _rxBuffer = other._rxBuffer;
+        _rxCapacity = other._rxCapacity;
+        _rxBufferSize = other._rxBufferSize;
+        _rxLen = other._rxLen;
+        _rxPos = other._rxPos;
+        _netStats = other._netStats;
+
+        other._pTcpSocket = NULL;
+        other._rxBuffer = NULL;
+        other._rxCapacity = 0;
+        other._rxLen = 0;
+        other._rxPos = 0;
+    }
+    return *this;
+}
+
+void WiFiClient::setRxBufferSize(size_t size)
+{
+    _rxBufferSize = (size > 0) ? size : 1;
+    if (_rxLen == _rxPos)
+    {
+        releaseBuffer();
+    }
+}
+
+void WiFiClient::releaseBuffer()
+{
+    mem_profile_free(_rxBuffer);
+    _rxBuffer = NULL;
+    _rxCapacity = 0;
+    _rxLen = 0;
+    _rxPos = 0;
+}
+
+// Reads what the socket has into the empty buffer without waiting; returns the bytes buffered
+int WiFiClient::fill()
 {
+    if (_pTcpSocket == NULL)
+    {
+        return 0;
+    }
+
+    _rxLen = 0;
+    _rxPos = 0;
+    if (_rxCapacity != _rxBufferSize)
+    {
+        releaseBuffer();
+        _rxBuffer = (uint8_t*)mem_profile_malloc(MEM_TAG_WIFI, _rxBufferSize);
+        if (_rxBuffer == NULL)
+        {
+            return 0;
+        }
+        _rxCapacity = _rxBufferSize;
+    }
+
+    _pTcpSocket->set_blocking(false);
+    int ret = _pTcpSocket->recv(_rxBuffer, _rxCapacity);
+    _pTcpSocket->set_timeout(1000);
+    net_stats_recv(NET_STATS_TCP, &_netStats, ret);
+    if (ret > 0)
+    {
+        _rxLen = ret;
+        return ret;
+    }
+    if (ret == 0)
+    {
+        // Connection closed
+        stop();
+    }
     return 0;
 }
 
+int WiFiClient::peek()
+{
+    if (available() > 0)
+    {
+        return _rxBuffer[_rxPos];
+    }
+    return -1;
+}
+
+int WiFiClient::peekBuffered(const uint8_t **data)
+{
+    int count = available();
+    if (count > 0)
+    {
+        *data = &_rxBuffer[_rxPos];
+    }
+    return count;
+}
+
+void WiFiClient::consumeBuffered(size_t length)
+{
+    _rxPos += length;
+}
+
 int WiFiClient::connect(const char* host, unsigned short port)
 {
     if (_pTcpSocket != NULL)
@@ -46,17 +202,24 @@ int WiFiClient::connect(const char* host, unsigned short port)
         return 0;
     }
 
+    // Drop anything left from the previous connection
+    _rxLen = 0;
+    _rxPos = 0;
+
     _pTcpSocket = new TCPSocket();
     if (_pTcpSocket == NULL)
     {
         return 0;
     }
+    uint32_t start = millis();
     if (_pTcpSocket->open(WiFiInterface()) != 0 || _pTcpSocket->connect(host, (uint16_t)port) != 0)
     {
+        net_stats_connect(NET_STATS_TCP, &_netStats, millis() - start, false);
         delete _pTcpSocket;
         _pTcpSocket = NULL;
         return 0;
     }
+    net_stats_connect(NET_STATS_TCP, &_netStats, millis() - start, true);
 
     _pTcpSocket->set_blocking(false);
     _pTcpSocket->set_timeout(1000);
@@ -70,7 +233,14 @@ int WiFiClient::connect(IPAddress ip, unsigned short port)
 
 int WiFiClient::available()
 {
-    return connected();
+    // Return buffered data count if we have any
+    if (_rxLen > _rxPos)
+    {
+        return (int)(_rxLen - _rxPos);
+    }
+
+    // No buffered data - poll the socket without waiting
+    return fill();
 }
 
 size_t WiFiClient::write(uint8_t b)
@@ -83,6 +253,7 @@ size_t WiFiClient::write(const uint8_t *buf, size_t size)
     if (_pTcpSocket != NULL)
     {
         int ret = _pTcpSocket->send((void*)buf, (int)size);
+        net_stats_send(NET_STATS_TCP, &_netStats, ret);
         return (ret > 0) ? (size_t)ret : 0;
     }
     return 0;
@@ -90,27 +261,57 @@ size_t WiFiClient::write(const uint8_t *buf, size_t size)
 
 int WiFiClient::read()
 {
-    uint8_t ch;
-
-    int ret = read(&ch, 1);
-    if (ret == 0)
+    if (available() > 0)
     {
-        // Connection closed
-        stop();
+        return _rxBuffer[_rxPos++];
     }
-    if ( ret <= 0 )
-        return -1;
-    else
-        return (int)ch;
+    return -1;
 }
 
 int WiFiClient::read(uint8_t* buf, size_t size)
 {
-    if (_pTcpSocket != NULL)
+    if (size == 0) return 0;
+
+    // Whatever is buffered first, without touching the socket
+    if (_rxLen == _rxPos)
     {
-        return _pTcpSocket->recv((void*)buf, (int)size);
+        if (_pTcpSocket == NULL)
+        {
+            return -1;
+        }
+
+        if (size >= _rxBufferSize)
+        {
+            // Large reads go straight into the caller's buffer
+            _pTcpSocket->set_blocking(false);
+            int ret = _pTcpSocket->recv((void*)buf, size);
+            _pTcpSocket->set_timeout(1000);
+            net_stats_recv(NET_STATS_TCP, &_netStats, ret);
+            if (ret > 0)
+            {
+                return ret;
+            }
+            if (ret == 0)
+            {
+                stop();
+            }
+            return -1;
+        }
+
+        if (fill() == 0)
+        {
+            return -1;
+        }
     }
-    return -1;
+
+    size_t copied = _rxLen - _rxPos;
+    if (copied > size)
+    {
+        copied = size;
+    }
+    memcpy(buf, &_rxBuffer[_rxPos], copied);
+    _rxPos += copied;
+    return (int)copied;
 }
 
 void WiFiClient::flush()
@@ -120,6 +321,10 @@ void WiFiClient::flush()
 
 void WiFiClient::stop()
 {
+    // Unread data goes with the connection; the buffer is kept for the next one
+    _rxLen = 0;
+    _rxPos = 0;
+
     if (_pTcpSocket != NULL)
     {
         _pTcpSocket->close();
@@ -133,6 +338,11 @@ void WiFiClient::stop()
 
 uint8_t WiFiClient::connected()
 {
+    // Still readable while the buffer holds data, as in Arduino
+    if (_rxLen > _rxPos)
+    {
+        return 1;
+    }
     return ( _pTcpSocket == NULL || _pTcpSocket -> send(NULL, 0) == NSAPI_ERROR_NO_SOCKET) ? 0 : 1;
 }
 
@@ -19,14 +19,26 @@
 #include "Client.h"
 #include "IPAddress.h"
 #include "TCPSocket.h"
+#include "NetStats.h"
+
+// Default receive buffer, filled by one socket read at a time
+#ifndef WIFI_CLIENT_RX_BUFFER_SIZE
+#define WIFI_CLIENT_RX_BUFFER_SIZE    1024
+#endif
 
 class WiFiClient : public Client
 {
 public:
   WiFiClient(TCPSocket* socket);
   WiFiClient();
+  // a copy shares the socket but not the bytes already buffered
+  WiFiClient(const WiFiClient& other);
+  WiFiClient(WiFiClient&& other);
   ~WiFiClient();
 
+  WiFiClient& operator=(const WiFiClient& other);
+  WiFiClient& operator=(WiFiClient&& other);
+
   virtual int connect(IPAddress ip, unsigned short port);
   virtual int connect(const char *host, unsigned short port);
   virtual size_t write(uint8_t);
@@ -39,12 +51,30 @@ public:
   virtual uint8_t connected();
   virtual operator bool();
   virtual int peek();
+  virtual int peekBuffered(const uint8_t **data);
+  virtual void consumeBuffered(size_t length);
 
   friend class WiFiServer;
+  // receive buffer size, takes effect once the buffer is empty
+  void setRxBufferSize(size_t size);
+  // socket calls and connects of this client, see NetStats.h
+  const net_stats_t& netStats() const { return _netStats; }
 
 private:
+  int fill();
+  void releaseBuffer();
+
   TCPSocket* _pTcpSocket;
   bool _useServerSocket;
+
+  // Receive buffer, allocated on first use
+  uint8_t* _rxBuffer;
+  size_t _rxCapacity;     // allocated size of _rxBuffer
+  size_t _rxBufferSize;   // size wanted, see setRxBufferSize()
+  size_t _rxLen;
+  size_t _rxPos;
+
+  net_stats_t _netStats;
 };
 
 #endif
@@ -24,9 +24,16 @@ WiFiClientSecure::WiFiClientSecure()
     _caCert = NULL;
     _clientCert = NULL;
     _clientKey = NULL;
+    _caCertLen = 0;
+    _clientCertLen = 0;
+    _clientKeyLen = 0;
     _peekBufferLen = 0;
     _peekBufferPos = 0;
     _timeout = 2000;
+    _corkBufferSize = 0;
+    _memoryProfile = TLS_MEMORY_DEFAULT;
+    _cipherSuites = NULL;
+    _curves = NULL;
 }
 
 WiFiClientSecure::WiFiClientSecure(TLSSocket* socket)
@@ -36,9 +43,16 @@ WiFiClientSecure::WiFiClientSecure(TLSSocket* socket)
     _caCert = NULL;
     _clientCert = NULL;
     _clientKey = NULL;
+    _caCertLen = 0;
+    _clientCertLen = 0;
+    _clientKeyLen = 0;
     _peekBufferLen = 0;
     _peekBufferPos = 0;
     _timeout = 2000;
+    _corkBufferSize = 0;
+    _memoryProfile = TLS_MEMORY_DEFAULT;
+    _cipherSuites = NULL;
+    _curves = NULL;
 }
 
 WiFiClientSecure::~WiFiClientSecure()
@@ -49,21 +63,43 @@ WiFiClientSecure::~WiFiClientSecure()
 void WiFiClientSecure::setCACert(const char* rootCA)
 {
     _caCert = rootCA;
+    _caCertLen = 0;
 }
 
 void WiFiClientSecure::setCertificate(const char* clientCert)
 {
     _clientCert = clientCert;
+    _clientCertLen = 0;
 }
 
 void WiFiClientSecure::setPrivateKey(const char* privateKey)
 {
     _clientKey = privateKey;
+    _clientKeyLen = 0;
+}
+
+void WiFiClientSecure::setCACert(const uint8_t* rootCA, size_t length)
+{
+    _caCert = (const char*)rootCA;
+    _caCertLen = length;
+}
+
+void WiFiClientSecure::setCertificate(const uint8_t* clientCert, size_t length)
+{
+    _clientCert = (const char*)clientCert;
+    _clientCertLen = length;
+}
+
+void WiFiClientSecure::setPrivateKey(const uint8_t* privateKey, size_t length)
+{
+    _clientKey = (const char*)privateKey;
+    _clientKeyLen = length;
 }
 
 void WiFiClientSecure::setInsecure()
 {
     _caCert = NULL;
+    _caCertLen = 0;
 }
 
 int WiFiClientSecure::peek()
@@ -75,6 +111,21 @@ int WiFiClientSecure::peek()
     return -1;
 }
 
+int WiFiClientSecure::peekBuffered(const uint8_t **data)
+{
+    int count = available();
+    if (count > 0)
+    {
+        *data = &_peekBuffer[_peekBufferPos];
+    }
+    return count;
+}
+
+void WiFiClientSecure::consumeBuffered(size_t length)
+{
+    _peekBufferPos += length;
+}
+
 int WiFiClientSecure::connect(const char* host, unsigned short port)
 {
     if (_pTlsSocket != NULL)
@@ -93,7 +144,18 @@ int WiFiClientSecure::connect(const char* host, unsigned short port)
         return 0;
     }
 
-    if (_clientCert != NULL && _clientKey != NULL)
+    if (_caCertLen != 0 || _clientCertLen != 0 || _clientKeyLen != 0)
+    {
+        // some credentials given with a length: pass every length, PEM strings
+        // with their '\0', NULL/0 for a missing one
+        size_t caLen = _caCert == NULL ? 0 : (_caCertLen ? _caCertLen : strlen(_caCert) + 1);
+        size_t certLen = _clientCert == NULL ? 0 : (_clientCertLen ? _clientCertLen : strlen(_clientCert) + 1);
+        size_t keyLen = _clientKey == NULL ? 0 : (_clientKeyLen ? _clientKeyLen : strlen(_clientKey) + 1);
+        _pTlsSocket = new TLSSocket((const unsigned char*)_caCert, caLen,
+                                    (const unsigned char*)_clientCert, certLen,
+                                    (const unsigned char*)_clientKey, keyLen, netIface);
+    }
+    else if (_clientCert != NULL && _clientKey != NULL)
     {
         _pTlsSocket = new TLSSocket(_caCert, _clientCert, _clientKey, netIface);
     }
@@ -107,6 +169,14 @@ int WiFiClientSecure::connect(const char* host, unsigned short port)
         return 0;
     }
 
+    _pTlsSocket->set_memory_profile(_memoryProfile);
+    _pTlsSocket->set_ciphersuites(_cipherSuites);
+    _pTlsSocket->set_curves(_curves);
+    if (_corkBufferSize != 0)
+    {
+        _pTlsSocket->set_cork_buffer_size(_corkBufferSize);
+    }
+
     if (_pTlsSocket->connect(host, (uint16_t)port) != NSAPI_ERROR_OK)
     {
         delete _pTlsSocket;
@@ -204,6 +274,26 @@ int WiFiClientSecure::read(uint8_t* buf, size_t size)
 
 void WiFiClientSecure::flush()
 {
+    if (_pTlsSocket != NULL)
+    {
+        _pTlsSocket->flush();
+    }
+}
+
+void WiFiClientSecure::cork()
+{
+    if (_pTlsSocket != NULL)
+    {
+        _pTlsSocket->cork();
+    }
+}
+
+void WiFiClientSecure::uncork()
+{
+    if (_pTlsSocket != NULL)
+    {
+        _pTlsSocket->uncork();
+    }
 }
 
 void WiFiClientSecure::stop()
@@ -223,6 +313,21 @@ void WiFiClientSecure::stop()
     }
 }
 
+size_t WiFiClientSecure::getTLSHeapPeak()
+{
+    return (_pTlsSocket != NULL) ? _pTlsSocket->heap_peak() : 0;
+}
+
+const TLSHandshakeTiming* WiFiClientSecure::getHandshakeTiming()
+{
+    return (_pTlsSocket != NULL) ? &_pTlsSocket->handshake_timing() : NULL;
+}
+
+const net_stats_t* WiFiClientSecure::getNetStats()
+{
+    return (_pTlsSocket != NULL) ? &_pTlsSocket->net_stats() : NULL;
+}
+
 uint8_t WiFiClientSecure::connected()
 {
     return (_pTlsSocket != NULL) ? 1 : 0;
@@ -18,8 +18,7 @@
 #include "Arduino.h"
 #include "Client.h"
 #include "IPAddress.h"
-
-class TLSSocket;
+#include "TLSSocket.h"
 
 class WiFiClientSecure : public Client
 {
@@ -31,6 +30,10 @@ public:
   void setCACert(const char* rootCA);
   void setCertificate(const char* clientCert);
   void setPrivateKey(const char* privateKey);
+  // DER (or PEM including its '\0'), e.g. from TLSCertStore_Get()
+  void setCACert(const uint8_t* rootCA, size_t length);
+  void setCertificate(const uint8_t* clientCert, size_t length);
+  void setPrivateKey(const uint8_t* privateKey, size_t length);
   void setInsecure();
 
   virtual int connect(IPAddress ip, unsigned short port);
@@ -45,9 +48,27 @@ public:
   virtual uint8_t connected();
   virtual operator bool();
   virtual int peek();
+  virtual int peekBuffered(const uint8_t **data);
+  virtual void consumeBuffered(size_t length);
+  virtual void cork();
+  virtual void uncork();
 
   friend class WiFiServer;
   void setTimeout(unsigned int timeout) { _timeout = timeout; }
+  // largest record cork() gathers, see TLSSocket::set_cork_buffer_size()
+  void setCorkBufferSize(size_t size) { _corkBufferSize = size; }
+  // buffer sizes and max_fragment_length for the next connect(), see TLSSocket::set_memory_profile()
+  void setMemoryProfile(TLSMemoryProfile profile) { _memoryProfile = profile; }
+  // suites / curves to offer, most preferred first (e.g. TLS_CIPHERSUITES_ECDHE, TLS_CURVES_NIST);
+  // NULL for the defaults, see TLSSocket::set_ciphersuites()
+  void setCipherSuites(const int* suites) { _cipherSuites = suites; }
+  void setCurves(const mbedtls_ecp_group_id* curves) { _curves = curves; }
+  // heap the current connection holds at its highest, 0 when not connected
+  size_t getTLSHeapPeak();
+  // per-phase timing of the current connection's connect(), NULL when not connected
+  const TLSHandshakeTiming* getHandshakeTiming();
+  // socket calls and connects of the current socket, NULL when not connected; see TLSSocket::net_stats()
+  const net_stats_t* getNetStats();
 
 private:
   TLSSocket* _pTlsSocket;
@@ -55,12 +76,19 @@ private:
   const char* _caCert;
   const char* _clientCert;
   const char* _clientKey;
+  size_t _caCertLen;      // 0 for a PEM string
+  size_t _clientCertLen;
+  size_t _clientKeyLen;
   
   // Read buffer for proper available()/peek() support
   uint8_t _peekBuffer[64];
   int _peekBufferLen;
   int _peekBufferPos;
   unsigned int _timeout;  // Socket timeout in ms
+  size_t _corkBufferSize; // 0 for TLS_CORK_BUFFER_SIZE
+  TLSMemoryProfile _memoryProfile;
+  const int* _cipherSuites;
+  const mbedtls_ecp_group_id* _curves;
 };
 
 // Backward/compatibility aliases
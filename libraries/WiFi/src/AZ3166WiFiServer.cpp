@@ -21,6 +21,16 @@ WiFiServer::WiFiServer(unsigned short port)
 {
     _port = port;
     _pTcpServer = NULL;
+    _pooled = false;
+    _idleTimeout = WIFI_SERVER_IDLE_TIMEOUT_MS;
+    _onClient = NULL;
+    _onDisconnect = NULL;
+    _context = NULL;
+    for (int i = 0; i < WIFI_SERVER_MAX_CLIENTS; i++)
+    {
+        _poolUsed[i] = false;
+        _poolLastActive[i] = 0;
+    }
 }
 
 WiFiServer::~WiFiServer()
@@ -47,7 +57,7 @@ void WiFiServer::begin()
         _pTcpServer = NULL;
         return;
     }
-    if (_pTcpServer->bind(_port) != 0 || _pTcpServer->listen() != 0)
+    if (_pTcpServer->bind(_port) != 0 || _pTcpServer->listen(WIFI_SERVER_MAX_CLIENTS) != 0)
     {
         _pTcpServer->close();
         delete _pTcpServer;
@@ -100,7 +110,116 @@ void WiFiServer::close()
     {
         return;
     }
+    for (int i = 0; i < WIFI_SERVER_MAX_CLIENTS; i++)
+    {
+        if (_poolUsed[i])
+        {
+            release(i);
+        }
+    }
+    _pooled = false;
     _pTcpServer->close();
     delete _pTcpServer;
     _pTcpServer = NULL;
-}
\ No newline at end of file
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Pool mode
+void WiFiServer::onClient(WiFiServerClientCallback callback, void* context)
+{
+    _onClient = callback;
+    _context = context;
+}
+
+void WiFiServer::onDisconnect(WiFiServerClientCallback callback)
+{
+    _onDisconnect = callback;
+}
+
+int WiFiServer::clientCount() const
+{
+    int count = 0;
+    for (int i = 0; i < WIFI_SERVER_MAX_CLIENTS; i++)
+    {
+        if (_poolUsed[i])
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+void WiFiServer::release(int id)
+{
+    if (_onDisconnect != NULL)
+    {
+        _onDisconnect(_poolClients[id], id, _context);
+    }
+    _poolClients[id].stop();
+    _poolUsed[id] = false;
+}
+
+int WiFiServer::poll()
+{
+    if (_pTcpServer == NULL)
+    {
+        return 0;
+    }
+    if (!_pooled)
+    {
+        _pTcpServer->set_blocking(false);
+        _pooled = true;
+    }
+
+    uint32_t now = millis();
+
+    // Take everything pending while there are free slots
+    for (int i = 0; i < WIFI_SERVER_MAX_CLIENTS; i++)
+    {
+        if (_poolUsed[i])
+        {
+            continue;
+        }
+        if (_pTcpServer->accept(&_poolSockets[i]) != 0)
+        {
+            break;
+        }
+
+        // reuse the slot's client, and with it its receive buffer
+        WiFiClient& client = _poolClients[i];
+        client._pTcpSocket = &_poolSockets[i];
+        client._useServerSocket = true;
+        client._rxLen = 0;
+        client._rxPos = 0;
+        memset(&client._netStats, 0, sizeof(client._netStats));
+        _poolUsed[i] = true;
+        _poolLastActive[i] = now;
+    }
+
+    int dispatched = 0;
+    for (int i = 0; i < WIFI_SERVER_MAX_CLIENTS; i++)
+    {
+        if (!_poolUsed[i])
+        {
+            continue;
+        }
+
+        WiFiClient& client = _poolClients[i];
+        if (client.available() > 0)
+        {
+            _poolLastActive[i] = now;
+            if (_onClient != NULL)
+            {
+                _onClient(client, i, _context);
+                dispatched++;
+            }
+        }
+
+        if (!client.connected() ||
+            (_idleTimeout != 0 && (uint32_t)(now - _poolLastActive[i]) >= _idleTimeout))
+        {
+            release(i);
+        }
+    }
+    return dispatched;
+}
@@ -20,6 +20,19 @@
 #include "AZ3166WiFiClient.h"
 #include "Print.h"
 
+// Connections a server holds at once in pool mode, see WiFiServer::poll()
+#ifndef WIFI_SERVER_MAX_CLIENTS
+#define WIFI_SERVER_MAX_CLIENTS     4
+#endif
+
+// Pooled connections with nothing received for this long are closed
+#ifndef WIFI_SERVER_IDLE_TIMEOUT_MS
+#define WIFI_SERVER_IDLE_TIMEOUT_MS 10000
+#endif
+
+// Called from WiFiServer::poll(); id is the pool slot, stable while the connection lasts
+typedef void (*WiFiServerClientCallback)(WiFiClient& client, int id, void* context);
+
 class WiFiServer : public Print
 {
 public:
@@ -29,6 +42,35 @@ public:
     WiFiClient available();
     void begin();
 
+    /** Handler for pool mode
+     *
+     *  Called from poll() for each pooled connection with data to read. The
+     *  handler reads what it needs and returns; it may call client.stop()
+     *  when it is done with the connection.
+     *  @param callback  Data handler
+     *  @param context   Passed back to the handlers
+     */
+    void onClient(WiFiServerClientCallback callback, void* context = NULL);
+
+    /** Called from poll() before a pooled connection is closed or released */
+    void onDisconnect(WiFiServerClientCallback callback);
+
+    /** Close pooled connections idle for longer than timeout ms (0 never) */
+    void setIdleTimeout(unsigned int timeout) { _idleTimeout = timeout; }
+
+    /** Serve pooled connections without blocking
+     *
+     *  Switches the listening socket to non-blocking, accepts pending
+     *  connections into free slots (up to WIFI_SERVER_MAX_CLIENTS), calls the
+     *  onClient() handler for each connection with data, and releases the
+     *  ones that closed or idled out. Call it from loop().
+     *  @return  Number of handler calls
+     */
+    int poll();
+
+    /** Pooled connections currently open */
+    int clientCount() const;
+
     /** Set timeout on blocking socket operations
      *  
      *  setTimeout(0) is equivalent to set blocking = false
@@ -42,9 +84,22 @@ public:
     virtual size_t write(const unsigned char *buf, size_t size);
 
 private:
+    void release(int id);
+
 	unsigned short _port;
     TCPServer *_pTcpServer;
     TCPSocket _clientTcpSocket;
+
+    // Pool mode
+    bool _pooled;
+    TCPSocket _poolSockets[WIFI_SERVER_MAX_CLIENTS];
+    WiFiClient _poolClients[WIFI_SERVER_MAX_CLIENTS];
+    bool _poolUsed[WIFI_SERVER_MAX_CLIENTS];
+    uint32_t _poolLastActive[WIFI_SERVER_MAX_CLIENTS];
+    unsigned int _idleTimeout;
+    WiFiServerClientCallback _onClient;
+    WiFiServerClientCallback _onDisconnect;
+    void* _context;
 };
 
 #endif // wifiserver_h
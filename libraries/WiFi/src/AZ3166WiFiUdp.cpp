@@ -17,6 +17,17 @@
 #include "AZ3166WiFiUdp.h"
 #include "AZ3166WiFiClient.h"
 #include "SystemWiFi.h"
+#include "MemoryProfiler.h"
+
+// One datagram in the send queue, followed by its payload padded to 4 bytes
+struct QueuedPacket
+{
+    nsapi_addr_t addr;
+    uint16_t port;
+    uint16_t length;
+};
+
+#define QUEUED_SIZE(length)    ((sizeof(QueuedPacket) + (length) + 3) & ~(size_t)3)
 
 /* Constructor */
 WiFiUDP::WiFiUDP()
@@ -25,32 +36,46 @@ WiFiUDP::WiFiUDP()
 
     _localPort = 0;
     is_initialized = false;
+
+    _rxBuffer = NULL;
+    _rxLen = 0;
+    _rxPos = 0;
+    _txBuffer = NULL;
+    _txLen = 0;
+    _txOpen = false;
+    _queue = NULL;
+    _queueSize = 0;
+    _queueUsed = 0;
+    _queueMax = 0;
+    _queueCount = 0;
 }
 
-/* Start WiFiUDP socket, listening at local port PORT */
-int WiFiUDP::begin(unsigned short port)
+bool WiFiUDP::open()
 {
-    if ( !is_initialized )
+    if (!is_initialized)
     {
-        _pUdpSocket->set_blocking(false);
-        _pUdpSocket->set_timeout(5000);
-        if(_pUdpSocket->open(WiFiInterface()) != 0)
+        if (_pUdpSocket->open(WiFiInterface()) != 0)
         {
-            return 0;
+            return false;
         }
+        _pUdpSocket->set_blocking(false);
+        _pUdpSocket->set_timeout(5000);
         is_initialized = true;
     }
+    return true;
+}
 
-    if ( is_initialized )
-    {
-        _localPort = port;
-        _pUdpSocket->bind(port);
-        return 1;
-    }
-    else
+/* Start WiFiUDP socket, listening at local port PORT */
+int WiFiUDP::begin(unsigned short port)
+{
+    if (!open())
     {
         return 0;
     }
+
+    _localPort = port;
+    _pUdpSocket->bind(port);
+    return 1;
 }
 
 
@@ -60,10 +85,16 @@ void WiFiUDP::stop()
     if (!is_initialized)
         return;
 
+    sendQueued();
     _pUdpSocket->close();
     is_initialized = false;
+    _rxLen = 0;
+    _rxPos = 0;
+    _txOpen = false;
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Sending
 int WiFiUDP::beginPacket(const char *host, unsigned short port)
 {
     // Look up the host first
@@ -79,38 +110,43 @@ int WiFiUDP::beginPacket(const char *host, unsigned short port)
 
 int WiFiUDP::beginPacket(IPAddress ip, unsigned short port)
 {
-    if (!is_initialized)
+    if (!open())
     {
-        if(_pUdpSocket->open(WiFiInterface()) != 0)
+        return 0;
+    }
+
+    if (_txBuffer == NULL)
+    {
+        _txBuffer = (uint8_t*)mem_profile_malloc(MEM_TAG_WIFI, WIFI_UDP_PACKET_SIZE);
+        if (_txBuffer == NULL)
         {
             return 0;
         }
-
-        _pUdpSocket->set_blocking(false);
-        _pUdpSocket->set_timeout(5000);
-
-        is_initialized = true;
     }
 
-    if (_address != NULL)
-    {
-        delete _address;
-        _address = NULL;
-    }
-    _address = new SocketAddress(ip.get_address(), port);
-    if (_address == NULL)
+    if (!_remote.set_ip_address(ip.get_address()))
     {
         return 0;
     }
-    else
-    {
-        return 1;
-    }
+    _remote.set_port(port);
+    _txLen = 0;
+    _txOpen = true;
+    return 1;
 }
 
 int WiFiUDP::endPacket()
 {
-    return true;
+    if (!_txOpen)
+    {
+        return 0;
+    }
+    _txOpen = false;
+
+    if (_queueMax > 0)
+    {
+        return queuePacket();
+    }
+    return _pUdpSocket->sendto(_remote, _txBuffer, _txLen) == (nsapi_size_or_error_t)_txLen ? 1 : 0;
 }
 
 size_t WiFiUDP::write(unsigned char data)
@@ -120,80 +156,202 @@ size_t WiFiUDP::write(unsigned char data)
 
 size_t WiFiUDP::write(const unsigned char *buffer, size_t size)
 {
-    if (!is_initialized)
+    if (!_txOpen)
     {
         return 0;
     }
-    _pUdpSocket->sendto(*_address, (char*)buffer, size);
+
+    // a datagram cannot be split, so what does not fit is dropped
+    if (size > WIFI_UDP_PACKET_SIZE - _txLen)
+    {
+        size = WIFI_UDP_PACKET_SIZE - _txLen;
+    }
+    memcpy(_txBuffer + _txLen, buffer, size);
+    _txLen += size;
     return size;
 }
 
-int WiFiUDP::read()
+int WiFiUDP::setSendQueue(int count, size_t size)
+{
+    sendQueued();
+    mem_profile_free(_queue);
+    _queue = NULL;
+    _queueSize = 0;
+    _queueMax = 0;
+
+    if (count <= 0 || size == 0)
+    {
+        return 1;
+    }
+
+    _queue = (uint8_t*)mem_profile_malloc(MEM_TAG_WIFI, size);
+    if (_queue == NULL)
+    {
+        return 0;
+    }
+    _queueSize = size;
+    _queueMax = count;
+    return 1;
+}
+
+int WiFiUDP::queuePacket()
 {
-    int n;
-    char b;
+    size_t need = QUEUED_SIZE(_txLen);
+    if (need > _queueSize)
+    {
+        // never fits, send it on its own after what is already waiting
+        sendQueued();
+        return _pUdpSocket->sendto(_remote, _txBuffer, _txLen) == (nsapi_size_or_error_t)_txLen ? 1 : 0;
+    }
+    if (_queueCount == _queueMax || need > _queueSize - _queueUsed)
+    {
+        sendQueued();
+    }
+
+    QueuedPacket *packet = (QueuedPacket*)(_queue + _queueUsed);
+    packet->addr = _remote.get_addr();
+    packet->port = _remote.get_port();
+    packet->length = (uint16_t)_txLen;
+    memcpy(packet + 1, _txBuffer, _txLen);
+    _queueUsed += need;
+    _queueCount++;
+    return 1;
+}
 
-    if (_address == NULL)
+int WiFiUDP::sendQueued()
+{
+    int sent = 0;
+    size_t offset = 0;
+    for (int i = 0; i < _queueCount; i++)
     {
-        _address = new SocketAddress();
-        if (_address == NULL)
+        QueuedPacket *packet = (QueuedPacket*)(_queue + offset);
+        SocketAddress to(packet->addr, packet->port);
+        if (_pUdpSocket->sendto(to, packet + 1, packet->length) == (nsapi_size_or_error_t)packet->length)
         {
-            return 0;
+            sent++;
         }
+        offset += QUEUED_SIZE(packet->length);
     }
-    n =  _pUdpSocket->recvfrom(_address,  &b, 1);
-    return ( n != 1 )? (-1) : (int)(b);
+    _queueUsed = 0;
+    _queueCount = 0;
+    return sent;
 }
 
-int WiFiUDP::read(unsigned char* buffer, size_t len)
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Receiving
+
+// Takes the next datagram into the packet buffer, dropping what is left of the current one
+int WiFiUDP::receive(bool wait)
 {
-    if (_address == NULL)
+    _rxLen = 0;
+    _rxPos = 0;
+    if (!is_initialized)
     {
-        _address = new SocketAddress();
-        if (_address == NULL)
+        return 0;
+    }
+
+    if (_rxBuffer == NULL)
+    {
+        _rxBuffer = (uint8_t*)mem_profile_malloc(MEM_TAG_WIFI, WIFI_UDP_PACKET_SIZE);
+        if (_rxBuffer == NULL)
         {
             return 0;
         }
     }
-    return _pUdpSocket->recvfrom(_address, (char*)buffer, len);
+
+    if (!wait)
+    {
+        _pUdpSocket->set_blocking(false);
+    }
+    int n = _pUdpSocket->recvfrom(&_sender, _rxBuffer, WIFI_UDP_PACKET_SIZE);
+    if (!wait)
+    {
+        _pUdpSocket->set_timeout(5000);
+    }
+
+    if (n <= 0)
+    {
+        return 0;
+    }
+    _rxLen = n;
+    return n;
 }
 
-void WiFiUDP::flush()
+int WiFiUDP::parsePacket()
+{
+    return receive(false);
+}
+
+int WiFiUDP::available()
+{
+    return (int)(_rxLen - _rxPos);
+}
+
+int WiFiUDP::read()
 {
+    unsigned char b;
+    return (read(&b, 1) == 1) ? (int)b : -1;
+}
 
+int WiFiUDP::read(unsigned char* buffer, size_t len)
+{
+    if (_rxPos == _rxLen && receive(true) == 0)
+    {
+        return 0;
+    }
+
+    size_t n = _rxLen - _rxPos;
+    if (n > len)
+    {
+        n = len;
+    }
+    memcpy(buffer, _rxBuffer + _rxPos, n);
+    _rxPos += n;
+    return (int)n;
+}
+
+int WiFiUDP::peek()
+{
+    if (_rxPos == _rxLen)
+    {
+        return -1;
+    }
+    return _rxBuffer[_rxPos];
+}
+
+void WiFiUDP::flush()
+{
+    _rxLen = 0;
+    _rxPos = 0;
 }
 
 IPAddress WiFiUDP::remoteIP()
 {
-    if(_address == NULL)
+    if (!_sender)
     {
         return IP_ADDR_NONE;
     }
     IPAddress ip;
-    ip.fromString(_address->get_ip_address());
+    ip.fromString(_sender.get_ip_address());
     return ip;
 }
 
 unsigned short  WiFiUDP::remotePort()
 {
-    if(_address == NULL)
-    {
-        return 0;
-    }
-    return _address->get_port();
+    return _sender.get_port();
 }
 
 WiFiUDP:: ~WiFiUDP()
 {
     if(_pUdpSocket != NULL)
     {
+        sendQueued();
         _pUdpSocket->close();
         delete _pUdpSocket;
     }
 
-    if(_address != NULL)
-    {
-        delete _address;
-    }
+    mem_profile_free(_rxBuffer);
+    mem_profile_free(_txBuffer);
+    mem_profile_free(_queue);
     is_initialized = false;
 }
@@ -16,19 +16,47 @@
 #define wifiudp_h
 
 #include "UDPSocket.h"
+#include "IPAddress.h"
 
 #define UDP_TX_PACKET_MAX_SIZE 24
 
+// Largest datagram received or built; longer ones are truncated
+#ifndef WIFI_UDP_PACKET_SIZE
+#define WIFI_UDP_PACKET_SIZE   1472
+#endif
+
 class WiFiUDP
 {
 private:
   uint16_t _port; // local port to listen on
 
   UDPSocket* _pUdpSocket;
-  SocketAddress* _address;
+  SocketAddress _remote;    // destination of the packet being built
+  SocketAddress _sender;    // source of the current incoming packet
   uint16_t _localPort;
   bool is_initialized;
 
+  // Current incoming datagram
+  uint8_t* _rxBuffer;
+  size_t _rxLen;
+  size_t _rxPos;
+
+  // Outgoing datagram, sent by endPacket()
+  uint8_t* _txBuffer;
+  size_t _txLen;
+  bool _txOpen;
+
+  // Send queue, see setSendQueue()
+  uint8_t* _queue;
+  size_t _queueSize;
+  size_t _queueUsed;
+  int _queueMax;
+  int _queueCount;
+
+  bool open();
+  int receive(bool wait);
+  int queuePacket();
+
 public:
   WiFiUDP();  // Constructor
   virtual ~WiFiUDP(); //destructor
@@ -43,7 +71,7 @@ public:
   // Start building up a packet to send to the remote host specific in host and port
   // Returns 1 if successful, 0 if there was a problem resolving the hostname or port
   virtual int beginPacket(const char *host, unsigned short port);
-  // Finish off this packet and send it
+  // Finish off this packet and send it (or queue it, see setSendQueue())
   // Returns 1 if the packet was sent successfully, 0 if there was an error
   virtual int endPacket();
   // Write a single byte into the packet
@@ -51,14 +79,34 @@ public:
   // Write size bytes from buffer into the packet
   virtual size_t write(const unsigned char *buffer, size_t size);
 
+  // Hold back up to count datagrams, at most size bytes with their addresses, in endPacket()
+  // until sendQueued() or the queue fills; count 0 sends each one at once (the default)
+  // Returns 1 if successful, 0 if the queue cannot be allocated
+  int setSendQueue(int count, size_t size);
+  // Send every queued datagram, returns how many went out
+  int sendQueued();
+  // Datagrams waiting in the send queue
+  int queued() const { return _queueCount; }
+
+  // Start processing the next incoming packet without waiting
+  // Returns the size of the packet in bytes, or 0 if no packets are available
+  virtual int parsePacket();
+  // Number of bytes remaining in the current packet
+  virtual int available();
+  // The current packet's unread bytes, valid until the next parsePacket(), read() of a new packet, or stop()
+  const uint8_t* packetData() const { return _rxBuffer != NULL ? _rxBuffer + _rxPos : NULL; }
+
   // Read a single byte from the current packet
   virtual int read();
   // Read up to len bytes from the current packet and place them into buffer
+  // Without a current packet, waits for the next one as before
   // Returns the number of bytes read, or 0 if none are available
   virtual int read(unsigned char* buffer, size_t len);
   // Read up to len characters from the current packet and place them into buffer
   // Returns the number of characters read, or 0 if none are available
   virtual int read(char* buffer, size_t len) { return read((unsigned char*)buffer, len); };
+  // Return the next byte from the current packet without moving on from it
+  virtual int peek();
 
   virtual void flush();	// Finish reading the current packet
 
@@ -0,0 +1,44 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Cycles per call of dtoa_fixed() against the C library's "%.*f", for sensor
+// style values at the precisions sketches print.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "floatIO.h"
+
+#define CALLS 2000000
+
+int main(void)
+{
+    char buf[64];
+    static const int precs[] = { 0, 2, 6 };
+
+    printf("%-6s %14s %14s %8s\n", "prec", "dtoa_fixed", "snprintf", "speedup");
+    for (unsigned i = 0; i < sizeof(precs) / sizeof(precs[0]); i++)
+    {
+        int prec = precs[i];
+
+        uint64_t start = bench_cycles();
+        for (int n = 0; n < CALLS; n++)
+        {
+            dtoa_fixed(n * 0.37f - 1000.0f, prec, buf);
+            bench_keep(buf);
+        }
+        double a = (double)(bench_cycles() - start) / CALLS;
+
+        start = bench_cycles();
+        for (int n = 0; n < CALLS; n++)
+        {
+            snprintf(buf, sizeof(buf), "%.*f", prec, (double)(n * 0.37f - 1000.0f));
+            bench_keep(buf);
+        }
+        double b = (double)(bench_cycles() - start) / CALLS;
+
+        printf("%-6d %7.0f cycles %7.0f cycles %7.1fx\n", prec, a, b, b / a);
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Inbound MQTT messages/sec through PubSubClient's decoder alone, over the
+// in-memory LoopbackClient: no sockets, so the figures are the decoder and
+// the Client calls it makes. Bytes become readable a TCP segment (1460) at a
+// time, or 7 at a time to split every packet across many loop() calls; the
+// client is read in place (peekBuffered) or through read().
+
+#include "Arduino.h"
+#include "PubSubClient.h"
+#include "loopback_client.h"
+#include "bench.h"
+
+#define TOPIC   "devices/az3166/messages/devicebound"
+
+static unsigned long g_received, g_bad;
+static unsigned int g_payload;
+
+static void on_message(char *topic, uint8_t *payload, unsigned int length)
+{
+    g_received++;
+    if (length != g_payload || payload[0] != 'x' || payload[length - 1] != 'x' || strcmp(topic, TOPIC) != 0)
+    {
+        g_bad++;
+    }
+}
+
+static bool run(unsigned int payload, int qos, bool bulk, size_t segment, int count)
+{
+    LoopbackClient client(bulk);
+    static const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    client.rx.assign(connack, connack + sizeof(connack));
+    client.deliver(sizeof(connack));
+
+    PubSubClient mqtt(client);
+    mqtt.setBufferSize(2048);
+    mqtt.setServer("loopback", 1883);
+    mqtt.setCallback(on_message);
+    if (!mqtt.connect("bench"))
+    {
+        printf("connect failed\n");
+        return false;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        loopback_publish(client.rx, TOPIC, payload, 'x', qos, (uint16_t)(i + 1));
+    }
+
+    g_payload = payload;
+    g_received = g_bad = 0;
+    client.calls = 0;
+    uint64_t start = bench_now_ns();
+    while (client.arrived < client.rx.size())
+    {
+        client.deliver(segment);
+        mqtt.loop();
+    }
+    uint64_t ns = bench_now_ns() - start;
+
+    bool ok = g_received == (unsigned long)count && g_bad == 0;
+    printf("%7u B  qos%d  %-13s %7zu %12.0f %12.1f%s\n", payload, qos, bulk ? "peekBuffered" : "read()",
+           segment, count / (ns / 1e9), (double)client.calls / count, ok ? "" : "  FAILED");
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 20000;
+
+    printf("%d messages per row\n", count);
+    printf("%9s  %4s  %-13s %7s %12s %12s\n", "payload", "", "client", "segment", "msgs/s", "calls/msg");
+    bool ok = true;
+    static const unsigned int payloads[] = { 64, 1024 };
+    for (unsigned i = 0; i < sizeof(payloads) / sizeof(payloads[0]); i++)
+    {
+        ok = run(payloads[i], 0, true, 1460, count) && ok;
+        ok = run(payloads[i], 0, false, 1460, count) && ok;
+        ok = run(payloads[i], 0, true, 7, count) && ok;
+        ok = run(payloads[i], 0, false, 7, count) && ok;
+    }
+    ok = run(1024, 1, true, 1460, count) && ok;
+    return ok ? 0 : 1;
+}
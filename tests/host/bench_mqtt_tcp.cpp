@@ -0,0 +1,158 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// MQTT QoS 0 receive throughput over plain TCP on loopback: a broker thread
+// bursts PUBLISH packets, PubSubClient on top of WiFiClient (over the POSIX
+// TCPSocket stand-in) consumes them. A 1 byte receive buffer takes one socket
+// call per byte, as WiFiClient did before it buffered; the larger sizes fill
+// the buffer with one non-blocking read at a time.
+
+#include "Arduino.h"
+#include "AZ3166WiFiClient.h"
+#include "PubSubClient.h"
+#include "bench.h"
+
+#include <thread>
+#include <vector>
+
+#define TOPIC   "devices/az3166/messages/devicebound"
+
+static unsigned long g_received, g_bad;
+static unsigned int g_payload;
+
+static void on_message(char *topic, uint8_t *payload, unsigned int length)
+{
+    g_received++;
+    if (strcmp(topic, TOPIC) != 0 || length != g_payload || payload[length - 1] != 'x')
+    {
+        g_bad++;
+    }
+}
+
+static std::vector<uint8_t> publish_packet(unsigned int payload)
+{
+    const size_t topic_len = sizeof(TOPIC) - 1;
+    size_t remaining = 2 + topic_len + payload;
+    std::vector<uint8_t> p;
+    p.push_back(0x30);
+    do
+    {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        p.push_back(remaining ? digit | 0x80 : digit);
+    } while (remaining);
+    p.push_back(topic_len >> 8);
+    p.push_back(topic_len & 0xFF);
+    p.insert(p.end(), TOPIC, TOPIC + topic_len);
+    p.insert(p.end(), payload, 'x');
+    return p;
+}
+
+static bool send_all(int fd, const uint8_t *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// answers CONNECT, sends count PUBLISH packets in bursts of 64, then waits
+// for the client to go away
+static void broker(int listen_fd, int count, unsigned int payload)
+{
+    int fd = ::accept(listen_fd, NULL, NULL);
+    uint8_t in[256];
+    ::recv(fd, in, sizeof(in), 0);
+    static const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    send_all(fd, connack, sizeof(connack));
+
+    std::vector<uint8_t> packet = publish_packet(payload);
+    std::vector<uint8_t> burst;
+    for (int i = 0; i < 64; i++)
+    {
+        burst.insert(burst.end(), packet.begin(), packet.end());
+    }
+    for (int sent = 0; sent < count; sent += 64)
+    {
+        int n = count - sent < 64 ? count - sent : 64;
+        if (!send_all(fd, burst.data(), n * packet.size()))
+        {
+            break;
+        }
+    }
+    while (::recv(fd, in, sizeof(in), 0) > 0)
+    {
+    }
+    ::close(fd);
+}
+
+static bool run(unsigned int payload, size_t rx_size, int count)
+{
+    int listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    if (::bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || ::listen(listen_fd, 1) != 0 ||
+        ::getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len) != 0)
+    {
+        printf("cannot listen on loopback\n");
+        return false;
+    }
+    std::thread server(broker, listen_fd, count, payload);
+
+    g_received = g_bad = 0;
+    g_payload = payload;
+    WiFiClient net;
+    net.setRxBufferSize(rx_size);
+    PubSubClient mqtt(net);
+    mqtt.setBufferSize(payload + 128);
+    mqtt.setServer("127.0.0.1", ntohs(addr.sin_port));
+    mqtt.setCallback(on_message);
+    bool ok = mqtt.connect("bench");
+
+    memset(&host_socket_stats, 0, sizeof(host_socket_stats));
+    uint64_t start = bench_now_ns();
+    while (ok && g_received < (unsigned long)count && mqtt.connected())
+    {
+        mqtt.loop();
+    }
+    double secs = (bench_now_ns() - start) / 1e9;
+    unsigned long recv_calls = host_socket_stats.recv_calls;
+    mqtt.disconnect();
+    net.stop();
+    server.join();
+    ::close(listen_fd);
+
+    ok = ok && g_received == (unsigned long)count && g_bad == 0;
+    printf("%7u B %9zu B %11.0f %14.2f%s\n", payload, rx_size, g_received / secs,
+           (double)recv_calls / (g_received ? g_received : 1), ok ? "" : "  FAILED");
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 20000;
+    static const unsigned int payloads[] = { 32, 512 };
+    static const size_t rx_sizes[] = { 1, WIFI_CLIENT_RX_BUFFER_SIZE, 4096 };
+
+    printf("%d messages per row, topic %s\n", count, TOPIC);
+    printf("%9s %11s %11s %14s\n", "payload", "rx buffer", "msgs/s", "recv calls/msg");
+    bool ok = true;
+    for (unsigned i = 0; i < sizeof(payloads) / sizeof(payloads[0]); i++)
+    {
+        for (unsigned j = 0; j < sizeof(rx_sizes) / sizeof(rx_sizes[0]); j++)
+        {
+            ok = run(payloads[i], rx_sizes[j], count) && ok;
+        }
+    }
+    return ok ? 0 : 1;
+}
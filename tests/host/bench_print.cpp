@@ -0,0 +1,153 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Virtual write() calls and cycles to print one sensor JSON document (the
+// shape SensorManager::toJson produces) through Print, with print() calls
+// and with printf(). The byte sink only implements write(uint8_t), so it
+// sees Print's per-byte fallback; the bulk sink also overrides
+// write(buf, len) the way UARTClass, WiFiClient and PubSubClient do. Cycles
+// are time stamp counter ticks; a libc snprintf of the whole document is
+// included for reference.
+
+#include "Arduino.h"
+#include "bench.h"
+
+static unsigned long g_write_calls;
+
+class ByteSink : public Print
+{
+public:
+    ByteSink() : len(0) {}
+    size_t write(uint8_t c)
+    {
+        g_write_calls++;
+        if (len < sizeof(out))
+        {
+            out[len++] = c;
+        }
+        return 1;
+    }
+
+    char out[512];
+    size_t len;
+};
+
+class BulkSink : public ByteSink
+{
+public:
+    using Print::write;
+    size_t write(uint8_t c) { return ByteSink::write(c); }
+    size_t write(const uint8_t *buffer, size_t size)
+    {
+        g_write_calls++;
+        size_t n = size < sizeof(out) - len ? size : sizeof(out) - len;
+        memcpy(out + len, buffer, n);
+        len += n;
+        return size;
+    }
+};
+
+struct Reading
+{
+    float temperature, humidity, pressure;
+    long accel[3], gyro[3], mag[3];
+    bool a, b;
+};
+
+static const Reading reading = {
+    23.57f, 41.20f, 1012.84f, { -12, 987, 64 }, { 210, -1540, 70 }, { -301, 122, -455 }, false, true
+};
+
+static void print_xyz(Print &p, const char *name, const long *v)
+{
+    p.print(",\""); p.print(name); p.print("\":{\"x\":"); p.print(v[0]);
+    p.print(",\"y\":"); p.print(v[1]); p.print(",\"z\":"); p.print(v[2]); p.print('}');
+}
+
+static void json_print(Print &p, const Reading &r)
+{
+    p.print("{\"temperature\":"); p.print(r.temperature, 2);
+    p.print(",\"humidity\":"); p.print(r.humidity, 2);
+    p.print(",\"pressure\":"); p.print(r.pressure, 2);
+    print_xyz(p, "accelerometer", r.accel);
+    print_xyz(p, "gyroscope", r.gyro);
+    print_xyz(p, "magnetometer", r.mag);
+    p.print(",\"buttons\":{\"a\":"); p.print(r.a ? "true" : "false");
+    p.print(",\"b\":"); p.print(r.b ? "true" : "false"); p.print("}}");
+}
+
+static void json_printf(Print &p, const Reading &r)
+{
+    p.printf("{\"temperature\":%.2f,\"humidity\":%.2f,\"pressure\":%.2f,"
+             "\"accelerometer\":{\"x\":%ld,\"y\":%ld,\"z\":%ld},"
+             "\"gyroscope\":{\"x\":%ld,\"y\":%ld,\"z\":%ld},"
+             "\"magnetometer\":{\"x\":%ld,\"y\":%ld,\"z\":%ld},"
+             "\"buttons\":{\"a\":%s,\"b\":%s}}",
+             r.temperature, r.humidity, r.pressure,
+             r.accel[0], r.accel[1], r.accel[2],
+             r.gyro[0], r.gyro[1], r.gyro[2],
+             r.mag[0], r.mag[1], r.mag[2],
+             r.a ? "true" : "false", r.b ? "true" : "false");
+}
+
+// reference: format the whole document with libc snprintf, write it once
+static void json_snprintf(Print &p, const Reading &r)
+{
+    char buf[512];
+    int n = snprintf(buf, sizeof(buf),
+             "{\"temperature\":%.2f,\"humidity\":%.2f,\"pressure\":%.2f,"
+             "\"accelerometer\":{\"x\":%ld,\"y\":%ld,\"z\":%ld},"
+             "\"gyroscope\":{\"x\":%ld,\"y\":%ld,\"z\":%ld},"
+             "\"magnetometer\":{\"x\":%ld,\"y\":%ld,\"z\":%ld},"
+             "\"buttons\":{\"a\":%s,\"b\":%s}}",
+             r.temperature, r.humidity, r.pressure,
+             r.accel[0], r.accel[1], r.accel[2],
+             r.gyro[0], r.gyro[1], r.gyro[2],
+             r.mag[0], r.mag[1], r.mag[2],
+             r.a ? "true" : "false", r.b ? "true" : "false");
+    p.write((const uint8_t *)buf, n);
+}
+
+template <typename Sink>
+static void run(const char *label, void (*emit)(Print &, const Reading &), int rounds, char *text)
+{
+    g_write_calls = 0;
+    uint64_t start = bench_cycles();
+    for (int i = 0; i < rounds; i++)
+    {
+        Sink sink;
+        emit(sink, reading);
+        bench_keep(sink.out);
+        if (i == 0)
+        {
+            memcpy(text, sink.out, sink.len);
+            text[sink.len] = 0;
+        }
+    }
+    uint64_t cycles = (bench_cycles() - start) / rounds;
+    printf("%-22s %10lu %12llu\n", label, g_write_calls / rounds, (unsigned long long)cycles);
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 100000;
+    char text[5][513];
+
+    printf("%-22s %10s %12s\n", "sink / API", "writes", "cycles");
+    run<ByteSink>("byte sink, print()", json_print, rounds, text[0]);
+    run<BulkSink>("bulk sink, print()", json_print, rounds, text[1]);
+    run<ByteSink>("byte sink, printf()", json_printf, rounds, text[2]);
+    run<BulkSink>("bulk sink, printf()", json_printf, rounds, text[3]);
+    run<BulkSink>("bulk sink, snprintf", json_snprintf, rounds, text[4]);
+    printf("%zu bytes: %s\n", strlen(text[0]), text[0]);
+
+    for (int i = 1; i < 5; i++)
+    {
+        if (strcmp(text[0], text[i]) != 0)
+        {
+            printf("MISMATCH: %s\n", text[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Throughput of SPSCRingBuffer against the older RingBuffer class for 1, 16
+// and 256 byte transfers, the sizes the serial rx interrupt, line reads and
+// bulk writes move. Each transfer is written in and read straight back out,
+// so the ring wraps continuously but never fills.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#include "RingBuffer.h"
+#include "SPSCRingBuffer.h"
+#include "bench.h"
+
+#define RING_SIZE   1024
+#define TOTAL_BYTES (64u << 20)
+
+static uint8_t src[256], dst[256];
+
+static double mb_per_s(uint64_t ns)
+{
+    return (double)TOTAL_BYTES / (1 << 20) / (ns / 1e9);
+}
+
+static double old_ring(uint32_t chunk)
+{
+    RingBuffer ring(RING_SIZE - 1);
+    uint64_t start = bench_now_ns();
+    for (uint32_t done = 0; done < TOTAL_BYTES; done += chunk)
+    {
+        if (chunk == 1)
+        {
+            ring.putc(src[done & 0xFF]);
+            dst[0] = ring.getc();
+        }
+        else
+        {
+            ring.put(src, chunk);
+            ring.get(dst, chunk);
+        }
+        bench_keep(dst);
+    }
+    return mb_per_s(bench_now_ns() - start);
+}
+
+static double spsc_ring(uint32_t chunk)
+{
+    SPSCRingBuffer<uint8_t> ring(RING_SIZE);
+    uint64_t start = bench_now_ns();
+    for (uint32_t done = 0; done < TOTAL_BYTES; done += chunk)
+    {
+        if (chunk == 1)
+        {
+            ring.push(src[done & 0xFF]);
+            ring.pop(dst);
+        }
+        else
+        {
+            ring.write(src, chunk);
+            ring.read(dst, chunk);
+        }
+        bench_keep(dst);
+    }
+    return mb_per_s(bench_now_ns() - start);
+}
+
+// Producer and consumer on their own threads, the way the rx interrupt and
+// the sketch share the ring; also checks that every byte arrives in order.
+static double spsc_threads(uint32_t chunk, bool *ok)
+{
+    SPSCRingBuffer<uint8_t> ring(RING_SIZE);
+    uint64_t start = bench_now_ns();
+    std::thread producer([&ring, chunk]() {
+        uint8_t data[256];
+        for (uint32_t seq = 0; seq < TOTAL_BYTES; )
+        {
+            for (uint32_t i = 0; i < chunk; i++)
+            {
+                data[i] = (uint8_t)(seq + i);
+            }
+            uint32_t n = ring.write(data, chunk);
+            if (n == 0)
+            {
+                std::this_thread::yield();
+            }
+            seq += n;
+        }
+    });
+
+    uint8_t expect = 0;
+    *ok = true;
+    for (uint32_t done = 0; done < TOTAL_BYTES; )
+    {
+        uint32_t n;
+        const uint8_t *p = ring.peekRead(&n);
+        if (n == 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        for (uint32_t i = 0; i < n; i++)
+        {
+            if (p[i] != expect++)
+            {
+                *ok = false;
+            }
+        }
+        ring.consume(n);
+        done += n;
+    }
+    producer.join();
+    return mb_per_s(bench_now_ns() - start);
+}
+
+int main(void)
+{
+    for (int i = 0; i < (int)sizeof(src); i++)
+    {
+        src[i] = (uint8_t)i;
+    }
+
+    printf("%-8s %14s %14s %8s %18s\n", "transfer", "RingBuffer", "SPSCRingBuffer", "speedup", "SPSC (2 threads)");
+    static const uint32_t sizes[] = { 1, 16, 256 };
+    bool all_ok = true;
+    for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        double a = old_ring(sizes[i]);
+        double b = spsc_ring(sizes[i]);
+        bool ok;
+        double c = spsc_threads(sizes[i], &ok);
+        all_ok = all_ok && ok;
+        printf("%5u B  %9.1f MB/s %9.1f MB/s %7.2fx %13.1f MB/s%s\n",
+               sizes[i], a, b, b / a, c, ok ? "" : "  CORRUPT");
+    }
+    return all_ok ? 0 : 1;
+}
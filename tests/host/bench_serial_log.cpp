@@ -0,0 +1,81 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Call-site cost of a log line: formatting it and writing it to Serial, as
+// serial_xlog did before it was deferred, against recording it into the
+// SerialLog ring. Serial here is a memory sink, so the formatting figure
+// leaves out the UART wait it also paid on the board.
+
+#include "Arduino.h"
+#include "SerialLog.h"
+#include "bench.h"
+
+#define CALLS 64
+#define ROUNDS 20000
+
+// serial_xlog before the deferred logger: format on the stack, or in a heap
+// buffer when the line is longer, and print it
+static void format_and_write(const char *format, ...)
+{
+    va_list arg;
+    va_start(arg, format);
+    char temp[64];
+    char *buffer = temp;
+    size_t len = vsnprintf(temp, sizeof(temp), format, arg);
+    va_end(arg);
+    if (len > sizeof(temp) - 1)
+    {
+        buffer = new char[len + 1];
+        va_start(arg, format);
+        vsnprintf(buffer, len + 1, format, arg);
+        va_end(arg);
+    }
+    Serial.print(buffer);
+    if (buffer != temp)
+    {
+        delete[] buffer;
+    }
+}
+
+static const char *host = "myhub.azure-devices.net";
+static const char *text =
+    "{\"properties\":{\"desired\":{\"interval\":30,\"$version\":12},\"reported\":{\"fw\":\"1.6.2\"}}}......";
+
+#define MEASURE(cycles, call) \
+    do { \
+        uint64_t total = 0; \
+        for (int r = 0; r < ROUNDS; r++) \
+        { \
+            uint64_t start = bench_cycles(); \
+            for (int i = 0; i < CALLS; i++) \
+            { \
+                call; \
+            } \
+            total += bench_cycles() - start; \
+            serial_log_flush(); \
+            Serial.output.clear(); \
+        } \
+        cycles = (double)total / ROUNDS / CALLS; \
+    } while (0)
+
+int main(void)
+{
+    double before, after;
+
+    printf("%-34s %10s %10s\n", "message", "format", "record");
+
+    MEASURE(before, format_and_write("[TLS] read %d bytes\r\n", i));
+    MEASURE(after, SERIAL_LOG_INFO(SERIAL_LOG_MODULE_TLS, "read %d bytes", i));
+    printf("%-34s %10.0f %10.0f\n", "\"read %d bytes\"", before, after);
+
+    MEASURE(before, format_and_write("[TLS] %s:%d connected in %lu ms\r\n", host, 8883, (unsigned long)i));
+    MEASURE(after, SERIAL_LOG_INFO(SERIAL_LOG_MODULE_TLS, "%s:%d connected in %lu ms", host, 8883, (unsigned long)i));
+    printf("%-34s %10.0f %10.0f\n", "\"%s:%d connected in %lu ms\"", before, after);
+
+    MEASURE(before, format_and_write("[AzureIoT] twin %s\r\n", text));
+    MEASURE(after, SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "twin %s", text));
+    printf("%-34s %10.0f %10.0f\n", "100 character %s", before, after);
+
+    printf("(cycles per call)\n");
+    return 0;
+}
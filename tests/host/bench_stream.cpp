@@ -0,0 +1,170 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Parses a 4 KB HTTP response with the Stream helpers (readBytesUntil, find,
+// parseInt, parseFloat), once through a stream that only has read()/peek(),
+// which takes the per-byte path, and once through one that also exposes its
+// buffer with peekBuffered(), the way UARTClass and WiFiClient do.
+
+#include "Arduino.h"
+#include "bench.h"
+
+#include <string>
+
+static unsigned long g_byte_calls;
+
+// the whole response is "in the socket"; the buffered variant hands it out
+// in segment-sized runs like a TCP receive buffer
+class MemoryStream : public Stream
+{
+public:
+    MemoryStream(const std::string &data, bool buffered)
+        : _data(data), _pos(0), _buffered(buffered)
+    {
+        setTimeout(0);
+    }
+
+    int available() { return _data.size() - _pos; }
+    int read()
+    {
+        g_byte_calls++;
+        return _pos < _data.size() ? (uint8_t)_data[_pos++] : -1;
+    }
+    int peek()
+    {
+        g_byte_calls++;
+        return _pos < _data.size() ? (uint8_t)_data[_pos] : -1;
+    }
+    void flush() {}
+    size_t write(uint8_t) { return 0; }
+
+    int peekBuffered(const uint8_t **data)
+    {
+        if (!_buffered)
+        {
+            return -1;
+        }
+        size_t n = _data.size() - _pos;
+        *data = (const uint8_t *)_data.data() + _pos;
+        return n < SEGMENT ? n : SEGMENT;
+    }
+    void consumeBuffered(size_t length) { _pos += length; }
+
+private:
+    static const size_t SEGMENT = 1460;
+    const std::string &_data;
+    size_t _pos;
+    bool _buffered;
+};
+
+struct Parsed
+{
+    long status;
+    long content_length;
+    int headers;
+    long count;
+    long sum;
+    float temperature;
+
+    bool operator==(const Parsed &o) const
+    {
+        return status == o.status && content_length == o.content_length && headers == o.headers
+            && count == o.count && sum == o.sum && temperature == o.temperature;
+    }
+};
+
+static std::string make_response(void)
+{
+    std::string body = "{\"device\":\"az3166\",\"temperature\":23.75,\"count\":520,\"readings\":[";
+    for (int i = 0; i < 520; i++)
+    {
+        char num[16];
+        snprintf(num, sizeof(num), "%s%d", i ? "," : "", (i * 7919) % 100000 - 50000);
+        body += num;
+    }
+    body += "]}";
+
+    std::string r = "HTTP/1.1 200 OK\r\n";
+    r += "Server: nginx/1.18.0\r\nContent-Type: application/json; charset=utf-8\r\n";
+    r += "Cache-Control: no-cache, no-store, must-revalidate\r\nConnection: keep-alive\r\n";
+    r += "X-Request-Id: 7c1e5b2a-1f8e-4c3d-9a0b-2e6f4d8c1a3b\r\n";
+    for (int i = 0; r.size() < 1024; i++)
+    {
+        char h[64];
+        snprintf(h, sizeof(h), "X-Trace-%d: %08x%08x\r\n", i, i * 2654435761u, i * 40503u);
+        r += h;
+    }
+    r += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+    return r + body;
+}
+
+static Parsed parse(Stream &s)
+{
+    Parsed p = Parsed();
+    char line[128];
+
+    size_t n = s.readBytesUntil('\n', line, sizeof(line) - 1);
+    line[n] = 0;
+    p.status = atol(line + 9);
+
+    // headers until the empty line
+    while ((n = s.readBytesUntil('\n', line, sizeof(line) - 1)) > 1)
+    {
+        line[n] = 0;
+        if (strncmp(line, "Content-Length:", 15) == 0)
+        {
+            p.content_length = atol(line + 15);
+        }
+        p.headers++;
+    }
+
+    s.find("\"temperature\":");
+    p.temperature = s.parseFloat();
+    s.find("\"count\":");
+    p.count = s.parseInt();
+    s.find("\"readings\":[");
+    for (long i = 0; i < p.count; i++)
+    {
+        p.sum += s.parseInt();
+    }
+    return p;
+}
+
+static double run(const std::string &response, bool buffered, int rounds, Parsed *out, unsigned long *calls)
+{
+    g_byte_calls = 0;
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < rounds; i++)
+    {
+        MemoryStream s(response, buffered);
+        *out = parse(s);
+        bench_keep(*out);
+    }
+    *calls = g_byte_calls / rounds;
+    return (bench_now_ns() - start) / 1e3 / rounds;
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 2000;
+    std::string response = make_response();
+
+    Parsed a, b;
+    unsigned long calls_a, calls_b;
+    double us_a = run(response, false, rounds, &a, &calls_a);
+    double us_b = run(response, true, rounds, &b, &calls_b);
+
+    printf("%zu byte response, %d headers, %ld numbers\n", response.size(), a.headers, a.count);
+    printf("%-18s %10s %16s\n", "path", "us/parse", "read/peek calls");
+    printf("%-18s %10.1f %16lu\n", "per byte", us_a, calls_a);
+    printf("%-18s %10.1f %16lu\n", "peekBuffered", us_b, calls_b);
+    printf("speedup %.1fx\n", us_a / us_b);
+
+    if (!(a == b) || a.status != 200 || a.content_length != (long)(response.size() - response.find("\r\n\r\n") - 4))
+    {
+        printf("MISMATCH: status %ld/%ld length %ld/%ld sum %ld/%ld\n",
+               a.status, b.status, a.content_length, b.content_length, a.sum, b.sum);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Builds 10,000 telemetry messages piece by piece with String concatenation,
+// keeping the last 32 alive like an outgoing queue, and reports how often the
+// heap is called and how much of it is held at the peak. Run once with plain
+// +=, once with reserve() up front and once over caller buffers (setBuffer).
+
+#include "Arduino.h"
+#include "bench.h"
+
+#include <malloc.h>
+#include <new>
+
+#define MESSAGES    10000
+#define QUEUE_DEPTH 32
+#define MESSAGE_MAX 192
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+static unsigned long g_allocs, g_reallocs, g_frees;
+static size_t g_live, g_peak;
+
+static void account(size_t before, void *now)
+{
+    g_live = g_live - before + (now ? malloc_usable_size(now) : 0);
+    if (g_live > g_peak)
+    {
+        g_peak = g_live;
+    }
+}
+
+extern "C" void *malloc(size_t size)
+{
+    void *p = __libc_malloc(size);
+    g_allocs++;
+    account(0, p);
+    return p;
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    void *p = __libc_calloc(count, size);
+    g_allocs++;
+    account(0, p);
+    return p;
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    size_t before = ptr ? malloc_usable_size(ptr) : 0;
+    void *p = __libc_realloc(ptr, size);
+    if (ptr)
+    {
+        g_reallocs++;
+    }
+    else
+    {
+        g_allocs++;
+    }
+    account(before, p);
+    return p;
+}
+
+extern "C" void free(void *ptr)
+{
+    if (ptr)
+    {
+        g_frees++;
+        account(malloc_usable_size(ptr), NULL);
+    }
+    __libc_free(ptr);
+}
+
+static void build(String &s, unsigned long id)
+{
+    s += "{\"deviceId\":\"az3166-";
+    s += (int)(id % 97);
+    s += "\",\"messageId\":";
+    s += id;
+    s += ",\"temperature\":";
+    s += String(20.0f + (id % 150) / 10.0f, 2);
+    s += ",\"humidity\":";
+    s += String(35.0f + (id % 300) / 10.0f, 2);
+    s += ",\"pressure\":";
+    s += String(1000.0f + (id % 400) / 10.0f, 2);
+    s += ",\"status\":\"";
+    s += (id % 10) ? "ok" : "warning";
+    s += "\"}";
+}
+
+enum Mode
+{
+    PLAIN,
+    RESERVE,
+    CALLER_BUFFER
+};
+
+static void run(const char *label, Mode mode)
+{
+    // the queue slots are reused in place, so only string storage reaches
+    // the heap
+    static String queue[QUEUE_DEPTH];
+    static char storage[QUEUE_DEPTH][MESSAGE_MAX];
+
+    g_allocs = g_reallocs = g_frees = 0;
+    g_live = g_peak = 0;
+    uint64_t start = bench_now_ns();
+    for (unsigned long id = 0; id < MESSAGES; id++)
+    {
+        String &s = queue[id % QUEUE_DEPTH];
+        s.~String();
+        new (&s) String();
+
+        if (mode == RESERVE)
+        {
+            s.reserve(MESSAGE_MAX - 1);
+        }
+        else if (mode == CALLER_BUFFER)
+        {
+            s.setBuffer(storage[id % QUEUE_DEPTH], MESSAGE_MAX);
+        }
+        build(s, id);
+    }
+    uint64_t ns = bench_now_ns() - start;
+
+    for (int i = 0; i < QUEUE_DEPTH; i++)
+    {
+        queue[i].~String();
+        new (&queue[i]) String();
+    }
+    printf("%-14s %9.2f %10.2f %10zu %10.2f\n", label,
+           (double)g_allocs / MESSAGES, (double)g_reallocs / MESSAGES, g_peak, ns / 1e3 / MESSAGES);
+}
+
+int main(void)
+{
+    String sample;
+    build(sample, 12345);
+    printf("%d messages of about %u bytes, last %d alive\n", MESSAGES, sample.length(), QUEUE_DEPTH);
+    printf("%-14s %9s %10s %10s %10s\n", "mode", "mallocs", "reallocs", "peak heap", "us/msg");
+    run("+=", PLAIN);
+    run("reserve()", RESERVE);
+    run("setBuffer()", CALLER_BUFFER);
+    return 0;
+}
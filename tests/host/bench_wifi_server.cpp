@@ -0,0 +1,236 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Requests/sec and latency of a small JSON endpoint served by WiFiServer to
+// 1, 4 and 8 concurrent clients over loopback, once with the one-at-a-time
+// available() loop and once with the pool (poll() and onClient()). Each
+// client thread connects, sends its request in two parts with a short gap (a
+// slow client), reads the response until the server closes, and repeats.
+// Latency is from connect to the end of the response.
+
+#include "Arduino.h"
+#include "AZ3166WiFiServer.h"
+#include "bench.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define MAX_CLIENTS 8
+
+static uint16_t g_port;
+static int g_gap_us;
+static std::atomic<bool> g_running;
+static std::atomic<int> g_failures;
+static std::vector<double> g_latency_ms[MAX_CLIENTS];
+
+static char g_response[256];
+static int g_response_len;
+
+// progress through the "\r\n\r\n" that ends a request
+static int end_of_request(int matched, int c)
+{
+    static const char end[] = "\r\n\r\n";
+    return c == end[matched] ? matched + 1 : (c == '\r' ? 1 : 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Server
+static int g_matched[WIFI_SERVER_MAX_CLIENTS];
+
+static void on_client(WiFiClient &client, int id, void *context)
+{
+    (void)context;
+    int c;
+    while ((c = client.read()) >= 0)
+    {
+        g_matched[id] = end_of_request(g_matched[id], c);
+        if (g_matched[id] == 4)
+        {
+            client.write((const uint8_t *)g_response, g_response_len);
+            client.stop();
+            return;
+        }
+    }
+}
+
+static void on_disconnect(WiFiClient &client, int id, void *context)
+{
+    (void)client;
+    (void)context;
+    g_matched[id] = 0;
+}
+
+static void serve_pool(WiFiServer *server)
+{
+    server->onClient(on_client);
+    server->onDisconnect(on_disconnect);
+    while (g_running)
+    {
+        if (server->poll() == 0)
+        {
+            // what the rest of loop() would do; the host has one core here
+            Thread::yield();
+        }
+    }
+}
+
+static void serve_available(WiFiServer *server)
+{
+    server->setTimeout(50);
+    while (g_running)
+    {
+        WiFiClient client = server->available();
+        if (!client)
+        {
+            continue;
+        }
+
+        int matched = 0;
+        uint32_t start = millis();
+        while (client.connected() && millis() - start < 1000)
+        {
+            int c = client.read();
+            if (c < 0)
+            {
+                Thread::yield();
+                continue;
+            }
+            matched = end_of_request(matched, c);
+            if (matched == 4)
+            {
+                client.write((const uint8_t *)g_response, g_response_len);
+                break;
+            }
+        }
+        client.stop();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Clients
+static void client_thread(int index, uint64_t stop_ns)
+{
+    static const char head[] = "GET /api/sensors HTTP/1.1\r\nHost: az3166\r\n";
+    static const char tail[] = "Accept: application/json\r\n\r\n";
+    char buf[512];
+
+    while (bench_now_ns() < stop_ns)
+    {
+        uint64_t start = bench_now_ns();
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(g_port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            ::close(fd);
+            g_failures++;
+            continue;
+        }
+
+        ::send(fd, head, sizeof(head) - 1, MSG_NOSIGNAL);
+        usleep(g_gap_us);
+        ::send(fd, tail, sizeof(tail) - 1, MSG_NOSIGNAL);
+
+        int total = 0;
+        ssize_t n;
+        while ((n = ::recv(fd, buf, sizeof(buf), 0)) > 0)
+        {
+            total += n;
+        }
+        ::close(fd);
+
+        if (total != g_response_len)
+        {
+            g_failures++;
+            continue;
+        }
+        g_latency_ms[index].push_back((bench_now_ns() - start) / 1e6);
+    }
+}
+
+// a port nothing is listening on
+static uint16_t free_port(void)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    ::bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    ::getsockname(fd, (struct sockaddr *)&addr, &len);
+    ::close(fd);
+    return ntohs(addr.sin_port);
+}
+
+static bool run(const char *label, void (*serve)(WiFiServer *), int clients, double seconds)
+{
+    g_port = free_port();
+    WiFiServer server(g_port);
+    server.begin();
+
+    g_running = true;
+    g_failures = 0;
+    std::thread server_thread(serve, &server);
+
+    uint64_t stop_ns = bench_now_ns() + (uint64_t)(seconds * 1e9);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; i++)
+    {
+        g_latency_ms[i].clear();
+        threads.push_back(std::thread(client_thread, i, stop_ns));
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+    }
+    g_running = false;
+    server_thread.join();
+    server.close();
+
+    std::vector<double> all;
+    for (int i = 0; i < clients; i++)
+    {
+        all.insert(all.end(), g_latency_ms[i].begin(), g_latency_ms[i].end());
+    }
+    std::sort(all.begin(), all.end());
+    double p50 = all.empty() ? 0 : all[all.size() / 2];
+    double p99 = all.empty() ? 0 : all[std::min(all.size() - 1, all.size() * 99 / 100)];
+    double max = all.empty() ? 0 : all.back();
+
+    printf("%-12s %7d %10.0f %9.2f %9.2f %9.2f %8d\n", label, clients, all.size() / seconds,
+           p50, p99, max, g_failures.load());
+    return !all.empty();
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    g_gap_us = argc > 2 ? atoi(argv[2]) : 200;
+
+    g_response_len = snprintf(g_response, sizeof(g_response),
+        "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n"
+        "{\"temperature\":23.57,\"humidity\":41.20,\"pressure\":1012.84,\"uptime\":123456}");
+
+    printf("%.1f s per row, %d us between the two parts of a request, pool of %d\n",
+           seconds, g_gap_us, WIFI_SERVER_MAX_CLIENTS);
+    printf("%-12s %7s %10s %9s %9s %9s %8s\n", "server", "clients", "req/s", "p50 ms", "p99 ms", "max ms", "failures");
+    static const int counts[] = { 1, 4, MAX_CLIENTS };
+    bool ok = true;
+    for (unsigned i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        ok = run("available()", serve_available, counts[i], seconds) && ok;
+    }
+    for (unsigned i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        ok = run("poll()", serve_pool, counts[i], seconds) && ok;
+    }
+    return ok ? 0 : 1;
+}
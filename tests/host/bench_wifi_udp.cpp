@@ -0,0 +1,208 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Datagrams/sec through WiFiUDP over loopback, on the POSIX UDPSocket
+// stand-in. Sending builds a syslog-style line from four write() calls per
+// datagram, sent by endPacket() or gathered with setSendQueue(). Receiving
+// takes NTP-sized and larger datagrams with parsePacket() and then read(buf),
+// packetData() or read() byte by byte. Datagrams go in batches the kernel
+// queue can hold; only the WiFiUDP side is timed, and every datagram is
+// checked.
+
+#include "Arduino.h"
+#include "AZ3166WiFiUdp.h"
+#include "bench.h"
+
+#define BATCH   64
+
+static const char *const g_parts[] = { "<14>", "az3166 app: ", "temperature=23.57 humidity=41.20", "\n" };
+
+static int raw_socket(uint16_t *port)
+{
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    ::bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    ::getsockname(fd, (struct sockaddr *)&addr, &len);
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static uint16_t free_port(void)
+{
+    uint16_t port;
+    ::close(raw_socket(&port));
+    return port;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Sending
+static bool bench_send(const char *label, int queue, int count)
+{
+    uint16_t sink_port;
+    int sink = raw_socket(&sink_port);
+    size_t expect = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        expect += strlen(g_parts[i]);
+    }
+
+    WiFiUDP udp;
+    udp.begin(free_port());
+    if (queue > 0)
+    {
+        udp.setSendQueue(queue, 2048);
+    }
+    IPAddress sink_ip(127, 0, 0, 1);
+
+    memset(&host_socket_stats, 0, sizeof(host_socket_stats));
+    uint64_t ns = 0;
+    long received = 0, bad = 0;
+    for (int sent = 0; sent < count; sent += BATCH)
+    {
+        uint64_t start = bench_now_ns();
+        for (int i = 0; i < BATCH; i++)
+        {
+            udp.beginPacket(sink_ip, sink_port);
+            for (int j = 0; j < 4; j++)
+            {
+                udp.write((const unsigned char *)g_parts[j], strlen(g_parts[j]));
+            }
+            udp.endPacket();
+        }
+        udp.sendQueued();
+        ns += bench_now_ns() - start;
+
+        char buf[2048];
+        ssize_t n;
+        while ((n = ::recv(sink, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+        {
+            received++;
+            if ((size_t)n != expect || memcmp(buf, g_parts[0], 4) != 0 || buf[n - 1] != '\n')
+            {
+                bad++;
+            }
+        }
+    }
+    ::close(sink);
+
+    bool ok = received == count && bad == 0;
+    printf("%-24s %12.0f %12.2f%s\n", label, count / (ns / 1e9),
+           (double)host_socket_stats.sendto_calls / count, ok ? "" : "  FAILED");
+    return ok;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Receiving
+enum ReadMode
+{
+    READ_BUFFER,
+    PACKET_DATA,
+    READ_BYTES
+};
+
+static bool bench_recv(const char *label, ReadMode mode, int size, int count)
+{
+    uint16_t port = free_port();
+    WiFiUDP udp;
+    udp.begin(port);
+
+    uint16_t tx_port;
+    int tx = raw_socket(&tx_port);
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    unsigned char payload[1500], buf[1500];
+    memset(payload, 'x', sizeof(payload));
+
+    memset(&host_socket_stats, 0, sizeof(host_socket_stats));
+    uint64_t ns = 0;
+    long received = 0, bad = 0;
+    for (int sent = 0; sent < count; sent += BATCH)
+    {
+        for (int i = 0; i < BATCH; i++)
+        {
+            uint32_t seq = sent + i;
+            memcpy(payload, &seq, sizeof(seq));
+            ::sendto(tx, payload, size, 0, (struct sockaddr *)&to, sizeof(to));
+        }
+
+        uint64_t start = bench_now_ns();
+        for (int i = 0; i < BATCH; i++)
+        {
+            int len = udp.parsePacket();
+            if (len <= 0)
+            {
+                break;
+            }
+
+            const unsigned char *data = buf;
+            int n = 0;
+            if (mode == READ_BUFFER)
+            {
+                n = udp.read(buf, sizeof(buf));
+            }
+            else if (mode == PACKET_DATA)
+            {
+                data = udp.packetData();
+                n = udp.available();
+                udp.flush();
+            }
+            else
+            {
+                // read() would wait for the next datagram once this one is used up
+                while (udp.available() > 0)
+                {
+                    buf[n++] = (unsigned char)udp.read();
+                }
+            }
+
+            uint32_t seq;
+            memcpy(&seq, data, sizeof(seq));
+            if (len != size || n != size || seq != (uint32_t)received || data[n - 1] != 'x' ||
+                udp.remotePort() != tx_port)
+            {
+                bad++;
+            }
+            received++;
+        }
+        ns += bench_now_ns() - start;
+    }
+    ::close(tx);
+
+    bool ok = received == count && bad == 0;
+    printf("%-24s %12.0f %12.2f%s\n", label, received / (ns / 1e9),
+           (double)host_socket_stats.recvfrom_calls / (received ? received : 1), ok ? "" : "  FAILED");
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 64000;
+    count -= count % BATCH;
+
+    printf("%d datagrams per row\n", count);
+    printf("%-24s %12s %12s\n", "send (4 writes)", "datagrams/s", "sendto/dgram");
+    bool ok = bench_send("endPacket()", 0, count);
+    ok = bench_send("setSendQueue(16)", 16, count) && ok;
+
+    printf("%-24s %12s %12s\n", "receive", "datagrams/s", "recvfrom/dgram");
+    static const int sizes[] = { 48, 512 };
+    for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        char label[3][40];
+        snprintf(label[0], sizeof(label[0]), "%4d B read(buf)", sizes[i]);
+        snprintf(label[1], sizeof(label[1]), "%4d B packetData()", sizes[i]);
+        snprintf(label[2], sizeof(label[2]), "%4d B read() per byte", sizes[i]);
+        ok = bench_recv(label[0], READ_BUFFER, sizes[i], count) && ok;
+        ok = bench_recv(label[1], PACKET_DATA, sizes[i], count) && ok;
+        ok = bench_recv(label[2], READ_BYTES, sizes[i], count) && ok;
+    }
+    return ok ? 0 : 1;
+}
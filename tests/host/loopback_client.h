@@ -0,0 +1,115 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// An in-memory Client for the PubSubClient test and benchmark. rx holds
+// everything the "broker" will send, and only the first `arrived` bytes of
+// it can be read, the way bytes trickle in from a socket. Writes are kept in
+// tx. With bulk set it exposes its buffer through peekBuffered(), like
+// WiFiClient; without, PubSubClient has to read(). Every call is counted.
+
+#ifndef HOST_LOOPBACK_CLIENT_H
+#define HOST_LOOPBACK_CLIENT_H
+
+#include "Arduino.h"
+#include "Client.h"
+
+#include <vector>
+
+class LoopbackClient : public Client
+{
+public:
+    explicit LoopbackClient(bool bulk) : pos(0), arrived(0), calls(0), _bulk(bulk), _connected(false) {}
+
+    // make up to n more bytes of rx readable
+    void deliver(size_t n)
+    {
+        arrived = arrived + n < rx.size() ? arrived + n : rx.size();
+    }
+
+    int connect(IPAddress, uint16_t) { calls++; _connected = true; return 1; }
+    int connect(const char *, uint16_t) { calls++; _connected = true; return 1; }
+    size_t write(uint8_t b)
+    {
+        calls++;
+        tx.push_back(b);
+        return 1;
+    }
+    size_t write(const uint8_t *buf, size_t size)
+    {
+        calls++;
+        tx.insert(tx.end(), buf, buf + size);
+        return size;
+    }
+    int available() { calls++; return (int)(arrived - pos); }
+    int read()
+    {
+        calls++;
+        return pos < arrived ? rx[pos++] : -1;
+    }
+    int read(uint8_t *buf, size_t size)
+    {
+        calls++;
+        size_t n = arrived - pos < size ? arrived - pos : size;
+        if (n == 0)
+        {
+            return -1;
+        }
+        memcpy(buf, &rx[pos], n);
+        pos += n;
+        return (int)n;
+    }
+    int peek()
+    {
+        calls++;
+        return pos < arrived ? rx[pos] : -1;
+    }
+    int peekBuffered(const uint8_t **data)
+    {
+        calls++;
+        if (!_bulk)
+        {
+            return -1;
+        }
+        *data = rx.data() + pos;
+        return (int)(arrived - pos);
+    }
+    void consumeBuffered(size_t length) { calls++; pos += length; }
+    void flush() {}
+    void stop() { calls++; _connected = false; }
+    uint8_t connected() { calls++; return _connected; }
+    operator bool() { return _connected; }
+
+    std::vector<uint8_t> rx, tx;
+    size_t pos, arrived;
+    unsigned long calls;
+
+private:
+    bool _bulk;
+    bool _connected;
+};
+
+// Appends a PUBLISH of payload bytes of fill to v; QoS 1 carries msg_id
+static inline void loopback_publish(std::vector<uint8_t> &v, const char *topic, unsigned int payload,
+                                    uint8_t fill, int qos = 0, uint16_t msg_id = 0)
+{
+    size_t topic_len = strlen(topic);
+    size_t remaining = 2 + topic_len + (qos ? 2 : 0) + payload;
+    v.push_back(0x30 | (qos << 1));
+    do
+    {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        v.push_back(remaining ? digit | 0x80 : digit);
+    } while (remaining);
+    v.push_back(topic_len >> 8);
+    v.push_back(topic_len & 0xFF);
+    v.insert(v.end(), topic, topic + topic_len);
+    if (qos)
+    {
+        v.push_back(msg_id >> 8);
+        v.push_back(msg_id & 0xFF);
+    }
+    v.insert(v.end(), payload, fill);
+}
+
+#endif  // HOST_LOOPBACK_CLIENT_H
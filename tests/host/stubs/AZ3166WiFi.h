@@ -0,0 +1,13 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Host stand-in for AZ3166WiFi.h. The real header also pulls in
+// WiFiClientSecure and the TLS stack, which the host build leaves out; the
+// WiFi sources under test only need the Arduino core from it.
+
+#ifndef HOST_AZ3166_WIFI_H
+#define HOST_AZ3166_WIFI_H
+
+#include "Arduino.h"
+
+#endif  // HOST_AZ3166_WIFI_H
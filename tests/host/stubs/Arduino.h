@@ -0,0 +1,42 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Host stand-in for Arduino.h: the C library, the String/Print/Stream core
+// and the timing calls, without the board, the UART or the system services.
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "mbed.h"
+#include "pgmspace.h"
+#include "floatIO.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+typedef unsigned int word;
+
+extern "C" {
+char *itoa(int value, char *s, int radix);
+char *ltoa(long value, char *s, int radix);
+char *utoa(unsigned int value, char *s, int radix);
+char *ultoa(unsigned long value, char *s, int radix);
+}
+
+extern void delay(uint32_t ms);
+extern unsigned long millis(void);
+extern "C" void yield(void);
+
+#include "WString.h"
+#include "Stream.h"
+#include "UARTClass.h"
+
+extern UARTClass Serial;
+
+#endif  // Arduino_h
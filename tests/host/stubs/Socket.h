@@ -0,0 +1,108 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Host stand-in for mbed OS's Socket and NetworkInterface over POSIX
+// sockets on the loopback interface. Blocking, non-blocking and timeout modes
+// behave as on the device: a call that would wait longer than the timeout
+// returns NSAPI_ERROR_WOULD_BLOCK.
+
+#ifndef HOST_SOCKET_H
+#define HOST_SOCKET_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "nsapi_types.h"
+#include "SocketAddress.h"
+
+// socket calls made through the stand-ins, for the benchmarks to report
+typedef struct
+{
+    unsigned long send_calls;
+    unsigned long recv_calls;
+    unsigned long accept_calls;
+    unsigned long sendto_calls;
+    unsigned long recvfrom_calls;
+} host_socket_stats_t;
+
+extern host_socket_stats_t host_socket_stats;
+
+// every stand-in socket uses the host's own network stack
+class NetworkInterface
+{
+public:
+    virtual ~NetworkInterface() {}
+
+    // no DNS: only dotted IPv4 addresses resolve
+    nsapi_error_t gethostbyname(const char *host, SocketAddress *address)
+    {
+        return address->set_ip_address(host) ? NSAPI_ERROR_OK : NSAPI_ERROR_DNS_FAILURE;
+    }
+};
+
+class Socket
+{
+public:
+    virtual ~Socket() { close(); }
+
+    nsapi_error_t close()
+    {
+        if (_fd < 0)
+        {
+            return NSAPI_ERROR_NO_SOCKET;
+        }
+        ::close(_fd);
+        _fd = -1;
+        return NSAPI_ERROR_OK;
+    }
+
+    void set_blocking(bool blocking) { _timeout_ms = blocking ? -1 : 0; }
+    void set_timeout(int timeout_ms) { _timeout_ms = timeout_ms; }
+
+protected:
+    Socket() : _fd(-1), _timeout_ms(-1) {}
+
+    nsapi_error_t open_fd(int type)
+    {
+        close();
+        _fd = ::socket(AF_INET, type, 0);
+        return _fd < 0 ? NSAPI_ERROR_NO_SOCKET : NSAPI_ERROR_OK;
+    }
+
+    // false if the timeout ran out before any of the events
+    bool wait(short events)
+    {
+        struct pollfd p = { _fd, events, 0 };
+        return ::poll(&p, 1, _timeout_ms) > 0;
+    }
+
+    // a result of send()/recv() and friends as an nsapi result
+    static nsapi_size_or_error_t result(ssize_t ret)
+    {
+        if (ret >= 0)
+        {
+            return (nsapi_size_or_error_t)ret;
+        }
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? NSAPI_ERROR_WOULD_BLOCK : NSAPI_ERROR_NO_CONNECTION;
+    }
+
+    static void loopback(struct sockaddr_in *addr, uint16_t port)
+    {
+        memset(addr, 0, sizeof(*addr));
+        addr->sin_family = AF_INET;
+        addr->sin_port = htons(port);
+        addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    }
+
+    int _fd;
+    int _timeout_ms;    // -1 blocks, 0 never waits
+};
+
+#endif  // HOST_SOCKET_H
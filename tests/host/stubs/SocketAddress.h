@@ -0,0 +1,59 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Host stand-in for mbed OS's SocketAddress, IPv4 only.
+
+#ifndef HOST_SOCKET_ADDRESS_H
+#define HOST_SOCKET_ADDRESS_H
+
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "nsapi_types.h"
+
+class SocketAddress
+{
+public:
+    SocketAddress(nsapi_addr_t addr = nsapi_addr_t(), uint16_t port = 0) : _addr(addr), _port(port) {}
+
+    SocketAddress(const char *addr, uint16_t port = 0) : _addr(), _port(port)
+    {
+        set_ip_address(addr);
+    }
+
+    // false, leaving the address unset, for anything but a dotted IPv4 address
+    bool set_ip_address(const char *addr)
+    {
+        memset(&_addr, 0, sizeof(_addr));
+        if (addr == NULL || inet_pton(AF_INET, addr, _addr.bytes) != 1)
+        {
+            return false;
+        }
+        _addr.version = NSAPI_IPv4;
+        return true;
+    }
+
+    const char *get_ip_address() const
+    {
+        if (_addr.version == NSAPI_UNSPEC)
+        {
+            return NULL;
+        }
+        inet_ntop(AF_INET, _addr.bytes, _text, sizeof(_text));
+        return _text;
+    }
+
+    void set_addr(nsapi_addr_t addr) { _addr = addr; }
+    nsapi_addr_t get_addr() const { return _addr; }
+    void set_port(uint16_t port) { _port = port; }
+    uint16_t get_port() const { return _port; }
+
+    operator bool() const { return _addr.version != NSAPI_UNSPEC; }
+
+private:
+    nsapi_addr_t _addr;
+    uint16_t _port;
+    mutable char _text[NSAPI_IPv4_SIZE];
+};
+
+#endif  // HOST_SOCKET_ADDRESS_H
@@ -0,0 +1,15 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Host stand-in for SystemWiFi.h: the "Wi-Fi" is the host's loopback
+// interface and is always up.
+
+#ifndef HOST_SYSTEM_WIFI_H
+#define HOST_SYSTEM_WIFI_H
+
+#include "mbed.h"
+#include "Socket.h"
+
+NetworkInterface *WiFiInterface(void);
+
+#endif  // HOST_SYSTEM_WIFI_H
@@ -0,0 +1,74 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Host stand-in for mbed OS's TCPServer, see Socket.h. bind() takes the port
+// on the loopback address.
+
+#ifndef HOST_TCP_SERVER_H
+#define HOST_TCP_SERVER_H
+
+#include "TCPSocket.h"
+
+class TCPServer : public Socket
+{
+public:
+    TCPServer() {}
+
+    nsapi_error_t open(NetworkInterface *iface)
+    {
+        (void)iface;
+        nsapi_error_t ret = open_fd(SOCK_STREAM);
+        if (ret == NSAPI_ERROR_OK)
+        {
+            int one = 1;
+            setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        }
+        return ret;
+    }
+
+    nsapi_error_t bind(uint16_t port)
+    {
+        struct sockaddr_in addr;
+        loopback(&addr, port);
+        if (_fd < 0)
+        {
+            return NSAPI_ERROR_NO_SOCKET;
+        }
+        return ::bind(_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 ? NSAPI_ERROR_OK : NSAPI_ERROR_PARAMETER;
+    }
+
+    nsapi_error_t listen(int backlog = 1)
+    {
+        if (_fd < 0)
+        {
+            return NSAPI_ERROR_NO_SOCKET;
+        }
+        return ::listen(_fd, backlog) == 0 ? NSAPI_ERROR_OK : NSAPI_ERROR_PARAMETER;
+    }
+
+    // the connection replaces whatever socket was open in *connection
+    nsapi_error_t accept(TCPSocket *connection)
+    {
+        host_socket_stats.accept_calls++;
+        if (_fd < 0)
+        {
+            return NSAPI_ERROR_NO_SOCKET;
+        }
+        if (!wait(POLLIN))
+        {
+            return NSAPI_ERROR_WOULD_BLOCK;
+        }
+        int fd = ::accept(_fd, NULL, NULL);
+        if (fd < 0)
+        {
+            return result(fd);
+        }
+        connection->close();
+        connection->_fd = fd;
+        connection->_timeout_ms = -1;
+        connection->no_delay();
+        return NSAPI_ERROR_OK;
+    }
+};
+
+#endif  // HOST_TCP_SERVER_H
@@ -0,0 +1,92 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Host stand-in for mbed OS's TCPSocket, see Socket.h. connect() takes a
+// dotted IPv4 address; there is no DNS.
+
+#ifndef HOST_TCP_SOCKET_H
+#define HOST_TCP_SOCKET_H
+
+#include <string.h>
+#include "Socket.h"
+
+class TCPServer;
+
+class TCPSocket : public Socket
+{
+public:
+    TCPSocket() {}
+    TCPSocket(NetworkInterface *iface) { open(iface); }
+
+    nsapi_error_t open(NetworkInterface *iface)
+    {
+        (void)iface;
+        return open_fd(SOCK_STREAM);
+    }
+
+    nsapi_error_t connect(const char *host, uint16_t port)
+    {
+        struct sockaddr_in addr;
+        loopback(&addr, port);
+        if (_fd < 0)
+        {
+            return NSAPI_ERROR_NO_SOCKET;
+        }
+        if (host == NULL || inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+        {
+            return NSAPI_ERROR_DNS_FAILURE;
+        }
+        if (::connect(_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            return NSAPI_ERROR_NO_CONNECTION;
+        }
+        no_delay();
+        return NSAPI_ERROR_OK;
+    }
+
+    // send(NULL, 0) tells an open socket (0) from a closed one
+    nsapi_size_or_error_t send(const void *data, nsapi_size_t size)
+    {
+        host_socket_stats.send_calls++;
+        if (_fd < 0)
+        {
+            return NSAPI_ERROR_NO_SOCKET;
+        }
+        if (size == 0)
+        {
+            return 0;
+        }
+        if (!wait(POLLOUT))
+        {
+            return NSAPI_ERROR_WOULD_BLOCK;
+        }
+        return result(::send(_fd, data, size, MSG_NOSIGNAL | MSG_DONTWAIT));
+    }
+
+    // 0 once the peer has closed the connection
+    nsapi_size_or_error_t recv(void *data, nsapi_size_t size)
+    {
+        host_socket_stats.recv_calls++;
+        if (_fd < 0)
+        {
+            return NSAPI_ERROR_NO_SOCKET;
+        }
+        if (!wait(POLLIN))
+        {
+            return NSAPI_ERROR_WOULD_BLOCK;
+        }
+        return result(::recv(_fd, data, size, MSG_DONTWAIT));
+    }
+
+private:
+    friend class TCPServer;
+
+    // small writes go out at once, as lwIP does on the device
+    void no_delay()
+    {
+        int one = 1;
+        setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+};
+
+#endif  // HOST_TCP_SOCKET_H
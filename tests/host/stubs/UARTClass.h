@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Host stand-in for the Serial port: everything written is kept in output,
+// and each bulk write is counted.
+
+#ifndef HOST_UART_CLASS_H
+#define HOST_UART_CLASS_H
+
+#include "Print.h"
+#include <string>
+
+class UARTClass : public Print
+{
+public:
+    UARTClass() : writes(0) {}
+
+    using Print::write;
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size)
+    {
+        std::lock_guard<std::mutex> hold(_lock);
+        output.append((const char *)buffer, size);
+        writes++;
+        return size;
+    }
+
+    void drain() {}
+
+    std::string output;
+    unsigned long writes;
+
+private:
+    std::mutex _lock;
+};
+
+#endif  // HOST_UART_CLASS_H
@@ -0,0 +1,78 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Host stand-in for mbed OS's UDPSocket, see Socket.h. bind() takes the port
+// on the loopback address.
+
+#ifndef HOST_UDP_SOCKET_H
+#define HOST_UDP_SOCKET_H
+
+#include "Socket.h"
+
+class UDPSocket : public Socket
+{
+public:
+    UDPSocket() {}
+
+    nsapi_error_t open(NetworkInterface *iface)
+    {
+        (void)iface;
+        return open_fd(SOCK_DGRAM);
+    }
+
+    nsapi_error_t bind(uint16_t port)
+    {
+        struct sockaddr_in addr;
+        loopback(&addr, port);
+        if (_fd < 0)
+        {
+            return NSAPI_ERROR_NO_SOCKET;
+        }
+        return ::bind(_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 ? NSAPI_ERROR_OK : NSAPI_ERROR_PARAMETER;
+    }
+
+    nsapi_size_or_error_t sendto(const SocketAddress &address, const void *data, nsapi_size_t size)
+    {
+        host_socket_stats.sendto_calls++;
+        if (_fd < 0)
+        {
+            return NSAPI_ERROR_NO_SOCKET;
+        }
+        struct sockaddr_in addr;
+        loopback(&addr, address.get_port());
+        memcpy(&addr.sin_addr, address.get_addr().bytes, 4);
+        if (!wait(POLLOUT))
+        {
+            return NSAPI_ERROR_WOULD_BLOCK;
+        }
+        return result(::sendto(_fd, data, size, MSG_DONTWAIT, (struct sockaddr *)&addr, sizeof(addr)));
+    }
+
+    // one datagram; the part that does not fit in size is dropped
+    nsapi_size_or_error_t recvfrom(SocketAddress *address, void *data, nsapi_size_t size)
+    {
+        host_socket_stats.recvfrom_calls++;
+        if (_fd < 0)
+        {
+            return NSAPI_ERROR_NO_SOCKET;
+        }
+        if (!wait(POLLIN))
+        {
+            return NSAPI_ERROR_WOULD_BLOCK;
+        }
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        ssize_t ret = ::recvfrom(_fd, data, size, MSG_DONTWAIT, (struct sockaddr *)&addr, &addr_len);
+        if (ret >= 0 && address != NULL)
+        {
+            nsapi_addr_t ip = nsapi_addr_t();
+            ip.version = NSAPI_IPv4;
+            memcpy(ip.bytes, &addr.sin_addr, 4);
+            address->set_addr(ip);
+            address->set_port(ntohs(addr.sin_port));
+        }
+        return result(ret);
+    }
+};
+
+#endif  // HOST_UDP_SOCKET_H
@@ -0,0 +1,14 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// The loopback "network" behind the socket stand-ins.
+
+#include "SystemWiFi.h"
+
+host_socket_stats_t host_socket_stats;
+
+NetworkInterface *WiFiInterface(void)
+{
+    static NetworkInterface loopback;
+    return &loopback;
+}
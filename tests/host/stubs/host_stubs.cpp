@@ -0,0 +1,71 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Host versions of the newlib extensions and wiring calls declared in the
+// stand-in Arduino.h.
+
+#include "Arduino.h"
+#include <unistd.h>
+
+UARTClass Serial;
+
+static char *host_ultoa(unsigned long value, char *s, int radix, bool negative)
+{
+    char tmp[sizeof(unsigned long) * 8 + 1];
+    int n = 0;
+    do
+    {
+        int d = value % radix;
+        tmp[n++] = d < 10 ? '0' + d : 'a' + d - 10;
+        value /= radix;
+    } while (value);
+
+    char *p = s;
+    if (negative)
+    {
+        *p++ = '-';
+    }
+    while (n > 0)
+    {
+        *p++ = tmp[--n];
+    }
+    *p = 0;
+    return s;
+}
+
+extern "C" char *itoa(int value, char *s, int radix)
+{
+    bool negative = radix == 10 && value < 0;
+    return host_ultoa(negative ? 0u - (unsigned int)value : (unsigned int)value, s, radix, negative);
+}
+
+extern "C" char *ltoa(long value, char *s, int radix)
+{
+    // like newlib, only base 10 is signed
+    bool negative = radix == 10 && value < 0;
+    return host_ultoa(negative ? 0ul - (unsigned long)value : (unsigned long)value, s, radix, negative);
+}
+
+extern "C" char *utoa(unsigned int value, char *s, int radix)
+{
+    return host_ultoa(value, s, radix, false);
+}
+
+extern "C" char *ultoa(unsigned long value, char *s, int radix)
+{
+    return host_ultoa(value, s, radix, false);
+}
+
+void delay(uint32_t ms)
+{
+    usleep(ms * 1000);
+}
+
+unsigned long millis(void)
+{
+    return (unsigned long)(host_now_us() / 1000);
+}
+
+extern "C" void yield(void)
+{
+}
@@ -0,0 +1,98 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Host stand-in for the parts of mbed OS the code under test uses.
+
+#ifndef HOST_MBED_H
+#define HOST_MBED_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <mutex>
+#include <thread>
+
+static inline uint64_t host_now_us(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000ull + t.tv_nsec / 1000;
+}
+
+class Timer
+{
+public:
+    Timer() : _start(0) {}
+    void start() { _start = host_now_us(); }
+    void reset() { _start = host_now_us(); }
+    int read_ms() { return (int)((host_now_us() - _start) / 1000); }
+    int read_us() { return (int)(host_now_us() - _start); }
+
+private:
+    uint64_t _start;
+};
+
+static inline uint32_t us_ticker_read(void)
+{
+    return (uint32_t)host_now_us();
+}
+
+// the host code always runs in "thread mode" with interrupts enabled
+static inline uint32_t __get_IPSR(void) { return 0; }
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+
+typedef enum
+{
+    osPriorityIdle = -3,
+    osPriorityLow = -2,
+    osPriorityBelowNormal = -1,
+    osPriorityNormal = 0,
+    osPriorityAboveNormal = 1,
+    osPriorityHigh = 2,
+    osPriorityRealtime = 3
+} osPriority;
+
+class Mutex
+{
+public:
+    void lock() { _mutex.lock(); }
+    void unlock() { _mutex.unlock(); }
+
+private:
+    std::recursive_mutex _mutex;
+};
+
+// runs the task on a detached std::thread
+class Thread
+{
+public:
+    Thread(osPriority priority = osPriorityNormal, uint32_t stack_size = 0, unsigned char *stack_mem = NULL)
+        : _id(0)
+    {
+        (void)priority;
+        (void)stack_size;
+        (void)stack_mem;
+    }
+
+    void start(void (*task)(void))
+    {
+        static uint32_t next_id = 1;
+        _id = next_id++;
+        std::thread(task).detach();
+    }
+
+    uint32_t gettid() { return _id; }
+
+    static void wait(uint32_t ms) { usleep(ms * 1000); }
+    static void yield() { sched_yield(); }
+
+private:
+    uint32_t _id;
+};
+
+#endif  // HOST_MBED_H
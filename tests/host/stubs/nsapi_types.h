@@ -0,0 +1,49 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Host stand-in for mbed OS's nsapi_types.h: the error codes and size types
+// the socket stand-ins return.
+
+#ifndef HOST_NSAPI_TYPES_H
+#define HOST_NSAPI_TYPES_H
+
+#include <stdint.h>
+
+enum nsapi_error
+{
+    NSAPI_ERROR_OK            =  0,
+    NSAPI_ERROR_WOULD_BLOCK   = -3001,
+    NSAPI_ERROR_UNSUPPORTED   = -3002,
+    NSAPI_ERROR_PARAMETER     = -3003,
+    NSAPI_ERROR_NO_CONNECTION = -3004,
+    NSAPI_ERROR_NO_SOCKET     = -3005,
+    NSAPI_ERROR_NO_ADDRESS    = -3006,
+    NSAPI_ERROR_NO_MEMORY     = -3007,
+    NSAPI_ERROR_DNS_FAILURE   = -3009,
+    NSAPI_ERROR_DEVICE_ERROR  = -3012,
+    NSAPI_ERROR_IN_PROGRESS   = -3013,
+    NSAPI_ERROR_ALREADY       = -3014,
+    NSAPI_ERROR_IS_CONNECTED  = -3015,
+};
+
+typedef signed int nsapi_error_t;
+typedef unsigned int nsapi_size_t;
+typedef signed int nsapi_size_or_error_t;
+
+#define NSAPI_IPv4_SIZE     16
+#define NSAPI_IP_BYTES      16
+
+typedef enum nsapi_version
+{
+    NSAPI_UNSPEC,
+    NSAPI_IPv4,
+    NSAPI_IPv6,
+} nsapi_version_t;
+
+typedef struct nsapi_addr
+{
+    nsapi_version_t version;
+    uint8_t bytes[NSAPI_IP_BYTES];
+} nsapi_addr_t;
+
+#endif  // HOST_NSAPI_TYPES_H
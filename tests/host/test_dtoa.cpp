@@ -0,0 +1,94 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Checks dtoa_fixed() (floatIO.c) against the C library's "%.*f" for float32
+// bit patterns at precisions 0-9, then random doubles at precisions 0-17.
+//
+//   test_dtoa [step]   visit every step-th float bit pattern (default 4099);
+//                      step 1 is the exhaustive run over all 2^32 patterns,
+//                      which takes a while.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "floatIO.h"
+
+static unsigned long g_checked, g_failed;
+
+static void check(double d, int prec)
+{
+    char got[64], want[64];
+
+    dtoa_fixed(d, prec, got);
+    snprintf(want, sizeof(want), "%.*f", prec, d);
+    g_checked++;
+    if (strcmp(got, want) != 0 && g_failed++ < 20)
+    {
+        printf("FAIL %a prec %d: got %s, want %s\n", d, prec, got, want);
+    }
+}
+
+static void expect(double d, int prec, const char *want)
+{
+    char got[64];
+
+    dtoa_fixed(d, prec, got);
+    g_checked++;
+    if (strcmp(got, want) != 0 && g_failed++ < 20)
+    {
+        printf("FAIL %a prec %d: got %s, want %s\n", d, prec, got, want);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t step = argc > 1 ? strtoull(argv[1], NULL, 0) : 4099;
+
+    // outside printf's agreement: no "-" on zero, and the 32-bit range
+    expect(NAN, 2, "nan");
+    expect(INFINITY, 2, "inf");
+    expect(-INFINITY, 2, "inf");
+    expect(4294967296.0, 2, "ovf");
+    expect(-4294967296.0, 0, "ovf");
+    expect(-0.0, 2, "0.00");
+    expect(9.995, 2, "9.99");       // 9.9949999... in binary
+    expect(9.9951, 2, "10.00");
+    expect(0.125, 2, "0.12");       // exact tie, even digit kept
+    expect(0.375, 2, "0.38");
+
+    for (uint64_t u = 0; u <= 0xffffffffull; u += step)
+    {
+        uint32_t w = (uint32_t)u;
+        float f;
+        memcpy(&f, &w, sizeof(f));
+        if (isnan(f) || isinf(f) || fabsf(f) > 4294967040.0f || f == 0.0f)
+        {
+            continue;
+        }
+        for (int prec = 0; prec <= 9; prec++)
+        {
+            check(f, prec);
+        }
+    }
+
+    srand(1);
+    for (int i = 0; i < 1000000; i++)
+    {
+        double d = ((double)rand() / RAND_MAX - 0.5) * pow(10, rand() % 20 - 10);
+        check(d, rand() % 18);
+    }
+
+    char buf[DTOA_FIXED_SIZE(3)];
+    g_checked += 2;
+    if (strcmp(dtostrf(-12.3456, 8, 3, buf), "-12.346") != 0 || strcmp(f2s(1.5f, 1), "1.5") != 0)
+    {
+        printf("FAIL dtostrf/f2s\n");
+        g_failed++;
+    }
+
+    printf("%lu checked, %lu failed\n", g_checked, g_failed);
+    return g_failed != 0;
+}
@@ -0,0 +1,205 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// MemoryProfiler.cpp built for the host (its non-__MBED__ path) over an
+// interposed malloc that can be told to fail: per-tag counters through
+// malloc/calloc/realloc/free, failures, the whole-heap sum, thread names and
+// the table and JSON reports.
+
+#include "Arduino.h"
+#include "MemoryProfiler.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+// the next g_fail_after allocations succeed, the one after fails
+static volatile long g_fail_after = -1;
+static volatile unsigned long g_heap_calls;
+
+static bool should_fail(void)
+{
+    if (g_fail_after < 0)
+    {
+        return false;
+    }
+    return g_fail_after-- == 0;
+}
+
+extern "C" void *malloc(size_t size)
+{
+    g_heap_calls++;
+    return should_fail() ? NULL : __libc_malloc(size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    g_heap_calls++;
+    return should_fail() ? NULL : __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+static int g_failed;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL line %d: %s\n", __LINE__, #cond); \
+            g_failed++; \
+        } \
+    } while (0)
+
+static mem_stats_t tag_stats(uint8_t tag)
+{
+    mem_stats_t s;
+    mem_profile_tag(tag, &s);
+    return s;
+}
+
+static void test_counters(void)
+{
+    void *a = mem_profile_malloc(MEM_TAG_TLS, 100);
+    void *b = mem_profile_calloc(MEM_TAG_MQTT, 4, 64);
+    CHECK(a != NULL && b != NULL);
+    CHECK(((uintptr_t)a & 7) == 0);
+
+    bool zeroed = true;
+    for (int i = 0; i < 256; i++)
+    {
+        zeroed = zeroed && ((uint8_t *)b)[i] == 0;
+    }
+    CHECK(zeroed);
+
+    mem_stats_t tls = tag_stats(MEM_TAG_TLS);
+    CHECK(tls.current == 100 && tls.peak == 100 && tls.total == 100 && tls.count == 1 && tls.allocs == 1);
+    mem_stats_t mqtt = tag_stats(MEM_TAG_MQTT);
+    CHECK(mqtt.current == 256 && mqtt.count == 1);
+
+    // growing moves the bytes, a retag moves the block between tags
+    memset(a, 0x5a, 100);
+    a = mem_profile_realloc(MEM_TAG_TLS, a, 1000);
+    CHECK(a != NULL && ((uint8_t *)a)[99] == 0x5a);
+    tls = tag_stats(MEM_TAG_TLS);
+    CHECK(tls.current == 1000 && tls.peak == 1000 && tls.total == 1100 && tls.count == 1 && tls.allocs == 2);
+
+    b = mem_profile_realloc(MEM_TAG_HTTP, b, 32);
+    CHECK(tag_stats(MEM_TAG_MQTT).current == 0 && tag_stats(MEM_TAG_MQTT).count == 0);
+    CHECK(tag_stats(MEM_TAG_HTTP).current == 32);
+
+    // the host whole-heap figures are the sum of the tags
+    mem_stats_t heap;
+    uint32_t reserved = 1;
+    mem_profile_heap(&heap, &reserved);
+    CHECK(heap.current == 1032 && heap.count == 2 && reserved == 0);
+
+    mem_profile_free(a);
+    mem_profile_free(b);
+    mem_profile_free(NULL);
+    CHECK(tag_stats(MEM_TAG_TLS).current == 0 && tag_stats(MEM_TAG_TLS).peak == 1000);
+    mem_profile_reset_peaks();
+    CHECK(tag_stats(MEM_TAG_TLS).peak == 0);
+
+    // out of range tags are counted as "other"
+    void *c = mem_profile_malloc(200, 8);
+    CHECK(tag_stats(MEM_TAG_OTHER).current == 8);
+    mem_profile_free(c);
+    CHECK(tag_stats(MEM_TAG_OTHER).current == 0);
+}
+
+static void test_failures(void)
+{
+    uint32_t fails = tag_stats(MEM_TAG_WIFI).fails;
+
+    g_fail_after = 0;
+    CHECK(mem_profile_malloc(MEM_TAG_WIFI, 64) == NULL);
+    CHECK(tag_stats(MEM_TAG_WIFI).fails == fails + 1 && tag_stats(MEM_TAG_WIFI).current == 0);
+
+    // a failed realloc leaves the block and its counters as they were
+    void *p = mem_profile_malloc(MEM_TAG_WIFI, 64);
+    memset(p, 0x11, 64);
+    g_fail_after = 0;
+    CHECK(mem_profile_realloc(MEM_TAG_WIFI, p, 4096) == NULL);
+    CHECK(((uint8_t *)p)[63] == 0x11);
+    CHECK(tag_stats(MEM_TAG_WIFI).current == 64 && tag_stats(MEM_TAG_WIFI).fails == fails + 2);
+    mem_profile_free(p);
+
+    // calloc overflow is refused without calling malloc
+    unsigned long calls = g_heap_calls;
+    CHECK(mem_profile_calloc(MEM_TAG_WIFI, SIZE_MAX / 2, 4) == NULL);
+    CHECK(g_heap_calls == calls && tag_stats(MEM_TAG_WIFI).fails == fails + 3);
+
+    CHECK(mem_profile_realloc(MEM_TAG_WIFI, mem_profile_malloc(MEM_TAG_WIFI, 8), 0) == NULL);
+    CHECK(tag_stats(MEM_TAG_WIFI).current == 0 && tag_stats(MEM_TAG_WIFI).count == 0);
+}
+
+static void test_threads(void)
+{
+    mem_stats_t before = tag_stats(MEM_TAG_USER);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.push_back(std::thread([]() {
+            for (int i = 0; i < 50000; i++)
+            {
+                void *p = mem_profile_malloc(MEM_TAG_USER, i % 300 + 1);
+                mem_profile_free(p);
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+    }
+
+    mem_stats_t after = tag_stats(MEM_TAG_USER);
+    CHECK(after.current == 0 && after.count == 0);
+    CHECK(after.allocs - before.allocs == 4 * 50000);
+    CHECK(after.peak <= 4 * 300);
+}
+
+static void test_report(void)
+{
+    mem_profile_name_thread(7, "arduino");
+    mem_profile_name_thread(7, "renamed");
+    mem_profile_name_thread(0, "ignored");
+
+    mem_stack_stats_t stacks[4];
+    CHECK(mem_profile_stacks(stacks, 4) == 0);
+    mem_free_stats_t free_stats;
+    mem_profile_free_blocks(&free_stats);
+    CHECK(free_stats.free_blocks == 0 && free_stats.largest == 0);
+
+    void *p = mem_profile_malloc(MEM_TAG_TLS, 512);
+    Serial.output.clear();
+    mem_profile_print(Serial, true);
+    std::string json = Serial.output;
+    CHECK(json.compare(0, 14, "{\"reserved\":0,") == 0);
+    CHECK(json.find("\"tls\":{\"current\":512,") != std::string::npos);
+    CHECK(json.find("\"histogram\":[0,0,0,0,0,0,0,0,0,0,0,0]") != std::string::npos);
+    CHECK(json.find("\"stacks\":[]}\r\n") != std::string::npos);
+
+    Serial.output.clear();
+    mem_profile_print(Serial, false);
+    CHECK(Serial.output.compare(0, 20, "Heap: 512 bytes in u") == 0);
+    CHECK(Serial.output.find("  tls         512") != std::string::npos);
+    mem_profile_free(p);
+}
+
+int main(void)
+{
+    test_counters();
+    test_failures();
+    test_threads();
+    test_report();
+
+    printf("%s\n", g_failed ? "FAILED" : "ok");
+    return g_failed != 0;
+}
@@ -0,0 +1,199 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// PubSubClient's incremental decoder over the in-memory LoopbackClient, with
+// and without peekBuffered(): an inbound PUBLISH split at every kind of
+// boundary while publish() and a keepalive ping go out in between, and
+// packets fed one byte per loop() (QoS 0 and 1, streamed, oversized, broker
+// pings, an invalid remaining length).
+
+#include "Arduino.h"
+#include "PubSubClient.h"
+#include "loopback_client.h"
+
+#include <string>
+
+#define TOPIC_IN    "devices/az3166/messages/devicebound"
+#define TOPIC_OUT   "devices/az3166/messages/events"
+
+static int g_failed;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL line %d: %s\n", __LINE__, #cond); \
+            g_failed++; \
+        } \
+    } while (0)
+
+static int g_messages;
+static std::string g_topic, g_payload;
+
+static void on_message(char *topic, uint8_t *payload, unsigned int length)
+{
+    g_messages++;
+    g_topic = topic;
+    g_payload.assign((const char *)payload, length);
+}
+
+class StringStream : public Stream
+{
+public:
+    size_t write(uint8_t b) { data += (char)b; return 1; }
+    size_t write(const uint8_t *buf, size_t size) { data.append((const char *)buf, size); return size; }
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+    void flush() {}
+
+    std::string data;
+};
+
+static bool ends_with(const std::vector<uint8_t> &v, const uint8_t *tail, size_t n)
+{
+    return v.size() >= n && memcmp(v.data() + v.size() - n, tail, n) == 0;
+}
+
+static bool connect(LoopbackClient &client, PubSubClient &mqtt, uint16_t buffer_size)
+{
+    static const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    client.rx.insert(client.rx.end(), connack, connack + sizeof(connack));
+    client.deliver(sizeof(connack));
+    mqtt.setServer("loopback", 1883);
+    mqtt.setCallback(on_message);
+    mqtt.setBufferSize(buffer_size);
+    bool ok = mqtt.connect("az3166");
+    client.tx.clear();
+    g_messages = 0;
+    return ok;
+}
+
+// A QoS 1 PUBLISH arrives in two parts; between them the sketch publishes
+// and loop() sends a ping, both built in the outgoing buffer.
+static void test_interleaved(bool bulk)
+{
+    std::vector<uint8_t> packet;
+    loopback_publish(packet, TOPIC_IN, 200, 'i', 1, 0x1234);
+    const size_t splits[] = { 1, 2, 3, 7, 12, packet.size() - 50, packet.size() - 1 };
+
+    for (size_t i = 0; i < sizeof(splits) / sizeof(splits[0]); i++)
+    {
+        LoopbackClient client(bulk);
+        PubSubClient mqtt(client);
+        CHECK(connect(client, mqtt, 512));
+
+        client.rx.insert(client.rx.end(), packet.begin(), packet.end());
+        client.deliver(splits[i]);
+        CHECK(mqtt.loop());
+        CHECK(g_messages == 0);
+
+        std::string out(150, 'o');
+        CHECK(mqtt.publish(TOPIC_OUT, out.c_str()));
+        std::vector<uint8_t> expect;
+        loopback_publish(expect, TOPIC_OUT, out.size(), 'o');
+        CHECK(ends_with(client.tx, expect.data(), expect.size()));
+
+        mqtt.setKeepAlive(0);
+        delay(2);
+        CHECK(mqtt.loop());
+        mqtt.setKeepAlive(MQTT_KEEPALIVE);
+        static const uint8_t pingreq[] = { 0xC0, 0x00 };
+        CHECK(ends_with(client.tx, pingreq, sizeof(pingreq)));
+
+        // the rest of the PUBLISH, and the broker's answer to the ping
+        client.rx.push_back(0xD0);
+        client.rx.push_back(0x00);
+        client.deliver(client.rx.size());
+        CHECK(mqtt.loop());
+        CHECK(g_messages == 1);
+        CHECK(g_topic == TOPIC_IN);
+        CHECK(g_payload == std::string(200, 'i'));
+        static const uint8_t puback[] = { 0x40, 0x02, 0x12, 0x34 };
+        CHECK(ends_with(client.tx, puback, sizeof(puback)));
+        CHECK(mqtt.connected());
+        if (g_failed)
+        {
+            printf("  %s client, split after %zu bytes\n", bulk ? "bulk" : "read", splits[i]);
+            return;
+        }
+    }
+}
+
+// Feeds client.rx one byte per loop(); returns false if the connection dropped
+static bool feed_bytes(LoopbackClient &client, PubSubClient &mqtt)
+{
+    while (client.arrived < client.rx.size())
+    {
+        client.deliver(1);
+        if (!mqtt.loop())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_byte_at_a_time(bool bulk)
+{
+    // QoS 1, a payload larger than the buffer (streamed) and a small one
+    {
+        LoopbackClient client(bulk);
+        PubSubClient mqtt(client);
+        StringStream stream;
+        mqtt.setStream(stream);
+        CHECK(connect(client, mqtt, 256));
+
+        loopback_publish(client.rx, TOPIC_IN, 100, 'a', 1, 0x0102);
+        loopback_publish(client.rx, TOPIC_IN, 1000, 'b');
+        loopback_publish(client.rx, TOPIC_IN, 5, 'c');
+        CHECK(feed_bytes(client, mqtt));
+        CHECK(g_messages == 3);
+        CHECK(g_payload == "ccccc");
+        CHECK(stream.data == std::string(100, 'a') + std::string(1000, 'b') + "ccccc");
+        static const uint8_t puback[] = { 0x40, 0x02, 0x01, 0x02 };
+        CHECK(client.tx.size() == sizeof(puback) && ends_with(client.tx, puback, sizeof(puback)));
+    }
+
+    // without a stream an oversized packet is skipped and the next one is whole;
+    // a ping from the broker is answered
+    {
+        LoopbackClient client(bulk);
+        PubSubClient mqtt(client);
+        CHECK(connect(client, mqtt, 256));
+
+        loopback_publish(client.rx, TOPIC_IN, 1000, 'b');
+        loopback_publish(client.rx, TOPIC_IN, 7, 'd');
+        client.rx.push_back(0xC0);
+        client.rx.push_back(0x00);
+        CHECK(feed_bytes(client, mqtt));
+        CHECK(g_messages == 1);
+        CHECK(g_topic == TOPIC_IN);
+        CHECK(g_payload == "ddddddd");
+        static const uint8_t pingresp[] = { 0xD0, 0x00 };
+        CHECK(client.tx.size() == sizeof(pingresp) && ends_with(client.tx, pingresp, sizeof(pingresp)));
+    }
+
+    // a remaining length of more than four bytes drops the connection
+    {
+        LoopbackClient client(bulk);
+        PubSubClient mqtt(client);
+        CHECK(connect(client, mqtt, 256));
+
+        static const uint8_t invalid[] = { 0x30, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 };
+        client.rx.insert(client.rx.end(), invalid, invalid + sizeof(invalid));
+        CHECK(!feed_bytes(client, mqtt));
+        CHECK(mqtt.state() == MQTT_DISCONNECTED);
+        CHECK(g_messages == 0);
+    }
+}
+
+int main(void)
+{
+    test_interleaved(true);
+    test_interleaved(false);
+    test_byte_at_a_time(true);
+    test_byte_at_a_time(false);
+
+    printf("%s\n", g_failed ? "FAILED" : "ok");
+    return g_failed != 0;
+}
@@ -0,0 +1,136 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+
+// Deferred logger (SerialLog.cpp): formatted lines match snprintf, long
+// strings are cut with a "..." marker, errors stay deferred until a flush,
+// and concurrent producers lose nothing without counting it as dropped.
+
+#include "Arduino.h"
+#include "SerialLog.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int g_failed;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL line %d: %s\n", __LINE__, #cond); \
+            g_failed++; \
+        } \
+    } while (0)
+
+static std::string take_output(void)
+{
+    serial_log_flush();
+    std::string out = Serial.output;
+    Serial.output.clear();
+    return out;
+}
+
+static void test_parity(void)
+{
+    char want[256];
+    snprintf(want, sizeof(want), "%-*d|%*.*ld|%08.3f|%+5lld %zu %hhd %#x|%%|%5s|%.2s|%c",
+             -7, 42, 5, 3, 9L, 3.14159, -7LL, (size_t)9, 300, 255, "ab", "xyz", 'Q');
+    serial_xlog("%-*d|%*.*ld|%08.3f|%+5lld %zu %hhd %#x|%%|%5s|%.2s|%c",
+                -7, 42, 5, 3, 9L, 3.14159, -7LL, (size_t)9, 300, 255, "ab", "xyz", 'Q');
+    CHECK(take_output() == want);
+
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_TLS, "TCP connect failed: %d", -3005);
+    CHECK(take_output() == "[TLS] TCP connect failed: -3005\r\n");
+}
+
+static void test_strings_copied(void)
+{
+    char topic[16];
+    strcpy(topic, "devices/a");
+    SERIAL_LOG_INFO(SERIAL_LOG_MODULE_AZUREIOT, "topic %s", topic);
+    strcpy(topic, "CHANGED");
+    CHECK(take_output() == "[AzureIoT] topic devices/a\r\n");
+}
+
+static void test_truncation(void)
+{
+    std::string fits(SERIAL_LOG_STRING_MAX, 'a');
+    std::string longer(SERIAL_LOG_STRING_MAX + 1, 'b');
+
+    serial_xlog("%s|", fits.c_str());
+    CHECK(take_output() == fits + "|");
+
+    serial_xlog("%s|", longer.c_str());
+    CHECK(take_output() == std::string(SERIAL_LOG_STRING_MAX - 3, 'b') + "...|");
+}
+
+static void test_error_deferred(void)
+{
+    SERIAL_LOG_ERROR(SERIAL_LOG_MODULE_DPS, "registration failed %d", 401);
+    CHECK(Serial.output.empty());
+    CHECK(take_output() == "[DPS] registration failed 401\r\n");
+}
+
+static void test_producers(void)
+{
+    uint32_t dropped = serial_log_dropped();
+    volatile bool stop = false;
+
+    std::thread consumer([&stop]() {
+        while (!stop)
+        {
+            serial_log_flush();
+        }
+        serial_log_flush();
+    });
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; t++)
+    {
+        producers.push_back(std::thread([t]() {
+            for (int i = 0; i < 20000; i++)
+            {
+                SERIAL_LOG_INFO(SERIAL_LOG_MODULE_TLS, "t%d n%d", t, i);
+            }
+        }));
+    }
+    for (size_t i = 0; i < producers.size(); i++)
+    {
+        producers[i].join();
+    }
+    stop = true;
+    consumer.join();
+
+    std::string out = take_output();
+    size_t lines = 0;
+    size_t bad = 0;
+    for (size_t pos = 0; pos < out.size(); )
+    {
+        size_t end = out.find('\n', pos);
+        std::string line = out.substr(pos, end - pos);
+        int t, n;
+        if (sscanf(line.c_str(), "[TLS] t%d n%d", &t, &n) == 2)
+        {
+            lines++;
+        }
+        else if (line.compare(0, 5, "[log]") != 0)
+        {
+            bad++;
+        }
+        pos = end + 1;
+    }
+    CHECK(bad == 0);
+    CHECK(lines + (serial_log_dropped() - dropped) == 4 * 20000);
+}
+
+int main(void)
+{
+    test_parity();
+    test_strings_copied();
+    test_truncation();
+    test_error_deferred();
+    test_producers();
+
+    printf("%s\n", g_failed ? "FAILED" : "ok");
+    return g_failed != 0;
+}